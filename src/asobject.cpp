@@ -229,7 +229,7 @@ bool ASObject::has_valueOf()
 {
 	multiname valueOfName;
 	valueOfName.name_type=multiname::NAME_STRING;
-	valueOfName.name_s="valueOf";
+	valueOfName.setName("valueOf");
 	valueOfName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	valueOfName.ns.push_back(nsNameAndKind(AS3,NAMESPACE));
 	valueOfName.isAttribute = false;
@@ -243,7 +243,7 @@ _R<ASObject> ASObject::call_valueOf()
 {
 	multiname valueOfName;
 	valueOfName.name_type=multiname::NAME_STRING;
-	valueOfName.name_s="valueOf";
+	valueOfName.setName("valueOf");
 	valueOfName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	valueOfName.ns.push_back(nsNameAndKind(AS3,NAMESPACE));
 	valueOfName.isAttribute = false;
@@ -262,7 +262,7 @@ bool ASObject::has_toString()
 {
 	multiname toStringName;
 	toStringName.name_type=multiname::NAME_STRING;
-	toStringName.name_s="toString";
+	toStringName.setName("toString");
 	toStringName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	toStringName.ns.push_back(nsNameAndKind(AS3,NAMESPACE));
 	toStringName.isAttribute = false;
@@ -276,7 +276,7 @@ _R<ASObject> ASObject::call_toString()
 {
 	multiname toStringName;
 	toStringName.name_type=multiname::NAME_STRING;
-	toStringName.name_s="toString";
+	toStringName.setName("toString");
 	toStringName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	toStringName.ns.push_back(nsNameAndKind(AS3,NAMESPACE));
 	toStringName.isAttribute = false;
@@ -302,23 +302,18 @@ bool ASObject::isPrimitive() const
 
 variable* variables_map::findObjVar(const tiny_string& n, const nsNameAndKind& ns, TRAIT_KIND createKind, uint32_t traitKinds)
 {
-	pair<var_iterator, var_iterator> var_range=Variables.equal_range(n);
-	var_iterator ret=var_range.first;
-	for(;ret!=var_range.second;++ret)
-	{
-		if(!(ret->second.kind & traitKinds))
-			continue;
-
-		if(ret->second.ns.count(ns))
-			return &ret->second;
-	}
+	const variable_name name(n);
+	variable* ret=find(name,&ns,1,traitKinds);
+	if(ret)
+		return ret;
 
 	//Name not present, insert it if we have to create it
 	if(createKind==NO_CREATE_TRAIT)
 		return NULL;
 
-	var_iterator inserted=Variables.insert(var_range.first,make_pair(n, variable(ns, createKind)) );
-	return &inserted->second;
+	if(createKind==BORROWED_TRAIT)
+		property_cache::invalidate();
+	return insert(name,ns.nameId,createKind);
 }
 
 bool ASObject::hasPropertyByMultiname(const multiname& name, bool considerDynamic)
@@ -503,6 +498,11 @@ void ASObject::setVariableByMultiname(const multiname& name, ASObject* o, Class_
 		obj=Variables.findObjVar(name,DYNAMIC_TRAIT,DYNAMIC_TRAIT);
 	}
 
+	setVariableValue(obj, o);
+}
+
+void ASObject::setVariableValue(variable* obj, ASObject* o)
+{
 	if(obj->setter)
 	{
 		//Call the setter
@@ -523,6 +523,57 @@ void ASObject::setVariableByMultiname(const multiname& name, ASObject* o, Class_
 	}
 }
 
+void ASObject::setCachedVariableByMultiname(const multiname& name, ASObject* o, property_cache* cache)
+{
+	if(!classdef || name.name_type!=multiname::NAME_STRING || !hasDefaultPropertyLookup(NONE))
+	{
+		setVariableByMultiname(name,o);
+		return;
+	}
+
+	check();
+	property_cache::entry* e=cache->find(classdef);
+	variable* obj=NULL;
+	//The cached location is tried first, the full lookup is only done on a miss
+	if(e && e->kind==property_cache::SLOT)
+	{
+		obj=Variables.findSlotVar(e->slot, name);
+		if(obj && !(obj->setter || obj->var))
+			obj=NULL;
+	}
+	//Instances of dynamic classes may shadow a borrowed variable with their own
+	else if(e && classdef->isSealed && (e->var->setter || e->var->var))
+		obj=e->var;
+	if(obj)
+	{
+		setVariableValue(obj, o);
+		return;
+	}
+
+	obj=findSettable(name, false);
+	if(obj)
+	{
+		unsigned int slot=(name.ns.size()==1)?Variables.findSlotIndex(obj):0;
+		if(slot)
+			cache->addSlot(classdef, slot);
+	}
+	else if(e && e->kind==property_cache::BORROWED && (e->var->setter || e->var->var))
+		obj=e->var;
+	else
+	{
+		obj=classdef->findSettable(name,true);
+		if(!obj)
+		{
+			//Prototype chain, read-only properties and dynamic variables creation
+			setVariableByMultiname(name,o,classdef);
+			return;
+		}
+		cache->addBorrowed(classdef, obj);
+	}
+
+	setVariableValue(obj, o);
+}
+
 void ASObject::setVariableByQName(const tiny_string& name, const tiny_string& ns, ASObject* o, TRAIT_KIND traitKind)
 {
 	const nsNameAndKind tmpns(ns, NAMESPACE);
@@ -567,63 +618,34 @@ void variable::setVar(ASObject* v)
 	var=v;
 }
 
-template<class Set1, class Set2>
-bool is_disjoint(const Set1 &set1, const Set2 &set2)
+//n keeps the normalized name alive when mname is not a string
+static variable_name variableNameOf(const multiname& mname, tiny_string& n)
 {
-	if(set1.empty() || set2.empty()) return true;
-
-	typename Set1::const_iterator
-		it1 = set1.begin(),
-		it1End = set1.end();
-	typename Set2::const_iterator
-		it2 = set2.begin(),
-		it2End = set2.end();
-	if(*it1 > *set2.rbegin() || *it2 > *set1.rbegin()) return true;
-
-	while(it1 != it1End && it2 != it2End)
-	{
-		if(*it1 == *it2) return false;
-		if(*it1 < *it2) { it1++; }
-		else { it2++; }
-	}
-	return true;
+	if(mname.name_type==multiname::NAME_STRING)
+		return variable_name(mname.name_s,mname.name_s_id,mname.name_s_hash);
+	n=mname.normalizedName();
+	return variable_name(n);
 }
 
 void variables_map::killObjVar(const multiname& mname)
 {
-	tiny_string name=mname.normalizedName();
-	const pair<var_iterator, var_iterator> ret=Variables.equal_range(name);
-	assert_and_throw(ret.first!=ret.second);
-
-	//Find the namespace
-	var_iterator start=ret.first;
-	for(;start!=ret.second;++start)
-	{
-		if(!is_disjoint(mname.ns,start->second.ns))
-		{
-			Variables.erase(start);
-			return;
-		}
-	}
-
-	throw RunTimeException("Variable to kill not found");
+	uint32_t pos;
+	tiny_string n;
+	variable* v=find(variableNameOf(mname,n),mname.ns.data(),mname.ns.size(),
+			DECLARED_TRAIT|DYNAMIC_TRAIT|BORROWED_TRAIT,&pos);
+	if(v==NULL)
+		throw RunTimeException("Variable to kill not found");
+	erase(v,pos);
 }
 
 variable* variables_map::findObjVar(const multiname& mname, TRAIT_KIND createKind, uint32_t traitKinds)
 {
-	tiny_string name=mname.normalizedName();
-	pair<var_iterator, var_iterator> var_range=Variables.equal_range(name);
 	assert(!mname.ns.empty());
-	var_iterator ret=var_range.first;
-	for(;ret!=var_range.second;++ret)
-	{
-		if(!(ret->second.kind & traitKinds))
-			continue;
-		//Check if one the namespace is already present
-		//We can use binary search, as the namespace are ordered
-		if(!is_disjoint(mname.ns,ret->second.ns))
-			return &ret->second;
-	}
+	tiny_string n;
+	const variable_name name=variableNameOf(mname,n);
+	variable* ret=find(name,mname.ns.data(),mname.ns.size(),traitKinds);
+	if(ret)
+		return ret;
 
 	//Name not present, insert it, if the multiname has a single ns and if we have to insert it
 	if(createKind==NO_CREATE_TRAIT)
@@ -633,19 +655,16 @@ variable* variables_map::findObjVar(const multiname& mname, TRAIT_KIND createKin
 	{
 		if(mname.ns.begin()->name != "")
 			throw Class<ReferenceError>::getInstanceS("Error #1056: Trying to create a dynamic variable with namespace != \"\"");
-		var_iterator inserted=Variables.insert(ret,make_pair(name,
-					variable(nsNameAndKind("",NAMESPACE), createKind)));
-		return &inserted->second;
+		return insert(name,0,createKind);
 	}
 	assert(mname.ns.size() == 1);
-	var_iterator inserted=Variables.insert(ret,make_pair(name, variable(mname.ns[0], createKind)));
-	return &inserted->second;
+	if(createKind==BORROWED_TRAIT)
+		property_cache::invalidate();
+	return insert(name,mname.ns[0].nameId,createKind);
 }
 
 void variables_map::initializeVar(const multiname& mname, ASObject* obj, multiname* typemname)
 {
-	tiny_string name=mname.normalizedName();
-
 	const Type* type = NULL;
 	 /* If typename is resolvable right now, we coerce obj.
 	  * It it's not resolvable, then it must be a user defined class,
@@ -667,7 +686,21 @@ void variables_map::initializeVar(const multiname& mname, ASObject* obj, multina
 		obj = type->coerce(obj);
 	}
 
-	Variables.insert(make_pair(name, variable(mname.ns[0], DECLARED_TRAIT, obj, typemname, type)));
+	tiny_string n;
+	variable* v=insert(variableNameOf(mname,n),mname.ns[0].nameId,DECLARED_TRAIT);
+	v->var=obj;
+	v->typemname=typemname;
+	v->type=type;
+}
+
+variable* variables_map::copyVar(const variable& v)
+{
+	variable* ret=insert(variable_name(v.getName(),v.nameId,v.nameHash),v.nsId,v.kind);
+	//The copy owns its own name
+	tiny_string* dynamicName=ret->dynamicName;
+	*ret=v;
+	ret->dynamicName=dynamicName;
+	return ret;
 }
 
 ASFUNCTIONBODY(ASObject,generator)
@@ -709,7 +742,7 @@ ASFUNCTIONBODY(ASObject,hasOwnProperty)
 	assert_and_throw(argslen==1);
 	multiname name;
 	name.name_type=multiname::NAME_STRING;
-	name.name_s=args[0]->toString();
+	name.setName(args[0]->toString());
 	name.ns.push_back(nsNameAndKind("",NAMESPACE));
 	name.isAttribute=false;
 	if(obj->getClass())
@@ -754,7 +787,7 @@ ASFUNCTIONBODY(ASObject,propertyIsEnumerable)
 	assert_and_throw(argslen==1);
 	multiname name;
 	name.name_type=multiname::NAME_STRING;
-	name.name_s=args[0]->toString();
+	name.setName(args[0]->toString());
 	name.ns.push_back(nsNameAndKind("",NAMESPACE));
 	name.isAttribute=false;
 	unsigned int index = 0;
@@ -825,22 +858,33 @@ _NR<ASObject> ASObject::getVariableByMultiname(const multiname& name, GET_VARIAB
 	if(!obj && cls)
 	{
 		//Check prototype chain
-		ASObject* proto = cls->prototype.getPtr();
-		while(proto)
-		{
-			obj = proto->findGettable(name, false);
-			if(obj)
-			{
-				obj->var->incRef();
-				return _MNR(obj->var);
-			}
-			proto = proto->getprop_prototype();
-		}
+		return getVariableFromPrototype(name, cls);
 	}
 
 	if(!obj)
 		return NullRef;
 
+	return getVariableValue(obj, name);
+}
+
+_NR<ASObject> ASObject::getVariableFromPrototype(const multiname& name, Class_base* cls)
+{
+	ASObject* proto = cls->prototype.getPtr();
+	while(proto)
+	{
+		variable* obj = proto->findGettable(name, false);
+		if(obj)
+		{
+			obj->var->incRef();
+			return _MNR(obj->var);
+		}
+		proto = proto->getprop_prototype();
+	}
+	return NullRef;
+}
+
+_NR<ASObject> ASObject::getVariableValue(variable* obj, const multiname& name)
+{
 	if(obj->getter)
 	{
 		//Call the getter
@@ -878,6 +922,49 @@ _NR<ASObject> ASObject::getVariableByMultiname(const multiname& name, GET_VARIAB
 	}
 }
 
+_NR<ASObject> ASObject::getCachedVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt, property_cache* cache)
+{
+	if(!classdef || name.name_type!=multiname::NAME_STRING || !hasDefaultPropertyLookup(opt))
+		return getVariableByMultiname(name,opt);
+
+	check();
+	property_cache::entry* e=cache->find(classdef);
+	variable* obj=NULL;
+	//The cached location is tried first, the full lookup is only done on a miss
+	if(e && e->kind==property_cache::SLOT)
+	{
+		obj=Variables.findSlotVar(e->slot, name);
+		if(obj && !(obj->getter || obj->var))
+			obj=NULL;
+	}
+	//Instances of dynamic classes may shadow a borrowed variable with their own
+	else if(e && classdef->isSealed && (e->var->getter || e->var->var))
+		obj=e->var;
+	if(obj)
+	{
+		return getVariableValue(obj, name);
+	}
+
+	obj=findGettable(name, false);
+	if(obj)
+	{
+		unsigned int slot=(name.ns.size()==1)?Variables.findSlotIndex(obj):0;
+		if(slot)
+			cache->addSlot(classdef, slot);
+	}
+	else if(e && e->kind==property_cache::BORROWED && (e->var->getter || e->var->var))
+		obj=e->var;
+	else
+	{
+		obj=classdef->findGettable(name,true);
+		if(!obj)
+			return getVariableFromPrototype(name, classdef);
+		cache->addBorrowed(classdef, obj);
+	}
+
+	return getVariableValue(obj, name);
+}
+
 void ASObject::check() const
 {
 	//Put here a bunch of safety check on the object
@@ -889,34 +976,35 @@ void variables_map::check() const
 {
 	//Heavyweight stuff
 #ifdef EXPENSIVE_DEBUG
-	variables_map::const_var_iterator it=Variables.begin();
-	for(;it!=Variables.end();++it)
+	for(uint32_t i=0;i<used;i++)
 	{
-		variables_map::const_var_iterator next=it;
-		next++;
-		if(next==Variables.end())
-			break;
-
-		//No double definition of a single variable should exist
-		if(it->first==next->first && it->second.ns==next->second.ns)
+		const variable* v=at(i);
+		if(v->kind==NO_CREATE_TRAIT)
+			continue;
+		for(uint32_t j=i+1;j<used;j++)
 		{
-			if(it->second.var==NULL && next->second.var==NULL)
+			const variable* w=at(j);
+			//No double definition of a single variable should exist
+			if(w->kind==NO_CREATE_TRAIT || v->nsId!=w->nsId || !variable_name(v->getName(),v->nameId,v->nameHash).matches(*w))
+				continue;
+
+			if(v->var==NULL && w->var==NULL)
 				continue;
 
-			if((it->second.kind == BORROWED_TRAIT && next->second.kind != BORROWED_TRAIT)
-				|| (it->second.kind != BORROWED_TRAIT && next->second.kind == BORROWED_TRAIT))
+			if((v->kind == BORROWED_TRAIT && w->kind != BORROWED_TRAIT)
+				|| (v->kind != BORROWED_TRAIT && w->kind == BORROWED_TRAIT))
 				continue;
-			if(it->second.var==NULL || next->second.var==NULL)
+			if(v->var==NULL || w->var==NULL)
 			{
-				LOG(LOG_INFO, it->first << " " << it->second.ns);
-				LOG(LOG_INFO, it->second.var << ' ' << it->second.setter << ' ' << it->second.getter);
-				LOG(LOG_INFO, next->second.var << ' ' << next->second.setter << ' ' << next->second.getter);
+				LOG(LOG_INFO, v->getName() << " " << getInternedName(v->nsId));
+				LOG(LOG_INFO, v->var << ' ' << v->setter << ' ' << v->getter);
+				LOG(LOG_INFO, w->var << ' ' << w->setter << ' ' << w->getter);
 				abort();
 			}
 
-			if(it->second.var->getObjectType()!=T_FUNCTION || next->second.var->getObjectType()!=T_FUNCTION)
+			if(v->var->getObjectType()!=T_FUNCTION || w->var->getObjectType()!=T_FUNCTION)
 			{
-				LOG(LOG_INFO, it->first);
+				LOG(LOG_INFO, v->getName());
 				abort();
 			}
 		}
@@ -926,11 +1014,11 @@ void variables_map::check() const
 
 void variables_map::dumpVariables()
 {
-	var_iterator it=Variables.begin();
-	for(;it!=Variables.end();++it)
+	for(uint32_t i=0;i<used;i++)
 	{
+		const variable* v=at(i);
 		const char* kind;
-		switch(it->second.kind)
+		switch(v->kind)
 		{
 			case DECLARED_TRAIT:
 				kind="Declared: ";
@@ -942,34 +1030,340 @@ void variables_map::dumpVariables()
 				kind="Dynamic: ";
 				break;
 			case NO_CREATE_TRAIT:
-				kind="NoCreate: ";
-				assert(false);
+				//Erased
+				continue;
 		}
-		LOG(LOG_INFO, kind <<  '[' << it->second.ns << "] "<< it->first << ' ' <<
-			it->second.var << ' ' << it->second.setter << ' ' << it->second.getter);
+		LOG(LOG_INFO, kind <<  '[' << getInternedName(v->nsId) << "] "<< v->getName() << ' ' <<
+			v->var << ' ' << v->setter << ' ' << v->getter);
+	}
+}
+
+#ifdef PROFILING_SUPPORT
+static StaticMutex storageMutex=GLIBMM_STATIC_MUTEX_INIT;
+static int64_t storageBytesTotal=0;
+static int64_t storageMaps=0;
+
+void variables_map::accountStorage(int64_t bytes, int32_t maps)
+{
+	Locker l(storageMutex);
+	storageBytesTotal+=bytes;
+	storageMaps+=maps;
+}
+
+void variables_map::dumpStatistics(std::ostream& f)
+{
+	Locker l(storageMutex);
+	f << "# variables: maps bytes sizeof(ASObject) sizeof(variables_map)" << endl;
+	f << "# variables: " << storageMaps << ' ' << storageBytesTotal << ' ' << sizeof(ASObject) << ' ' << sizeof(variables_map) << endl;
+	if(storageMaps)
+		f << "# variables: bytes per object " << (sizeof(ASObject)+storageBytesTotal/storageMaps) << endl;
+}
+#endif
+
+//Accounts the heap storage that a map gains or loses in a scope, in profiling builds only
+class variables_map::storage_accounting
+{
+#ifdef PROFILING_SUPPORT
+private:
+	const variables_map& map;
+	const size_t before;
+public:
+	storage_accounting(const variables_map& m):map(m),before(m.storageBytes()){}
+	~storage_accounting()
+	{
+		variables_map::accountStorage(int64_t(map.storageBytes())-int64_t(before),0);
+	}
+#else
+public:
+	storage_accounting(const variables_map&){}
+#endif
+};
+
+size_t variables_map::storageBytes() const
+{
+	size_t ret=blocks.capacity()*sizeof(variable*)+slots_vars.capacity()*sizeof(variable*);
+	for(uint32_t b=0;b<blocks.size();b++)
+		ret+=(FIRST_BLOCK_SIZE<<b)*sizeof(variable);
+	if(extra)
+	{
+		ret+=sizeof(extra_data);
+		ret+=extra->freePositions.capacity()*sizeof(uint32_t);
+		ret+=extra->order.capacity()*sizeof(uint32_t);
+		ret+=extra->index.capacity()*sizeof(index_entry);
 	}
+	return ret;
 }
 
 variables_map::~variables_map()
 {
 	destroyContents();
+#ifdef PROFILING_SUPPORT
+	accountStorage(0,-1);
+#endif
 }
 
 void variables_map::destroyContents()
 {
-	var_iterator it=Variables.begin();
-	for(;it!=Variables.end();++it)
+	storage_accounting accounting(*this);
+	for(uint32_t i=0;i<used;i++)
+	{
+		variable* v=at(i);
+		delete v->dynamicName;
+		if(v->var)
+			v->var->decRef();
+		if(v->setter)
+			v->setter->decRef();
+		if(v->getter)
+			v->getter->decRef();
+	}
+	uint32_t blockStart=0;
+	for(uint32_t b=0;b<blocks.size();b++)
+	{
+		const uint32_t blockSize=FIRST_BLOCK_SIZE<<b;
+		for(uint32_t i=0;i<blockSize && blockStart+i<used;i++)
+			blocks[b][i].~variable();
+		::operator delete(blocks[b]);
+		blockStart+=blockSize;
+	}
+	//Release the memory too, the accounting expects it
+	std::vector<variable*>().swap(blocks);
+	used=0;
+	count=0;
+	delete extra;
+	extra=NULL;
+	std::vector<variable*>().swap(slots_vars);
+}
+
+variables_map::extra_data* variables_map::getExtra()
+{
+	if(extra==NULL)
+		extra=new extra_data;
+	return extra;
+}
+
+variable* variables_map::at(uint32_t pos) const
+{
+	uint32_t b=0;
+	uint32_t blockSize=FIRST_BLOCK_SIZE;
+	while(pos>=blockSize)
+	{
+		pos-=blockSize;
+		blockSize<<=1;
+		b++;
+	}
+	return blocks[b]+pos;
+}
+
+uint32_t variables_map::nthPosition(uint32_t i) const
+{
+	if(extra==NULL || extra->freePositions.empty())
+		return i;
+	std::vector<uint32_t>& order=extra->order;
+	//Enumerations walk all the variables, so skip the holes once for all of them
+	if(order.empty())
 	{
-		if(it->second.var)
-			it->second.var->decRef();
-		if(it->second.setter)
-			it->second.setter->decRef();
-		if(it->second.getter)
-			it->second.getter->decRef();
+		storage_accounting accounting(*this);
+		order.reserve(count);
+		for(uint32_t pos=0;pos<used;pos++)
+		{
+			if(at(pos)->kind!=NO_CREATE_TRAIT)
+				order.push_back(pos);
+		}
+	}
+	if(i>=order.size())
+		throw RunTimeException("nthPosition out of bounds");
+	return order[i];
+}
+
+static inline uint32_t indexHash(uint32_t nameHash)
+{
+	//Mix the hash, as only its low bits are used
+	return nameHash*2654435761u;
+}
+
+static bool inNamespaces(const variable& v, const nsNameAndKind* ns, uint32_t nsCount)
+{
+	for(uint32_t i=0;i<nsCount;i++)
+	{
+		if(v.hasNamespace(ns[i].nameId))
+			return true;
+	}
+	return false;
+}
+
+variable* variables_map::find(const variable_name& name, const nsNameAndKind* ns, uint32_t nsCount, uint32_t traitKinds, uint32_t* pos) const
+{
+	if(!isIndexed())
+	{
+		uint32_t blockStart=0;
+		for(uint32_t b=0;blockStart<used;b++)
+		{
+			const uint32_t blockSize=FIRST_BLOCK_SIZE<<b;
+			const uint32_t n=std::min(blockSize,used-blockStart);
+			for(uint32_t i=0;i<n;i++)
+			{
+				variable* v=blocks[b]+i;
+				//Erased variables have no kind
+				if(!(v->kind & traitKinds) || !name.matches(*v) || !inNamespaces(*v,ns,nsCount))
+					continue;
+				if(pos)
+					*pos=blockStart+i;
+				return v;
+			}
+			blockStart+=blockSize;
+		}
+		return NULL;
+	}
+
+	const std::vector<index_entry>& index=extra->index;
+	const uint32_t mask=index.size()-1;
+	for(uint32_t i=indexHash(name.hash)&mask;index[i].pos!=INDEX_EMPTY;i=(i+1)&mask)
+	{
+		if(index[i].nameHash!=name.hash)
+			continue;
+		variable* v=at(index[i].pos);
+		if(!(v->kind & traitKinds) || !name.matches(*v) || !inNamespaces(*v,ns,nsCount))
+			continue;
+		if(pos)
+			*pos=index[i].pos;
+		return v;
+	}
+	return NULL;
+}
+
+variable* variables_map::insert(const variable_name& name, uint32_t nsId, TRAIT_KIND kind)
+{
+	uint32_t nameId=name.id;
+	tiny_string* dynamicName=NULL;
+	if(nameId==INVALID_NAME_ID)
+	{
+		if(kind==DYNAMIC_TRAIT)
+		{
+			//Always copy, the string may not own its buffer
+			dynamicName=new tiny_string(std::string(name.str));
+		}
+		else
+			nameId=internName(name.str);
+	}
+	uint32_t pos;
+	variable* ret;
+	if(extra && !extra->freePositions.empty())
+	{
+		pos=extra->freePositions.back();
+		extra->freePositions.pop_back();
+		ret=at(pos);
+		*ret=variable(nameId,nsId,name.hash,kind);
+	}
+	else
+	{
+		pos=used;
+		//Blocks 0..n-1 hold FIRST_BLOCK_SIZE*(2^n-1) variables
+		if(used==FIRST_BLOCK_SIZE*((1u<<blocks.size())-1))
+		{
+			storage_accounting accounting(*this);
+			const uint32_t blockSize=FIRST_BLOCK_SIZE<<blocks.size();
+			blocks.push_back(static_cast<variable*>(::operator new(blockSize*sizeof(variable))));
+		}
+		ret=new (at(pos)) variable(nameId,nsId,name.hash,kind);
+		used++;
+	}
+	ret->dynamicName=dynamicName;
+	count++;
+	if(extra)
+		extra->order.clear();
+
+	if(isIndexed())
+	{
+		//Keep the load factor under 1/2
+		if(2*count>extra->index.size())
+			rebuildIndex(extra->index.size()*2);
+		else
+			indexInsert(name.hash,pos);
+	}
+	else if(count>LINEAR_SEARCH_LIMIT)
+		rebuildIndex(4*LINEAR_SEARCH_LIMIT);
+	return ret;
+}
+
+void variables_map::erase(variable* v, uint32_t pos)
+{
+	storage_accounting accounting(*this);
+	extra_data* e=getExtra();
+	if(!e->index.empty())
+	{
+		std::vector<index_entry>& index=e->index;
+		//Find the entry of v, then shift back the following entries of the run
+		const uint32_t mask=index.size()-1;
+		uint32_t i=indexHash(v->nameHash)&mask;
+		while(index[i].pos!=pos)
+		{
+			assert(index[i].pos!=INDEX_EMPTY);
+			i=(i+1)&mask;
+		}
+		for(uint32_t j=(i+1)&mask;index[j].pos!=INDEX_EMPTY;j=(j+1)&mask)
+		{
+			const uint32_t home=indexHash(index[j].nameHash)&mask;
+			//The entry can be moved to i only if its home is not in (i,j]
+			const bool inRange=(i<j)?(home>i && home<=j):(home>i || home<=j);
+			if(inRange)
+				continue;
+			index[i]=index[j];
+			i=j;
+		}
+		index[i].pos=INDEX_EMPTY;
+	}
+
+	for(uint32_t i=0;i<slots_vars.size();i++)
+	{
+		if(slots_vars[i]==v)
+			slots_vars[i]=NULL;
+	}
+	//Property caches may point to borrowed variables
+	if(v->kind==BORROWED_TRAIT)
+		property_cache::invalidate();
+
+	delete v->dynamicName;
+	*v=variable(INVALID_NAME_ID,0,0,NO_CREATE_TRAIT);
+	e->freePositions.push_back(pos);
+	count--;
+	e->order.clear();
+}
+
+void variables_map::indexInsert(uint32_t nameHash, uint32_t pos)
+{
+	std::vector<index_entry>& index=extra->index;
+	const uint32_t mask=index.size()-1;
+	uint32_t i=indexHash(nameHash)&mask;
+	while(index[i].pos!=INDEX_EMPTY)
+		i=(i+1)&mask;
+	index[i].nameHash=nameHash;
+	index[i].pos=pos;
+}
+
+void variables_map::rebuildIndex(uint32_t capacity)
+{
+	assert((capacity&(capacity-1))==0);
+	storage_accounting accounting(*this);
+	const index_entry empty={0,INDEX_EMPTY};
+	getExtra()->index.assign(capacity,empty);
+	for(uint32_t i=0;i<used;i++)
+	{
+		const variable* v=at(i);
+		if(v->kind!=NO_CREATE_TRAIT)
+			indexInsert(v->nameHash,i);
 	}
-	Variables.clear();
 }
 
+//Keep plain objects small, they are created for every boxed value. The bounds are absolute,
+//so that any growth of the header or of the variables fails the build. They assume that
+//std::vector is three pointers, as in the release builds of libstdc++ and libc++
+//The variables: blocks and slots_vars, used and count, extra
+static_assert(sizeof(std::vector<variable*>)!=3*sizeof(void*) ||
+		sizeof(variables_map)<=(sizeof(void*)==8?64:36),"variables_map layout grew");
+//The header: vtable, type and ref_count, manager, classdef, and the flags in one word
+static_assert(sizeof(std::vector<variable*>)!=3*sizeof(void*) ||
+		sizeof(ASObject)<=(sizeof(void*)==8?104:60),"ASObject layout grew");
+
 ASObject::ASObject():type(T_OBJECT),ref_count(1),manager(NULL),classdef(NULL),constructed(false),
 		implEnable(true)
 {
@@ -1028,48 +1422,113 @@ ASObject::~ASObject()
 void variables_map::initSlot(unsigned int n, const tiny_string& name, const nsNameAndKind& ns)
 {
 	if(n>slots_vars.size())
-		slots_vars.resize(n,Variables.end());
-
-	pair<var_iterator, var_iterator> ret=Variables.equal_range(name);
-	var_iterator start=ret.first;
-	for(;start!=ret.second;++start)
 	{
-		if(start->second.ns.count(ns))
-		{
-			slots_vars[n-1]=start;
-			return;
-		}
+		storage_accounting accounting(*this);
+		slots_vars.resize(n,NULL);
 	}
 
+	variable* v=find(variable_name(name),&ns,1,DECLARED_TRAIT|DYNAMIC_TRAIT|BORROWED_TRAIT);
 	//Name not present, no good
-	throw RunTimeException("initSlot on missing variable");
+	if(v==NULL)
+		throw RunTimeException("initSlot on missing variable");
+	slots_vars[n-1]=v;
+}
+
+variable* variables_map::findSlotVar(unsigned int n, const multiname& mname)
+{
+	if(n==0 || n>slots_vars.size() || mname.name_type!=multiname::NAME_STRING || mname.ns.size()!=1)
+		return NULL;
+
+	variable* v=slots_vars[n-1];
+	if(v==NULL || !variable_name(mname.name_s,mname.name_s_id,mname.name_s_hash).matches(*v))
+		return NULL;
+	if(!(v->kind & (DECLARED_TRAIT|DYNAMIC_TRAIT)) || !v->hasNamespace(mname.ns[0].nameId))
+		return NULL;
+	return v;
+}
+
+unsigned int variables_map::findSlotIndex(const variable* v) const
+{
+	for(unsigned int i=0;i<slots_vars.size();i++)
+	{
+		if(slots_vars[i]==v)
+			return i+1;
+	}
+	return 0;
 }
 
 void variables_map::setSlot(unsigned int n,ASObject* o)
 {
 	if(n-1<slots_vars.size())
 	{
-		assert_and_throw(slots_vars[n-1]!=Variables.end());
-		if(slots_vars[n-1]->second.setter)
+		assert_and_throw(slots_vars[n-1]!=NULL);
+		if(slots_vars[n-1]->setter)
 			throw UnsupportedException("setSlot has setters");
-		slots_vars[n-1]->second.setVar(o);
+		slots_vars[n-1]->setVar(o);
 	}
 	else
 		throw RunTimeException("setSlot out of bounds");
 }
 
-variable* variables_map::getValueAt(unsigned int index)
+ATOMIC_INT32(property_cache::epoch);
+
+property_cache::property_cache():next(0)
 {
-	//TODO: CHECK behaviour on overridden methods
-	if(index<Variables.size())
+	for(unsigned int i=0;i<ENTRIES;i++)
 	{
-		var_iterator it=Variables.begin();
-
-		for(unsigned int i=0;i<index;i++)
-			++it;
+		entries[i].cls=NULL;
+		entries[i].kind=EMPTY;
+		entries[i].epoch=0;
+		entries[i].var=NULL;
+	}
+}
 
-		return &it->second;
+property_cache::entry* property_cache::replace(const Class_base* c, ENTRY_KIND k)
+{
+	//Reuse the entry of the same class, even if stale
+	entry* ret=NULL;
+	for(unsigned int i=0;i<ENTRIES;i++)
+	{
+		if(entries[i].cls==c)
+		{
+			ret=&entries[i];
+			break;
+		}
+	}
+	if(ret==NULL)
+	{
+		ret=&entries[next];
+		next=(next+1)%ENTRIES;
 	}
+	ret->cls=c;
+	ret->kind=k;
+	ret->epoch=epoch;
+	return ret;
+}
+
+void property_cache::addSlot(const Class_base* c, unsigned int slot)
+{
+	replace(c, SLOT)->slot=slot;
+}
+
+void property_cache::addBorrowed(const Class_base* c, variable* var)
+{
+	replace(c, BORROWED)->var=var;
+}
+
+variable* variables_map::getValueAt(unsigned int i)
+{
+	//TODO: CHECK behaviour on overridden methods
+	if(i<count)
+		return at(nthPosition(i));
+	else
+		throw RunTimeException("getValueAt out of bounds");
+}
+
+const variable* variables_map::getValueAt(unsigned int i) const
+{
+	if(i<count)
+		return at(nthPosition(i));
 	else
 		throw RunTimeException("getValueAt out of bounds");
 }
@@ -1095,18 +1554,11 @@ _R<ASObject> ASObject::getValueAt(int index)
 	}
 }
 
-tiny_string variables_map::getNameAt(unsigned int index) const
+tiny_string variables_map::getNameAt(unsigned int i) const
 {
 	//TODO: CHECK behaviour on overridden methods
-	if(index<Variables.size())
-	{
-		const_var_iterator it=Variables.begin();
-
-		for(unsigned int i=0;i<index;i++)
-			++it;
-
-		return it->first;
-	}
+	if(i<count)
+		return at(nthPosition(i))->getName();
 	else
 		throw RunTimeException("getNameAt out of bounds");
 }
@@ -1116,24 +1568,43 @@ unsigned int ASObject::numVariables() const
 	return Variables.size();
 }
 
+/*
+ * Objects are rarely waited upon, so instead of a mutex and a condition
+ * in every object the waiters park on one of a few shared stripes, chosen
+ * by the object address. A stripe may be signaled for another object,
+ * so waiters have to check the state again after waking up
+ */
+struct ConstructionStripe
+{
+	Mutex mutex;
+	Cond signal;
+};
+
+static const uint32_t CONSTRUCTION_STRIPES=64;
+
+static ConstructionStripe& getConstructionStripe(const ASObject* o)
+{
+	static ConstructionStripe stripes[CONSTRUCTION_STRIPES];
+	//Objects are at least 16 bytes aligned
+	return stripes[(reinterpret_cast<uintptr_t>(o)>>4)%CONSTRUCTION_STRIPES];
+}
+
 void ASObject::constructionComplete()
 {
-	Mutex::Lock lock(constructionMutex);
-	constructionSignal.broadcast();
+	ConstructionStripe& stripe=getConstructionStripe(this);
+	Mutex::Lock lock(stripe.mutex);
+	stripe.signal.broadcast();
 }
 
 bool ASObject::waitUntilConstructed(unsigned long maxwait_ms)
 {
-	Mutex::Lock lock(constructionMutex);
-
-	if(isConstructed())
-		return true;
+	ConstructionStripe& stripe=getConstructionStripe(this);
+	Mutex::Lock lock(stripe.mutex);
 
-	// No need to loop over wait() because the construction state
-	// will change only once from false to true.
 	if(maxwait_ms==0)
 	{
-		constructionSignal.wait(constructionMutex);
+		while(!isConstructed())
+			stripe.signal.wait(stripe.mutex);
 		return true;
 	}
 	else
@@ -1141,7 +1612,12 @@ bool ASObject::waitUntilConstructed(unsigned long maxwait_ms)
 		Glib::TimeVal waitEnd;
 		waitEnd.assign_current_time();
 		waitEnd.add_milliseconds(maxwait_ms);
-		return constructionSignal.timed_wait(constructionMutex, waitEnd);
+		while(!isConstructed())
+		{
+			if(!stripe.signal.timed_wait(stripe.mutex, waitEnd))
+				return isConstructed();
+		}
+		return true;
 	}
 }
 
@@ -1157,15 +1633,15 @@ void variables_map::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& s
 				std::map<const Class_base*, uint32_t>& traitsMap) const
 {
 	//Pairs of name, value
-	auto it=Variables.begin();
-	for(;it!=Variables.end();it++)
+	for(uint32_t i=0;i<used;i++)
 	{
-		if(it->second.kind!=DYNAMIC_TRAIT)
+		const variable* v=at(i);
+		if(v->kind!=DYNAMIC_TRAIT)
 			continue;
-		assert_and_throw(it->second.ns.size() == 1)
-		assert_and_throw(it->second.ns.begin()->name=="");
-		out->writeStringVR(stringMap,it->first);
-		it->second.var->serialize(out, stringMap, objMap, traitsMap);
+		assert_and_throw(v->extraNs.empty());
+		assert_and_throw(v->nsId==0);
+		out->writeStringVR(stringMap,v->getName());
+		v->var->serialize(out, stringMap, objMap, traitsMap);
 	}
 	//The empty string closes the object
 	out->writeStringVR(stringMap, "");
@@ -1215,7 +1691,7 @@ void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 		//Invoke writeExternal
 		multiname writeExternalName;
 		writeExternalName.name_type=multiname::NAME_STRING;
-		writeExternalName.name_s="writeExternal";
+		writeExternalName.setName("writeExternal");
 		writeExternalName.ns.push_back(nsNameAndKind("",NAMESPACE));
 		writeExternalName.isAttribute = false;
 
@@ -1233,8 +1709,7 @@ void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 	objMap.insert(make_pair(this, objMap.size()));
 
 	uint32_t traitsCount=0;
-	const variables_map::const_var_iterator beginIt = Variables.Variables.begin();
-	const variables_map::const_var_iterator endIt = Variables.Variables.end();
+	const unsigned int varCount=Variables.size();
 	//Check if the class traits has been already serialized to send it by reference
 	auto it2=traitsMap.find(type);
 	if(it2!=traitsMap.end())
@@ -1242,28 +1717,30 @@ void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 	else
 	{
 		traitsMap.insert(make_pair(type, traitsMap.size()));
-		for(variables_map::const_var_iterator varIt=beginIt; varIt != endIt; ++varIt)
+		for(unsigned int i=0;i<varCount;i++)
 		{
-			if(varIt->second.kind==DECLARED_TRAIT)
+			if(Variables.getValueAt(i)->kind==DECLARED_TRAIT)
 				traitsCount++;
 		}
 		uint32_t dynamicFlag=(type->isSealed)?0:(1 << 3);
 		out->writeU29((traitsCount << 4) | dynamicFlag | 0x03);
 		out->writeStringVR(stringMap, alias);
-		for(variables_map::const_var_iterator varIt=beginIt; varIt != endIt; ++varIt)
+		for(unsigned int i=0;i<varCount;i++)
 		{
-			if(varIt->second.kind==DECLARED_TRAIT)
+			const variable* v=Variables.getValueAt(i);
+			if(v->kind==DECLARED_TRAIT)
 			{
-				assert_and_throw(varIt->second.ns.size() == 1)
-				assert_and_throw(varIt->second.ns.begin()->name=="");
-				out->writeStringVR(stringMap, varIt->first);
+				assert_and_throw(v->extraNs.empty());
+				assert_and_throw(v->nsId==0);
+				out->writeStringVR(stringMap, v->getName());
 			}
 		}
 	}
-	for(variables_map::const_var_iterator varIt=beginIt; varIt != endIt; ++varIt)
+	for(unsigned int i=0;i<varCount;i++)
 	{
-		if(varIt->second.kind==DECLARED_TRAIT)
-			varIt->second.var->serialize(out, stringMap, objMap, traitsMap);
+		const variable* v=Variables.getValueAt(i);
+		if(v->kind==DECLARED_TRAIT)
+			v->var->serialize(out, stringMap, objMap, traitsMap);
 	}
 	if(!type->isSealed)
 		serializeDynamicProperties(out, stringMap, objMap, traitsMap);
@@ -1300,7 +1777,7 @@ bool ASObject::hasprop_prototype()
 {
 	multiname prototypeName;
 	prototypeName.name_type=multiname::NAME_STRING;
-	prototypeName.name_s="prototype";
+	prototypeName.setName("prototype");
 	prototypeName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	prototypeName.isAttribute = false;
 	return findGettable(prototypeName, false) != NULL;
@@ -1310,7 +1787,7 @@ ASObject* ASObject::getprop_prototype()
 {
 	multiname prototypeName;
 	prototypeName.name_type=multiname::NAME_STRING;
-	prototypeName.name_s="prototype";
+	prototypeName.setName("prototype");
 	prototypeName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	prototypeName.isAttribute = false;
 	variable* var = findGettable(prototypeName, false);
@@ -1329,7 +1806,7 @@ void ASObject::setprop_prototype(_NR<ASObject>& o)
 
 	multiname prototypeName;
 	prototypeName.name_type=multiname::NAME_STRING;
-	prototypeName.name_s="prototype";
+	prototypeName.setName("prototype");
 	prototypeName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	bool has_getter = false;
 	variable* ret=findSettable(prototypeName,false, &has_getter);
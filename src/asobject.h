@@ -24,6 +24,7 @@
 #include "swftypes.h"
 #include "smartrefs.h"
 #include "threading.h"
+#include "slab_allocator.h"
 #include <map>
 
 #define ASFUNCTION(name) \
@@ -138,7 +139,14 @@ enum TRAIT_KIND { NO_CREATE_TRAIT=0, DECLARED_TRAIT=1, DYNAMIC_TRAIT=2, BORROWED
 
 struct variable
 {
-	std::set<nsNameAndKind> ns;
+	//Interned names, see internName. Names of dynamic traits are not interned,
+	//nameId is INVALID_NAME_ID and the name is owned by the variables_map
+	uint32_t nameId;
+	uint32_t nsId;
+	uint32_t nameHash;
+	tiny_string* dynamicName;
+	//Further namespaces the variable is reachable with, see Class_base::copyBorrowedTraitsFromSuper
+	std::vector<uint32_t> extraNs;
 	ASObject* var;
 	multiname* typemname;
 	const Type* type;
@@ -146,21 +154,119 @@ struct variable
 	IFunction* getter;
 	TRAIT_KIND kind;
 	//obj_var(ASObject* _v, Class_base* _t):var(_v),type(_t),{}
-	variable(const nsNameAndKind& _ns, TRAIT_KIND _k)
-		: var(NULL),typemname(NULL),type(NULL),setter(NULL),getter(NULL),kind(_k) { ns.insert(_ns); }
-	variable(const nsNameAndKind& _ns, TRAIT_KIND _k, ASObject* _v, multiname* _t, const Type* type)
-		: var(_v),typemname(_t),type(type),setter(NULL),getter(NULL),kind(_k) { ns.insert(_ns); }
+	variable(uint32_t _nameId, uint32_t _nsId, uint32_t _nameHash, TRAIT_KIND _k)
+		: nameId(_nameId),nsId(_nsId),nameHash(_nameHash),dynamicName(NULL),var(NULL),typemname(NULL),type(NULL),
+		setter(NULL),getter(NULL),kind(_k) {}
 	void setVar(ASObject* v);
+	const tiny_string& getName() const
+	{
+		return dynamicName?*dynamicName:getInternedName(nameId);
+	}
+	bool hasNamespace(uint32_t id) const
+	{
+		return nsId==id || (!extraNs.empty() && std::find(extraNs.begin(),extraNs.end(),id)!=extraNs.end());
+	}
+	void addNamespace(uint32_t id)
+	{
+		if(!hasNamespace(id))
+			extraNs.push_back(id);
+	}
+};
+
+/*
+ * A name to look up in a variables_map. When both the name and the variable are interned
+ * they are compared by id, otherwise by string once the hashes match
+ */
+struct variable_name
+{
+	const tiny_string& str;
+	uint32_t id;
+	uint32_t hash;
+	variable_name(const tiny_string& s, uint32_t i, uint32_t h):str(s),id(i),hash(h){}
+	explicit variable_name(const tiny_string& s):str(s),id(s.empty()?0:INVALID_NAME_ID),hash(nameHash(s)){}
+	bool matches(const variable& v) const
+	{
+		if(v.nameHash!=hash)
+			return false;
+		if(id!=INVALID_NAME_ID && v.nameId!=INVALID_NAME_ID)
+			return id==v.nameId;
+		return str==v.getName();
+	}
 };
 
+/*
+ * The variables of an object. They are kept in insertion order in blocks
+ * that are never moved, so that pointers to a variable stay valid until it
+ * is erased. Small maps are searched linearly, comparing the name hashes
+ * first. Bigger ones get an open addressing index keyed on the name hash,
+ * which lives with the free positions in a side structure: most objects
+ * have a few variables and never erase one, so they do not pay for it
+ */
 class variables_map
 {
+private:
+	struct index_entry
+	{
+		uint32_t nameHash;
+		uint32_t pos;
+	};
+	struct extra_data
+	{
+		//Positions of erased variables, reused by insert
+		std::vector<uint32_t> freePositions;
+		//Positions of the live variables when there are erased ones, built on demand. Empty when stale
+		std::vector<uint32_t> order;
+		//Empty or a power of two in size
+		std::vector<index_entry> index;
+	};
+	class storage_accounting;
+	//Block n holds FIRST_BLOCK_SIZE<<n variables
+	static const uint32_t FIRST_BLOCK_SIZE=4;
+	//The index is only built for maps bigger than this
+	static const uint32_t LINEAR_SEARCH_LIMIT=8;
+	static const uint32_t INDEX_EMPTY=0xffffffff;
+	static const uint32_t INDEX_ERASED=0xfffffffe;
+	std::vector<variable*> blocks;
+	//Positions used so far, erased variables included
+	uint32_t used;
+	//Live variables
+	uint32_t count;
+	//Allocated by the first erase or when the map gets indexed
+	extra_data* extra;
+	std::vector<variable*> slots_vars;
+	extra_data* getExtra();
+	bool isIndexed() const
+	{
+		return extra && !extra->index.empty();
+	}
+	variable* at(uint32_t pos) const;
+	//Returns the position of the i-th live variable
+	uint32_t nthPosition(uint32_t i) const;
+	/*
+	 * Returns the first variable with the given name and one of the given kinds
+	 * which is reachable with one of the namespaces ns[0..nsCount)
+	 */
+	variable* find(const variable_name& name, const nsNameAndKind* ns, uint32_t nsCount, uint32_t traitKinds, uint32_t* pos=NULL) const;
+	//Names of traits are interned, names of dynamic variables are copied
+	variable* insert(const variable_name& name, uint32_t nsId, TRAIT_KIND kind);
+	void erase(variable* v, uint32_t pos);
+	void indexInsert(uint32_t nameHash, uint32_t pos);
+	void rebuildIndex(uint32_t capacity);
+	//Bytes allocated on the heap for the variables, the index and the slots
+	size_t storageBytes() const;
+#ifdef PROFILING_SUPPORT
+	static void accountStorage(int64_t bytes, int32_t maps);
+#endif
+	//Not copyable, variables are referenced by pointer
+	variables_map(const variables_map&);
+	variables_map& operator=(const variables_map&);
 public:
-	std::multimap<tiny_string,variable> Variables;
-	typedef std::multimap<tiny_string,variable>::iterator var_iterator;
-	typedef std::multimap<tiny_string,variable>::const_iterator const_var_iterator;
-	std::vector<var_iterator> slots_vars;
-public:
+	variables_map():used(0),count(0),extra(NULL)
+	{
+#ifdef PROFILING_SUPPORT
+		accountStorage(0,1);
+#endif
+	}
 	/**
 	   Find a variable in the map
 
@@ -173,19 +279,29 @@ public:
 	//Initialize a new variable specifying the type (TODO: add support for const)
 	void initializeVar(const multiname& mname, ASObject* obj, multiname* typemname);
 	void killObjVar(const multiname& mname);
+	//Adds a copy of v, no reference to its values is acquired
+	variable* copyVar(const variable& v);
 	ASObject* getSlot(unsigned int n)
 	{
 		assert(n<=slots_vars.size());
-		return slots_vars[n-1]->second.var;
+		return slots_vars[n-1]->var;
 	}
 	void setSlot(unsigned int n,ASObject* o);
 	void initSlot(unsigned int n,const tiny_string& name, const nsNameAndKind& ns);
+	/**
+	   Return the variable in slot n if it's a declared or dynamic trait with the given name,
+	   NULL otherwise. Only multinames with a string name and a single namespace are accepted
+	*/
+	variable* findSlotVar(unsigned int n, const multiname& mname);
+	//Returns the slot of the given variable, or 0 if it has no slot
+	unsigned int findSlotIndex(const variable* v) const;
 	int size() const
 	{
-		return Variables.size();
+		return count;
 	}
 	tiny_string getNameAt(unsigned int i) const;
 	variable* getValueAt(unsigned int i);
+	const variable* getValueAt(unsigned int i) const;
 	~variables_map();
 	void check() const;
 	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
@@ -193,6 +309,60 @@ public:
 				std::map<const Class_base*, uint32_t>& traitsMap) const;
 	void dumpVariables();
 	void destroyContents();
+#ifdef PROFILING_SUPPORT
+	//Writes the number of live maps and the bytes they hold, as callgrind comments
+	static void dumpStatistics(std::ostream& f);
+#endif
+};
+
+/*
+ * Inline cache of a getproperty, setproperty or callproperty site.
+ * For the last few classes of the objects seen at the site it remembers
+ * where the name has been found: in a slot of the object itself or in
+ * the borrowed traits of the class. SLOT entries are verified against the
+ * name on every hit, BORROWED entries are valid until the epoch changes,
+ * which happens when borrowed traits are added or a class is finalized
+ */
+struct property_cache
+{
+	enum ENTRY_KIND { EMPTY=0, SLOT, BORROWED };
+	struct entry
+	{
+		const Class_base* cls;
+		ENTRY_KIND kind;
+		uint32_t epoch;
+		union
+		{
+			unsigned int slot;
+			//A borrowed variable of cls
+			variable* var;
+		};
+	};
+	static const unsigned int ENTRIES=4;
+	entry entries[ENTRIES];
+	//The entry to be reused when all are taken
+	unsigned int next;
+	static ATOMIC_INT32(epoch);
+	property_cache();
+	entry* find(const Class_base* c)
+	{
+		const uint32_t cur=epoch;
+		for(unsigned int i=0;i<ENTRIES;i++)
+		{
+			if(entries[i].cls==c && entries[i].epoch==cur)
+				return &entries[i];
+		}
+		return NULL;
+	}
+	void addSlot(const Class_base* c, unsigned int slot);
+	void addBorrowed(const Class_base* c, variable* var);
+	//Drops all the BORROWED entries of all caches
+	static void invalidate()
+	{
+		ATOMIC_INCREMENT(epoch);
+	}
+private:
+	entry* replace(const Class_base* c, ENTRY_KIND k);
 };
 
 /*
@@ -238,23 +408,33 @@ protected:
 				std::map<const ASObject*, uint32_t>& objMap,
 				std::map<const Class_base*, uint32_t> traitsMap) const;
 private:
+	//Next to type, so that the two fill one word
+	ATOMIC_INT32(ref_count);
 	//maps variable name to namespace and var
 	variables_map Variables;
 	variable* findGettable(const multiname& name, bool borrowedMode) DLL_LOCAL;
 	variable* findSettable(const multiname& name, bool borrowedMode, bool* has_getter=NULL) DLL_LOCAL;
+	_NR<ASObject> getVariableFromPrototype(const multiname& name, Class_base* cls) DLL_LOCAL;
+	//Returns the value of a variable found by findGettable, calling the getter if needed
+	_NR<ASObject> getVariableValue(variable* obj, const multiname& name) DLL_LOCAL;
+	//Sets the value of a variable found by findSettable, calling the setter if needed
+	void setVariableValue(variable* obj, ASObject* o) DLL_LOCAL;
 
-	ATOMIC_INT32(ref_count);
 	Manager* manager;
 	Class_base* classdef;
+	//Waiting for construction goes through a table shared by all objects, see waitUntilConstructed
 	ACQUIRE_RELEASE_FLAG(constructed);
-	Glib::Mutex constructionMutex;
-	Glib::Cond constructionSignal;
 public:
 #ifndef NDEBUG
 	//Stuff only used in debugging
 	bool initialized;
 	int getRefCount(){ return ref_count; }
 #endif
+	//True if the caller holds the only reference, so that the object can't be observed by others
+	bool isLastRef() const { return ref_count==1; }
+	//The destructor is virtual, so delete always gets the size of the most derived class
+	static void* operator new(size_t size) { return SlabAllocator::allocate(size); }
+	static void operator delete(void* p, size_t size) { SlabAllocator::deallocate(p,size); }
 	bool implEnable;
 	void setClass(Class_base* c);
 	Class_base* getClass() const { return classdef; }
@@ -342,6 +522,18 @@ public:
 	 * If no property is found, an instance variable is created.
 	 */
 	void setVariableByMultiname(const multiname& name, ASObject* o, Class_base* cls);
+	/*
+	 * Classes that specialize getVariableByMultiname or setVariableByMultiname
+	 * must return false, at least when opt does not contain SKIP_IMPL,
+	 * so that property caches are bypassed for their instances
+	 */
+	virtual bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return true; }
+	/*
+	 * Like getVariableByMultiname and setVariableByMultiname, but the lookup
+	 * goes through the given inline cache, which is updated on misses
+	 */
+	_NR<ASObject> getCachedVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt, property_cache* cache);
+	void setCachedVariableByMultiname(const multiname& name, ASObject* o, property_cache* cache);
 	void initializeVariableByMultiname(const multiname& name, ASObject* o, multiname* typemname);
 	virtual bool deleteVariableByMultiname(const multiname& name);
 	void setVariableByQName(const tiny_string& name, const tiny_string& ns, _R<ASObject> o, TRAIT_KIND traitKind)
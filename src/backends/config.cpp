@@ -79,9 +79,9 @@ Config::Config():
 	systemConfigDirectories(g_get_system_config_dirs()),userConfigDirectory(g_get_user_config_dir()),
 	//DEFAULT SETTINGS
 	defaultCacheDirectory((string) g_get_user_cache_dir() + "/lightspark"),
-	cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),
+	cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),persistentCache(false),persistentCacheSize(256),
 	audioBackend(INVALID),audioBackendName(""),
-	renderingEnabled(true)
+	renderingEnabled(true),workerThreads(0)
 {
 #ifdef _WIN32
 	const char* exePath = getExectuablePath();
@@ -204,12 +204,20 @@ void Config::handleEntry()
 	//Rendering
 	else if(group == "rendering" && key == "enabled")
 		renderingEnabled = atoi(value.c_str());
+	//Job pool
+	else if(group == "threads" && key == "workers")
+		workerThreads = atoi(value.c_str());
 	//Cache directory
 	else if(group == "cache" && key == "directory")
 		cacheDirectory = value;
 	//Cache prefix
 	else if(group == "cache" && key == "prefix")
 		cachePrefix = value;
+	//Persistent cache of decoded resources
+	else if(group == "cache" && key == "persistent")
+		persistentCache = atoi(value.c_str());
+	else if(group == "cache" && key == "persistent_size")
+		persistentCacheSize = atoi(value.c_str());
 	else
 		throw ConfigException((string) _("Invalid entry encountered in configuration file") + ": '" + group + "/" + key + "'='" + value + "'");
 }
@@ -49,6 +49,10 @@ namespace lightspark
 		std::string cacheDirectory;
 		//Specifies what prefix the cache files should have, default="cache"
 		std::string cachePrefix;
+		//Specifies if decoded SWF resources are kept in the cache directory, default=false
+		bool persistentCache;
+		//Specifies how many megabytes the decoded SWF resources may use, default=256
+		uint32_t persistentCacheSize;
 		//Specifies the filename including full path of the gnash executable
 		std::string gnashPath;
 
@@ -58,6 +62,9 @@ namespace lightspark
 
 		//Specifies if rendering should be done
 		bool renderingEnabled;
+
+		//Number of threads of the job pool, 0 means one per CPU
+		uint32_t workerThreads;
 		Config();
 		~Config();
 	public:
@@ -66,12 +73,15 @@ namespace lightspark
 
 		const std::string& getCacheDirectory() const { return cacheDirectory; }
 		const std::string& getCachePrefix() const { return cachePrefix; }
+		bool isPersistentCacheEnabled() const { return persistentCache; }
+		uint64_t getPersistentCacheSize() const { return (uint64_t)persistentCacheSize*1024*1024; }
 		const std::string& getGnashPath() const { return gnashPath; }
 
 		AUDIOBACKEND getAudioBackend() const { return audioBackend; }
 		const std::string& getAudioBackendName() const { return audioBackendName; }
 
 		bool isRenderingEnabled() const { return renderingEnabled; }
+		uint32_t getWorkerThreads() const { return workerThreads; }
 	};
 }
 
@@ -20,6 +20,7 @@
 #include <fstream>
 #include <cmath>
 #include <algorithm>
+#include <limits>
 #include "swftypes.h"
 #include "logger.h"
 #include "geometry.h"
@@ -203,3 +204,308 @@ void ShapesBuilder::outputTokens(const std::list<FILLSTYLE>& styles, vector< Geo
 	}
 }
 
+
+/* Appends the points approximating the segment t starting at from, tolerance is in token units */
+static void flattenSegment(const GeomToken& t, const Vector2f& from, double tolerance, vector<Vector2f>& points)
+{
+	unsigned int steps=1;
+	if(t.type==CURVE_QUADRATIC)
+	{
+		//The distance from the chord is bounded by |p0-2c+p1|/(4*steps^2)
+		const Vector2f c(t.p1), end(t.p2);
+		double dx=from.x-2*c.x+end.x;
+		double dy=from.y-2*c.y+end.y;
+		steps=ceil(sqrt(sqrt(dx*dx+dy*dy)/(4*tolerance)));
+	}
+	else if(t.type==CURVE_CUBIC)
+	{
+		const Vector2f c1(t.p1), c2(t.p2), end(t.p3);
+		double dx1=from.x-2*c1.x+c2.x;
+		double dy1=from.y-2*c1.y+c2.y;
+		double dx2=c1.x-2*c2.x+end.x;
+		double dy2=c1.y-2*c2.y+end.y;
+		double m=max(sqrt(dx1*dx1+dy1*dy1),sqrt(dx2*dx2+dy2*dy2));
+		steps=ceil(sqrt(6*m/(8*tolerance)));
+	}
+	steps=max(1u,min(steps,128u));
+
+	for(unsigned int i=1;i<=steps;i++)
+	{
+		double s=double(i)/steps;
+		double r=1-s;
+		if(t.type==CURVE_QUADRATIC)
+			points.push_back(Vector2f(r*r*from.x+2*r*s*t.p1.x+s*s*t.p2.x,
+						  r*r*from.y+2*r*s*t.p1.y+s*s*t.p2.y));
+		else if(t.type==CURVE_CUBIC)
+			points.push_back(Vector2f(r*r*r*from.x+3*r*r*s*t.p1.x+3*r*s*s*t.p2.x+s*s*s*t.p3.x,
+						  r*r*r*from.y+3*r*r*s*t.p1.y+3*r*s*s*t.p2.y+s*s*s*t.p3.y));
+		else
+			points.push_back(t.p1);
+	}
+}
+
+static Vector2f segmentEnd(const GeomToken& t)
+{
+	if(t.type==CURVE_QUADRATIC)
+		return t.p2;
+	else if(t.type==CURVE_CUBIC)
+		return t.p3;
+	else
+		return t.p1;
+}
+
+static bool isFillVisible(const FILLSTYLE& style)
+{
+	//Gradients and bitmaps are assumed to cover what they fill. Sampling
+	//their alpha would need the decoded bitmap, which may not be ready yet
+	return style.FillStyleType!=SOLID_FILL || style.Color.Alpha!=0;
+}
+
+PathHitTester::PathHitTester(const vector<GeomToken>& tokens, double _scaleFactor):fillGroups(0),scaleFactor(_scaleFactor)
+{
+	flatten(tokens);
+	outline.buildBands();
+	fills.buildBands();
+	strokes.buildBands();
+}
+
+void PathHitTester::flushFill(vector<Edge>& pending, bool visible)
+{
+	if(visible && !pending.empty())
+	{
+		for(uint32_t i=0;i<pending.size();i++)
+		{
+			pending[i].group=fillGroups;
+			fills.edges.push_back(pending[i]);
+		}
+		fillGroups++;
+	}
+	pending.clear();
+}
+
+void PathHitTester::flushStroke(vector<Edge>& pending, bool visible, double pad)
+{
+	if(visible)
+	{
+		for(uint32_t i=0;i<pending.size();i++)
+		{
+			pending[i].pad=pad;
+			strokes.edges.push_back(pending[i]);
+		}
+	}
+	pending.clear();
+}
+
+/*
+ * This follows the paths built by CairoTokenRenderer::cairoPathFromTokens.
+ * Three paths are tracked: the whole outline, the fill path which is consumed
+ * by every fill and the stroke path which is consumed by every stroke
+ */
+void PathHitTester::flatten(const vector<GeomToken>& tokens)
+{
+	enum { OUTLINE=0, FILL, STROKE };
+	const double tolerance=0.1/scaleFactor;
+	Vector2f start[3];
+	Vector2f cur[3];
+	bool hasCur[3]={false,false,false};
+	vector<Edge> pendingFill;
+	vector<Edge> pendingStroke;
+	vector<Edge>* edges[3]={&outline.edges, &pendingFill, &pendingStroke};
+	//Nothing is painted until the first SET_FILL/SET_STROKE
+	bool fillVisible=false;
+	bool strokeVisible=false;
+	double strokePad=0;
+	vector<Vector2f> points;
+
+	for(uint32_t i=0;i<tokens.size();i++)
+	{
+		const GeomToken& t=tokens[i];
+		switch(t.type)
+		{
+			case MOVE:
+				for(int k=0;k<3;k++)
+				{
+					//Fills are implicitly closed, strokes are not
+					if(hasCur[k] && k!=STROKE && cur[k]!=start[k])
+						edges[k]->push_back(Edge(cur[k],start[k],0,0));
+					start[k]=cur[k]=t.p1;
+					hasCur[k]=true;
+				}
+				break;
+			case STRAIGHT:
+			case CURVE_QUADRATIC:
+			case CURVE_CUBIC:
+			{
+				const Vector2f end=segmentEnd(t);
+				for(int k=0;k<3;k++)
+				{
+					if(!hasCur[k])
+					{
+						//Without a current point cairo starts a new subpath
+						start[k]=cur[k]=end;
+						hasCur[k]=true;
+						continue;
+					}
+					points.clear();
+					flattenSegment(t, cur[k], tolerance, points);
+					Vector2f prev=cur[k];
+					for(uint32_t j=0;j<points.size();j++)
+					{
+						edges[k]->push_back(Edge(prev,points[j],0,0));
+						prev=points[j];
+					}
+					cur[k]=end;
+				}
+				break;
+			}
+			case SET_FILL:
+			case CLEAR_FILL:
+			case FILL_KEEP_SOURCE:
+			case FILL_TRANSFORM_TEXTURE:
+				if(hasCur[FILL] && cur[FILL]!=start[FILL])
+					pendingFill.push_back(Edge(cur[FILL],start[FILL],0,0));
+				flushFill(pendingFill, fillVisible);
+				hasCur[FILL]=false;
+				if(t.type==SET_FILL)
+					fillVisible=isFillVisible(t.fillStyle);
+				else if(t.type==CLEAR_FILL)
+					fillVisible=false;
+				break;
+			case SET_STROKE:
+			case CLEAR_STROKE:
+				flushStroke(pendingStroke, strokeVisible, strokePad);
+				hasCur[STROKE]=false;
+				if(t.type==SET_STROKE)
+				{
+					strokeVisible=t.lineStyle.Color.Alpha!=0;
+					//Hairlines still cover the pixels they cross
+					strokePad=max(t.lineStyle.Width/20.0/2.0, 0.5/scaleFactor);
+				}
+				else
+					strokeVisible=false;
+				break;
+		}
+	}
+
+	if(hasCur[OUTLINE] && cur[OUTLINE]!=start[OUTLINE])
+		outline.edges.push_back(Edge(cur[OUTLINE],start[OUTLINE],0,0));
+	if(hasCur[FILL] && cur[FILL]!=start[FILL])
+		pendingFill.push_back(Edge(cur[FILL],start[FILL],0,0));
+	flushFill(pendingFill, fillVisible);
+	flushStroke(pendingStroke, strokeVisible, strokePad);
+}
+
+void PathHitTester::EdgeSet::buildBands()
+{
+	if(edges.empty())
+		return;
+	ymin=numeric_limits<double>::infinity();
+	double ymax=-numeric_limits<double>::infinity();
+	for(uint32_t i=0;i<edges.size();i++)
+	{
+		ymin=min(ymin,min(edges[i].p0.y,edges[i].p1.y)-edges[i].pad);
+		ymax=max(ymax,max(edges[i].p0.y,edges[i].p1.y)+edges[i].pad);
+	}
+	uint32_t count=max<uint32_t>(1,min<uint32_t>(edges.size()/4,256));
+	bandHeight=(ymax-ymin)/count;
+	if(bandHeight<=0)
+	{
+		count=1;
+		bandHeight=1;
+	}
+	bands.resize(count);
+	for(uint32_t i=0;i<edges.size();i++)
+	{
+		double lo=min(edges[i].p0.y,edges[i].p1.y)-edges[i].pad;
+		double hi=max(edges[i].p0.y,edges[i].p1.y)+edges[i].pad;
+		uint32_t first=min<uint32_t>((lo-ymin)/bandHeight,count-1);
+		uint32_t last=min<uint32_t>((hi-ymin)/bandHeight,count-1);
+		for(uint32_t j=first;j<=last;j++)
+			bands[j].push_back(i);
+	}
+}
+
+const vector<uint32_t>* PathHitTester::EdgeSet::bandFor(double y) const
+{
+	if(bands.empty() || y<ymin)
+		return NULL;
+	double index=floor((y-ymin)/bandHeight);
+	if(index>=bands.size())
+	{
+		//The top of the last band is inclusive
+		if(y>ymin+bandHeight*bands.size())
+			return NULL;
+		index=bands.size()-1;
+	}
+	return &bands[uint32_t(index)];
+}
+
+bool PathHitTester::hitTest(double x, double y) const
+{
+	const double px=x/scaleFactor;
+	const double py=y/scaleFactor;
+	const vector<uint32_t>* band=outline.bandFor(py);
+	if(band==NULL)
+		return false;
+	int winding=0;
+	for(uint32_t i=0;i<band->size();i++)
+	{
+		const Edge& e=outline.edges[(*band)[i]];
+		if((e.p0.y<=py) == (e.p1.y<=py))
+			continue;
+		double crossX=e.p0.x+(py-e.p0.y)*(e.p1.x-e.p0.x)/(e.p1.y-e.p0.y);
+		if(crossX>px)
+			winding+=(e.p1.y>e.p0.y)?1:-1;
+	}
+	return winding!=0;
+}
+
+bool PathHitTester::isOpaque(double x, double y) const
+{
+	//Test the center of the pixel
+	const double px=(x+0.5)/scaleFactor;
+	const double py=(y+0.5)/scaleFactor;
+	const vector<uint32_t>* band=fills.bandFor(py);
+	if(band)
+	{
+		//Each fill uses the even-odd rule on its own. The edges of a fill are contiguous
+		uint32_t group=0;
+		bool inside=false;
+		for(uint32_t i=0;i<band->size();i++)
+		{
+			const Edge& e=fills.edges[(*band)[i]];
+			if(e.group!=group)
+			{
+				if(inside)
+					return true;
+				group=e.group;
+			}
+			if((e.p0.y<=py) == (e.p1.y<=py))
+				continue;
+			double crossX=e.p0.x+(py-e.p0.y)*(e.p1.x-e.p0.x)/(e.p1.y-e.p0.y);
+			if(crossX>px)
+				inside=!inside;
+		}
+		if(inside)
+			return true;
+	}
+	band=strokes.bandFor(py);
+	if(band)
+	{
+		for(uint32_t i=0;i<band->size();i++)
+		{
+			const Edge& e=strokes.edges[(*band)[i]];
+			//Distance from the point to the segment
+			double dx=e.p1.x-e.p0.x;
+			double dy=e.p1.y-e.p0.y;
+			double len2=dx*dx+dy*dy;
+			double s=(len2>0)?((px-e.p0.x)*dx+(py-e.p0.y)*dy)/len2:0;
+			s=max(0.0,min(1.0,s));
+			double ex=e.p0.x+s*dx-px;
+			double ey=e.p0.y+s*dy-py;
+			if(ex*ex+ey*ey<=e.pad*e.pad)
+				return true;
+		}
+	}
+	return false;
+}
@@ -120,6 +120,60 @@ public:
 	void clear();
 };
 
+/*
+ * The flattened outlines of a token list, used to test points against a shape
+ * without going through cairo. Edges are stored in horizontal bands, so only
+ * the edges crossing the row of the tested point are visited
+ */
+class PathHitTester
+{
+private:
+	class Edge
+	{
+	public:
+		Vector2f p0;
+		Vector2f p1;
+		/* The fill this edge belongs to, only used for fills */
+		uint32_t group;
+		/* The distance from the edge that is still covered, half the width for strokes */
+		double pad;
+		Edge(const Vector2f& _p0, const Vector2f& _p1, uint32_t _g, double _pad):p0(_p0),p1(_p1),group(_g),pad(_pad){}
+	};
+	class EdgeSet
+	{
+	public:
+		std::vector<Edge> edges;
+		std::vector< std::vector<uint32_t> > bands;
+		double ymin;
+		double bandHeight;
+		void buildBands();
+		/* The edges that may cross the row y, NULL if there are none */
+		const std::vector<uint32_t>* bandFor(double y) const;
+	};
+	/* Every subpath, closed. This is what cairo_in_fill tests on the whole path */
+	EdgeSet outline;
+	/* The visible fills, each one closed and tested with the even-odd rule */
+	EdgeSet fills;
+	uint32_t fillGroups;
+	/* The visible strokes, not closed */
+	EdgeSet strokes;
+	const double scaleFactor;
+	void flatten(const std::vector<GeomToken>& tokens);
+	void flushFill(std::vector<Edge>& pending, bool visible);
+	void flushStroke(std::vector<Edge>& pending, bool visible, double pad);
+public:
+	PathHitTester(const std::vector<GeomToken>& tokens, double _scaleFactor);
+	double getScaleFactor() const { return scaleFactor; }
+	/* True if the point is inside the outlines with the nonzero rule, like cairo_in_fill */
+	bool hitTest(double x, double y) const;
+	/*
+	 * True if a visible fill or stroke covers the pixel at x, y.
+	 * Gradient and bitmap fills count as opaque over their whole area,
+	 * the alpha of their colors and pixels is not sampled
+	 */
+	bool isOpaque(double x, double y) const;
+};
+
 std::ostream& operator<<(std::ostream& s, const Vector2& p);
 
 };
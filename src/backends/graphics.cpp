@@ -29,6 +29,8 @@
 #include "scripting/flash/text/flashtext.h"
 
 #include <iostream>
+#include <limits>
+#include <cmath>
 
 using namespace lightspark;
 
@@ -291,17 +293,73 @@ bool TextureChunk::resizeIfLargeEnough(uint32_t w, uint32_t h)
 	return false;
 }
 
+void CachedSurface::getPlacement(int32_t& x, int32_t& y, float& a) const
+{
+	Locker l(mutex);
+	x=xOffset;
+	y=yOffset;
+	a=alpha;
+}
+
+void CachedSurface::setRasterized(int32_t x, int32_t y, float a, _NR<TokenList> tokens, const MATRIX& m, float scaling)
+{
+	Locker l(mutex);
+	xOffset=x;
+	yOffset=y;
+	alpha=a;
+	rasterTokens=tokens;
+	rasterMatrix=m;
+	rasterScaling=scaling;
+}
+
+bool CachedSurface::reuseRaster(const TokenList* tokens, const MATRIX& m, float scaling, float a)
+{
+	Locker l(mutex);
+	//A render still in flight would overwrite whatever we set here
+	if(pendingRenders || rasterTokens.getPtr()!=tokens || rasterScaling!=scaling)
+		return false;
+	if(m.ScaleX!=rasterMatrix.ScaleX || m.ScaleY!=rasterMatrix.ScaleY ||
+		m.RotateSkew0!=rasterMatrix.RotateSkew0 || m.RotateSkew1!=rasterMatrix.RotateSkew1)
+		return false;
+	//The texture can only be moved by whole pixels, a fractional move needs resampling
+	const number_t x=m.TranslateX-rasterMatrix.TranslateX;
+	const number_t y=m.TranslateY-rasterMatrix.TranslateY;
+	const number_t roundedX=floor(x+0.5);
+	const number_t roundedY=floor(y+0.5);
+	if(fabs(x-roundedX)>0.01 || fabs(y-roundedY)>0.01)
+		return false;
+	xOffset=roundedX;
+	yOffset=roundedY;
+	alpha=a;
+	return true;
+}
+
+void CachedSurface::renderQueued()
+{
+	Locker l(mutex);
+	pendingRenders++;
+}
+
+void CachedSurface::renderDone()
+{
+	Locker l(mutex);
+	assert(pendingRenders);
+	pendingRenders--;
+}
+
 CairoRenderer::CairoRenderer(ASObject* _o, CachedSurface& _t, const MATRIX& _m,
 		int32_t _x, int32_t _y, int32_t _w, int32_t _h, float _s, float _a)
 	: owner(_o),surface(_t),matrix(_m),xOffset(_x),yOffset(_y),alpha(_a),width(_w),height(_h),
-	surfaceBytes(NULL),scaleFactor(_s),uploadNeeded(true)
+	surfaceBytes(NULL),scaleFactor(_s),uploadNeeded(true),rasterComplete(false)
 {
 	owner->incRef();
+	surface.renderQueued();
 }
 
 CairoRenderer::~CairoRenderer()
 {
 	delete[] surfaceBytes;
+	surface.renderDone();
 	owner->decRef();
 }
 
@@ -324,9 +382,10 @@ const TextureChunk& CairoRenderer::getTexture()
 	//Verify that the texture is large enough
 	if(!surface.tex.resizeIfLargeEnough(width, height))
 		surface.tex=getSys()->getRenderThread()->allocateTexture(width, height,false);
-	surface.xOffset=xOffset;
-	surface.yOffset=yOffset;
-	surface.alpha=alpha;
+	if(rasterComplete)
+		surface.setRasterized(xOffset, yOffset, alpha, getRasterTokens(), matrix, scaleFactor);
+	else
+		surface.setRasterized(xOffset, yOffset, alpha, NullRef, matrix, scaleFactor);
 	return surface.tex;
 }
 
@@ -450,9 +509,9 @@ cairo_pattern_t* CairoTokenRenderer::FILLSTYLEToCairo(const FILLSTYLE& style, do
 			if(style.bitmap==NULL)
 				throw RunTimeException("Invalid bitmap");
 
-			cairo_surface_t* surface = cairo_image_surface_create_for_data (style.bitmap->data,
+			cairo_surface_t* surface = cairo_image_surface_create_for_data (style.bitmap->getData(),
 										CAIRO_FORMAT_ARGB32, style.bitmap->width, style.bitmap->height,
-										cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, style.bitmap->width));
+										style.bitmap->getStride());
 
 			pattern = cairo_pattern_create_for_surface(surface);
 			cairo_surface_destroy(surface);
@@ -668,20 +727,112 @@ cairo_surface_t* CairoRenderer::allocateSurface()
 	return cairo_image_surface_create_for_data(surfaceBytes, CAIRO_FORMAT_ARGB32, width, height, cairoWidthStride);
 }
 
+bool TokenList::getBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+{
+	Locker l(mutex);
+	if(!boundsValid)
+	{
+		computeBounds();
+		boundsValid=true;
+	}
+	xmin=bxmin;
+	xmax=bxmax;
+	ymin=bymin;
+	ymax=bymax;
+	return hasContent;
+}
+
+const PathHitTester* TokenList::getHitTester(float scaleFactor)
+{
+	//The flattening tolerance depends on the scale
+	if(hitTester && hitTester->getScaleFactor()!=scaleFactor)
+	{
+		delete hitTester;
+		hitTester=NULL;
+	}
+	if(hitTester==NULL)
+		hitTester=new PathHitTester(tokens, scaleFactor);
+	return hitTester;
+}
+
+bool TokenList::hitTest(float scaleFactor, number_t x, number_t y)
+{
+	Locker l(mutex);
+	return getHitTester(scaleFactor)->hitTest(x, y);
+}
+
+bool TokenList::isOpaque(float scaleFactor, number_t x, number_t y)
+{
+	Locker l(mutex);
+	return getHitTester(scaleFactor)->isOpaque(x, y);
+}
+
+void TokenList::computeBounds()
+{
+	#define VECTOR_BOUNDS(v) \
+		bxmin=dmin(v.x-strokeWidth,bxmin); \
+		bxmax=dmax(v.x+strokeWidth,bxmax); \
+		bymin=dmin(v.y-strokeWidth,bymin); \
+		bymax=dmax(v.y+strokeWidth,bymax);
+
+	bxmin = std::numeric_limits<double>::infinity();
+	bymin = std::numeric_limits<double>::infinity();
+	bxmax = -std::numeric_limits<double>::infinity();
+	bymax = -std::numeric_limits<double>::infinity();
+
+	hasContent = false;
+	double strokeWidth = 0;
+
+	for(unsigned int i=0;i<tokens.size();i++)
+	{
+		switch(tokens[i].type)
+		{
+			case CURVE_CUBIC:
+			{
+				VECTOR_BOUNDS(tokens[i].p3);
+				// fall through
+			}
+			case CURVE_QUADRATIC:
+			{
+				VECTOR_BOUNDS(tokens[i].p2);
+				// fall through
+			}
+			case STRAIGHT:
+			{
+				hasContent = true;
+				// fall through
+			}
+			case MOVE:
+			{
+				VECTOR_BOUNDS(tokens[i].p1);
+				break;
+			}
+			case CLEAR_FILL:
+			case CLEAR_STROKE:
+			case SET_FILL:
+			case FILL_KEEP_SOURCE:
+			case FILL_TRANSFORM_TEXTURE:
+				break;
+			case SET_STROKE:
+				strokeWidth = (double)(tokens[i].lineStyle.Width / 20.0);
+				break;
+		}
+	}
+
+#undef VECTOR_BOUNDS
+}
+
 void CairoTokenRenderer::executeDraw(cairo_t* cr)
 {
 	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
 	cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
 
-	cairoPathFromTokens(cr, tokens, scaleFactor, false);
+	cairoPathFromTokens(cr, tokens->tokens, scaleFactor, false);
 }
 
-StaticMutex CairoRenderer::cairoMutex = GLIBMM_STATIC_MUTEX_INIT;
-
 /* This implements IThreadJob::execute */
 void CairoRenderer::execute()
 {
-	Mutex::Lock l(cairoMutex);
 	if(width==0 || height==0 || !Config::getConfig()->isRenderingEnabled())
 	{
 		uploadNeeded = false;
@@ -698,6 +849,9 @@ void CairoRenderer::execute()
 		return;
 	}
 
+	rasterComplete=(xOffset>=0 && yOffset>=0 &&
+			xOffset+width<=windowWidth && yOffset+height<=windowHeight);
+
 	//TODO:clip on the right and bottom also
 	if(xOffset<0)
 		width+=xOffset;
@@ -709,6 +863,8 @@ void CairoRenderer::execute()
 		width=windowWidth-xOffset;
 	if((yOffset>0) && (height+yOffset) > windowHeight)
 		height=windowHeight-yOffset;
+	RenderThread* rt=getSys()->getRenderThread();
+	const uint64_t start=rt->rasterizationStarted();
 	cairo_surface_t* cairoSurface=allocateSurface();
 
 	cairo_t* cr=cairo_create(cairoSurface);
@@ -728,50 +884,7 @@ void CairoRenderer::execute()
 	executeDraw(cr);
 
 	cairo_destroy(cr);
-}
-
-bool CairoTokenRenderer::hitTest(const std::vector<GeomToken>& tokens, float scaleFactor, number_t x, number_t y)
-{
-	cairo_surface_t* cairoSurface=cairo_image_surface_create_for_data(NULL, CAIRO_FORMAT_ARGB32, 0, 0, 0);
-
-	cairo_t *cr=cairo_create(cairoSurface);
-	bool empty=cairoPathFromTokens(cr, tokens, scaleFactor, true);
-	bool ret=false;
-	if(!empty)
-	{
-		/* reset the matrix so x and y are not scaled
-		 * by the current cairo transformation
-		 */
-		cairo_identity_matrix(cr);
-		ret=cairo_in_fill(cr, x, y);
-	}
-	cairo_destroy(cr);
-	cairo_surface_destroy(cairoSurface);
-	return ret;
-}
-
-bool CairoTokenRenderer::isOpaque(const std::vector<GeomToken>& tokens, float scaleFactor, number_t x, number_t y)
-{
-	//We render the alpha value of a single pixel, hopefully this is not too slow
-	int32_t cairoWidthStride=cairo_format_stride_for_width(CAIRO_FORMAT_A8, 1);
-	uint8_t* pixelBytes=g_newa(uint8_t, cairoWidthStride);
-	cairo_surface_t* cairoSurface=cairo_image_surface_create_for_data(pixelBytes, CAIRO_FORMAT_A8, 1, 1, cairoWidthStride);
-
-	cairo_t* cr=cairo_create(cairoSurface);
-	cairoClean(cr);
-
-	//Make sure the rendering starts at 0,0 in surface coordinates
-	cairo_translate(cr, -x, -y);
-
-	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
-	cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
-
-	cairoPathFromTokens(cr, tokens, scaleFactor, false);
-
-	cairo_destroy(cr);
-	cairo_surface_destroy(cairoSurface);
-	//CHECK: the condition is alpha > 0x00 or alpha==0xff
-	return pixelBytes[0]!=0x00;
+	rt->rasterizationDone(start);
 }
 
 uint8_t* CairoRenderer::convertBitmapWithAlphaToCairo(uint8_t* inData, uint32_t width, uint32_t height, size_t* dataSize, size_t* stride)
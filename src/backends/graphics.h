@@ -27,6 +27,7 @@
 #include <vector>
 #include "swftypes.h"
 #include "threading.h"
+#include "smartrefs.h"
 #include <cairo.h>
 #include <pango/pango.h>
 #include "backends/geometry.h"
@@ -152,14 +153,110 @@ public:
 	uint32_t height;
 };
 
-class CachedSurface
+/*
+ * The tokens of a shape, shared by all the shapes created from the same tag
+ * and by the render jobs drawing them. A shared list must not be modified,
+ * see TokenContainer::getTokensForWrite. The bounds are computed only once
+ * for each list
+ */
+class TokenList
 {
+private:
+	ATOMIC_INT32(ref_count);
+	/* Protects the cached bounds and hitTester */
+	Mutex mutex;
+	bool boundsValid;
+	bool hasContent;
+	number_t bxmin, bxmax, bymin, bymax;
+	/* Built on the first hit test */
+	PathHitTester* hitTester;
+	void computeBounds();
+	const PathHitTester* getHitTester(float scaleFactor);
+	void dropCaches()
+	{
+		boundsValid=false;
+		delete hitTester;
+		hitTester=NULL;
+	}
 public:
-	CachedSurface():xOffset(0),yOffset(0),alpha(1.0){}
-	TextureChunk tex;
+	std::vector<GeomToken> tokens;
+	TokenList():ref_count(1),boundsValid(false),hasContent(false),bxmin(0),bxmax(0),bymin(0),bymax(0),hitTester(NULL){}
+	~TokenList() { delete hitTester; }
+	void incRef() { ATOMIC_INCREMENT(ref_count); }
+	void decRef()
+	{
+		if(ATOMIC_DECREMENT(ref_count)==0)
+			delete this;
+	}
+	bool isShared() const { return ref_count>1; }
+	/* Returns the unscaled bounds, or false if there is nothing to draw */
+	bool getBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax);
+	/*
+	 * Write access to tokens. Bounds and hit tests wait while a Writer exists,
+	 * the cached data is dropped when it goes out of scope, after the write
+	 */
+	class Writer
+	{
+	private:
+		TokenList* list;
+		Writer(const Writer&);
+		Writer& operator=(const Writer&);
+	public:
+		Writer(TokenList* l):list(l) { list->mutex.lock(); }
+		Writer(Writer&& w):list(w.list) { w.list=NULL; }
+		~Writer()
+		{
+			if(list==NULL)
+				return;
+			list->dropCaches();
+			list->mutex.unlock();
+		}
+		std::vector<GeomToken>* operator->() { return &list->tokens; }
+	};
+	/* x and y are in local coordinates, like the ones given to TokenContainer::hitTestImpl */
+	bool hitTest(float scaleFactor, number_t x, number_t y);
+	bool isOpaque(float scaleFactor, number_t x, number_t y);
+};
+
+/*
+ * The texture of a DisplayObject and where it is drawn. tex is only touched
+ * from the render thread, the placement is guarded by mutex. The surface also
+ * remembers which tokens and transformation were rasterized into tex, so that
+ * moving the object or changing its alpha does not need a new rasterization
+ */
+class CachedSurface
+{
+private:
+	mutable Mutex mutex;
 	int32_t xOffset;
 	int32_t yOffset;
 	float alpha;
+	/* The rasterized tokens, NullRef if tex can't be reused */
+	_NR<TokenList> rasterTokens;
+	/* The matrix used for the rasterization, translated to texture coordinates */
+	MATRIX rasterMatrix;
+	float rasterScaling;
+	/* Render jobs which have been queued but not uploaded or discarded yet */
+	uint32_t pendingRenders;
+public:
+	CachedSurface():xOffset(0),yOffset(0),alpha(1.0),rasterScaling(0),pendingRenders(0){}
+	TextureChunk tex;
+	void getPlacement(int32_t& x, int32_t& y, float& a) const;
+	/*
+	 * Called from the render thread when tex has been updated.
+	 * tokens is NullRef if the contents are not reusable, for example because
+	 * they have been clipped to the window
+	 */
+	void setRasterized(int32_t x, int32_t y, float a, _NR<TokenList> tokens, const MATRIX& m, float scaling);
+	/*
+	 * Moves the current texture to the new position if it already holds
+	 * tokens rasterized with the same scale and rotation, and the position
+	 * changed by whole pixels.
+	 * Returns false if a new rasterization is needed
+	 */
+	bool reuseRaster(const TokenList* tokens, const MATRIX& m, float scaling, float a);
+	void renderQueued();
+	void renderDone();
 };
 
 class ITextureUploadable
@@ -224,17 +321,27 @@ protected:
 	const float scaleFactor;
 	bool uploadNeeded;
 	/*
-	 * There are reports (http://lists.freedesktop.org/archives/cairo/2011-September/022247.html)
-	 * that cairo is not threadsafe, and I have encountered some spurious crashes, too.
-	 * So we use a global lock for all cairo calls until this issue is sorted out.
-	 * TODO: CairoRenderes are enqueued as IThreadJobs, therefore this mutex
-	 *       will serialize the thread pool when all thread pool workers are executing CairoRenderers!
+	   True if nothing has been clipped away, so the texture can be moved around
+	*/
+	bool rasterComplete;
+	/*
+	 * Renderers run concurrently on the thread pool. Each one draws on its own
+	 * surface and context, and only reads the tokens and bitmaps it references.
+	 * The font state shared through pango is serialized by CairoPangoRenderer.
+	 * All renderers used to share a global lock because of spurious crashes and
+	 * http://lists.freedesktop.org/archives/cairo/2011-September/022247.html
+	 * cairo guards its own global caches with the mutexes listed in
+	 * cairo-mutex-list-private.h, so objects that are not shared between
+	 * threads can be used concurrently.
 	 */
-	static StaticMutex cairoMutex;
 	static cairo_matrix_t MATRIXToCairo(const MATRIX& matrix);
 	static void cairoClean(cairo_t* cr);
 	cairo_surface_t* allocateSurface();
 	virtual void executeDraw(cairo_t* cr)=0;
+	/*
+	 * The tokens that identify the drawn contents, NullRef if they can't be reused
+	 */
+	virtual _NR<TokenList> getRasterTokens() const { return NullRef; }
 public:
 	CairoRenderer(ASObject* _o, CachedSurface& _t, const MATRIX& _m,
 				int32_t _x, int32_t _y, int32_t _w, int32_t _h, float _s, float _a);
@@ -246,6 +353,7 @@ public:
 	//IThreadJob interface
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_RENDER; }
 	void execute();
 	/*
 	 * Converts data (which is in RGB format) to the format internally used by cairo.
@@ -268,43 +376,26 @@ private:
 	/*
 	   The tokens to be drawn
 	*/
-	const std::vector<GeomToken> tokens;
+	_R<TokenList> tokens;
 	/*
 	 * This is run by CairoRenderer::execute()
 	 */
 	void executeDraw(cairo_t* cr);
+	_NR<TokenList> getRasterTokens() const { return tokens; }
 public:
 	/*
 	   CairoTokenRenderer constructor
 
 	   @param _o Owner of the surface _t. See comments on 'owner' member.
 	   @param _t GL surface where the final drawing will be uploaded
-	   @param _g The tokens to be drawn. This is copied internally.
+	   @param _g The tokens to be drawn. They are shared, not copied.
 	   @param _m The whole transformation matrix
 	   @param _s The scale factor to be applied in both the x and y axis
 	   @param _a The alpha factor to be applied
 	*/
-	CairoTokenRenderer(ASObject* _o, CachedSurface& _t, const std::vector<GeomToken>& _g, const MATRIX& _m,
+	CairoTokenRenderer(ASObject* _o, CachedSurface& _t, _R<TokenList> _g, const MATRIX& _m,
 					   int32_t _x, int32_t _y, int32_t _w, int32_t _h, float _s, float _a)
 		: CairoRenderer(_o,_t,_m,_x,_y,_w,_h,_s,_a), tokens(_g) {}
-	/*
-	   Hit testing helper. Uses cairo to find if a point in inside the shape
-
-	   @param tokens The tokens of the shape being tested
-	   @param scaleFactor The scale factor to be applied
-	   @param x The X in local coordinates
-	   @param y The Y in local coordinates
-	*/
-	static bool hitTest(const std::vector<GeomToken>& tokens, float scaleFactor, number_t x, number_t y);
-	/*
-	   Opacity test helper. Uses cairo to render a single pixel and see if it's opaque or not
-
-	   @param tokens The tokens of the shape being tested
-	   @param scaleFactor The scale factor to be applied
-	   @param x The X in local coordinates
-	   @param y The Y in local coordinates
-	*/
-	static bool isOpaque(const std::vector<GeomToken>& tokens, float scaleFactor, number_t x, number_t y);
 };
 
 class TextData
@@ -334,6 +425,7 @@ public:
 
 class CairoPangoRenderer : public CairoRenderer
 {
+	//Pango font maps and caches are not threadsafe
 	static StaticMutex pangoMutex;
 	/*
 	 * This is run by CairoRenderer::execute()
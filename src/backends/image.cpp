@@ -151,6 +151,38 @@ uint8_t* ImageDecoder::decodeJPEG(uint8_t* inData, int len, uint32_t* width, uin
 	return decodeJPEGImpl(src, width, height);
 }
 
+bool ImageDecoder::getJPEGSize(uint8_t* inData, int len, uint32_t* width, uint32_t* height)
+{
+	struct source_mgr src(inData,len);
+
+	src.init_source = init_source;
+	src.fill_input_buffer = fill_input_buffer;
+	src.skip_input_data = skip_input_data;
+	src.resync_to_restart = resync_to_restart;
+	src.term_source = term_source;
+
+	struct jpeg_decompress_struct cinfo;
+	struct error_mgr err;
+
+	//jpeg_destroy_decompress does nothing on a cleared struct
+	memset(&cinfo, 0, sizeof(cinfo));
+	cinfo.err = jpeg_std_error(&err);
+	err.error_exit = error_exit;
+
+	if (setjmp(err.jmpBuf)) {
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	cinfo.src = &src;
+	jpeg_read_header(&cinfo, TRUE);
+	*width = cinfo.image_width;
+	*height = cinfo.image_height;
+	jpeg_destroy_decompress(&cinfo);
+	return true;
+}
+
 uint8_t* ImageDecoder::decodeJPEG(std::istream& str, uint32_t* width, uint32_t* height)
 {
 	struct istream_source_mgr src(str);
@@ -173,11 +205,17 @@ uint8_t* ImageDecoder::decodeJPEGImpl(jpeg_source_mgr& src, uint32_t* width, uin
 {
 	struct jpeg_decompress_struct cinfo;
 	struct error_mgr err;
+	//Assigned after setjmp, so it must not be kept in a register
+	uint8_t* volatile outData = NULL;
 
+	//jpeg_destroy_decompress does nothing on a cleared struct
+	memset(&cinfo, 0, sizeof(cinfo));
 	cinfo.err = jpeg_std_error(&err);
 	err.error_exit = error_exit;
 
 	if (setjmp(err.jmpBuf)) {
+		jpeg_destroy_decompress(&cinfo);
+		delete[] outData;
 		return NULL;
 	}
 
@@ -200,7 +238,7 @@ uint8_t* ImageDecoder::decodeJPEGImpl(jpeg_source_mgr& src, uint32_t* width, uin
 	int rowstride = cinfo.output_width * cinfo.output_components;
 	JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, rowstride, 1);
 
-	uint8_t* outData = new uint8_t[cinfo.output_height * rowstride];
+	outData = new uint8_t[cinfo.output_height * rowstride];
 
 	/* read one scanline at a time */
 	int y=0;
@@ -37,6 +37,11 @@ public:
 	 */
 	static uint8_t* decodeJPEG(uint8_t* inData, int len, uint32_t* width, uint32_t* height);
 	static uint8_t* decodeJPEG(std::istream& str, uint32_t* width, uint32_t* height);
+	/*
+	 * Reads only the header to get the size of the image
+	 * Returns false on error
+	 */
+	static bool getJPEGSize(uint8_t* inData, int len, uint32_t* width, uint32_t* height);
 };
 
 }
@@ -241,6 +241,7 @@ private:
 public:
 	void enableFencingWaiting();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 	void waitFencing();
 protected:
 	//Abstract base class, can not be constructed
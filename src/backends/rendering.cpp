@@ -62,7 +62,7 @@ RenderThread::RenderThread(SystemState* s):
 	pixelBufferWidth(0),pixelBufferHeight(0),prevUploadJob(NULL),
 	renderNeeded(false),uploadNeeded(false),resizeNeeded(false),newTextureNeeded(false),event(0),newWidth(0),newHeight(0),scaleX(1),scaleY(1),
 	offsetX(0),offsetY(0),tempBufferAcquired(false),frameCount(0),secsCount(0),initialized(0),
-	tempTex(false),hasNPOTTextures(false),cairoTextureContext(NULL)
+	rasterJobs(0),rasterRunning(0),rasterJobTime(0),rasterBusyStart(0),rasterBusyTime(0),tempTex(false),hasNPOTTextures(false),cairoTextureContext(NULL)
 {
 	LOG(LOG_INFO,_("RenderThread this=") << this);
 #ifdef _WIN32
@@ -91,9 +91,34 @@ void RenderThread::stop()
 RenderThread::~RenderThread()
 {
 	wait();
+	if(rasterJobs)
+	{
+		LOG(LOG_INFO,_("Rasterized ") << rasterJobs << _(" jobs in ") << rasterJobTime/1000 << _("ms, ")
+				<< rasterBusyTime/1000 << _("ms with at least one running, ")
+				<< double(rasterJobTime)/max(rasterBusyTime,(uint64_t)1) << _(" in parallel on average"));
+	}
 	LOG(LOG_INFO,_("~RenderThread this=") << this);
 }
 
+uint64_t RenderThread::rasterizationStarted()
+{
+	const uint64_t now=compat_usectiming();
+	Locker l(mutexRasterStats);
+	if(rasterRunning++==0)
+		rasterBusyStart=now;
+	return now;
+}
+
+void RenderThread::rasterizationDone(uint64_t start)
+{
+	const uint64_t now=compat_usectiming();
+	Locker l(mutexRasterStats);
+	rasterJobs++;
+	rasterJobTime+=now-start;
+	if(--rasterRunning==0)
+		rasterBusyTime+=now-rasterBusyStart;
+}
+
 /*void RenderThread::acquireTempBuffer(number_t xmin, number_t xmax, number_t ymin, number_t ymax)
 {
 	::abort();
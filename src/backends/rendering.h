@@ -109,6 +109,17 @@ private:
 	void coreRendering();
 	void plotProfilingData();
 	Semaphore initialized;
+	/*
+		Rasterization statistics, logged on exit. Comparing the summed time of
+		the jobs with the time at least one of them was running gives how many
+		ran in parallel on average
+	*/
+	Mutex mutexRasterStats;
+	uint32_t rasterJobs;
+	uint32_t rasterRunning;
+	uint64_t rasterJobTime;
+	uint64_t rasterBusyStart;
+	uint64_t rasterBusyTime;
 
 	static void SizeAllocateCallback(GtkWidget* widget, GdkRectangle* allocation, gpointer data);
 public:
@@ -145,6 +156,12 @@ public:
 		Enqueue something to be uploaded to texture
 	*/
 	void addUploadJob(ITextureUploadable* u);
+	/**
+		Bracket the drawing of a CairoRenderer, from any thread.
+		rasterizationStarted returns the start time to give to rasterizationDone
+	*/
+	uint64_t rasterizationStarted();
+	void rasterizationDone(uint64_t start);
 
 	void requestResize(uint32_t w, uint32_t h);
 	void waitForInitialization()
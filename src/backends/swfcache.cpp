@@ -0,0 +1,255 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2011  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+#include "backends/swfcache.h"
+#include "backends/config.h"
+#include "logger.h"
+#include "threading.h"
+#include "swf.h"
+
+using namespace std;
+using namespace lightspark;
+
+//Bump this when the layout of the decoded data changes
+#define SWFCACHE_VERSION 1
+//Encoded data smaller than this decodes faster than the cache lookup
+#define SWFCACHE_MIN_SIZE 4096
+
+struct BitmapCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	uint64_t stride;
+	uint64_t dataSize;
+};
+
+static const char bitmapMagic[4]={'L','S','B','M'};
+
+static StaticMutex cachePathMutex=GLIBMM_STATIC_MUTEX_INIT;
+//Bytes used by the entries, counted by scanning the directory on the first write
+static StaticMutex cacheSizeMutex=GLIBMM_STATIC_MUTEX_INIT;
+static uint64_t cacheSize=0;
+static bool cacheSizeKnown=false;
+
+static const string& getCachePath()
+{
+	static string path;
+	static bool initialized=false;
+	Locker l(cachePathMutex);
+	if(!initialized)
+	{
+		initialized=true;
+		if(Config::getConfig()->isPersistentCacheEnabled())
+		{
+			string dir=Config::getConfig()->getCacheDirectory()+G_DIR_SEPARATOR_S+"swfcache";
+			if(g_mkdir_with_parents(dir.c_str(),0700)==0)
+				path=dir;
+			else
+				LOG(LOG_ERROR,_("Could not create SWF cache directory ") << dir);
+		}
+	}
+	return path;
+}
+
+string SWFCache::bitmapKey(uint8_t variant, const uint8_t* data, size_t len, const uint8_t* extra, size_t extraLen)
+{
+	if(len+extraLen<SWFCACHE_MIN_SIZE || getCachePath().empty())
+		return "";
+
+	GChecksum* sum=g_checksum_new(G_CHECKSUM_SHA1);
+	g_checksum_update(sum,&variant,1);
+	g_checksum_update(sum,data,len);
+	if(extra)
+		g_checksum_update(sum,extra,extraLen);
+	string ret=g_checksum_get_string(sum);
+	g_checksum_free(sum);
+	return ret;
+}
+
+struct CacheEntry
+{
+	string fileName;
+	uint64_t size;
+	time_t lastUse;
+	bool operator<(const CacheEntry& r) const { return lastUse<r.lastUse; }
+};
+
+/* Lists the entries of the cache directory and returns the bytes they use.
+ * Temporary files of writes in progress are not entries, they are skipped */
+static uint64_t scanCache(const string& path, vector<CacheEntry>* entries)
+{
+	uint64_t ret=0;
+	GDir* dir=g_dir_open(path.c_str(),0,NULL);
+	if(dir==NULL)
+		return 0;
+	const char* name;
+	while((name=g_dir_read_name(dir))!=NULL)
+	{
+		//Keys are hex SHA-1 digests
+		if(strlen(name)!=40)
+			continue;
+		CacheEntry e;
+		e.fileName=path+G_DIR_SEPARATOR_S+name;
+		struct stat st;
+		if(g_stat(e.fileName.c_str(),&st)!=0)
+			continue;
+		e.size=st.st_size;
+		e.lastUse=st.st_mtime;
+		ret+=e.size;
+		if(entries)
+			entries->push_back(e);
+	}
+	g_dir_close(dir);
+	return ret;
+}
+
+/* Accounts for a new entry of the given size and removes the least recently
+ * used entries when the cache grows past its budget. Hits touch their entry,
+ * so the modification time is the time of the last use */
+static void accountEntry(uint64_t size)
+{
+	const string& path=getCachePath();
+	const uint64_t budget=Config::getConfig()->getPersistentCacheSize();
+	Locker l(cacheSizeMutex);
+	if(!cacheSizeKnown)
+	{
+		cacheSize=scanCache(path,NULL);
+		cacheSizeKnown=true;
+	}
+	else
+		cacheSize+=size;
+	if(cacheSize<=budget)
+		return;
+
+	//Other instances may share the directory, so look at what is really there
+	vector<CacheEntry> entries;
+	cacheSize=scanCache(path,&entries);
+	sort(entries.begin(),entries.end());
+	//Evict down to 3/4 of the budget, so that the next writes do not evict again
+	for(unsigned int i=0;i<entries.size() && cacheSize>budget/4*3;i++)
+	{
+		if(g_unlink(entries[i].fileName.c_str())==0)
+			cacheSize-=entries[i].size;
+	}
+	LOG(LOG_INFO,_("SWF cache trimmed to ") << cacheSize/1024 << _(" KB"));
+}
+
+/* Writes an entry in the background, the decoding thread only copies the data */
+class CacheWriter: public IThreadJob
+{
+private:
+	string fileName;
+	string contents;
+public:
+	CacheWriter(const string& f, string& c):fileName(f)
+	{
+		contents.swap(c);
+	}
+	void execute()
+	{
+		//g_file_set_contents writes to a temporary file and renames it in place
+		GError* error=NULL;
+		if(!g_file_set_contents(fileName.c_str(),contents.data(),contents.size(),&error))
+		{
+			LOG(LOG_ERROR,_("Could not write SWF cache entry ") << fileName << ": " << error->message);
+			g_error_free(error);
+			return;
+		}
+		accountEntry(contents.size());
+	}
+	void jobFence()
+	{
+		delete this;
+	}
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
+};
+
+uint8_t* SWFCache::loadBitmap(const string& key, int32_t& width, int32_t& height, size_t& stride, size_t& dataSize)
+{
+	if(key.empty())
+		return NULL;
+
+	string fileName=getCachePath()+G_DIR_SEPARATOR_S+key;
+	GMappedFile* file=g_mapped_file_new(fileName.c_str(),FALSE,NULL);
+	if(file==NULL)
+		return NULL;
+
+	uint8_t* ret=NULL;
+	size_t len=g_mapped_file_get_length(file);
+	const char* contents=g_mapped_file_get_contents(file);
+	BitmapCacheHeader header;
+	if(len>=sizeof(header))
+	{
+		memcpy(&header,contents,sizeof(header));
+		//The entry may be truncated or come from elsewhere, check it before trusting the sizes
+		if(memcmp(header.magic,bitmapMagic,4)==0 && header.version==SWFCACHE_VERSION &&
+			header.width>0 && header.height>0 &&
+			header.dataSize==len-sizeof(header) &&
+			header.stride>=(uint64_t)header.width*4 &&
+			header.stride<=header.dataSize/header.height &&
+			header.dataSize==header.stride*header.height)
+		{
+			ret=new(nothrow) uint8_t[header.dataSize];
+			if(ret)
+			{
+				memcpy(ret,contents+sizeof(header),header.dataSize);
+				width=header.width;
+				height=header.height;
+				stride=header.stride;
+				dataSize=header.dataSize;
+				//Mark the entry as recently used
+				g_utime(fileName.c_str(),NULL);
+			}
+		}
+		else
+			LOG(LOG_INFO,_("Ignoring invalid SWF cache entry ") << fileName);
+	}
+	g_mapped_file_unref(file);
+	return ret;
+}
+
+void SWFCache::storeBitmap(const string& key, const uint8_t* data, int32_t width, int32_t height, size_t stride, size_t dataSize)
+{
+	if(key.empty())
+		return;
+
+	BitmapCacheHeader header;
+	memcpy(header.magic,bitmapMagic,4);
+	header.version=SWFCACHE_VERSION;
+	header.width=width;
+	header.height=height;
+	header.stride=stride;
+	header.dataSize=dataSize;
+
+	string contents;
+	contents.reserve(sizeof(header)+dataSize);
+	contents.append((const char*)&header,sizeof(header));
+	contents.append((const char*)data,dataSize);
+
+	string fileName=getCachePath()+G_DIR_SEPARATOR_S+key;
+	getSys()->addJob(new CacheWriter(fileName,contents));
+}
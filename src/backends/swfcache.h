@@ -0,0 +1,62 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2011  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef _SWFCACHE_H
+#define _SWFCACHE_H
+
+#include "compat.h"
+#include <string>
+
+namespace lightspark
+{
+
+/*
+ * On disk cache of decoded SWF resources. Entries are keyed by the SHA-1 of
+ * the encoded data, so a repeat load of the same content maps the decoded
+ * pixels back from the cache directory instead of inflating and converting
+ * them again. Entries are written atomically, so concurrent instances can
+ * share the cache. When the entries grow past the configured size the least
+ * recently used ones are removed
+ */
+class SWFCache
+{
+public:
+	/*
+	 * Returns the key for an encoded bitmap. variant distinguishes tags that
+	 * decode the same bytes differently, extra is any further data the
+	 * decoding depends on. Returns an empty string if the data is too small
+	 * to be worth caching or the cache is disabled
+	 */
+	static std::string bitmapKey(uint8_t variant, const uint8_t* data, size_t len,
+			const uint8_t* extra=NULL, size_t extraLen=0);
+	/*
+	 * Returns a new[]'ed copy of the cached pixels in the BitmapData layout,
+	 * or NULL if there is no valid entry for key
+	 */
+	static uint8_t* loadBitmap(const std::string& key, int32_t& width, int32_t& height,
+			size_t& stride, size_t& dataSize);
+	/*
+	 * Copies the pixels and writes the entry from a background job
+	 */
+	static void storeBitmap(const std::string& key, const uint8_t* data, int32_t width,
+			int32_t height, size_t stride, size_t dataSize);
+};
+
+};
+#endif
@@ -22,6 +22,9 @@
 #include <string>
 #include <stdlib.h>
 #include "logger.h"
+#ifndef _WIN32
+#	include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -49,6 +52,32 @@ uint64_t compat_msectiming()
 #endif
 }
 
+uint64_t compat_usectiming()
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return count.QuadPart*1000000/frequency.QuadPart;
+#else
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (t.tv_sec*1000000 + t.tv_nsec/1000);
+#endif
+}
+
+uint32_t compat_get_num_processors()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long ret=sysconf(_SC_NPROCESSORS_ONLN);
+	return (ret>0)?ret:1;
+#endif
+}
+
 int kill_child(GPid childPid)
 {
 #ifdef _WIN32
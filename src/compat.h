@@ -122,6 +122,10 @@ long lrint(double f);
 #	define ACQUIRE_RELEASE_FLAG(x) ATOMIC_INT32(x)
 #	define ACQUIRE_READ(x) InterlockedCompareExchange(const_cast<long*>(&x),1,1)
 #	define RELEASE_WRITE(x, v) InterlockedExchange(&x,v)
+//Volatile accesses have acquire and release semantics with MSVC
+#	define ATOMIC_POINTER(T, x) T* volatile x
+#	define ACQUIRE_READ_POINTER(x) (x)
+#	define POINTER_COMPARE_AND_SWAP(x, o, n) (InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&x),n,o)==(o))
 #else //GCC
 #ifndef _WIN32
 #	define CALLBACK
@@ -142,6 +146,16 @@ long lrint(double f);
 #	define ACQUIRE_RELEASE_FLAG(x) std::atomic_bool x
 #	define ACQUIRE_READ(x) x.load(std::memory_order_acquire)
 #	define RELEASE_WRITE(x, v) x.store(v, std::memory_order_release)
+
+//Pointer published once by one of several threads, see POINTER_COMPARE_AND_SWAP
+#	define ATOMIC_POINTER(T, x) std::atomic<T*> x
+#	define ACQUIRE_READ_POINTER(x) x.load(std::memory_order_acquire)
+template<class T>
+inline bool pointerCompareAndSwap(std::atomic<T*>& x, T* o, T* n)
+{
+	return x.compare_exchange_strong(o,n);
+}
+#	define POINTER_COMPARE_AND_SWAP(x, o, n) pointerCompareAndSwap(x,o,n)
 #endif
 
 
@@ -180,9 +194,13 @@ inline T maxTmpl(T a, T b)
 /* timing */
 
 uint64_t compat_msectiming();
+uint64_t compat_usectiming();
 void compat_msleep(unsigned int time);
 uint64_t compat_get_thread_cputime_us();
 
+/* number of online processors, at least 1 */
+uint32_t compat_get_num_processors();
+
 int kill_child(GPid p);
 
 /* byte order */
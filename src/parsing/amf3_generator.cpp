@@ -168,7 +168,7 @@ _R<ASObject> Amf3Deserializer::parseObject(std::vector<tiny_string>& stringMap,
 		//Invoke readExternal
 		multiname readExternalName;
 		readExternalName.name_type=multiname::NAME_STRING;
-		readExternalName.name_s="readExternal";
+		readExternalName.setName("readExternal");
 		readExternalName.ns.push_back(nsNameAndKind("",NAMESPACE));
 		readExternalName.isAttribute = false;
 
@@ -217,7 +217,7 @@ _R<ASObject> Amf3Deserializer::parseObject(std::vector<tiny_string>& stringMap,
 
 		multiname name;
 		name.name_type=multiname::NAME_STRING;
-		name.name_s=traits.traitsNames[i];
+		name.setName(traits.traitsNames[i]);
 		name.ns.push_back(nsNameAndKind("",NAMESPACE));
 		name.isAttribute=false;
 
@@ -27,7 +27,9 @@
 #include "scripting/abc.h"
 #include "tags.h"
 #include "backends/geometry.h"
+#include "backends/image.h"
 #include "backends/security.h"
+#include "backends/swfcache.h"
 #include "swftypes.h"
 #include "logger.h"
 #include "compat.h"
@@ -38,10 +40,8 @@
 using namespace std;
 using namespace lightspark;
 
-_NR<Tag> TagFactory::readTag()
+bool TagFactory::readHeader(RECORDHEADER& h)
 {
-	RECORDHEADER h;
-
 	//Catch eofs
 	try
 	{
@@ -52,9 +52,68 @@ _NR<Tag> TagFactory::readTag()
 			throw e;
 		f.clear();
 		LOG(LOG_INFO,"Simulating EndTag at EOF @ " << f.tellg());
+		return false;
+	}
+	return true;
+}
+
+_NR<Tag> TagFactory::readTag()
+{
+	RECORDHEADER h;
+	if(!readHeader(h))
 		return _MR(new EndTag(h,f));
+	return readTagBody(h);
+}
+
+bool TagFactory::isDeferrable(const RECORDHEADER& h)
+{
+	switch(h.getTagType())
+	{
+		case 2: //DefineShape
+		case 10: //DefineFont
+		case 22: //DefineShape2
+		case 32: //DefineShape3
+		case 46: //DefineMorphShape
+		case 48: //DefineFont2
+		case 75: //DefineFont3
+		case 83: //DefineShape4
+			return true;
+#ifndef PROFILING_SUPPORT
+		//The contexts are registered for profiling from the constructor
+		case 72: //DoABC
+		case 82: //DoABCDefine
+			return true;
+#endif
+		default:
+			return false;
 	}
+}
 
+_NR<Tag> TagFactory::readTagOrBody(RECORDHEADER& h, std::string& body)
+{
+	if(!readHeader(h))
+		return _MR(new EndTag(h,f));
+	if(!isDeferrable(h))
+		return readTagBody(h);
+
+	body.resize(h.getLength());
+	if(!body.empty())
+		f.read(&body[0], body.size());
+	firstTag=false;
+	return NullRef;
+}
+
+_NR<Tag> TagFactory::parseTag(RECORDHEADER h, const std::string& body)
+{
+	istringstream s(body);
+	s.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
+	TagFactory factory(s, true);
+	factory.firstTag=false;
+	return factory.readTagBody(h);
+}
+
+_NR<Tag> TagFactory::readTagBody(RECORDHEADER h)
+{
 	unsigned int expectedLen=h.getLength();
 	unsigned int start=f.tellg();
 	Tag* ret=NULL;
@@ -616,6 +675,144 @@ DefineFont4Tag::DefineFont4Tag(RECORDHEADER h, std::istream& in):DictionaryTag(h
 	ignore(in,dest-in.tellg());
 }
 
+/*
+ * The zlib compressed pixels of a DefineBitsLossless(2) tag, inflated on
+ * first use
+ */
+class LosslessBitmapBuffer: public BitmapBuffer
+{
+private:
+	string cData;
+	int version;
+	void decode();
+public:
+	LosslessBitmapBuffer(int32_t w, int32_t h, string& data, int v):BitmapBuffer(w, h, true),version(v)
+	{
+		cData.swap(data);
+	}
+};
+
+void LosslessBitmapBuffer::decode()
+{
+	//The decoded size depends on the dimensions too
+	uint16_t dimensions[2]={(uint16_t)width, (uint16_t)height};
+	string cacheKey=SWFCache::bitmapKey(version, (const uint8_t*)cData.data(), cData.size(),
+			(const uint8_t*)dimensions, sizeof(dimensions));
+	if(!fromCache(cacheKey))
+	{
+		istringstream cDataStream(cData);
+		zlib_filter zf(cDataStream.rdbuf());
+		istream zfstream(&zf);
+
+		size_t size = width * height * 4;
+		uint8_t* inData=new(nothrow) uint8_t[size];
+		if(inData==NULL)
+			throw RunTimeException("Cannot allocate bitmap");
+		zfstream.read((char*)inData,size);
+		if(zfstream.fail() || zfstream.eof())
+		{
+			delete[] inData;
+			throw ParseException("Truncated DefineBitsLossless data");
+		}
+
+		if(version == 1)
+		{	/* for version 1, the alpha field is always zero
+			 * but should not be interpreted. Setting it to
+			 * 0xff (opaque) allows us to handle it as ARGB
+			 */
+			for(size_t i=0;i<size;i+=4)
+				inData[i] = 0xFF;
+		}
+
+		if(fromRGB(inData, true))
+			toCache(cacheKey);
+	}
+	//Not needed anymore
+	string().swap(cData);
+}
+
+/*
+ * The JPEG data and the zlib compressed alpha channel of a DefineBitsJPEG2/3
+ * tag, decoded on first use
+ */
+class JPEGBitmapBuffer: public BitmapBuffer
+{
+private:
+	string jpegData;
+	string alphaData;
+	uint8_t cacheVariant;
+	void decode();
+public:
+	JPEGBitmapBuffer(int32_t w, int32_t h, string& jpeg, string& alpha, uint8_t v):
+		BitmapBuffer(w, h, true),cacheVariant(v)
+	{
+		jpegData.swap(jpeg);
+		alphaData.swap(alpha);
+	}
+};
+
+void JPEGBitmapBuffer::decode()
+{
+	string cacheKey=SWFCache::bitmapKey(cacheVariant, (const uint8_t*)jpegData.data(), jpegData.size(),
+			(const uint8_t*)alphaData.data(), alphaData.size());
+	if(!fromCache(cacheKey))
+	{
+		//TODO: check header. Could also be PNG or GIF
+		uint32_t w,h;
+		uint8_t* rgb=ImageDecoder::decodeJPEG((uint8_t*)&jpegData[0], jpegData.size(), &w, &h);
+		if(rgb && (w!=(uint32_t)width || h!=(uint32_t)height))
+		{
+			LOG(LOG_ERROR, "JPEG size does not match its header");
+			delete[] rgb;
+			rgb=NULL;
+		}
+		bool complete=fromRGB(rgb, false);
+		if(complete && !alphaData.empty())
+		{
+			//Create a zlib filter
+			istringstream alphaStream(alphaData);
+			zlib_filter zf(alphaStream.rdbuf());
+			istream zfstream(&zf);
+			zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
+
+			//Catch the exception if the stream ends
+			try
+			{
+				//Set alpha
+				for(int32_t i=0;i<height;i++)
+				{
+					for(int32_t j=0;j<width;j++)
+						data[i*stride + j*4 + 3]=zfstream.get();
+				}
+			}
+			catch(std::exception& e)
+			{
+				LOG(LOG_ERROR, "Exception while parsing Alpha data in DefineBitsJPEG3");
+				complete=false;
+			}
+		}
+		if(complete)
+			toCache(cacheKey);
+	}
+	//Not needed anymore
+	string().swap(jpegData);
+	string().swap(alphaData);
+}
+
+/* Returns the encoded buffer for the JPEG, or NULL if its header is invalid */
+static BitmapBuffer* createJPEGBuffer(string& jpeg, string& alpha, uint8_t cacheVariant)
+{
+	uint32_t w,h;
+	/* flash uses signed values for width and height */
+	if(!ImageDecoder::getJPEGSize((uint8_t*)&jpeg[0], jpeg.size(), &w, &h) ||
+		(int32_t)w < 0 || (int32_t)h < 0)
+	{
+		LOG(LOG_ERROR, "Invalid JPEG data");
+		return NULL;
+	}
+	return new JPEGBitmapBuffer(w, h, jpeg, alpha, cacheVariant);
+}
+
 DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int version):DictionaryTag(h)
 {
 	int dest=in.tellg();
@@ -636,25 +833,11 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 	size_t cSize = dest-in.tellg(); //rest of this tag
 	cData.resize(cSize);
 	in.read(&cData[0], cSize);
-	istringstream cDataStream(cData);
-	zlib_filter zf(cDataStream.rdbuf());
-	istream zfstream(&zf);
-
-	size_t size = BitmapWidth * BitmapHeight * 4;
-	uint8_t* inData=new(nothrow) uint8_t[size];
-	zfstream.read((char*)inData,size);
-	assert(!zfstream.fail() && !zfstream.eof());
-
-	if(version == 1)
-	{	/* for version 1, the alpha field is always zero
-		 * but should not be interpreted. Setting it to
-		 * 0xff (opaque) allows us to handle it as ARGB
-		 */
-		for(size_t i=0;i<size;i+=4)
-			inData[i] = 0xFF;
-	}
 
-	fromRGB(inData, BitmapWidth, BitmapHeight, true);
+	//The pixels are inflated when first used
+	width=BitmapWidth;
+	height=BitmapHeight;
+	setBuffer(new LosslessBitmapBuffer(width, height, cData, version));
 }
 
 ASObject* DefineBitsLosslessTag::instance() const
@@ -678,7 +861,7 @@ ASObject* DefineBitsLosslessTag::instance() const
 	return ret;
 }
 
-DefineTextTag::DefineTextTag(RECORDHEADER h, istream& in, int v):DictionaryTag(h),version(v)
+DefineTextTag::DefineTextTag(RECORDHEADER h, istream& in, int v):DictionaryTag(h),tokens(_MR(new TokenList)),version(v)
 {
 	in >> CharacterId >> TextBounds >> TextMatrix >> GlyphBits >> AdvanceBits;
 	assert(v==1 || v==2);
@@ -702,7 +885,7 @@ ASObject* DefineTextTag::instance() const
 	/* we cannot call computeCached in the constructor
 	 * because loadedFrom is not available there for dictionary lookups
 	 */
-	if(tokens.empty())
+	if(tokens->tokens.empty())
 		computeCached();
 
 	StaticText* ret=new StaticText(tokens);
@@ -712,7 +895,7 @@ ASObject* DefineTextTag::instance() const
 
 void DefineTextTag::computeCached() const
 {
-	if(!tokens.empty())
+	if(!tokens->tokens.empty())
 		return;
 
 	FontTag* curFont = NULL;
@@ -758,31 +941,31 @@ void DefineTextTag::computeCached() const
 			/* curPos is in pixel, but the glyph coordinates are 1024*20 times pixel size,
 			 * so we scale curPos. This is scaled back to pixels by cairo.
 			 */
-			TokenContainer::FromShaperecordListToShapeVector(sr,tokens,fillStyles,curPos*1024*20,scaling);
+			TokenContainer::FromShaperecordListToShapeVector(sr,tokens->tokens,fillStyles,curPos*1024*20,scaling);
 			curPos.x += ge.GlyphAdvance;
 		}
 	}
 }
 
-DefineShapeTag::DefineShapeTag(RECORDHEADER h, std::istream& in):DictionaryTag(h),Shapes(1)
+DefineShapeTag::DefineShapeTag(RECORDHEADER h, std::istream& in):DictionaryTag(h),Shapes(1),tokens(_MR(new TokenList))
 {
 	LOG(LOG_TRACE,_("DefineShapeTag"));
 	in >> ShapeId >> ShapeBounds >> Shapes;
-	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens,Shapes.FillStyles.FillStyles);
+	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens->tokens,Shapes.FillStyles.FillStyles);
 }
 
 DefineShape2Tag::DefineShape2Tag(RECORDHEADER h, std::istream& in):DefineShapeTag(h,2)
 {
 	LOG(LOG_TRACE,_("DefineShape2Tag"));
 	in >> ShapeId >> ShapeBounds >> Shapes;
-	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens,Shapes.FillStyles.FillStyles);
+	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens->tokens,Shapes.FillStyles.FillStyles);
 }
 
 DefineShape3Tag::DefineShape3Tag(RECORDHEADER h, std::istream& in):DefineShape2Tag(h,3)
 {
 	LOG(LOG_TRACE,_("DefineShape3Tag"));
 	in >> ShapeId >> ShapeBounds >> Shapes;
-	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens,Shapes.FillStyles.FillStyles);
+	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens->tokens,Shapes.FillStyles.FillStyles);
 }
 
 DefineShape4Tag::DefineShape4Tag(RECORDHEADER h, std::istream& in):DefineShape3Tag(h,4)
@@ -795,7 +978,7 @@ DefineShape4Tag::DefineShape4Tag(RECORDHEADER h, std::istream& in):DefineShape3T
 	UsesNonScalingStrokes=UB(1,bs);
 	UsesScalingStrokes=UB(1,bs);
 	in >> Shapes;
-	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens,Shapes.FillStyles.FillStyles);
+	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens->tokens,Shapes.FillStyles.FillStyles);
 }
 
 DefineMorphShapeTag::DefineMorphShapeTag(RECORDHEADER h, std::istream& in):DictionaryTag(h)
@@ -1276,9 +1459,11 @@ DefineBinaryDataTag::DefineBinaryDataTag(RECORDHEADER h,std::istream& s):Diction
 	int size=h.getLength();
 	s >> Tag >> Reserved;
 	size -= sizeof(Tag)+sizeof(Reserved);
-	bytes=new uint8_t[size];
+	//Allocate at least a byte, ByteArrayBuffer data is never NULL
+	uint8_t* data=(uint8_t*) malloc(max(size,1));
 	len=size;
-	s.read((char*)bytes,size);
+	s.read((char*)data,size);
+	bytes=new ByteArrayBuffer(data,size);
 }
 
 FileAttributesTag::FileAttributesTag(RECORDHEADER h, std::istream& in):Tag(h)
@@ -1405,11 +1590,18 @@ DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in):Diction
 	in >> CharacterId;
 	//Read image data
 	int dataSize=Header.getLength()-2;
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
+	string jpeg, alpha;
+	jpeg.resize(dataSize);
+	in.read(&jpeg[0],dataSize);
 
-	fromJPEG(inData,dataSize);
-	delete[] inData;
+	//The image is decoded when first used
+	BitmapBuffer* b=createJPEGBuffer(jpeg, alpha, 3);
+	if(b)
+	{
+		width=b->width;
+		height=b->height;
+		setBuffer(b);
+	}
 }
 
 ASObject* DefineBitsJPEG2Tag::instance() const
@@ -1428,40 +1620,25 @@ DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in):Diction
 	UI32_SWF dataSize;
 	in >> CharacterId >> dataSize;
 	//Read image data
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-
-	//TODO: check header. Could also be PNG or GIF
-	fromJPEG(inData,dataSize);
-	delete[] inData;
+	string jpeg, alpha;
+	jpeg.resize(dataSize);
+	in.read(&jpeg[0],dataSize);
 
 	//Read alpha data (if any)
 	int alphaSize=Header.getLength()-dataSize-6;
 	if(alphaSize>0) //If less that 0 the consistency check on tag size will stop later
 	{
-		//Create a zlib filter
-		string alphaData;
-		alphaData.resize(alphaSize);
-		in.read(&alphaData[0], alphaSize);
-		istringstream alphaStream(alphaData);
-		zlib_filter zf(alphaStream.rdbuf());
-		istream zfstream(&zf);
-		zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
+		alpha.resize(alphaSize);
+		in.read(&alpha[0], alphaSize);
+	}
 
-		//Catch the exception if the stream ends
-		try
-		{
-			//Set alpha
-			for(int32_t i=0;i<height;i++)
-			{
-				for(int32_t j=0;j<width;j++)
-					data[i*stride + j*4 + 3]=zfstream.get();
-			}
-		}
-		catch(std::exception& e)
-		{
-			LOG(LOG_ERROR, "Exception while parsing Alpha data in DefineBitsJPEG3");
-		}
+	//The image is decoded when first used
+	BitmapBuffer* b=createJPEGBuffer(jpeg, alpha, 4);
+	if(b)
+	{
+		width=b->width;
+		height=b->height;
+		setBuffer(b);
 	}
 }
 
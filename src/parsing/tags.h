@@ -122,9 +122,9 @@ protected:
 	UI16_SWF ShapeId;
 	RECT ShapeBounds;
 	SHAPEWITHSTYLE Shapes;
-	/* tokens are computed from Shapes */
-	std::vector<GeomToken> tokens;
-	DefineShapeTag(RECORDHEADER h,int v):DictionaryTag(h),Shapes(v) {}
+	/* tokens are computed from Shapes and shared by all the instances */
+	_R<TokenList> tokens;
+	DefineShapeTag(RECORDHEADER h,int v):DictionaryTag(h),Shapes(v),tokens(_MR(new TokenList)) {}
 public:
 	DefineShapeTag(RECORDHEADER h, std::istream& in);
 	virtual int getId(){ return ShapeId; }
@@ -369,18 +369,17 @@ class DefineBinaryDataTag: public DictionaryTag
 private:
 	UI16_SWF Tag;
 	UI32_SWF Reserved;
-	uint8_t* bytes;
+	//Shared by all the instances, they copy it only when written
+	ByteArrayBuffer* bytes;
 	uint32_t len;
 public:
 	DefineBinaryDataTag(RECORDHEADER h,std::istream& s);
-	~DefineBinaryDataTag() { delete[] bytes; }
+	~DefineBinaryDataTag() { bytes->decRef(); }
 	virtual int getId(){return Tag;} 
 
 	ASObject* instance() const
 	{
-		uint8_t* b = new uint8_t[len];
-		memcpy(b,bytes,len);
-		ByteArray* ret=new ByteArray(b, len);
+		ByteArray* ret=new ByteArray(bytes, len);
 		ret->setClass(Class<ByteArray>::getClass());
 		return ret;
 	}
@@ -504,7 +503,7 @@ private:
 	UI8 GlyphBits;
 	UI8 AdvanceBits;
 	std::vector < TEXTRECORD > TextRecords;
-	mutable std::vector<GeomToken> tokens;
+	mutable _R<TokenList> tokens;
 	void computeCached() const;
 public:
 	int version;
@@ -728,9 +727,21 @@ private:
 	std::istream& f;
 	bool firstTag;
 	bool topLevel;
+	//Returns false at the end of the file
+	bool readHeader(RECORDHEADER& h);
+	_NR<Tag> readTagBody(RECORDHEADER h);
+	//Tags which are expensive to parse and are not needed to parse the tags that follow them
+	static bool isDeferrable(const RECORDHEADER& h);
 public:
 	TagFactory(std::istream& in, bool t):f(in),firstTag(true),topLevel(t){}
 	_NR<Tag> readTag();
+	/*
+	 * Like readTag, but deferrable tags are not parsed: their body is
+	 * read into body and NullRef is returned. They can be parsed later,
+	 * by any thread, with parseTag
+	 */
+	_NR<Tag> readTagOrBody(RECORDHEADER& h, std::string& body);
+	static _NR<Tag> parseTag(RECORDHEADER h, const std::string& body);
 };
 
 };
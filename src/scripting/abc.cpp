@@ -541,6 +541,28 @@ multiname* ABCContext::s_getMultiname(ABCContext* th, ASObject* n, ASObject* n2,
 	return th->getMultinameImpl(n,n2,midx);
 }
 
+void ABCContext::resolveStaticMultinames()
+{
+	//Index 0 is the any name
+	getMultinameImpl(NULL,NULL,0);
+	for(unsigned int i=1;i<constant_pool.multinames.size();i++)
+	{
+		switch(constant_pool.multinames[i].kind)
+		{
+			case 0x07: //QName
+			case 0x0d: //QNameA
+			case 0x09: //Multiname
+			case 0x0e: //MultinameA
+			case 0x1d: //Templated name
+				getMultinameImpl(NULL,NULL,i);
+				break;
+			default:
+				break;
+		}
+	}
+	staticMultinamesResolved=true;
+}
+
 /*
  * Gets a multiname without accessing the runtime stack.
  * If getMultinameRTData(midx) return 1 then the object
@@ -564,7 +586,7 @@ multiname* ABCContext::getMultinameImpl(ASObject* n, ASObject* n2, unsigned int
 		ret=m->cached;
 		if(midx==0)
 		{
-			ret->name_s="any";
+			ret->setName("any");
 			ret->name_type=multiname::NAME_STRING;
 			ret->ns.emplace_back(nsNameAndKind("",NAMESPACE));
 			ret->isAttribute=false;
@@ -582,7 +604,7 @@ multiname* ABCContext::getMultinameImpl(ASObject* n, ASObject* n2, unsigned int
 				else
 					ret->ns.push_back(nsNameAndKind("",(NS_KIND)(int)n->kind));
 
-				ret->name_s=getString(m->name);
+				ret->setInternedName(getString(m->name));
 				ret->name_type=multiname::NAME_STRING;
 				break;
 			}
@@ -598,7 +620,7 @@ multiname* ABCContext::getMultinameImpl(ASObject* n, ASObject* n2, unsigned int
 				}
 				sort(ret->ns.begin(),ret->ns.end());
 
-				ret->name_s=getString(m->name);
+				ret->setInternedName(getString(m->name));
 				ret->name_type=multiname::NAME_STRING;
 				break;
 			}
@@ -619,7 +641,7 @@ multiname* ABCContext::getMultinameImpl(ASObject* n, ASObject* n2, unsigned int
 			case 0x10: //RTQNameA
 			{
 				ret->name_type=multiname::NAME_STRING;
-				ret->name_s=getString(m->name);
+				ret->setInternedName(getString(m->name));
 				break;
 			}
 			case 0x11: //RTQNameL
@@ -642,7 +664,7 @@ multiname* ABCContext::getMultinameImpl(ASObject* n, ASObject* n2, unsigned int
 				}
 				const namespace_info* n=&constant_pool.namespaces[td->ns];
 				ret->ns.push_back(nsNameAndKind(getString(n->name),(NS_KIND)(int)n->kind));
-				ret->name_s=name;
+				ret->setInternedName(name);
 				ret->name_type=multiname::NAME_STRING;
 				break;
 			}
@@ -708,7 +730,7 @@ multiname* ABCContext::getMultinameImpl(ASObject* n, ASObject* n2, unsigned int
 	return ret;
 }
 
-ABCContext::ABCContext(RootMovieClip* r, istream& in):root(r)
+ABCContext::ABCContext(RootMovieClip* r, istream& in):root(r),staticMultinamesResolved(false)
 {
 	in >> minor >> major;
 	LOG(LOG_CALLS,_("ABCVm version ") << major << '.' << minor);
@@ -814,8 +836,9 @@ void ABCContext::dumpProfilingData(ostream& f) const
 }
 #endif
 
-ABCVm::ABCVm(SystemState* s):m_sys(s),status(CREATED),shuttingdown(false),currentCallContext(NULL),
-	cur_recursion(0)
+ABCVm::ABCVm(SystemState* s):m_sys(s),status(CREATED),jitThread(NULL),jitShuttingDown(false),
+	jitCompiled(0),jitMaxQueueLength(0),jitCompileTime(0),jitWindowStart(0),jitWindowTime(0),shuttingdown(false),currentCallContext(NULL),
+	numberClass(NULL),intClass(NULL),uintClass(NULL),booleanClass(NULL),cur_recursion(0)
 {
 	limits.max_recursion = 256;
 	limits.script_timeout = 20;
@@ -823,6 +846,8 @@ ABCVm::ABCVm(SystemState* s):m_sys(s),status(CREATED),shuttingdown(false),curren
 	int_manager=new Manager(15);
 	uint_manager=new Manager(15);
 	number_manager=new Manager(15);
+	undefinedInstance=new Undefined;
+	nullInstance=new Null;
 }
 
 void ABCVm::start()
@@ -863,6 +888,8 @@ ABCVm::~ABCVm()
 	delete int_manager;
 	delete uint_manager;
 	delete number_manager;
+	undefinedInstance->decRef();
+	nullInstance->decRef();
 }
 
 int ABCVm::getEventQueueSize()
@@ -1440,6 +1467,13 @@ void ABCVm::Run(ABCVm* th)
 		th->registerFunctions();
 	}
 	th->registerClasses();
+	th->numberClass=Class<Number>::getClass();
+	th->intClass=Class<Integer>::getClass();
+	th->uintClass=Class<UInteger>::getClass();
+	th->booleanClass=Class<Boolean>::getClass();
+	//Without the interpreter methods are compiled before their first call
+	if(th->m_sys->useJit && th->m_sys->useInterpreter)
+		th->jitThread=Glib::Thread::create(sigc::bind(&jitWorker,th), true);
 
 	ThreadProfile* profile=th->m_sys->allocateProfiler(RGB(0,200,0));
 	profile->setTag("VM");
@@ -1499,6 +1533,7 @@ void ABCVm::Run(ABCVm* th)
 			break;
 		}
 	}
+	th->stopJitWorker();
 	if(th->m_sys->useJit)
 	{
 		th->ex->clearAllGlobalMappings();
@@ -1506,6 +1541,220 @@ void ABCVm::Run(ABCVm* th)
 	}
 }
 
+/* Compiles the queued methods, one at a time. The VM thread keeps interpreting
+ * them until ABCVm::getCompiledMethod finds the native code ready */
+void ABCVm::jitWorker(ABCVm* th)
+{
+	setTLSSys(th->m_sys);
+	ThreadProfile* profile=th->m_sys->allocateProfiler(RGB(200,0,200));
+	profile->setTag("JIT");
+	while(true)
+	{
+		th->jit_queue_mutex.lock();
+		while(th->jit_queue.empty() && !th->jitShuttingDown)
+			th->jit_queue_cond.wait(th->jit_queue_mutex);
+		if(th->jitShuttingDown)
+		{
+			th->jit_queue_mutex.unlock();
+			break;
+		}
+		method_info* mi=th->jit_queue.front();
+		th->jit_queue.pop_front();
+		th->jit_queue_mutex.unlock();
+
+		Chronometer chronometer;
+		SyntheticFunction::synt_function f=NULL;
+		try
+		{
+			Locker l(th->jit_mutex);
+			f=mi->synt_method();
+		}
+		catch(LightsparkException& e)
+		{
+			//The method will just stay interpreted
+			LOG(LOG_ERROR,_("JIT compilation failed: ") << e.cause);
+		}
+		uint32_t elapsed=chronometer.checkpoint();
+		profile->accountTime(elapsed);
+
+		Locker l(th->jit_queue_mutex);
+		//mi->f is set by synt_method, the release makes it visible with the status
+		RELEASE_WRITE(mi->jitStatus,(f)?method_info::JIT_DONE:method_info::JIT_FAILED);
+		th->jitCompiled++;
+		th->jitCompileTime+=elapsed;
+		th->jitWindowTime+=elapsed;
+	}
+}
+
+void ABCVm::stopJitWorker()
+{
+	if(jitThread==NULL)
+		return;
+	jit_queue_mutex.lock();
+	jitShuttingDown=true;
+	jit_queue_cond.signal();
+	jit_queue_mutex.unlock();
+	jitThread->join();
+	jitThread=NULL;
+	LOG(LOG_INFO,_("JIT compiled ") << jitCompiled << _(" methods in ") << jitCompileTime/1000 << _("ms, ")
+			<< jit_queue.size() << _(" left in the queue, at most ") << jitMaxQueueLength << _(" queued"));
+}
+
+/* Returns the multiname index of field if the getter is just "return this.field",
+ * possibly with the pushscope of this that compilers emit, otherwise 0 */
+static uint32_t trivialGetterField(method_info* mi)
+{
+	if(mi->body->exception_count || mi->numArgs() || mi->needsArgs() || mi->needsRest() || mi->needsActivation())
+		return 0;
+	const vector<preloadedcodedata>& code=mi->preloadedcode;
+	unsigned int i=0;
+	if(code.size()>2 && code[0].opcode==0x62 && code[0].arg1==0 && code[1].opcode==0x30)
+		i=2;
+	if(code.size()!=i+4)
+		return 0;
+	if(code[i].opcode!=0x62 || code[i].arg1!=0 || code[i+1].opcode!=0x66 || code[i+2].opcode!=0x48)
+		return 0;
+	const uint32_t field=code[i+1].arg1;
+	if(field==0 || mi->context->getMultinameRTData(field)!=0)
+		return 0;
+	return field;
+}
+
+/* Returns the only entry of cache if it was filled in the current epoch
+ * with a variable borrowed from a class, otherwise NULL */
+static const property_cache::entry* monomorphicEntry(const property_cache& cache)
+{
+	const property_cache::entry* found=NULL;
+	unsigned int used=0;
+	for(unsigned int j=0;j<property_cache::ENTRIES;j++)
+	{
+		if(cache.entries[j].kind==property_cache::EMPTY)
+			continue;
+		used++;
+		found=&cache.entries[j];
+	}
+	if(used!=1 || found->kind!=property_cache::BORROWED || found->epoch!=property_cache::epoch)
+		return NULL;
+	return found;
+}
+
+/* Looks for property access sites where the interpreter only ever found the
+ * same function on objects of a single class. A getter is called through the
+ * JIT code by function pointer, or skipped altogether if it only returns a
+ * property. A method is called without looking it up and binding it */
+void ABCVm::findInlinableSites(method_info* mi)
+{
+	for(unsigned int i=0;i<mi->preloadedcode.size();i++)
+	{
+		const preloadedcodedata& ins=mi->preloadedcode[i];
+		if(ins.opcode!=0x66 && ins.opcode!=0x46 && ins.opcode!=0x4f)
+			continue;
+		if(ins.target<0 || mi->context->getMultinameRTData(ins.arg1)!=0)
+			continue;
+
+		const property_cache::entry* found=monomorphicEntry(mi->propertycaches[ins.target]);
+		if(found==NULL)
+			continue;
+
+		if(ins.opcode!=0x66)
+		{
+			if(found->var->getter || found->var->setter)
+				continue;
+			SyntheticFunction* method=dynamic_cast<SyntheticFunction*>(found->var->var);
+			if(method==NULL || method->isBound() || !method->isMethod())
+				continue;
+			inlined_call inlined;
+			inlined.cls=found->cls;
+			inlined.method=method;
+			inlined.argCount=ins.arg2;
+			inlined.keepReturn=(ins.opcode==0x46);
+			LOG(LOG_CALLS,_("Calling directly ") << *ABCContext::s_getMultiname(mi->context,NULL,NULL,ins.arg1) << _(" at ") << ins.pos);
+			mi->inlinedCalls[ins.pos]=inlined;
+			continue;
+		}
+
+		if(found->var->getter==NULL)
+			continue;
+		IFunction* getter=found->var->getter;
+		if(getter->isBound())
+			continue;
+		inlined_getter inlined;
+		inlined.cls=found->cls;
+		if(Function* f=dynamic_cast<Function*>(getter))
+			inlined.native=f->val;
+		else if(SyntheticFunction* f=dynamic_cast<SyntheticFunction*>(getter))
+		{
+			//The return type is resolved on the first call
+			if(f->mi->returnType==NULL)
+				continue;
+			if(f->mi->preloadedcode.empty())
+				preloadFunction(f->mi);
+			uint32_t field=trivialGetterField(f->mi);
+			if(field==0)
+				continue;
+			inlined.field=ABCContext::s_getMultiname(f->mi->context,NULL,NULL,field);
+			inlined.returnType=f->mi->returnType;
+		}
+		else
+			continue;
+		LOG(LOG_CALLS,_("Inlining getter of ") << *ABCContext::s_getMultiname(mi->context,NULL,NULL,ins.arg1) << _(" at ") << ins.pos);
+		mi->inlinedGetters[ins.pos]=inlined;
+	}
+}
+
+SyntheticFunction::synt_function ABCVm::getCompiledMethod(method_info* mi)
+{
+	//Do not let the queue grow without bounds while the worker is busy
+	const uint32_t maxQueueLength=64;
+	//Microseconds of compilation allowed in each window of milliseconds
+	const uint64_t windowBudget=250000;
+	const uint64_t windowLength=1000;
+	//Hot methods call this until they are compiled, only the first call needs the lock
+	switch(ACQUIRE_READ(mi->jitStatus))
+	{
+		case method_info::JIT_DONE:
+			return mi->f;
+		case method_info::JIT_QUEUED:
+		case method_info::JIT_FAILED:
+			return NULL;
+		default:
+			break;
+	}
+	Locker l(jit_queue_mutex);
+	if(mi->jitStatus!=method_info::JIT_NONE || jitThread==NULL || jit_queue.size()>=maxQueueLength)
+		return NULL;
+	//Methods left out while the budget is spent are queued by a later call
+	const uint64_t now=compat_msectiming();
+	if(now-jitWindowStart>=windowLength)
+	{
+		jitWindowStart=now;
+		jitWindowTime=0;
+	}
+	if(jitWindowTime>=windowBudget)
+		return NULL;
+
+	//Resolve here what the compilation would otherwise lazily build in shared structures
+	if(mi->preloadedcode.empty())
+		preloadFunction(mi);
+	if(!mi->context->staticMultinamesResolved)
+		mi->context->resolveStaticMultinames();
+	//The interpreter keeps recording while the method is compiled
+	mi->jitOperandTypes=mi->operandTypes;
+	findInlinableSites(mi);
+
+	RELEASE_WRITE(mi->jitStatus,method_info::JIT_QUEUED);
+	jit_queue.push_back(mi);
+	jitMaxQueueLength=max(jitMaxQueueLength,(uint32_t)jit_queue.size());
+	jit_queue_cond.signal();
+	return NULL;
+}
+
+SyntheticFunction::synt_function ABCVm::compileMethod(method_info* mi)
+{
+	Locker l(jit_mutex);
+	return mi->synt_method();
+}
+
 /* This breaks the lock on all enqueued events to prevent deadlocking */
 void ABCVm::signalEventWaiters()
 {
@@ -1598,7 +1847,7 @@ void ABCVm::parseRPCMessage(_R<ByteArray> message, _NR<ASObject> client, _R<Resp
 
 	multiname onResultName;
 	onResultName.name_type=multiname::NAME_STRING;
-	onResultName.name_s="onResult";
+	onResultName.setName("onResult");
 	onResultName.ns.push_back(nsNameAndKind("",NAMESPACE));
 	_NR<ASObject> callback = responder->getVariableByMultiname(onResultName);
 	if(!callback.isNull() && callback->getObjectType() == T_FUNCTION)
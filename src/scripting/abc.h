@@ -90,6 +90,51 @@ inline stack_entry make_stack_entry(llvm::Value* v, STACK_TYPE t)
 	return std::make_pair(v, t);
 }
 
+/* An instruction of a method body decoded by ABCVm::preloadFunction.
+ * Operands are read from the bytecode only once, branch targets
+ * are indexes in method_info::preloadedcode */
+struct preloadedcodedata
+{
+	/* opcode, or one of the internal opcodes below */
+	uint32_t opcode;
+	/* position of the opcode in the bytecode, used to compute exec_pos */
+	uint32_t pos;
+	uint32_t arg1;
+	uint32_t arg2;
+	/* destination of jumps, -1 if the original target is invalid.
+	 * For lookupswitch it is the first index in method_info::preloadedswitchtargets,
+	 * for property accesses it is the index in method_info::propertycaches */
+	int32_t target;
+	/* Internal opcode marking the end of the decoded code */
+	enum { END_OF_CODE=0x100, OPCODE_COUNT };
+};
+
+/* A getproperty site that only ever found the same getter on objects of one class.
+ * The JIT guards on the class and skips the call of the getter, see ABCVm::findInlinableSites */
+struct inlined_getter
+{
+	const Class_base* cls;
+	//A native getter is called directly
+	Function::as_function native;
+	//A getter that only returns a property of this is replaced by the lookup of field
+	multiname* field;
+	property_cache cache;
+	const Type* returnType;
+	inlined_getter():cls(NULL),native(NULL),field(NULL),returnType(NULL){}
+};
+
+/* A callproperty or callpropvoid site that only ever found the same method on objects of one class.
+ * The JIT guards on the class and calls the method without looking it up and binding it to the object */
+struct inlined_call
+{
+	const Class_base* cls;
+	//Owned by the traits of cls
+	SyntheticFunction* method;
+	uint32_t argCount;
+	bool keepReturn;
+	inlined_call():cls(NULL),method(NULL),argCount(0),keepReturn(false){}
+};
+
 class method_info
 {
 friend std::istream& operator>>(std::istream& in, method_info& v);
@@ -126,6 +171,57 @@ public:
 #endif
 
 	SyntheticFunction::synt_function f;
+	/* The method body decoded for the interpreter, see ABCVm::preloadFunction */
+	std::vector<preloadedcodedata> preloadedcode;
+	std::vector<int32_t> preloadedswitchtargets;
+	/* Pairs of bytecode position and index in preloadedcode, ordered by position */
+	std::vector<std::pair<uint32_t,uint32_t> > preloadedpositions;
+	int32_t getPreloadedIndex(uint32_t pos) const;
+	/* Inline caches of getproperty, setproperty and callproperty, shared with the JIT */
+	std::vector<property_cache> propertycaches;
+	property_cache* getPropertyCache(uint32_t pos);
+	/* Operand types observed by the interpreter at arithmetic and comparison
+	 * sites, indexed by bytecode position. It is only allocated when the JIT may run */
+	enum OPERAND_TYPE { OPERAND_INT=1, OPERAND_NUMBER=2, OPERAND_OTHER=4 };
+	std::vector<uint8_t> operandTypes;
+	/* Copy of operandTypes taken when the method is queued for compilation,
+	 * the JIT speculates on it while the interpreter keeps updating operandTypes */
+	std::vector<uint8_t> jitOperandTypes;
+	static uint8_t operandType(const ASObject* o)
+	{
+		switch(o->getObjectType())
+		{
+			case T_INTEGER:
+				return OPERAND_INT;
+			case T_NUMBER:
+				return OPERAND_NUMBER;
+			default:
+				return OPERAND_OTHER;
+		}
+	}
+	void recordOperandTypes(uint32_t pos, const ASObject* o1, const ASObject* o2)
+	{
+		if(!operandTypes.empty())
+			operandTypes[pos]|=operandType(o1)|operandType(o2);
+	}
+	uint8_t getOperandTypes(uint32_t pos) const
+	{
+		return jitOperandTypes.empty()?0:jitOperandTypes[pos];
+	}
+	/* Property access sites that the JIT specializes, indexed by bytecode position.
+	 * Filled before the method is queued for compilation */
+	std::map<uint32_t,inlined_getter> inlinedGetters;
+	std::map<uint32_t,inlined_call> inlinedCalls;
+	inlined_getter* getInlinedGetter(uint32_t pos)
+	{
+		auto it=inlinedGetters.find(pos);
+		return (it==inlinedGetters.end())?NULL:&it->second;
+	}
+	inlined_call* getInlinedCall(uint32_t pos)
+	{
+		auto it=inlinedCalls.find(pos);
+		return (it==inlinedCalls.end())?NULL:&it->second;
+	}
 	ABCContext* context;
 	method_body_info* body;
 	SyntheticFunction::synt_function synt_method();
@@ -144,12 +240,16 @@ public:
 	std::vector<const Type*> paramTypes;
 	const Type* returnType;
 	bool hasExplicitTypes;
+	/* Progress of the compilation on the JIT worker. Read without locks,
+	 * changed with ABCVm::jit_queue_mutex held */
+	enum JIT_STATUS { JIT_NONE=0, JIT_QUEUED, JIT_DONE, JIT_FAILED };
+	ATOMIC_INT32(jitStatus);
 	method_info():
 #ifdef PROFILING_SUPPORT
 		profTime(0),
 		validProfName(false),
 #endif
-		f(NULL),context(NULL),body(NULL),returnType(NULL)
+		f(NULL),context(NULL),body(NULL),returnType(NULL),jitStatus(JIT_NONE)
 	{
 	}
 };
@@ -163,7 +263,7 @@ struct opcode_handler
 enum ARGS_TYPE { ARGS_OBJ_OBJ=0, ARGS_OBJ_INT, ARGS_OBJ, ARGS_INT, ARGS_OBJ_OBJ_INT, ARGS_NUMBER, ARGS_OBJ_NUMBER,
 	ARGS_BOOL, ARGS_INT_OBJ, ARGS_NONE, ARGS_NUMBER_OBJ, ARGS_INT_INT, ARGS_CONTEXT, ARGS_CONTEXT_INT, ARGS_CONTEXT_INT_INT,
 	ARGS_CONTEXT_INT_INT_INT, ARGS_CONTEXT_INT_INT_INT_BOOL, ARGS_CONTEXT_OBJ_OBJ_INT, ARGS_CONTEXT_OBJ, ARGS_CONTEXT_OBJ_OBJ,
-	ARGS_CONTEXT_OBJ_OBJ_OBJ, ARGS_OBJ_OBJ_OBJ_INT, ARGS_OBJ_OBJ_OBJ };
+	ARGS_CONTEXT_OBJ_OBJ_OBJ, ARGS_OBJ_OBJ_OBJ_INT, ARGS_OBJ_OBJ_OBJ, ARGS_OBJ_OBJ_OBJ_OBJ, ARGS_CONTEXT_INT_INT_INT_BOOL_OBJ };
 
 struct typed_opcode_handler
 {
@@ -190,7 +290,8 @@ public:
 	u16 major;
 	cpool_info constant_pool;
 	u30 method_count;
-	std::vector<method_info> methods;
+	//method_info is not copyable, a deque is resized without moving its elements
+	std::deque<method_info> methods;
 	u30 metadata_count;
 	std::vector<metadata_info> metadata;
 	u30 class_count;
@@ -217,6 +318,9 @@ public:
 	int getMultinameRTData(int n) const;
 	multiname* getMultiname(unsigned int m, call_context* th);
 	multiname* getMultinameImpl(ASObject* rt1, ASObject* rt2, unsigned int m);
+	/* Caches all the multinames without runtime data, so that the JIT worker only reads them */
+	void resolveStaticMultinames();
+	bool staticMultinamesResolved;
 	void buildInstanceTraits(ASObject* obj, int class_index);
 	ABCContext(RootMovieClip* r, std::istream& in) DLL_PUBLIC;
 	void exec(bool lazy);
@@ -241,6 +345,28 @@ private:
 
 	llvm::Module* module;
 
+	/* The JIT worker compiles hot methods while the interpreter keeps running them */
+	Thread* jitThread;
+	Mutex jit_queue_mutex;
+	Cond jit_queue_cond;
+	std::deque<method_info*> jit_queue;
+	bool jitShuttingDown;
+	/* LLVM is not thread safe, this serializes the compilations */
+	Mutex jit_mutex;
+	/* Statistics of the JIT worker, guarded by jit_queue_mutex */
+	uint32_t jitCompiled;
+	uint32_t jitMaxQueueLength;
+	uint64_t jitCompileTime;
+	/* Compilation time spent since jitWindowStart, the budget is per window */
+	uint64_t jitWindowStart;
+	uint64_t jitWindowTime;
+	static void jitWorker(ABCVm* th);
+	void stopJitWorker();
+
+	/* undefined and null carry no state, a single instance of each is shared */
+	ASObject* undefinedInstance;
+	ASObject* nullInstance;
+
 	void registerClasses();
 
 	void registerFunctions();
@@ -268,7 +394,7 @@ private:
 		appDomain->writeToDomainMemory<T>(addr, val);
 	}
 	static void callSuper(call_context* th, int n, int m, method_info** called_mi, bool keepReturn);
-	static void callProperty(call_context* th, int n, int m, method_info** called_mi, bool keepReturn);
+	static void callProperty(call_context* th, int n, int m, method_info** called_mi, bool keepReturn, property_cache* cache);
 	static void callImpl(call_context* th, ASObject* f, ASObject* obj, ASObject** args, int m, method_info** called_mi, bool keepReturn);
 	static void constructProp(call_context* th, int n, int m); 
 	static void setLocal(int n); 
@@ -320,9 +446,11 @@ private:
 	static void decLocal_i(call_context* th, int n);
 	static void decLocal(call_context* th, int n);
 	static void coerce(call_context* th, int n);
-	static ASObject* getProperty(ASObject* obj, multiname* name);
+	static ASObject* getProperty(ASObject* obj, multiname* name, property_cache* cache);
+	static ASObject* getInlinedProperty(ASObject* obj, inlined_getter* getter);
+	static void callInlined(call_context* th, inlined_call* call);
 	static int32_t getProperty_i(ASObject* obj, multiname* name);
-	static void setProperty(ASObject* value,ASObject* obj, multiname* name);
+	static void setProperty(ASObject* value,ASObject* obj, multiname* name, property_cache* cache);
 	static void setProperty_i(int32_t value,ASObject* obj, multiname* name);
 	static void call(call_context* th, int n, method_info** called_mi);
 	static void constructSuper(call_context* th, int n);
@@ -411,6 +539,8 @@ private:
 
 	//Internal utilities
 	static void method_reset(method_info* th);
+	static void preloadFunction(method_info* mi);
+	static void findInlinableSites(method_info* mi);
 	static void newClassRecursiveLink(Class_base* target, Class_base* c);
 	static ASObject* constructFunction(call_context* th, IFunction* f, ASObject** args, int argslen);
 	void parseRPCMessage(_R<ByteArray> message, _NR<ASObject> client, _R<Responder> responder);
@@ -419,7 +549,7 @@ private:
 	void register_table(LLVMTYPE ret_type,typed_opcode_handler* table, int table_len);
 	static opcode_handler opcode_table_args_pointer_2int[];
 	static opcode_handler opcode_table_args_pointer_number_int[];
-	static opcode_handler opcode_table_args3_pointers[];
+	static opcode_handler opcode_table_args4_pointers[];
 	static typed_opcode_handler opcode_table_uint32_t[];
 	static typed_opcode_handler opcode_table_number_t[];
 	static typed_opcode_handler opcode_table_void[];
@@ -446,10 +576,33 @@ public:
 	Manager* int_manager;
 	Manager* uint_manager;
 	Manager* number_manager;
+	/* These return a new reference to the shared instances */
+	ASObject* getUndefinedRef()
+	{
+		undefinedInstance->incRef();
+		return undefinedInstance;
+	}
+	ASObject* getNullRef()
+	{
+		nullInstance->incRef();
+		return nullInstance;
+	}
 
 	llvm::ExecutionEngine* ex;
 	llvm::FunctionPassManager* FPM;
 	llvm::LLVMContext llvm_context;
+	/* The classes the JIT specializes parameters on. SystemState::classes can't be used from the JIT worker */
+	const Type* numberClass;
+	const Type* intClass;
+	const Type* uintClass;
+	const Type* booleanClass;
+	/*
+	 * Returns the native code of mi, or NULL if it is not ready yet.
+	 * The first call queues mi for compilation on the JIT worker
+	 */
+	SyntheticFunction::synt_function getCompiledMethod(method_info* mi);
+	/* Compiles mi on the calling thread */
+	SyntheticFunction::synt_function compileMethod(method_info* mi);
 
 	ABCVm(SystemState* s) DLL_PUBLIC;
 	/**
@@ -470,6 +623,9 @@ public:
 	void shutdown();
 
 	static Global* getGlobalScope(call_context* th);
+	/* The JIT loads the type and the class of objects directly to guard specialized code */
+	static size_t objectTypeOffset();
+	static size_t objectClassOffset();
 	static bool strictEqualImpl(ASObject*, ASObject*);
 	static void publicHandleEvent(_R<EventDispatcher> dispatcher, _R<Event> event);
 	static _R<ApplicationDomain> getCurrentApplicationDomain(call_context* th);
@@ -61,7 +61,7 @@ opcode_handler ABCVm::opcode_table_args_pointer_number_int[]={
 	{"getMultiname_d",(void*)&ABCContext::s_getMultiname_d}
 };
 
-opcode_handler ABCVm::opcode_table_args3_pointers[]={
+opcode_handler ABCVm::opcode_table_args4_pointers[]={
 	{"setProperty",(void*)&ABCVm::setProperty},
 };
 
@@ -139,7 +139,7 @@ typed_opcode_handler ABCVm::opcode_table_void[]={
 	{"initProperty",(void*)&ABCVm::initProperty,ARGS_OBJ_OBJ_OBJ},
 	{"kill",(void*)&ABCVm::kill,ARGS_INT},
 	{"jump",(void*)&ABCVm::jump,ARGS_INT},
-	{"callProperty",(void*)&ABCVm::callProperty,ARGS_CONTEXT_INT_INT_INT_BOOL},
+	{"callProperty",(void*)&ABCVm::callProperty,ARGS_CONTEXT_INT_INT_INT_BOOL_OBJ},
 	{"constructProp",(void*)&ABCVm::constructProp,ARGS_CONTEXT_INT_INT},
 	{"callSuper",(void*)&ABCVm::callSuper,ARGS_CONTEXT_INT_INT_INT_BOOL},
 	{"not_impl",(void*)&ABCVm::not_impl,ARGS_INT},
@@ -165,7 +165,9 @@ typed_opcode_handler ABCVm::opcode_table_voidptr[]={
 	{"pushNull",(void*)&ABCVm::pushNull,ARGS_NONE},
 	{"pushUndefined",(void*)&ABCVm::pushUndefined,ARGS_NONE},
 	{"pushNamespace",(void*)&ABCVm::pushNamespace,ARGS_CONTEXT_INT},
-	{"getProperty",(void*)&ABCVm::getProperty,ARGS_OBJ_OBJ},
+	{"getProperty",(void*)&ABCVm::getProperty,ARGS_OBJ_OBJ_OBJ},
+	{"getInlinedProperty",(void*)&ABCVm::getInlinedProperty,ARGS_OBJ_OBJ},
+	{"callInlined",(void*)&ABCVm::callInlined,ARGS_CONTEXT_OBJ},
 	{"asTypelate",(void*)&ABCVm::asTypelate,ARGS_OBJ_OBJ},
 	{"getGlobalScope",(void*)&ABCVm::getGlobalScope,ARGS_CONTEXT},
 	{"findPropStrict",(void*)&ABCVm::findPropStrict,ARGS_CONTEXT_OBJ},
@@ -277,20 +279,22 @@ void ABCVm::registerFunctions()
 	}
 	//End of lazy pushing
 
-	//Lazy pushing, no context, (ASObject*, ASObject*, void*)
+	//Lazy pushing, no context, (ASObject*, ASObject*, void*, property_cache*)
 	sig.clear();
 	sig.push_back(voidptr_type);
 	sig.push_back(voidptr_type);
 	sig.push_back(voidptr_type);
+	sig.push_back(voidptr_type);
 	FT=llvm::FunctionType::get(void_type, sig, false);
-	elems=sizeof(opcode_table_args3_pointers)/sizeof(opcode_handler);
+	elems=sizeof(opcode_table_args4_pointers)/sizeof(opcode_handler);
 	for(int i=0;i<elems;i++)
 	{
-		F=llvm::Function::Create(FT,llvm::Function::ExternalLinkage,opcode_table_args3_pointers[i].name,module);
-		ex->addGlobalMapping(F,opcode_table_args3_pointers[i].addr);
+		F=llvm::Function::Create(FT,llvm::Function::ExternalLinkage,opcode_table_args4_pointers[i].name,module);
+		ex->addGlobalMapping(F,opcode_table_args4_pointers[i].addr);
 	}
 
-	//Build the concrete interface
+	//Build the concrete interface, setProperty_i does not use the property cache
+	sig.pop_back();
 	sig[0]=int_type;
 	FT=llvm::FunctionType::get(void_type, sig, false);
 	F=llvm::Function::Create(FT,llvm::Function::ExternalLinkage,"setProperty_i",module);
@@ -345,6 +349,12 @@ void ABCVm::register_table(LLVMTYPE ret_type,typed_opcode_handler* table, int ta
 	sig_obj_obj_int.push_back(voidptr_type);
 	sig_obj_obj_int.push_back(int_type);
 
+	vector<LLVMTYPE> sig_obj_obj_obj_obj;
+	sig_obj_obj_obj_obj.push_back(voidptr_type);
+	sig_obj_obj_obj_obj.push_back(voidptr_type);
+	sig_obj_obj_obj_obj.push_back(voidptr_type);
+	sig_obj_obj_obj_obj.push_back(voidptr_type);
+
 	vector<LLVMTYPE> sig_obj_obj_obj_int;
 	sig_obj_obj_obj_int.push_back(voidptr_type);
 	sig_obj_obj_obj_int.push_back(voidptr_type);
@@ -384,6 +394,9 @@ void ABCVm::register_table(LLVMTYPE ret_type,typed_opcode_handler* table, int ta
 	sig_context_int_int_int_bool.push_back(int_type);
 	sig_context_int_int_int_bool.push_back(bool_type);
 
+	vector<LLVMTYPE> sig_context_int_int_int_bool_obj(sig_context_int_int_int_bool);
+	sig_context_int_int_int_bool_obj.push_back(voidptr_type);
+
 	vector<LLVMTYPE> sig_context_obj;
 	sig_context_obj.push_back(context_type);
 	sig_context_obj.push_back(voidptr_type);
@@ -443,6 +456,9 @@ void ABCVm::register_table(LLVMTYPE ret_type,typed_opcode_handler* table, int ta
 			case ARGS_OBJ_OBJ_INT:
 				FT=llvm::FunctionType::get(ret_type, LLVMMAKEARRAYREF(sig_obj_obj_int), false);
 				break;
+			case ARGS_OBJ_OBJ_OBJ_OBJ:
+				FT=llvm::FunctionType::get(ret_type, LLVMMAKEARRAYREF(sig_obj_obj_obj_obj), false);
+				break;
 			case ARGS_OBJ_OBJ_OBJ_INT:
 				FT=llvm::FunctionType::get(ret_type, LLVMMAKEARRAYREF(sig_obj_obj_obj_int), false);
 				break;
@@ -467,6 +483,9 @@ void ABCVm::register_table(LLVMTYPE ret_type,typed_opcode_handler* table, int ta
 			case ARGS_CONTEXT_INT_INT_INT_BOOL:
 				FT=llvm::FunctionType::get(ret_type, LLVMMAKEARRAYREF(sig_context_int_int_int_bool), false);
 				break;
+			case ARGS_CONTEXT_INT_INT_INT_BOOL_OBJ:
+				FT=llvm::FunctionType::get(ret_type, LLVMMAKEARRAYREF(sig_context_int_int_int_bool_obj), false);
+				break;
 			case ARGS_CONTEXT_OBJ_OBJ_INT:
 				FT=llvm::FunctionType::get(ret_type, LLVMMAKEARRAYREF(sig_context_obj_obj_int), false);
 				break;
@@ -726,6 +745,295 @@ static llvm::Value* llvm_ToNumber(llvm::ExecutionEngine* ex, llvm::IRBuilder<>&
 }
 
 /* Adds instructions to the builder to resolve the given multiname */
+//IRBuilder has CreateCall helpers only up to 5 arguments
+static llvm::CallInst* createCall(llvm::IRBuilder<>& builder, llvm::Value* callee, const vector<llvm::Value*>& args)
+{
+#ifdef LLVM_3
+	return builder.CreateCall(callee, llvm::makeArrayRef(args));
+#else
+	return builder.CreateCall(callee, args.begin(), args.end());
+#endif
+}
+
+//IRBuilder::CreatePHI takes the number of incoming values since LLVM 3
+static llvm::PHINode* createPHI(llvm::IRBuilder<>& builder, LLVMTYPE type, unsigned int incoming)
+{
+#ifdef LLVM_3
+	return builder.CreatePHI(type, incoming);
+#else
+	return builder.CreatePHI(type);
+#endif
+}
+
+size_t ABCVm::objectTypeOffset()
+{
+	return offsetof(ASObject,type);
+}
+
+size_t ABCVm::objectClassOffset()
+{
+	return offsetof(ASObject,classdef);
+}
+
+/* Speculation is only worth it when an operand is boxed, and only safe
+ * when the interpreter has never seen anything but numbers at the site */
+static bool canSpeculateNumbers(const stack_entry& lhs, const stack_entry& rhs, uint8_t feedback)
+{
+	if(feedback==0 || (feedback & method_info::OPERAND_OTHER))
+		return false;
+	if(lhs.second!=STACK_OBJECT && rhs.second!=STACK_OBJECT)
+		return false;
+	const STACK_TYPE types[2]={lhs.second, rhs.second};
+	for(int i=0;i<2;i++)
+	{
+		if(types[i]!=STACK_OBJECT && types[i]!=STACK_INT && types[i]!=STACK_UINT && types[i]!=STACK_NUMBER)
+			return false;
+	}
+	return true;
+}
+
+/* Unboxes e, which the interpreter has only seen holding the types in feedback.
+ * The guards branch to slowBB when e is anything else, otherwise the builder
+ * is left where the value is available as a number */
+static llvm::Value* llvm_speculateNumber(llvm::ExecutionEngine* ex, llvm::IRBuilder<>& Builder,
+		stack_entry e, uint8_t feedback, llvm::BasicBlock* slowBB)
+{
+	if(e.second!=STACK_OBJECT)
+		return llvm_ToNumber(ex, Builder, e);
+
+	llvm::LLVMContext& llvm_context=getVm()->llvm_context;
+	llvm::Function* llvmf=Builder.GetInsertBlock()->getParent();
+	llvm::Value* t=Builder.CreateGEP(e.first, llvm::ConstantInt::get(int_type, ABCVm::objectTypeOffset()));
+	t=Builder.CreateBitCast(t,intptr_type);
+	llvm::Value* type=Builder.CreateLoad(t);
+
+	llvm::BasicBlock* intBB=NULL;
+	llvm::BasicBlock* numberBB=NULL;
+	if(feedback & method_info::OPERAND_INT)
+		intBB=llvm::BasicBlock::Create(llvm_context,"speculatedInt", llvmf);
+	if(feedback & method_info::OPERAND_NUMBER)
+		numberBB=llvm::BasicBlock::Create(llvm_context,"speculatedNumber", llvmf);
+	llvm::BasicBlock* doneBB=llvm::BasicBlock::Create(llvm_context,"speculatedDone", llvmf);
+
+	if(intBB)
+	{
+		llvm::BasicBlock* notIntBB=slowBB;
+		if(numberBB)
+			notIntBB=llvm::BasicBlock::Create(llvm_context,"speculatedNotInt", llvmf);
+		llvm::Value* isInt=Builder.CreateICmpEQ(type, llvm::ConstantInt::get(int_type, T_INTEGER));
+		Builder.CreateCondBr(isInt, intBB, notIntBB);
+		if(numberBB)
+			Builder.SetInsertPoint(notIntBB);
+	}
+	if(numberBB)
+	{
+		llvm::Value* isNumber=Builder.CreateICmpEQ(type, llvm::ConstantInt::get(int_type, T_NUMBER));
+		Builder.CreateCondBr(isNumber, numberBB, slowBB);
+	}
+
+	llvm::Value* intValue=NULL;
+	llvm::Value* numberValue=NULL;
+	if(intBB)
+	{
+		Builder.SetInsertPoint(intBB);
+		t=Builder.CreateGEP(e.first, llvm::ConstantInt::get(int_type, offsetof(Integer,val)));
+		t=Builder.CreateBitCast(t,intptr_type);
+		intValue=Builder.CreateSIToFP(Builder.CreateLoad(t),number_type);
+		Builder.CreateBr(doneBB);
+	}
+	if(numberBB)
+	{
+		Builder.SetInsertPoint(numberBB);
+		t=Builder.CreateGEP(e.first, llvm::ConstantInt::get(int_type, offsetof(Number,val)));
+		t=Builder.CreateBitCast(t,numberptr_type);
+		numberValue=Builder.CreateLoad(t);
+		Builder.CreateBr(doneBB);
+	}
+
+	Builder.SetInsertPoint(doneBB);
+	if(intValue==NULL)
+		return numberValue;
+	if(numberValue==NULL)
+		return intValue;
+	llvm::PHINode* ret=createPHI(Builder, number_type, 2);
+	ret->addIncoming(intValue, intBB);
+	ret->addIncoming(numberValue, numberBB);
+	return ret;
+}
+
+/* Specializes an arithmetic or comparison opcode on the operand types observed
+ * by the interpreter. The fast path works on unboxed numbers, when a guard fails
+ * the generic runtime helper is called on the objects instead, so the code never
+ * has to bail out to the interpreter. Both operands are consumed */
+static stack_entry llvm_speculateBinaryOp(llvm::ExecutionEngine* ex, llvm::IRBuilder<>& Builder, uint8_t opcode,
+		stack_entry lhs, stack_entry rhs, uint8_t feedback)
+{
+	//The helpers of arithmetic and branches take the operands in reverse order
+	const char* helper;
+	bool reversed=true;
+	STACK_TYPE resultType=STACK_BOOLEAN;
+	LLVMTYPE resultLLVMType=bool_type;
+	switch(opcode)
+	{
+		case 0xa0: helper="add"; resultType=STACK_OBJECT; resultLLVMType=voidptr_type; break;
+		case 0xa1: helper="subtract"; resultType=STACK_NUMBER; resultLLVMType=number_type; break;
+		case 0xa2: helper="multiply"; resultType=STACK_NUMBER; resultLLVMType=number_type; break;
+		case 0xa3: helper="divide"; resultType=STACK_NUMBER; resultLLVMType=number_type; break;
+		case 0xad: helper="lessThan"; reversed=false; break;
+		case 0xae: helper="lessEquals"; reversed=false; break;
+		case 0xaf: helper="greaterThan"; reversed=false; break;
+		case 0xb0: helper="greaterEquals"; reversed=false; break;
+		case 0x0c: helper="ifNLT"; break;
+		case 0x0d: helper="ifNLE"; break;
+		case 0x0e: helper="ifNGT"; break;
+		case 0x0f: helper="ifNGE"; break;
+		case 0x15: helper="ifLT"; break;
+		case 0x16: helper="ifLE"; break;
+		case 0x17: helper="ifGT"; break;
+		case 0x18: helper="ifGE"; break;
+		default:
+			throw RunTimeException("Unexpected opcode to speculate on");
+	}
+
+	llvm::LLVMContext& llvm_context=getVm()->llvm_context;
+	llvm::Function* llvmf=Builder.GetInsertBlock()->getParent();
+	llvm::BasicBlock* slowBB=llvm::BasicBlock::Create(llvm_context,"speculationFailed", llvmf);
+	llvm::BasicBlock* mergeBB=llvm::BasicBlock::Create(llvm_context,"speculationMerge", llvmf);
+
+	llvm::Value* l=llvm_speculateNumber(ex, Builder, lhs, feedback, slowBB);
+	llvm::Value* r=llvm_speculateNumber(ex, Builder, rhs, feedback, slowBB);
+	if(lhs.second==STACK_OBJECT)
+		Builder.CreateCall(ex->FindFunctionNamed("decRef"), lhs.first);
+	if(rhs.second==STACK_OBJECT)
+		Builder.CreateCall(ex->FindFunctionNamed("decRef"), rhs.first);
+
+	//Comparisons with NaN are false, the negated branches are taken
+	llvm::Value* fast;
+	switch(opcode)
+	{
+		case 0xa0: fast=Builder.CreateCall(ex->FindFunctionNamed("abstract_d"), Builder.CreateFAdd(l,r)); break;
+		case 0xa1: fast=Builder.CreateFSub(l,r); break;
+		case 0xa2: fast=Builder.CreateFMul(l,r); break;
+		case 0xa3: fast=Builder.CreateFDiv(l,r); break;
+		case 0xad: case 0x15: fast=Builder.CreateFCmpOLT(l,r); break;
+		case 0xae: case 0x16: fast=Builder.CreateFCmpOLE(l,r); break;
+		case 0xaf: case 0x17: fast=Builder.CreateFCmpOGT(l,r); break;
+		case 0xb0: case 0x18: fast=Builder.CreateFCmpOGE(l,r); break;
+		case 0x0c: fast=Builder.CreateNot(Builder.CreateFCmpOLT(l,r)); break;
+		case 0x0d: fast=Builder.CreateNot(Builder.CreateFCmpOLE(l,r)); break;
+		case 0x0e: fast=Builder.CreateNot(Builder.CreateFCmpOGT(l,r)); break;
+		default: fast=Builder.CreateNot(Builder.CreateFCmpOGE(l,r)); break;
+	}
+	llvm::BasicBlock* fastBB=Builder.GetInsertBlock();
+	Builder.CreateBr(mergeBB);
+
+	Builder.SetInsertPoint(slowBB);
+	abstract_value(ex,Builder,lhs);
+	abstract_value(ex,Builder,rhs);
+	llvm::Value* slow;
+	if(reversed)
+		slow=Builder.CreateCall2(ex->FindFunctionNamed(helper), rhs.first, lhs.first);
+	else
+		slow=Builder.CreateCall2(ex->FindFunctionNamed(helper), lhs.first, rhs.first);
+	slowBB=Builder.GetInsertBlock();
+	Builder.CreateBr(mergeBB);
+
+	Builder.SetInsertPoint(mergeBB);
+	llvm::PHINode* ret=createPHI(Builder, resultLLVMType, 2);
+	ret->addIncoming(fast, fastBB);
+	ret->addIncoming(slow, slowBB);
+	return stack_entry(ret, resultType);
+}
+
+//True if the opcode starting at ip is in [from,to) of a handler. SyntheticFunction::call
+//matches (from,to] against exec_pos, which is past the opcode, so the two agree
+static bool inTryRange(const method_body_info* body, unsigned int ip)
+{
+	for(unsigned int i=0;i<body->exception_count;i++)
+	{
+		if(ip>=body->exceptions[i].from && ip<body->exceptions[i].to)
+			return true;
+	}
+	return false;
+}
+
+//The property cache of the instruction at ip is passed to the runtime as a constant
+static llvm::Value* propertyCacheConstant(method_info* mi, unsigned int ip)
+{
+	property_cache* cache=mi->getPropertyCache(ip);
+	return llvm::ConstantExpr::getIntToPtr(llvm::ConstantInt::get(ptr_type, (intptr_t)cache), voidptr_type);
+}
+
+//Branches to sameBB if obj is an instance of exactly cls, to otherBB if not
+static void llvm_classGuard(llvm::IRBuilder<>& Builder, llvm::Value* obj, const Class_base* cls,
+		llvm::BasicBlock* sameBB, llvm::BasicBlock* otherBB)
+{
+	llvm::Value* t=Builder.CreateGEP(obj, llvm::ConstantInt::get(int_type, ABCVm::objectClassOffset()));
+	t=Builder.CreateBitCast(t,voidptr_type->getPointerTo());
+	llvm::Value* objCls=Builder.CreateLoad(t);
+	llvm::Value* expected=llvm::ConstantExpr::getIntToPtr(llvm::ConstantInt::get(ptr_type, (intptr_t)cls), voidptr_type);
+	Builder.CreateCondBr(Builder.CreateICmpEQ(objCls, expected), sameBB, otherBB);
+}
+
+/* Emits a getproperty on a site where the interpreter always found the same getter.
+ * Objects of the class the getter was found on take the inlined path, the others
+ * the generic lookup. obj is consumed */
+static llvm::Value* llvm_inlinedGetProperty(llvm::ExecutionEngine* ex, llvm::IRBuilder<>& Builder,
+		llvm::Value* obj, llvm::Value* name, llvm::Value* cache, inlined_getter* getter)
+{
+	llvm::LLVMContext& llvm_context=getVm()->llvm_context;
+	llvm::Function* llvmf=Builder.GetInsertBlock()->getParent();
+	llvm::BasicBlock* inlinedBB=llvm::BasicBlock::Create(llvm_context,"inlinedGetter", llvmf);
+	llvm::BasicBlock* genericBB=llvm::BasicBlock::Create(llvm_context,"genericGetter", llvmf);
+	llvm::BasicBlock* mergeBB=llvm::BasicBlock::Create(llvm_context,"getterDone", llvmf);
+
+	llvm_classGuard(Builder, obj, getter->cls, inlinedBB, genericBB);
+
+	Builder.SetInsertPoint(inlinedBB);
+	llvm::Value* getterConstant=llvm::ConstantExpr::getIntToPtr(llvm::ConstantInt::get(ptr_type, (intptr_t)getter), voidptr_type);
+	llvm::Value* inlined=Builder.CreateCall2(ex->FindFunctionNamed("getInlinedProperty"), obj, getterConstant);
+	Builder.CreateBr(mergeBB);
+
+	Builder.SetInsertPoint(genericBB);
+	llvm::Value* generic=Builder.CreateCall3(ex->FindFunctionNamed("getProperty"), obj, name, cache);
+	Builder.CreateBr(mergeBB);
+
+	Builder.SetInsertPoint(mergeBB);
+	llvm::PHINode* ret=createPHI(Builder, voidptr_type, 2);
+	ret->addIncoming(inlined, inlinedBB);
+	ret->addIncoming(generic, genericBB);
+	return ret;
+}
+
+/* Emits a callproperty on a site where the interpreter always found the same method.
+ * The receiver is read below the arguments on the synced stack. If it is of the class
+ * the method was found on the method is called directly, otherwise through callProperty */
+static void llvm_inlinedCallProperty(llvm::ExecutionEngine* ex, llvm::IRBuilder<>& Builder, llvm::Value* context,
+		llvm::Value* dynamic_stack, llvm::Value* dynamic_stack_index, const vector<llvm::Value*>& genericArgs, inlined_call* call)
+{
+	llvm::LLVMContext& llvm_context=getVm()->llvm_context;
+	llvm::Function* llvmf=Builder.GetInsertBlock()->getParent();
+	llvm::BasicBlock* directBB=llvm::BasicBlock::Create(llvm_context,"directCall", llvmf);
+	llvm::BasicBlock* genericBB=llvm::BasicBlock::Create(llvm_context,"genericCall", llvmf);
+	llvm::BasicBlock* mergeBB=llvm::BasicBlock::Create(llvm_context,"callDone", llvmf);
+
+	llvm::Value* index=Builder.CreateLoad(dynamic_stack_index);
+	index=Builder.CreateSub(index, llvm::ConstantInt::get(int_type, call->argCount+1));
+	llvm::Value* obj=Builder.CreateLoad(Builder.CreateGEP(dynamic_stack,index));
+	llvm_classGuard(Builder, obj, call->cls, directBB, genericBB);
+
+	Builder.SetInsertPoint(directBB);
+	llvm::Value* callConstant=llvm::ConstantExpr::getIntToPtr(llvm::ConstantInt::get(ptr_type, (intptr_t)call), voidptr_type);
+	Builder.CreateCall2(ex->FindFunctionNamed("callInlined"), context, callConstant);
+	Builder.CreateBr(mergeBB);
+
+	Builder.SetInsertPoint(genericBB);
+	createCall(Builder, ex->FindFunctionNamed("callProperty"), genericArgs);
+	Builder.CreateBr(mergeBB);
+
+	Builder.SetInsertPoint(mergeBB);
+}
+
 inline llvm::Value* getMultiname(llvm::ExecutionEngine* ex,llvm::IRBuilder<>& Builder, vector<stack_entry>& static_stack,
 				llvm::Value* dynamic_stack,llvm::Value* dynamic_stack_index,
 				ABCContext* abccontext, int multinameIndex)
@@ -1700,9 +2008,11 @@ void method_info::doAnalysis(std::map<unsigned int,block_info>& blocks, llvm::IR
 			}
 			//It's not useful to sync variables that are going to be resetted
 			//(where 'reset' means 'written to before any read')
+			//When there are exception handlers the locals are always read back
+			//from memory on block entry, as catch blocks have no predecessors
 			for(unsigned int i=0;i<body->local_count;i++)
 			{
-				if(cur.locals_reset[i])
+				if(cur.locals_reset[i] || body->exception_count)
 					new_start[i]=STACK_NONE;
 			}
 
@@ -1835,7 +2145,7 @@ SyntheticFunction::synt_function method_info::synt_method()
 
 	for(unsigned i=0;i<paramTypes.size();++i)
 	{
-		if(paramTypes[i] == Class<Number>::getClass())
+		if(paramTypes[i] == getVm()->numberClass)
 		{
 			/* yield t = locals[i+1] */
 			LOAD_LOCALPTR
@@ -1847,7 +2157,7 @@ SyntheticFunction::synt_function method_info::synt_method()
 			blocks[0].locals_start_obj[i+1] = t;
 			LOG(LOG_TRACE,"found STACK_NUMBER parameter for local " << i+1);
 		}
-		else if(paramTypes[i] == Class<Integer>::getClass())
+		else if(paramTypes[i] == getVm()->intClass)
 		{
 			/* yield t = locals[i+1] */
 			LOAD_LOCALPTR
@@ -1858,7 +2168,7 @@ SyntheticFunction::synt_function method_info::synt_method()
 			//locals_start_obj should hold the pointer to the local's value
 			blocks[0].locals_start_obj[i+1] = t;
 		}
-		else if(paramTypes[i] == Class<UInteger>::getClass())
+		else if(paramTypes[i] == getVm()->uintClass)
 		{
 			/* yield t = locals[i+1] */
 			LOAD_LOCALPTR
@@ -1869,7 +2179,7 @@ SyntheticFunction::synt_function method_info::synt_method()
 			//locals_start_obj should hold the pointer to the local's value
 			blocks[0].locals_start_obj[i+1] = t;
 		}
-		else if(paramTypes[i] == Class<Boolean>::getClass())
+		else if(paramTypes[i] == getVm()->booleanClass)
 		{
 			/* yield t = locals[i+1] */
 			LOAD_LOCALPTR
@@ -1981,8 +2291,13 @@ SyntheticFunction::synt_function method_info::synt_method()
 		{ //if this function has a try/catch block, record the local_ip, so we can figure out where we were
 		  //in case of an exception to find the right catch
 		  //TODO: would be enough to set this once on enter of try-block
-			constant = llvm::ConstantInt::get(int_type, local_ip);
+		  //Like the interpreter store the position past the opcode, handler ranges are matched as (from,to]
+			constant = llvm::ConstantInt::get(int_type, local_ip+1);
 			Builder.CreateStore(constant,exec_pos);
+			//The stack is released by the call_context when an exception is caught,
+			//values only held in registers would leak
+			if(inTryRange(body,local_ip))
+				syncStacks(ex,Builder,static_stack,dynamic_stack,dynamic_stack_index);
 		}
 		switch(opcode)
 		{
@@ -2094,7 +2409,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
 				llvm::Value* cond;
-				if(v1.second==STACK_INT && v2.second==STACK_INT)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else if(v1.second==STACK_INT && v2.second==STACK_INT)
 					cond=Builder.CreateICmpSGE(v2.first,v1.first); //GE == NLT
 				else
 				{
@@ -2131,9 +2448,15 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				llvm::Value* cond=Builder.CreateCall2(ex->FindFunctionNamed("ifNLE"), v1.first, v2.first);
+				llvm::Value* cond;
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifNLE"), v1.first, v2.first);
+				}
 			
 				syncStacks(ex,Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
@@ -2164,9 +2487,15 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				llvm::Value* cond=Builder.CreateCall2(ex->FindFunctionNamed("ifNGT"), v1.first, v2.first);
+				llvm::Value* cond;
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifNGT"), v1.first, v2.first);
+				}
 			
 				syncStacks(ex,Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
@@ -2197,9 +2526,15 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				llvm::Value* cond=Builder.CreateCall2(ex->FindFunctionNamed("ifNGE"), v1.first, v2.first);
+				llvm::Value* cond;
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifNGE"), v1.first, v2.first);
+				}
 			
 				syncStacks(ex,Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
@@ -2414,7 +2749,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				llvm::Value* cond;
-				if(v1.second==STACK_OBJECT && v2.second==STACK_OBJECT)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else if(v1.second==STACK_OBJECT && v2.second==STACK_OBJECT)
 					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifLT"), v1.first, v2.first);
 				else if(v1.second==STACK_INT && v2.second==STACK_OBJECT)
 					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifLT_io"), v1.first, v2.first);
@@ -2458,7 +2795,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				llvm::Value* cond;
-				if(v1.second==STACK_OBJECT && v2.second==STACK_OBJECT)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else if(v1.second==STACK_OBJECT && v2.second==STACK_OBJECT)
 					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifLE"), v1.first, v2.first);
 				else
 				{
@@ -2497,9 +2836,14 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				llvm::Value* cond;
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				cond=Builder.CreateCall2(ex->FindFunctionNamed("ifGT"), v1.first, v2.first);
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifGT"), v1.first, v2.first);
+				}
 			
 				syncStacks(ex,Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
@@ -2531,9 +2875,14 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				llvm::Value* cond;
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				cond=Builder.CreateCall2(ex->FindFunctionNamed("ifGE"), v1.first, v2.first);
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					cond=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					cond=Builder.CreateCall2(ex->FindFunctionNamed("ifGE"), v1.first, v2.first);
+				}
 			
 				syncStacks(ex,Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
@@ -2993,7 +3342,17 @@ SyntheticFunction::synt_function method_info::synt_method()
 				for(int i=0;i<t;i++)
 					args[t-i]=static_stack_pop(Builder,static_stack,m).first;*/
 				//Call the function resolver, static case could be resolved at this time (TODO)
-				Builder.CreateCall5(ex->FindFunctionNamed("callProperty"), context, constant, constant2, constant3, constant4);
+				vector<llvm::Value*> args;
+				args.push_back(context);
+				args.push_back(constant);
+				args.push_back(constant2);
+				args.push_back(constant3);
+				args.push_back(constant4);
+				args.push_back(propertyCacheConstant(this,local_ip));
+				if(inlined_call* call=getInlinedCall(local_ip))
+					llvm_inlinedCallProperty(ex,Builder,context,dynamic_stack,dynamic_stack_index,args,call);
+				else
+					createCall(Builder, ex->FindFunctionNamed("callProperty"), args);
 	/*				//Pop the function object, and then the object itself
 				llvm::Value* fun=static_stack_pop(Builder,static_stack,m).first;
 
@@ -3105,7 +3464,17 @@ SyntheticFunction::synt_function method_info::synt_method()
 				constant2 = llvm::ConstantInt::get(int_type, t);
 				constant3 = llvm::ConstantInt::get(int_type, 0);
 				constant4 = llvm::ConstantInt::get(bool_type, 0);
-				Builder.CreateCall5(ex->FindFunctionNamed("callProperty"), context, constant, constant2, constant3, constant4);
+				vector<llvm::Value*> args;
+				args.push_back(context);
+				args.push_back(constant);
+				args.push_back(constant2);
+				args.push_back(constant3);
+				args.push_back(constant4);
+				args.push_back(propertyCacheConstant(this,local_ip));
+				if(inlined_call* call=getInlinedCall(local_ip))
+					llvm_inlinedCallProperty(ex,Builder,context,dynamic_stack,dynamic_stack_index,args,call);
+				else
+					createCall(Builder, ex->FindFunctionNamed("callProperty"), args);
 				break;
 			}
 			case 0x53:
@@ -3229,7 +3598,8 @@ SyntheticFunction::synt_function method_info::synt_method()
 				else
 				{
 					abstract_value(ex,Builder,value);
-					Builder.CreateCall3(ex->FindFunctionNamed("setProperty"),value.first, obj.first, name);
+					Builder.CreateCall4(ex->FindFunctionNamed("setProperty"),value.first, obj.first, name,
+							propertyCacheConstant(this,local_ip));
 				}
 				break;
 			}
@@ -3248,8 +3618,12 @@ SyntheticFunction::synt_function method_info::synt_method()
 					llvm::Value* t=Builder.CreateGEP(locals,constant);
 					t=Builder.CreateLoad(t,"stack");
 					static_stack_push(static_stack,stack_entry(t,STACK_OBJECT));
-					static_locals[i]=stack_entry(t,STACK_OBJECT);
-					Builder.CreateCall(ex->FindFunctionNamed("incRef"), t);
+					//With exception handlers locals are kept in memory only, see setlocal
+					if(!body->exception_count)
+					{
+						static_locals[i]=stack_entry(t,STACK_OBJECT);
+						Builder.CreateCall(ex->FindFunctionNamed("incRef"), t);
+					}
 					Builder.CreateCall(ex->FindFunctionNamed("incRef"), t);
 					if(Log::getLevel()>=LOG_CALLS)
 						Builder.CreateCall2(ex->FindFunctionNamed("getLocal"), t, constant);
@@ -3310,7 +3684,17 @@ SyntheticFunction::synt_function method_info::synt_method()
 
 				stack_entry obj=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				abstract_value(ex,Builder,obj);
-				value=Builder.CreateCall2(ex->FindFunctionNamed("getProperty"), obj.first, name);
+				inlined_getter* getter=getInlinedGetter(local_ip);
+				if(getter)
+				{
+					value=llvm_inlinedGetProperty(ex,Builder,obj.first,name,
+							propertyCacheConstant(this,local_ip),getter);
+				}
+				else
+				{
+					value=Builder.CreateCall3(ex->FindFunctionNamed("getProperty"), obj.first, name,
+							propertyCacheConstant(this,local_ip));
+				}
 				static_stack_push(static_stack,stack_entry(value,STACK_OBJECT));
 				/*if(cur_block->push_types[local_ip]==STACK_OBJECT ||
 					cur_block->push_types[local_ip]==STACK_BOOLEAN)
@@ -3592,7 +3976,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				LOG(LOG_TRACE, _("synt add") );
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
-				if(v1.second==STACK_OBJECT && v2.second==STACK_INT)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					static_stack_push(static_stack,llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)));
+				else if(v1.second==STACK_OBJECT && v2.second==STACK_INT)
 				{
 					value=Builder.CreateCall2(ex->FindFunctionNamed("add_oi"), v1.first, v2.first);
 					static_stack_push(static_stack,stack_entry(value,STACK_OBJECT));
@@ -3623,7 +4009,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				LOG(LOG_TRACE, _("synt subtract") );
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
-				if(v1.second==STACK_INT && v2.second==STACK_INT)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					static_stack_push(static_stack,llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)));
+				else if(v1.second==STACK_INT && v2.second==STACK_INT)
 				{
 					value=Builder.CreateSub(v2.first, v1.first);
 					static_stack_push(static_stack,stack_entry(value,STACK_INT));
@@ -3676,7 +4064,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				LOG(LOG_TRACE, _("synt multiply") );
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
-				if(v1.second==STACK_INT && v2.second==STACK_OBJECT)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					static_stack_push(static_stack,llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)));
+				else if(v1.second==STACK_INT && v2.second==STACK_OBJECT)
 				{
 					value=Builder.CreateCall2(ex->FindFunctionNamed("multiply_oi"), v2.first, v1.first);
 					static_stack_push(static_stack,stack_entry(value,STACK_NUMBER));
@@ -3725,7 +4115,9 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v2=	static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				if(v1.second==STACK_INT && v2.second==STACK_NUMBER)
+				if(canSpeculateNumbers(v2,v1,getOperandTypes(local_ip)))
+					value=llvm_speculateBinaryOp(ex,Builder,opcode,v2,v1,getOperandTypes(local_ip)).first;
+				else if(v1.second==STACK_INT && v2.second==STACK_NUMBER)
 				{
 					v1.first=Builder.CreateSIToFP(v1.first,number_type);
 					value=Builder.CreateFDiv(v2.first,v1.first);
@@ -3937,9 +4329,14 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				value=Builder.CreateCall2(ex->FindFunctionNamed("lessThan"), v1.first, v2.first);
+				if(canSpeculateNumbers(v1,v2,getOperandTypes(local_ip)))
+					value=llvm_speculateBinaryOp(ex,Builder,opcode,v1,v2,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					value=Builder.CreateCall2(ex->FindFunctionNamed("lessThan"), v1.first, v2.first);
+				}
 				static_stack_push(static_stack,stack_entry(value,STACK_BOOLEAN));
 				break;
 			}
@@ -3950,9 +4347,14 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				value=Builder.CreateCall2(ex->FindFunctionNamed("lessEquals"), v1.first, v2.first);
+				if(canSpeculateNumbers(v1,v2,getOperandTypes(local_ip)))
+					value=llvm_speculateBinaryOp(ex,Builder,opcode,v1,v2,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					value=Builder.CreateCall2(ex->FindFunctionNamed("lessEquals"), v1.first, v2.first);
+				}
 				static_stack_push(static_stack,stack_entry(value,STACK_BOOLEAN));
 				break;
 			}
@@ -3963,9 +4365,14 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				value=Builder.CreateCall2(ex->FindFunctionNamed("greaterThan"), v1.first, v2.first);
+				if(canSpeculateNumbers(v1,v2,getOperandTypes(local_ip)))
+					value=llvm_speculateBinaryOp(ex,Builder,opcode,v1,v2,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					value=Builder.CreateCall2(ex->FindFunctionNamed("greaterThan"), v1.first, v2.first);
+				}
 				static_stack_push(static_stack,stack_entry(value,STACK_BOOLEAN));
 				break;
 			}
@@ -3976,9 +4383,14 @@ SyntheticFunction::synt_function method_info::synt_method()
 				stack_entry v2=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 				stack_entry v1=static_stack_pop(Builder,static_stack,dynamic_stack,dynamic_stack_index);
 
-				abstract_value(ex,Builder,v1);
-				abstract_value(ex,Builder,v2);
-				value=Builder.CreateCall2(ex->FindFunctionNamed("greaterEquals"), v1.first, v2.first);
+				if(canSpeculateNumbers(v1,v2,getOperandTypes(local_ip)))
+					value=llvm_speculateBinaryOp(ex,Builder,opcode,v1,v2,getOperandTypes(local_ip)).first;
+				else
+				{
+					abstract_value(ex,Builder,v1);
+					abstract_value(ex,Builder,v2);
+					value=Builder.CreateCall2(ex->FindFunctionNamed("greaterEquals"), v1.first, v2.first);
+				}
 				static_stack_push(static_stack,stack_entry(value,STACK_BOOLEAN));
 				break;
 			}
@@ -4088,7 +4500,22 @@ SyntheticFunction::synt_function method_info::synt_method()
 				if(static_locals[i].second==STACK_OBJECT)
 					Builder.CreateCall(ex->FindFunctionNamed("decRef"), static_locals[i].first);
 
-				static_locals[i]=e;
+				if(body->exception_count)
+				{
+					//Keep the local in memory only: a catch block reached from the middle
+					//of this block reloads it from there, and a register copy would leak
+					//its reference when an exception unwinds the compiled code
+					constant = llvm::ConstantInt::get(int_type, i);
+					llvm::Value* gep=Builder.CreateGEP(locals,constant);
+					llvm::Value* old=Builder.CreateLoad(gep);
+					Builder.CreateCall(ex->FindFunctionNamed("decRef"), old);
+					stack_entry boxed=e;
+					abstract_value(ex,Builder,boxed);
+					Builder.CreateStore(boxed.first,gep);
+					static_locals[i].second=STACK_NONE;
+				}
+				else
+					static_locals[i]=e;
 				if(Log::getLevel()>=LOG_CALLS)
 				{
 					constant = llvm::ConstantInt::get(int_type, i);
@@ -23,10 +23,59 @@
 #include "abcutils.h"
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 using namespace std;
 using namespace lightspark;
 
+//GCC supports taking the address of labels, use it to dispatch the instructions
+#if defined(__GNUC__) && !defined(_MSC_VER)
+#define INTERPRETER_COMPUTED_GOTO
+#endif
+
+/* Numeric results are boxed again by the interpreter. When an operand is
+ * already a box of the result type and only the stack references it, an
+ * extra reference keeps it alive across the operation and the result is
+ * stored in it, sparing the Manager round trip. Both operands must be
+ * plain numbers, so that the operation can't throw and leak the box */
+static bool isPlainNumber(ASObject* o)
+{
+	const SWFOBJECT_TYPE t=o->getObjectType();
+	return t==T_INTEGER || t==T_UINTEGER || t==T_NUMBER || t==T_BOOLEAN;
+}
+
+static ASObject* resultBox(ASObject* o, SWFOBJECT_TYPE t)
+{
+	if(o->getObjectType()!=t || !o->isLastRef())
+		return NULL;
+	o->incRef();
+	return o;
+}
+
+static ASObject* resultBox(ASObject* o1, ASObject* o2, SWFOBJECT_TYPE t)
+{
+	if(!isPlainNumber(o1) || !isPlainNumber(o2))
+		return NULL;
+	ASObject* ret=resultBox(o1,t);
+	return (ret)?ret:resultBox(o2,t);
+}
+
+static ASObject* boxNumber(ASObject* box, number_t n)
+{
+	if(box==NULL)
+		return abstract_d(n);
+	box->as<Number>()->val=n;
+	return box;
+}
+
+static ASObject* boxInteger(ASObject* box, int32_t n)
+{
+	if(box==NULL)
+		return abstract_i(n);
+	box->as<Integer>()->val=n;
+	return box;
+}
+
 uint64_t ABCVm::profilingCheckpoint(uint64_t& startTime)
 {
 	uint64_t cur=compat_get_thread_cputime_us();
@@ -35,21 +84,374 @@ uint64_t ABCVm::profilingCheckpoint(uint64_t& startTime)
 	return ret;
 }
 
+int32_t method_info::getPreloadedIndex(uint32_t pos) const
+{
+	auto it=lower_bound(preloadedpositions.begin(),preloadedpositions.end(),make_pair(pos,(uint32_t)0));
+	if(it==preloadedpositions.end() || it->first!=pos)
+		return -1;
+	return it->second;
+}
+
+property_cache* method_info::getPropertyCache(uint32_t pos)
+{
+	if(preloadedcode.empty())
+		ABCVm::preloadFunction(this);
+	int32_t index=getPreloadedIndex(pos);
+	assert_and_throw(index>=0);
+	return &propertycaches[preloadedcode[index].target];
+}
+
+/* Decodes the body of the method once, so that the interpreter does not
+ * have to parse the bytecode on every call */
+void ABCVm::preloadFunction(method_info* mi)
+{
+	assert(mi->preloadedcode.empty());
+	const std::string& bytecode=mi->body->code;
+	istringstream code(bytecode);
+	const int code_len=bytecode.length();
+	cpool_info& constant_pool=mi->context->constant_pool;
+
+	//Index of the instruction and absolute destination of each jump, resolved when everything is decoded
+	vector<pair<uint32_t,int> > jumps;
+	uint32_t propertyCaches=0;
+	bool stop=false;
+	while(!stop)
+	{
+		uint32_t pos=code.tellg();
+		u8 opcode;
+		code >> opcode;
+		if(code.eof())
+			break;
+
+		//Instructions which are not emitted map to the following one
+		mi->preloadedpositions.push_back(make_pair(pos,(uint32_t)mi->preloadedcode.size()));
+
+		preloadedcodedata ins;
+		ins.opcode=opcode;
+		ins.pos=pos;
+		ins.arg1=0;
+		ins.arg2=0;
+		ins.target=-1;
+		switch(opcode)
+		{
+			case 0x02: //nop
+			case 0x09: //label
+				continue;
+			case 0xef:
+			{
+				//debug
+				uint8_t debug_type;
+				u30 index;
+				uint8_t reg;
+				u30 extra;
+				code.read((char*)&debug_type,1);
+				code >> index;
+				code.read((char*)&reg,1);
+				code >> extra;
+				continue;
+			}
+			case 0xf0: //debugline
+			case 0xf1: //debugfile
+			{
+				u30 t;
+				code >> t;
+				continue;
+			}
+			case 0x0c: //ifnlt
+			case 0x0d: //ifnle
+			case 0x0e: //ifngt
+			case 0x0f: //ifnge
+			case 0x10: //jump
+			case 0x11: //iftrue
+			case 0x12: //iffalse
+			case 0x13: //ifeq
+			case 0x14: //ifne
+			case 0x15: //iflt
+			case 0x16: //ifle
+			case 0x17: //ifgt
+			case 0x18: //ifge
+			case 0x19: //ifstricteq
+			case 0x1a: //ifstrictne
+			{
+				s24 t;
+				code >> t;
+				//The offset is relative to the next instruction
+				int here=code.tellg();
+				jumps.push_back(make_pair((uint32_t)mi->preloadedcode.size(),here+t));
+				break;
+			}
+			case 0x1b:
+			{
+				//lookupswitch
+				//Base for the jumps is the instruction itself for the switch
+				int here=pos;
+				s24 t;
+				code >> t;
+				int defaultdest=here+t;
+				u30 count;
+				code >> count;
+				ins.arg1=count;
+				ins.target=mi->preloadedswitchtargets.size();
+				//The case targets are followed by the default one
+				for(unsigned int i=0;i<count+1;i++)
+				{
+					s24 offset;
+					code >> offset;
+					mi->preloadedswitchtargets.push_back(here+offset);
+				}
+				mi->preloadedswitchtargets.push_back(defaultdest);
+				break;
+			}
+			case 0x24:
+			{
+				//pushbyte
+				int8_t t;
+				code.read((char*)&t,1);
+				ins.arg1=(int32_t)t;
+				break;
+			}
+			case 0x25:
+			{
+				//pushshort
+				// specs say pushshort is a u30, but it's really a u32
+				// see https://bugs.adobe.com/jira/browse/ASC-4181
+				u32 t;
+				code >> t;
+				ins.arg1=t;
+				break;
+			}
+			case 0x2d:
+			{
+				//pushint
+				u30 t;
+				code >> t;
+				ins.arg1=t;
+				ins.arg2=(int32_t)constant_pool.integer[t];
+				break;
+			}
+			case 0x2e:
+			{
+				//pushuint
+				u30 t;
+				code >> t;
+				ins.arg1=t;
+				ins.arg2=constant_pool.uinteger[t];
+				break;
+			}
+			case 0x04: //getsuper
+			case 0x05: //setsuper
+			case 0x06: //dxns
+			case 0x08: //kill
+			case 0x2c: //pushstring
+			case 0x2f: //pushdouble
+			case 0x31: //pushnamespace
+			case 0x40: //newfunction
+			case 0x41: //call
+			case 0x42: //construct
+			case 0x49: //constructsuper
+			case 0x53: //constructgenerictype
+			case 0x55: //newobject
+			case 0x56: //newarray
+			case 0x58: //newclass
+			case 0x59: //getdescendants
+			case 0x5a: //newcatch
+			case 0x5d: //findpropstrict
+			case 0x5e: //findproperty
+			case 0x60: //getlex
+			case 0x61: //setproperty
+			case 0x62: //getlocal
+			case 0x63: //setlocal
+			case 0x65: //getscopeobject
+			case 0x66: //getproperty
+			case 0x68: //initproperty
+			case 0x6a: //deleteproperty
+			case 0x6c: //getslot
+			case 0x6d: //setslot
+			case 0x80: //coerce
+			case 0x86: //astype
+			case 0x92: //inclocal
+			case 0x94: //declocal
+			case 0xb2: //istype
+			case 0xc2: //inclocal_i
+			case 0xc3: //declocal_i
+			{
+				u30 t;
+				code >> t;
+				ins.arg1=t;
+				break;
+			}
+			case 0x4c: //callproplex seems to be exactly like callproperty
+				ins.opcode=0x46;
+				//fall through
+			case 0x32: //hasnext2
+			case 0x45: //callsuper
+			case 0x46: //callproperty
+			case 0x4a: //constructprop
+			case 0x4e: //callsupervoid
+			case 0x4f: //callpropvoid
+			{
+				u30 t,t2;
+				code >> t;
+				code >> t2;
+				ins.arg1=t;
+				ins.arg2=t2;
+				break;
+			}
+			case 0xd0:
+			case 0xd1:
+			case 0xd2:
+			case 0xd3:
+			{
+				//getlocal_n
+				ins.opcode=0x62;
+				ins.arg1=opcode&3;
+				break;
+			}
+			case 0xd4:
+			case 0xd5:
+			case 0xd6:
+			case 0xd7:
+			{
+				//setlocal_n
+				ins.opcode=0x63;
+				ins.arg1=opcode&3;
+				break;
+			}
+			case 0x03: //throw
+			case 0x07: //dxnslate
+			case 0x1c: //pushwith
+			case 0x1d: //popscope
+			case 0x1e: //nextname
+			case 0x20: //pushnull
+			case 0x21: //pushundefined
+			case 0x23: //nextvalue
+			case 0x26: //pushtrue
+			case 0x27: //pushfalse
+			case 0x28: //pushnan
+			case 0x29: //pop
+			case 0x2a: //dup
+			case 0x2b: //swap
+			case 0x30: //pushscope
+			case 0x35: //li8
+			case 0x36: //li16
+			case 0x37: //li32
+			case 0x3a: //si8
+			case 0x3b: //si16
+			case 0x3c: //si32
+			case 0x47: //returnvoid
+			case 0x48: //returnvalue
+			case 0x57: //newactivation
+			case 0x64: //getglobalscope
+			case 0x70: //convert_s
+			case 0x71: //esc_xelem
+			case 0x72: //esc_xattr
+			case 0x73: //convert_i
+			case 0x74: //convert_u
+			case 0x75: //convert_d
+			case 0x76: //convert_b
+			case 0x78: //checkfilter
+			case 0x82: //coerce_a
+			case 0x85: //coerce_s
+			case 0x87: //astypelate
+			case 0x90: //negate
+			case 0x91: //increment
+			case 0x93: //decrement
+			case 0x95: //typeof
+			case 0x96: //not
+			case 0x97: //bitnot
+			case 0xa0: //add
+			case 0xa1: //subtract
+			case 0xa2: //multiply
+			case 0xa3: //divide
+			case 0xa4: //modulo
+			case 0xa5: //lshift
+			case 0xa6: //rshift
+			case 0xa7: //urshift
+			case 0xa8: //bitand
+			case 0xa9: //bitor
+			case 0xaa: //bitxor
+			case 0xab: //equals
+			case 0xac: //strictequals
+			case 0xad: //lessthan
+			case 0xae: //lessequals
+			case 0xaf: //greaterthan
+			case 0xb0: //greaterequals
+			case 0xb1: //instanceof
+			case 0xb3: //istypelate
+			case 0xb4: //in
+			case 0xc0: //increment_i
+			case 0xc1: //decrement_i
+			case 0xc4: //negate_i
+			case 0xc5: //add_i
+			case 0xc6: //subtract_i
+			case 0xc7: //multiply_i
+				break;
+			default:
+				//The length of an unknown instruction is unknown as well, stop decoding here.
+				//The interpreter will fail when (and if) it reaches this instruction
+				stop=true;
+				break;
+		}
+		//Truncated instruction, execution will stop before it
+		if(code.fail())
+			break;
+		//Every property access site gets its own inline cache
+		if(ins.opcode==0x46 || ins.opcode==0x4f || ins.opcode==0x61 || ins.opcode==0x66)
+			ins.target=propertyCaches++;
+		mi->preloadedcode.push_back(ins);
+	}
+	//The caches are never reallocated, as the JIT references them directly
+	mi->propertycaches.resize(propertyCaches);
+	if(getSys()->useJit && getSys()->useInterpreter)
+		mi->operandTypes.resize(code_len,0);
+
+	preloadedcodedata end;
+	end.opcode=preloadedcodedata::END_OF_CODE;
+	end.pos=code_len;
+	end.arg1=0;
+	end.arg2=0;
+	end.target=-1;
+	mi->preloadedcode.push_back(end);
+
+	//Now that all the instructions are known, resolve the jumps
+	for(uint32_t i=0;i<jumps.size();i++)
+	{
+		int dest=jumps[i].second;
+		preloadedcodedata& jumpIns=mi->preloadedcode[jumps[i].first];
+		if(dest >= 0 && dest < code_len)
+			jumpIns.target=mi->getPreloadedIndex(dest);
+	}
+	for(uint32_t i=0;i<mi->preloadedswitchtargets.size();i++)
+	{
+		int dest=mi->preloadedswitchtargets[i];
+		if(dest >= 0 && dest < code_len)
+			mi->preloadedswitchtargets[i]=mi->getPreloadedIndex(dest);
+		else
+			mi->preloadedswitchtargets[i]=-1;
+	}
+}
+
 ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context* context)
 {
 	method_info* mi=function->mi;
 
-	istringstream code(mi->body->code);
-	//This may be non-zero and point to the position of an exception handler
-	code.seekg(context->exec_pos);
+	if(mi->preloadedcode.empty())
+		preloadFunction(mi);
 
-	int code_len=code.str().length();
-
-	u8 opcode;
+	const preloadedcodedata* const code=&mi->preloadedcode[0];
+	const preloadedcodedata* instr=code;
+	//This may be non-zero and point to the position of an exception handler
+	if(context->exec_pos!=0)
+	{
+		int32_t start=mi->getPreloadedIndex(context->exec_pos);
+		if(start<0)
+			throw ParseException("Exception handler out of bounds in interpreter");
+		instr=code+start;
+	}
 
 #ifdef PROFILING_SUPPORT
 	if(mi->profTime.empty())
-		mi->profTime.resize(code_len,0);
+		mi->profTime.resize(mi->body->code.length(),0);
 	uint64_t startTime=compat_get_thread_cputime_us();
 #define PROF_ACCOUNT_TIME(a, b)  do{a+=b;}while(0)
 #define PROF_IGNORE_TIME(a) do{ a; } while(0)
@@ -58,508 +460,373 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 #define PROF_IGNORE_TIME(a) do{ ; } while(0)
 #endif
 
-	//Each case block builds the correct parameters for the interpreter function and call it
-	while(1)
+#ifdef INTERPRETER_COMPUTED_GOTO
+	static const void* const dispatch_table[preloadedcodedata::OPCODE_COUNT] =
 	{
-#ifdef PROFILING_SUPPORT
-		uint32_t instructionPointer=code.tellg();
+		&&op_default, &&op_default, &&op_default, &&op_0x03, &&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07,
+		&&op_0x08, &&op_default, &&op_default, &&op_default, &&op_0x0c, &&op_0x0d, &&op_0x0e, &&op_0x0f,
+		&&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13, &&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17,
+		&&op_0x18, &&op_0x19, &&op_0x1a, &&op_0x1b, &&op_0x1c, &&op_0x1d, &&op_0x1e, &&op_default,
+		&&op_0x20, &&op_0x21, &&op_default, &&op_0x23, &&op_0x24, &&op_0x25, &&op_0x26, &&op_0x27,
+		&&op_0x28, &&op_0x29, &&op_0x2a, &&op_0x2b, &&op_0x2c, &&op_0x2d, &&op_0x2e, &&op_0x2f,
+		&&op_0x30, &&op_0x31, &&op_0x32, &&op_default, &&op_default, &&op_0x35, &&op_0x36, &&op_0x37,
+		&&op_default, &&op_default, &&op_0x3a, &&op_0x3b, &&op_0x3c, &&op_default, &&op_default, &&op_default,
+		&&op_0x40, &&op_0x41, &&op_0x42, &&op_default, &&op_default, &&op_0x45, &&op_0x46, &&op_0x47,
+		&&op_0x48, &&op_0x49, &&op_0x4a, &&op_default, &&op_default, &&op_default, &&op_0x4e, &&op_0x4f,
+		&&op_default, &&op_default, &&op_default, &&op_0x53, &&op_default, &&op_0x55, &&op_0x56, &&op_0x57,
+		&&op_0x58, &&op_0x59, &&op_0x5a, &&op_default, &&op_default, &&op_0x5d, &&op_0x5e, &&op_default,
+		&&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63, &&op_0x64, &&op_0x65, &&op_0x66, &&op_default,
+		&&op_0x68, &&op_default, &&op_0x6a, &&op_default, &&op_0x6c, &&op_0x6d, &&op_default, &&op_default,
+		&&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73, &&op_0x74, &&op_0x75, &&op_0x76, &&op_default,
+		&&op_0x78, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_0x80, &&op_default, &&op_0x82, &&op_default, &&op_default, &&op_0x85, &&op_0x86, &&op_0x87,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_0x90, &&op_0x91, &&op_0x92, &&op_0x93, &&op_0x94, &&op_0x95, &&op_0x96, &&op_0x97,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_0xa0, &&op_0xa1, &&op_0xa2, &&op_0xa3, &&op_0xa4, &&op_0xa5, &&op_0xa6, &&op_0xa7,
+		&&op_0xa8, &&op_0xa9, &&op_0xaa, &&op_0xab, &&op_0xac, &&op_0xad, &&op_0xae, &&op_0xaf,
+		&&op_0xb0, &&op_0xb1, &&op_0xb2, &&op_0xb3, &&op_0xb4, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_0xc0, &&op_0xc1, &&op_0xc2, &&op_0xc3, &&op_0xc4, &&op_0xc5, &&op_0xc6, &&op_0xc7,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default, &&op_default,
+		&&op_end
+	};
+#define INSTRUCTION(op) op_##op:
+#define END_OF_CODE_INSTRUCTION op_end:
+#define DEFAULT_INSTRUCTION op_default:
+#define DISPATCH { context->exec_pos=instr->pos+1; goto *dispatch_table[instr->opcode]; }
+#else
+#define INSTRUCTION(op) case op:
+#define END_OF_CODE_INSTRUCTION case preloadedcodedata::END_OF_CODE:
+#define DEFAULT_INSTRUCTION default:
+#define DISPATCH continue
 #endif
-		code >> opcode;
-		if(code.eof())
-			throw ParseException("End of code in interpreter");
-
-		//Save ip for exception handling in SyntheticFunction::callImpl
-		context->exec_pos = code.tellg();
-		switch(opcode)
+	//DISPATCH saves the ip for exception handling in SyntheticFunction::call
+#define NEXT_INSTRUCTION { PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime)); ++instr; DISPATCH; }
+#define JUMP_INSTRUCTION(t) { \
+		int32_t dest=(t); \
+		if(dest < 0) \
+			throw ParseException("Jump out of bounds in interpreter"); \
+		PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime)); \
+		instr=code+dest; \
+		DISPATCH; }
+
+	//Each instruction block builds the correct parameters for the interpreter function and call it
+#ifdef INTERPRETER_COMPUTED_GOTO
+	DISPATCH;
+#else
+	while(1)
+	{
+		context->exec_pos=instr->pos+1;
+		switch(instr->opcode)
 		{
-			case 0x02:
-			{
-				//nop
-				break;
-			}
-			case 0x03:
+#endif
+			INSTRUCTION(0x03)
 			{
 				//throw
 				_throw(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x04:
+			INSTRUCTION(0x04)
 			{
 				//getsuper
-				u30 t;
-				code >> t;
-				getSuper(context,t);
-				break;
+				getSuper(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x05:
+			INSTRUCTION(0x05)
 			{
 				//setsuper
-				u30 t;
-				code >> t;
-				setSuper(context,t);
-				break;
+				setSuper(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x06:
+			INSTRUCTION(0x06)
 			{
 				//dxns
-				u30 t;
-				code >> t;
-				dxns(context,t);
-				break;
+				dxns(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x07:
+			INSTRUCTION(0x07)
 			{
 				//dxnslate
 				ASObject* v=context->runtime_stack_pop();
 				dxnslate(context, v);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x08:
+			INSTRUCTION(0x08)
 			{
 				//kill
-				u30 t;
-				code >> t;
+				uint32_t t=instr->arg1;
 				assert_and_throw(context->locals[t]);
 				context->locals[t]->decRef();
 				context->locals[t]=new Undefined;
-				break;
-			}
-			case 0x09:
-			{
-				//label
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x0c:
+			INSTRUCTION(0x0c)
 			{
 				//ifnlt
-				s24 t;
-				code >> t;
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifNLT(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x0d:
+			INSTRUCTION(0x0d)
 			{
 				//ifnle
-				s24 t;
-				code >> t;
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifNLE(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x0e:
+			INSTRUCTION(0x0e)
 			{
 				//ifngt
-				s24 t;
-				code >> t;
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifNGT(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x0f:
+			INSTRUCTION(0x0f)
 			{
 				//ifnge
-				s24 t;
-				code >> t;
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifNGE(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x10:
+			INSTRUCTION(0x10)
 			{
 				//jump
-				s24 t;
-				code >> t;
-
-				int here=code.tellg();
-				int dest=here+t;
-
-				//Now 'jump' to the destination, validate on the length
-				if(dest >= code_len)
-					throw ParseException("Jump out of bounds in interpreter");
-				code.seekg(dest);
-				break;
+				JUMP_INSTRUCTION(instr->target);
 			}
-			case 0x11:
+			INSTRUCTION(0x11)
 			{
 				//iftrue
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				bool cond=ifTrue(v1);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x12:
+			INSTRUCTION(0x12)
 			{
 				//iffalse
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				bool cond=ifFalse(v1);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x13:
+			INSTRUCTION(0x13)
 			{
 				//ifeq
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 				bool cond=ifEq(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x14:
+			INSTRUCTION(0x14)
 			{
 				//ifne
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 				bool cond=ifNE(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x15:
+			INSTRUCTION(0x15)
 			{
 				//iflt
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifLT(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x16:
+			INSTRUCTION(0x16)
 			{
 				//ifle
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifLE(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x17:
+			INSTRUCTION(0x17)
 			{
 				//ifgt
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifGT(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x18:
+			INSTRUCTION(0x18)
 			{
 				//ifge
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 				bool cond=ifGE(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x19:
+			INSTRUCTION(0x19)
 			{
 				//ifstricteq
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 				bool cond=ifStrictEq(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
 			}
-			case 0x1a:
+			INSTRUCTION(0x1a)
 			{
 				//ifstrictne
-				s24 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 				bool cond=ifStrictNE(v1, v2);
 				if(cond)
-				{
-					int here=code.tellg();
-					int dest=here+t;
-
-					//Now 'jump' to the destination, validate on the length
-					if(dest >= code_len)
-						throw ParseException("Jump out of bounds in interpreter");
-					code.seekg(dest);
-				}
-				break;
-			}
-			case 0x1b:
-			{
-				//lookupswitch
-				int here=int(code.tellg())-1; //Base for the jumps is the instruction itself for the switch
-				s24 t;
-				code >> t;
-				int defaultdest=here+t;
-				LOG(LOG_CALLS,_("Switch default dest ") << defaultdest);
-				u30 count;
-				code >> count;
-				vector<s24> offsets(count+1);
-				for(unsigned int i=0;i<count+1;i++)
-				{
-					code >> offsets[i];
-					LOG(LOG_CALLS,_("Switch dest ") << i << ' ' << offsets[i]);
-				}
+					JUMP_INSTRUCTION(instr->target);
+				NEXT_INSTRUCTION;
+			}
+			INSTRUCTION(0x1b)
+			{
+				//lookupswitch
+				const int32_t* targets=&mi->preloadedswitchtargets[instr->target];
+				uint32_t count=instr->arg1;
 
 				ASObject* index_obj=context->runtime_stack_pop();
 				assert_and_throw(index_obj->getObjectType()==T_INTEGER);
 				unsigned int index=index_obj->toUInt();
 				index_obj->decRef();
 
-				int dest=defaultdest;
+				//The default target follows the case targets
 				if(index<=count)
-					dest=here+offsets[index];
-
-				if(dest >= code_len)
-					throw ParseException("Jump out of bounds in interpreter");
-				code.seekg(dest);
-				break;
+					JUMP_INSTRUCTION(targets[index]);
+				JUMP_INSTRUCTION(targets[count+1]);
 			}
-			case 0x1c:
+			INSTRUCTION(0x1c)
 			{
 				//pushwith
 				pushWith(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x1d:
+			INSTRUCTION(0x1d)
 			{
 				//popscope
 				popScope(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x1e:
+			INSTRUCTION(0x1e)
 			{
 				//nextname
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 				context->runtime_stack_push(nextName(v1,v2));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x20:
+			INSTRUCTION(0x20)
 			{
 				//pushnull
 				context->runtime_stack_push(pushNull());
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x21:
+			INSTRUCTION(0x21)
 			{
 				//pushundefined
 				context->runtime_stack_push(pushUndefined());
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x23:
+			INSTRUCTION(0x23)
 			{
 				//nextvalue
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 				context->runtime_stack_push(nextValue(v1,v2));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x24:
+			INSTRUCTION(0x24)
 			{
 				//pushbyte
-				int8_t t;
-				code.read((char*)&t,1);
+				int32_t t=instr->arg1;
 				context->runtime_stack_push(abstract_i(t));
 				pushByte(t);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x25:
+			INSTRUCTION(0x25)
 			{
 				//pushshort
-				// specs say pushshort is a u30, but it's really a u32
-				// see https://bugs.adobe.com/jira/browse/ASC-4181
-				u32 t;
-				code >> t;
+				int32_t t=instr->arg1;
 				context->runtime_stack_push(abstract_i(t));
 				pushShort(t);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x26:
+			INSTRUCTION(0x26)
 			{
 				//pushtrue
 				context->runtime_stack_push(abstract_b(pushTrue()));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x27:
+			INSTRUCTION(0x27)
 			{
 				//pushfalse
 				context->runtime_stack_push(abstract_b(pushFalse()));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x28:
+			INSTRUCTION(0x28)
 			{
 				//pushnan
 				context->runtime_stack_push(pushNaN());
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x29:
+			INSTRUCTION(0x29)
 			{
 				//pop
 				pop();
 				ASObject* o=context->runtime_stack_pop();
 				if(o)
 					o->decRef();
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x2a:
+			INSTRUCTION(0x2a)
 			{
 				//dup
 				dup();
 				ASObject* o=context->runtime_stack_peek();
 				o->incRef();
 				context->runtime_stack_push(o);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x2b:
+			INSTRUCTION(0x2b)
 			{
 				//swap
 				swap();
@@ -568,513 +835,443 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 
 				context->runtime_stack_push(v1);
 				context->runtime_stack_push(v2);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x2c:
+			INSTRUCTION(0x2c)
 			{
 				//pushstring
-				u30 t;
-				code >> t;
-				context->runtime_stack_push(pushString(context,t));
-				break;
+				context->runtime_stack_push(pushString(context,instr->arg1));
+				NEXT_INSTRUCTION;
 			}
-			case 0x2d:
+			INSTRUCTION(0x2d)
 			{
 				//pushint
-				u30 t;
-				code >> t;
-				pushInt(context, t);
+				pushInt(context, instr->arg1);
 
-				ASObject* i=abstract_i(context->context->constant_pool.integer[t]);
+				//The value has been resolved from the constant pool by preloadFunction
+				ASObject* i=abstract_i(instr->arg2);
 				context->runtime_stack_push(i);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x2e:
+			INSTRUCTION(0x2e)
 			{
 				//pushuint
-				u30 t;
-				code >> t;
-				pushUInt(context, t);
+				pushUInt(context, instr->arg1);
 
-				ASObject* i=abstract_i(context->context->constant_pool.uinteger[t]);
+				ASObject* i=abstract_i(instr->arg2);
 				context->runtime_stack_push(i);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x2f:
+			INSTRUCTION(0x2f)
 			{
 				//pushdouble
-				u30 t;
-				code >> t;
-				pushDouble(context, t);
+				pushDouble(context, instr->arg1);
 
-				ASObject* d=abstract_d(context->context->constant_pool.doubles[t]);
+				ASObject* d=abstract_d(context->context->constant_pool.doubles[instr->arg1]);
 				context->runtime_stack_push(d);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x30:
+			INSTRUCTION(0x30)
 			{
 				//pushscope
 				pushScope(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x31:
+			INSTRUCTION(0x31)
 			{
 				//pushnamespace
-				u30 t;
-				code >> t;
-				context->runtime_stack_push( pushNamespace(context, t) );
-				break;
+				context->runtime_stack_push( pushNamespace(context, instr->arg1) );
+				NEXT_INSTRUCTION;
 			}
-			case 0x32:
+			INSTRUCTION(0x32)
 			{
 				//hasnext2
-				u30 t,t2;
-				code >> t;
-				code >> t2;
-
-				bool ret=hasNext2(context,t,t2);
+				bool ret=hasNext2(context,instr->arg1,instr->arg2);
 				context->runtime_stack_push(abstract_b(ret));
-				break;
+				NEXT_INSTRUCTION;
 			}
 			//Alchemy opcodes
-			case 0x35:
+			INSTRUCTION(0x35)
 			{
 				//li8
 				loadIntN<uint8_t>(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x36:
+			INSTRUCTION(0x36)
 			{
 				//li16
 				loadIntN<uint16_t>(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x37:
+			INSTRUCTION(0x37)
 			{
 				//li32
 				loadIntN<uint32_t>(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x3a:
+			INSTRUCTION(0x3a)
 			{
 				//si8
 				storeIntN<uint8_t>(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x3b:
+			INSTRUCTION(0x3b)
 			{
 				//si16
 				storeIntN<uint16_t>(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x3c:
+			INSTRUCTION(0x3c)
 			{
 				//si32
 				storeIntN<uint32_t>(context);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x40:
+			INSTRUCTION(0x40)
 			{
 				//newfunction
-				u30 t;
-				code >> t;
-				context->runtime_stack_push(newFunction(context,t));
-				break;
+				context->runtime_stack_push(newFunction(context,instr->arg1));
+				NEXT_INSTRUCTION;
 			}
-			case 0x41:
+			INSTRUCTION(0x41)
 			{
 				//call
-				u30 t;
-				code >> t;
 				method_info* called_mi=NULL;
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
-				call(context,t,&called_mi);
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
+				call(context,instr->arg1,&called_mi);
 				if(called_mi)
 					PROF_ACCOUNT_TIME(mi->profCalls[called_mi],profilingCheckpoint(startTime));
 				else
 					PROF_IGNORE_TIME(profilingCheckpoint(startTime));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x42:
+			INSTRUCTION(0x42)
 			{
 				//construct
-				u30 t;
-				code >> t;
-				construct(context,t);
-				break;
+				construct(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x45:
+			INSTRUCTION(0x45)
 			{
 				//callsuper
-				u30 t,t2;
-				code >> t;
-				code >> t2;
 				method_info* called_mi=NULL;
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
-				callSuper(context,t,t2,&called_mi,true);
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
+				callSuper(context,instr->arg1,instr->arg2,&called_mi,true);
 				if(called_mi)
 					PROF_ACCOUNT_TIME(mi->profCalls[called_mi],profilingCheckpoint(startTime));
 				else
 					PROF_IGNORE_TIME(profilingCheckpoint(startTime));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x46:
-			case 0x4c: //callproplex seems to be exactly like callproperty
+			INSTRUCTION(0x46)
 			{
 				//callproperty
-				u30 t,t2;
-				code >> t;
-				code >> t2;
+				//callproplex is decoded as callproperty
 				method_info* called_mi=NULL;
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
-				callProperty(context,t,t2,&called_mi,true);
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
+				callProperty(context,instr->arg1,instr->arg2,&called_mi,true,&mi->propertycaches[instr->target]);
 				if(called_mi)
 					PROF_ACCOUNT_TIME(mi->profCalls[called_mi],profilingCheckpoint(startTime));
 				else
 					PROF_IGNORE_TIME(profilingCheckpoint(startTime));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x47:
+			INSTRUCTION(0x47)
 			{
 				//returnvoid
 				LOG(LOG_CALLS,_("returnVoid"));
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
 				return NULL;
 			}
-			case 0x48:
+			INSTRUCTION(0x48)
 			{
 				//returnvalue
 				ASObject* ret=context->runtime_stack_pop();
 				LOG(LOG_CALLS,_("returnValue ") << ret);
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
 				return ret;
 			}
-			case 0x49:
+			INSTRUCTION(0x49)
 			{
 				//constructsuper
-				u30 t;
-				code >> t;
-				constructSuper(context,t);
-				break;
+				constructSuper(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x4a:
+			INSTRUCTION(0x4a)
 			{
 				//constructprop
-				u30 t,t2;
-				code >> t;
-				code >> t2;
-				constructProp(context,t,t2);
-				break;
+				constructProp(context,instr->arg1,instr->arg2);
+				NEXT_INSTRUCTION;
 			}
-			case 0x4e:
+			INSTRUCTION(0x4e)
 			{
 				//callsupervoid
-				u30 t,t2;
-				code >> t;
-				code >> t2;
 				method_info* called_mi=NULL;
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
-				callSuper(context,t,t2,&called_mi,false);
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
+				callSuper(context,instr->arg1,instr->arg2,&called_mi,false);
 				if(called_mi)
 					PROF_ACCOUNT_TIME(mi->profCalls[called_mi],profilingCheckpoint(startTime));
 				else
 					PROF_IGNORE_TIME(profilingCheckpoint(startTime));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x4f:
+			INSTRUCTION(0x4f)
 			{
 				//callpropvoid
-				u30 t,t2;
-				code >> t;
-				code >> t2;
 				method_info* called_mi=NULL;
-				PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
-				callProperty(context,t,t2,&called_mi,false);
+				PROF_ACCOUNT_TIME(mi->profTime[instr->pos],profilingCheckpoint(startTime));
+				callProperty(context,instr->arg1,instr->arg2,&called_mi,false,&mi->propertycaches[instr->target]);
 				if(called_mi)
 					PROF_ACCOUNT_TIME(mi->profCalls[called_mi],profilingCheckpoint(startTime));
 				else
 					PROF_IGNORE_TIME(profilingCheckpoint(startTime));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x53:
+			INSTRUCTION(0x53)
 			{
 				//constructgenerictype
-				u30 t;
-				code >> t;
-				constructGenericType(context, t);
-				break;
+				constructGenericType(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x55:
+			INSTRUCTION(0x55)
 			{
 				//newobject
-				u30 t;
-				code >> t;
-				newObject(context,t);
-				break;
+				newObject(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x56:
+			INSTRUCTION(0x56)
 			{
 				//newarray
-				u30 t;
-				code >> t;
-				newArray(context,t);
-				break;
+				newArray(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x57:
+			INSTRUCTION(0x57)
 			{
 				//newactivation
 				context->runtime_stack_push(newActivation(context, mi));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x58:
+			INSTRUCTION(0x58)
 			{
 				//newclass
-				u30 t;
-				code >> t;
-				newClass(context,t);
-				break;
+				newClass(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x59:
+			INSTRUCTION(0x59)
 			{
 				//getdescendants
-				u30 t;
-				code >> t;
-				getDescendants(context, t);
-				break;
+				getDescendants(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x5a:
+			INSTRUCTION(0x5a)
 			{
 				//newcatch
-				u30 t;
-				code >> t;
-				context->runtime_stack_push(newCatch(context,t));
-				break;
+				context->runtime_stack_push(newCatch(context,instr->arg1));
+				NEXT_INSTRUCTION;
 			}
-			case 0x5d:
+			INSTRUCTION(0x5d)
 			{
 				//findpropstrict
-				u30 t;
-				code >> t;
-				context->runtime_stack_push(findPropStrict(context,context->context->getMultiname(t,context)));
-				break;
+				multiname* name=context->context->getMultiname(instr->arg1,context);
+				context->runtime_stack_push(findPropStrict(context,name));
+				NEXT_INSTRUCTION;
 			}
-			case 0x5e:
+			INSTRUCTION(0x5e)
 			{
 				//findproperty
-				u30 t;
-				code >> t;
-				context->runtime_stack_push(findProperty(context,context->context->getMultiname(t,context)));
-				break;
+				multiname* name=context->context->getMultiname(instr->arg1,context);
+				context->runtime_stack_push(findProperty(context,name));
+				NEXT_INSTRUCTION;
 			}
-			case 0x60:
+			INSTRUCTION(0x60)
 			{
 				//getlex
-				u30 t;
-				code >> t;
-				getLex(context,t);
-				break;
+				getLex(context,instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x61:
+			INSTRUCTION(0x61)
 			{
 				//setproperty
-				u30 t;
-				code >> t;
 				ASObject* value=context->runtime_stack_pop();
 
-				multiname* name=context->context->getMultiname(t,context);
+				multiname* name=context->context->getMultiname(instr->arg1,context);
 
 				ASObject* obj=context->runtime_stack_pop();
 
-				setProperty(value,obj,name);
-				break;
+				setProperty(value,obj,name,&mi->propertycaches[instr->target]);
+				NEXT_INSTRUCTION;
 			}
-			case 0x62:
+			INSTRUCTION(0x62)
 			{
 				//getlocal
-				u30 i;
-				code >> i;
+				//getlocal_n is decoded as getlocal
+				uint32_t i=instr->arg1;
 				assert_and_throw(context->locals[i]);
 				context->locals[i]->incRef();
 				LOG(LOG_CALLS, _("getLocal ") << i << _(": ") << context->locals[i]->toDebugString() );
 				context->runtime_stack_push(context->locals[i]);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x63:
+			INSTRUCTION(0x63)
 			{
 				//setlocal
-				u30 i;
-				code >> i;
+				//setlocal_n is decoded as setlocal
+				uint32_t i=instr->arg1;
 				LOG(LOG_CALLS, _("setLocal ") << i );
 				ASObject* obj=context->runtime_stack_pop();
 				assert_and_throw(obj);
 				if(context->locals[i])
 					context->locals[i]->decRef();
 				context->locals[i]=obj;
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x64:
+			INSTRUCTION(0x64)
 			{
 				//getglobalscope
 				context->runtime_stack_push(getGlobalScope(context));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x65:
+			INSTRUCTION(0x65)
 			{
 				//getscopeobject
-				u30 t;
-				code >> t;
-				context->runtime_stack_push(getScopeObject(context,t));
-				break;
+				context->runtime_stack_push(getScopeObject(context,instr->arg1));
+				NEXT_INSTRUCTION;
 			}
-			case 0x66:
+			INSTRUCTION(0x66)
 			{
 				//getproperty
-				u30 t;
-				code >> t;
-				multiname* name=context->context->getMultiname(t,context);
+				multiname* name=context->context->getMultiname(instr->arg1,context);
 
 				ASObject* obj=context->runtime_stack_pop();
 
-				ASObject* ret=getProperty(obj,name);
+				ASObject* ret=getProperty(obj,name,&mi->propertycaches[instr->target]);
 
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x68:
+			INSTRUCTION(0x68)
 			{
 				//initproperty
-				u30 t;
-				code >> t;
 				ASObject* value=context->runtime_stack_pop();
-			        multiname* name=context->context->getMultiname(t,context);
-			        ASObject* obj=context->runtime_stack_pop();
+				multiname* name=context->context->getMultiname(instr->arg1,context);
+				ASObject* obj=context->runtime_stack_pop();
 				initProperty(obj,value,name);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x6a:
+			INSTRUCTION(0x6a)
 			{
 				//deleteproperty
-				u30 t;
-				code >> t;
-				multiname* name = context->context->getMultiname(t,context);
+				multiname* name = context->context->getMultiname(instr->arg1,context);
 				ASObject* obj=context->runtime_stack_pop();
 				bool ret = deleteProperty(obj,name);
 				context->runtime_stack_push(abstract_b(ret));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x6c:
+			INSTRUCTION(0x6c)
 			{
 				//getslot
-				u30 t;
-				code >> t;
 				ASObject* obj=context->runtime_stack_pop();
-				ASObject* ret=getSlot(obj, t);
+				ASObject* ret=getSlot(obj, instr->arg1);
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x6d:
+			INSTRUCTION(0x6d)
 			{
 				//setslot
-				u30 t;
-				code >> t;
-
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				setSlot(v1, v2, t);
-				break;
+				setSlot(v1, v2, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x70:
+			INSTRUCTION(0x70)
 			{
 				//convert_s
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(convert_s(val));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x71:
+			INSTRUCTION(0x71)
 			{
 				//FIXME: Properly escape as described in ECMA-357 section 10.2
 				//esc_xelem
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(convert_s(val));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x72:
+			INSTRUCTION(0x72)
 			{
 				//FIXME: Properly escape as described in ECMA-357 section 10.2
 				//esc_xattr
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(esc_xattr(val));
-				break;
-			}case 0x73:
+				NEXT_INSTRUCTION;
+			}
+			INSTRUCTION(0x73)
 			{
 				//convert_i
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(abstract_i(convert_i(val)));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x74:
+			INSTRUCTION(0x74)
 			{
 				//convert_u
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(abstract_ui(convert_u(val)));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x75:
+			INSTRUCTION(0x75)
 			{
 				//convert_d
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(abstract_d(convert_d(val)));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x76:
+			INSTRUCTION(0x76)
 			{
 				//convert_b
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(abstract_b(convert_b(val)));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x78:
+			INSTRUCTION(0x78)
 			{
 				//checkfilter
 				ASObject* val=context->runtime_stack_pop();
 				context->runtime_stack_push(checkfilter(val));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x80:
+			INSTRUCTION(0x80)
 			{
 				//coerce
-				u30 t;
-				code >> t;
-				coerce(context, t);
-				break;
+				coerce(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x82:
+			INSTRUCTION(0x82)
 			{
 				//coerce_a
 				coerce_a();
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x85:
+			INSTRUCTION(0x85)
 			{
 				//coerce_s
 				context->runtime_stack_push(coerce_s(context->runtime_stack_pop()));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x86:
+			INSTRUCTION(0x86)
 			{
 				//astype
-				u30 t;
-				code >> t;
-				multiname* name=context->context->getMultiname(t,context);
+				multiname* name=context->context->getMultiname(instr->arg1,context);
 
 				ASObject* v1=context->runtime_stack_pop();
 
 				ASObject* ret=asType(context->context, v1, name);
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x87:
+			INSTRUCTION(0x87)
 			{
 				//astypelate
 				ASObject* v1=context->runtime_stack_pop();
@@ -1082,184 +1279,198 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 
 				ASObject* ret=asTypelate(v1, v2);
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x90:
+			INSTRUCTION(0x90)
 			{
 				//negate
 				ASObject* val=context->runtime_stack_pop();
-				ASObject* ret=abstract_d(negate(val));
+				ASObject* box=resultBox(val,T_NUMBER);
+				ASObject* ret=boxNumber(box,negate(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x91:
+			INSTRUCTION(0x91)
 			{
 				//increment
 				ASObject* val=context->runtime_stack_pop();
-				ASObject* ret=abstract_d(increment(val));
+				ASObject* box=resultBox(val,T_NUMBER);
+				ASObject* ret=boxNumber(box,increment(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x92:
+			INSTRUCTION(0x92)
 			{
 				//inclocal
-				u30 t;
-				code >> t;
-				incLocal(context, t);
-				break;
+				incLocal(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x93:
+			INSTRUCTION(0x93)
 			{
 				//decrement
 				ASObject* val=context->runtime_stack_pop();
-				ASObject* ret=abstract_d(decrement(val));
+				ASObject* box=resultBox(val,T_NUMBER);
+				ASObject* ret=boxNumber(box,decrement(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x94:
+			INSTRUCTION(0x94)
 			{
 				//declocal
-				u30 t;
-				code >> t;
-				decLocal(context, t);
-				break;
+				decLocal(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0x95:
+			INSTRUCTION(0x95)
 			{
 				//typeof
 				ASObject* val=context->runtime_stack_pop();
 				ASObject* ret=typeOf(val);
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x96:
+			INSTRUCTION(0x96)
 			{
 				//not
 				ASObject* val=context->runtime_stack_pop();
 				ASObject* ret=abstract_b(_not(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0x97:
+			INSTRUCTION(0x97)
 			{
 				//bitnot
 				ASObject* val=context->runtime_stack_pop();
-				ASObject* ret=abstract_i(bitNot(val));
+				ASObject* box=resultBox(val,T_INTEGER);
+				ASObject* ret=boxInteger(box,bitNot(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa0:
+			INSTRUCTION(0xa0)
 			{
 				//add
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
 				ASObject* ret=add(v2, v1);
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa1:
+			INSTRUCTION(0xa1)
 			{
 				//subtract
 				//Be careful, operands in subtract implementation are swapped
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
-				ASObject* ret=abstract_d(subtract(v2, v1));
+				ASObject* box=resultBox(v2,v1,T_NUMBER);
+				ASObject* ret=boxNumber(box,subtract(v2, v1));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa2:
+			INSTRUCTION(0xa2)
 			{
 				//multiply
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
-				ASObject* ret=abstract_d(multiply(v2, v1));
+				ASObject* box=resultBox(v2,v1,T_NUMBER);
+				ASObject* ret=boxNumber(box,multiply(v2, v1));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa3:
+			INSTRUCTION(0xa3)
 			{
 				//divide
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
-				ASObject* ret=abstract_d(divide(v2, v1));
+				ASObject* box=resultBox(v2,v1,T_NUMBER);
+				ASObject* ret=boxNumber(box,divide(v2, v1));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa4:
+			INSTRUCTION(0xa4)
 			{
 				//modulo
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_d(modulo(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_NUMBER);
+				ASObject* ret=boxNumber(box,modulo(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa5:
+			INSTRUCTION(0xa5)
 			{
 				//lshift
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(lShift(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_INTEGER);
+				ASObject* ret=boxInteger(box,lShift(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa6:
+			INSTRUCTION(0xa6)
 			{
 				//rshift
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(rShift(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_INTEGER);
+				ASObject* ret=boxInteger(box,rShift(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa7:
+			INSTRUCTION(0xa7)
 			{
 				//urshift
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(urShift(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_INTEGER);
+				ASObject* ret=boxInteger(box,urShift(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa8:
+			INSTRUCTION(0xa8)
 			{
 				//bitand
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(bitAnd(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_INTEGER);
+				ASObject* ret=boxInteger(box,bitAnd(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xa9:
+			INSTRUCTION(0xa9)
 			{
 				//bitor
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(bitOr(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_INTEGER);
+				ASObject* ret=boxInteger(box,bitOr(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xaa:
+			INSTRUCTION(0xaa)
 			{
 				//bitxor
 				ASObject* v1=context->runtime_stack_pop();
 				ASObject* v2=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(bitXor(v1, v2));
+				ASObject* box=resultBox(v1,v2,T_INTEGER);
+				ASObject* ret=boxInteger(box,bitXor(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xab:
+			INSTRUCTION(0xab)
 			{
 				//equals
 				ASObject* v2=context->runtime_stack_pop();
@@ -1267,9 +1478,9 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 
 				ASObject* ret=abstract_b(equals(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xac:
+			INSTRUCTION(0xac)
 			{
 				//strictequals
 				ASObject* v2=context->runtime_stack_pop();
@@ -1277,71 +1488,73 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 
 				ASObject* ret=abstract_b(strictEquals(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xad:
+			INSTRUCTION(0xad)
 			{
 				//lessthan
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
 				ASObject* ret=abstract_b(lessThan(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xae:
+			INSTRUCTION(0xae)
 			{
 				//lessequals
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
 				ASObject* ret=abstract_b(lessEquals(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xaf:
+			INSTRUCTION(0xaf)
 			{
 				//greaterthan
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
 				ASObject* ret=abstract_b(greaterThan(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xb0:
+			INSTRUCTION(0xb0)
 			{
 				//greaterequals
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
+				mi->recordOperandTypes(instr->pos,v1,v2);
 
 				ASObject* ret=abstract_b(greaterEquals(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xb1:
+			INSTRUCTION(0xb1)
 			{
 				//instanceof
 				ASObject* type=context->runtime_stack_pop();
 				ASObject* value=context->runtime_stack_pop();
 				bool ret=instanceOf(value, type);
 				context->runtime_stack_push(abstract_b(ret));
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xb2:
+			INSTRUCTION(0xb2)
 			{
 				//istype
-				u30 t;
-				code >> t;
-				multiname* name=context->context->getMultiname(t,context);
+				multiname* name=context->context->getMultiname(instr->arg1,context);
 
 				ASObject* v1=context->runtime_stack_pop();
 
 				ASObject* ret=abstract_b(isType(context->context, v1, name));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xb3:
+			INSTRUCTION(0xb3)
 			{
 				//istypelate
 				ASObject* v1=context->runtime_stack_pop();
@@ -1349,9 +1562,9 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 
 				ASObject* ret=abstract_b(isTypelate(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xb4:
+			INSTRUCTION(0xb4)
 			{
 				//in
 				ASObject* v1=context->runtime_stack_pop();
@@ -1359,145 +1572,101 @@ ASObject* ABCVm::executeFunction(const SyntheticFunction* function, call_context
 
 				ASObject* ret=abstract_b(in(v1, v2));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xc0:
+			INSTRUCTION(0xc0)
 			{
 				//increment_i
 				ASObject* val=context->runtime_stack_pop();
-				ASObject* ret=abstract_i(increment_i(val));
+				ASObject* box=resultBox(val,T_INTEGER);
+				ASObject* ret=boxInteger(box,increment_i(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xc1:
+			INSTRUCTION(0xc1)
 			{
 				//decrement_i
 				ASObject* val=context->runtime_stack_pop();
-				ASObject* ret=abstract_i(decrement_i(val));
+				ASObject* box=resultBox(val,T_INTEGER);
+				ASObject* ret=boxInteger(box,decrement_i(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xc2:
+			INSTRUCTION(0xc2)
 			{
 				//inclocal_i
-				u30 t;
-				code >> t;
-				incLocal_i(context, t);
-				break;
+				incLocal_i(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0xc3:
+			INSTRUCTION(0xc3)
 			{
 				//declocal_i
-				u30 t;
-				code >> t;
-				decLocal_i(context, t);
-				break;
+				decLocal_i(context, instr->arg1);
+				NEXT_INSTRUCTION;
 			}
-			case 0xc4:
+			INSTRUCTION(0xc4)
 			{
 				//negate_i
 				ASObject *val=context->runtime_stack_pop();
-				ASObject* ret=abstract_i(negate_i(val));
+				ASObject* box=resultBox(val,T_INTEGER);
+				ASObject* ret=boxInteger(box,negate_i(val));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xc5:
+			INSTRUCTION(0xc5)
 			{
 				//add_i
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(add_i(v2, v1));
+				ASObject* box=resultBox(v2,v1,T_INTEGER);
+				ASObject* ret=boxInteger(box,add_i(v2, v1));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xc6:
+			INSTRUCTION(0xc6)
 			{
 				//subtract_i
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(subtract_i(v2, v1));
+				ASObject* box=resultBox(v2,v1,T_INTEGER);
+				ASObject* ret=boxInteger(box,subtract_i(v2, v1));
 				context->runtime_stack_push(ret);
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xc7:
+			INSTRUCTION(0xc7)
 			{
 				//multiply_i
 				ASObject* v2=context->runtime_stack_pop();
 				ASObject* v1=context->runtime_stack_pop();
 
-				ASObject* ret=abstract_i(multiply_i(v2, v1));
+				ASObject* box=resultBox(v2,v1,T_INTEGER);
+				ASObject* ret=boxInteger(box,multiply_i(v2, v1));
 				context->runtime_stack_push(ret);
-				break;
-			}
-			case 0xd0:
-			case 0xd1:
-			case 0xd2:
-			case 0xd3:
-			{
-				//getlocal_n
-				int i=opcode&3;
-				assert_and_throw(context->locals[i]);
-				LOG(LOG_CALLS, _("getLocal ") << i << _(": ") << context->locals[i]->toDebugString() );
-				context->locals[i]->incRef();
-				context->runtime_stack_push(context->locals[i]);
-				break;
-			}
-			case 0xd4:
-			case 0xd5:
-			case 0xd6:
-			case 0xd7:
-			{
-				//setlocal_n
-				int i=opcode&3;
-				LOG(LOG_CALLS, _("setLocal ") << i );
-				ASObject* obj=context->runtime_stack_pop();
-				if(context->locals[i])
-					context->locals[i]->decRef();
-				context->locals[i]=obj;
-				break;
-			}
-			case 0xef:
-			{
-				//debug
-				LOG(LOG_CALLS, _("debug") );
-				uint8_t debug_type;
-				u30 index;
-				uint8_t reg;
-				u30 extra;
-				code.read((char*)&debug_type,1);
-				code >> index;
-				code.read((char*)&reg,1);
-				code >> extra;
-				break;
+				NEXT_INSTRUCTION;
 			}
-			case 0xf0:
+			END_OF_CODE_INSTRUCTION
 			{
-				//debugline
-				LOG(LOG_CALLS, _("debugline") );
-				u30 t;
-				code >> t;
-				break;
+				throw ParseException("End of code in interpreter");
 			}
-			case 0xf1:
+			DEFAULT_INSTRUCTION
 			{
-				//debugfile
-				LOG(LOG_CALLS, _("debugfile") );
-				u30 t;
-				code >> t;
-				break;
-			}
-			default:
-				LOG(LOG_ERROR,_("Not interpreted instruction @") << code.tellg());
-				LOG(LOG_ERROR,_("dump ") << hex << (unsigned int)opcode << dec);
+				LOG(LOG_ERROR,_("Not interpreted instruction @") << instr->pos);
+				LOG(LOG_ERROR,_("dump ") << hex << instr->opcode << dec);
 				throw ParseException("Not implemented instruction in interpreter");
+			}
+#ifndef INTERPRETER_COMPUTED_GOTO
 		}
-		PROF_ACCOUNT_TIME(mi->profTime[instructionPointer],profilingCheckpoint(startTime));
 	}
+#endif
 
-#undef PROF_ACCOUNT_TIME 
+#undef INSTRUCTION
+#undef END_OF_CODE_INSTRUCTION
+#undef DEFAULT_INSTRUCTION
+#undef DISPATCH
+#undef NEXT_INSTRUCTION
+#undef JUMP_INSTRUCTION
+#undef PROF_ACCOUNT_TIME
 #undef PROF_IGNORE_TIME
-	//We managed to execute all the function
-	return context->runtime_stack_pop();
 }
@@ -49,12 +49,12 @@ uint32_t ABCVm::bitAnd_oi(ASObject* val1, int32_t val2)
 	return i1&i2;
 }
 
-void ABCVm::setProperty(ASObject* value,ASObject* obj,multiname* name)
+void ABCVm::setProperty(ASObject* value,ASObject* obj,multiname* name,property_cache* cache)
 {
 	LOG(LOG_CALLS,_("setProperty ") << *name << ' ' << obj);
 
 	//We have to reset the level before finding a variable
-	obj->setVariableByMultiname(*name,value);
+	obj->setCachedVariableByMultiname(*name,value,cache);
 	obj->decRef();
 }
 
@@ -123,13 +123,13 @@ void ABCVm::lookupswitch()
 ASObject* ABCVm::pushUndefined()
 {
 	LOG(LOG_CALLS, _("pushUndefined") );
-	return new Undefined;
+	return getVm()->getUndefinedRef();
 }
 
 ASObject* ABCVm::pushNull()
 {
 	LOG(LOG_CALLS, _("pushNull") );
-	return new Null;
+	return getVm()->getNullRef();
 }
 
 void ABCVm::coerce_a()
@@ -280,7 +280,7 @@ uint32_t ABCVm::bitOr(ASObject* val2, ASObject* val1)
 	return i1|i2;
 }
 
-void ABCVm::callProperty(call_context* th, int n, int m, method_info** called_mi, bool keepReturn)
+void ABCVm::callProperty(call_context* th, int n, int m, method_info** called_mi, bool keepReturn, property_cache* cache)
 {
 	ASObject** args=g_newa(ASObject*, m);
 	for(int i=0;i<m;i++)
@@ -294,7 +294,7 @@ void ABCVm::callProperty(call_context* th, int n, int m, method_info** called_mi
 		LOG(LOG_CALLS,obj->classdef->class_name);
 
 	//We should skip the special implementation of get
-	_NR<ASObject> o=obj->getVariableByMultiname(*name, ASObject::SKIP_IMPL);
+	_NR<ASObject> o=obj->getCachedVariableByMultiname(*name, ASObject::SKIP_IMPL, cache);
 
 	if(!o.isNull())
 	{
@@ -309,7 +309,7 @@ void ABCVm::callProperty(call_context* th, int n, int m, method_info** called_mi
 			//Check if there is a custom caller defined, skipping implementation to avoid recursive calls
 			multiname callPropertyName;
 			callPropertyName.name_type=multiname::NAME_STRING;
-			callPropertyName.name_s="callProperty";
+			callPropertyName.setName("callProperty");
 			callPropertyName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 			_NR<ASObject> o=obj->getVariableByMultiname(callPropertyName,ASObject::SKIP_IMPL);
 
@@ -367,11 +367,11 @@ int32_t ABCVm::getProperty_i(ASObject* obj, multiname* name)
 	return ret;
 }
 
-ASObject* ABCVm::getProperty(ASObject* obj, multiname* name)
+ASObject* ABCVm::getProperty(ASObject* obj, multiname* name, property_cache* cache)
 {
 	LOG(LOG_CALLS, _("getProperty ") << *name << ' ' << obj);
 
-	_NR<ASObject> prop=obj->getVariableByMultiname(*name);
+	_NR<ASObject> prop=obj->getCachedVariableByMultiname(*name, ASObject::NONE, cache);
 	ASObject *ret;
 
 	if(prop.isNull())
@@ -388,6 +388,56 @@ ASObject* ABCVm::getProperty(ASObject* obj, multiname* name)
 	return ret;
 }
 
+/* Called by the JIT when obj is of the class the getter was inlined for */
+ASObject* ABCVm::getInlinedProperty(ASObject* obj, inlined_getter* getter)
+{
+	LOG(LOG_CALLS, _("getInlinedProperty ") << obj);
+
+	ASObject* ret;
+	if(getter->native)
+	{
+		//Like Function::call, the getter does not consume obj
+		ret=getter->native(obj,NULL,0);
+		if(ret==NULL)
+			ret=getVm()->getUndefinedRef();
+	}
+	else
+	{
+		_NR<ASObject> prop=obj->getCachedVariableByMultiname(*getter->field, ASObject::NONE, &getter->cache);
+		if(prop.isNull())
+			ret=getVm()->getUndefinedRef();
+		else
+		{
+			prop->incRef();
+			ret=prop.getPtr();
+		}
+		ret=getter->returnType->coerce(ret);
+	}
+	obj->decRef();
+	return ret;
+}
+
+/* Called by the JIT when the receiver is of the class the method was found on */
+void ABCVm::callInlined(call_context* th, inlined_call* call)
+{
+	const int m=call->argCount;
+	ASObject** args=g_newa(ASObject*, m);
+	for(int i=0;i<m;i++)
+		args[m-i-1]=th->runtime_stack_pop();
+	ASObject* obj=th->runtime_stack_pop();
+	LOG(LOG_CALLS, _("callInlined ") << m << ' ' << obj);
+
+	//The method is passed obj as this, like the bound copy that the lookup returns
+	SyntheticFunction* f=call->method;
+	f->incRef();
+	ASObject* ret=f->call(obj,args,m);
+	f->decRef();
+	if(call->keepReturn)
+		th->runtime_stack_push(ret);
+	else
+		ret->decRef();
+}
+
 number_t ABCVm::divide(ASObject* val2, ASObject* val1)
 {
 	double num1=val1->toNumber();
@@ -415,8 +465,8 @@ void ABCVm::pushScope(call_context* th)
 
 Global* ABCVm::getGlobalScope(call_context* th)
 {
-	assert_and_throw(th->scope_stack.size() > 0);
-	ASObject* ret=th->scope_stack[0].object.getPtr();
+	assert_and_throw(th->scopeDepth() > 0);
+	ASObject* ret=th->scopeAt(0).object.getPtr();
 	assert_and_throw(ret->is<Global>());
 	LOG(LOG_CALLS,_("getGlobalScope: ") << ret);
 	ret->incRef();
@@ -549,32 +599,60 @@ int32_t ABCVm::multiply_i(ASObject* val2, ASObject* val1)
 void ABCVm::incLocal(call_context* th, int n)
 {
 	LOG(LOG_CALLS, _("incLocal ") << n );
-	number_t tmp=th->locals[n]->toNumber();
-	th->locals[n]->decRef();
+	ASObject* o=th->locals[n];
+	number_t tmp=o->toNumber();
+	//Nobody else can see the box, change it in place
+	if(o->getObjectType()==T_NUMBER && o->isLastRef())
+	{
+		o->as<Number>()->val=tmp+1;
+		return;
+	}
+	o->decRef();
 	th->locals[n]=abstract_d(tmp+1);
 }
 
 void ABCVm::incLocal_i(call_context* th, int n)
 {
 	LOG(LOG_CALLS, _("incLocal_i ") << n );
-	int32_t tmp=th->locals[n]->toInt();
-	th->locals[n]->decRef();
+	ASObject* o=th->locals[n];
+	int32_t tmp=o->toInt();
+	//Nobody else can see the box, change it in place
+	if(o->getObjectType()==T_INTEGER && o->isLastRef())
+	{
+		o->as<Integer>()->val=tmp+1;
+		return;
+	}
+	o->decRef();
 	th->locals[n]=abstract_i(tmp+1);
 }
 
 void ABCVm::decLocal(call_context* th, int n)
 {
 	LOG(LOG_CALLS, _("decLocal ") << n );
-	number_t tmp=th->locals[n]->toNumber();
-	th->locals[n]->decRef();
+	ASObject* o=th->locals[n];
+	number_t tmp=o->toNumber();
+	//Nobody else can see the box, change it in place
+	if(o->getObjectType()==T_NUMBER && o->isLastRef())
+	{
+		o->as<Number>()->val=tmp-1;
+		return;
+	}
+	o->decRef();
 	th->locals[n]=abstract_d(tmp-1);
 }
 
 void ABCVm::decLocal_i(call_context* th, int n)
 {
 	LOG(LOG_CALLS, _("decLocal_i ") << n );
-	int32_t tmp=th->locals[n]->toInt();
-	th->locals[n]->decRef();
+	ASObject* o=th->locals[n];
+	int32_t tmp=o->toInt();
+	//Nobody else can see the box, change it in place
+	if(o->getObjectType()==T_INTEGER && o->isLastRef())
+	{
+		o->as<Integer>()->val=tmp-1;
+		return;
+	}
+	o->decRef();
 	th->locals[n]=abstract_i(tmp-1);
 }
 
@@ -894,6 +972,19 @@ ASObject* ABCVm::add(ASObject* val2, ASObject* val1)
 		double num1=val1->as<Number>()->val;
 		double num2=val2->as<Number>()->val;
 		LOG(LOG_CALLS,"addN " << num1 << '+' << num2);
+		//Reuse an operand only referenced by the caller for the result
+		if(val1->isLastRef())
+		{
+			val2->decRef();
+			val1->as<Number>()->val=num1+num2;
+			return val1;
+		}
+		if(val2->isLastRef())
+		{
+			val1->decRef();
+			val2->as<Number>()->val=num1+num2;
+			return val2;
+		}
 		val1->decRef();
 		val2->decRef();
 		return abstract_d(num1+num2);
@@ -1282,15 +1373,15 @@ void ABCVm::getLex(call_context* th, int n)
 {
 	multiname* name=th->context->getMultiname(n,th);
 	LOG(LOG_CALLS, _("getLex: ") << *name );
-	vector<scope_entry>::reverse_iterator it=th->scope_stack.rbegin();
 	// o will be a reference owned by this function (or NULL). At
 	// the end the reference will be handed over to the runtime
 	// stack.
 	ASObject* o = NULL;
 
 	//Find out the current 'this', when looking up over it, we have to consider all of it
-	for(;it!=th->scope_stack.rend();++it)
+	for(int i=th->scopeDepth()-1;i>=0;i--)
 	{
+		const scope_entry* it=&th->scopeAt(i);
 		// XML_STRICT flag tells getVariableByMultiname to
 		// ignore non-existing properties in XML obejcts
 		// (normally it would return an empty XMLList if the
@@ -1347,11 +1438,11 @@ ASObject* ABCVm::findProperty(call_context* th, multiname* name)
 {
 	LOG(LOG_CALLS, _("findProperty ") << *name );
 
-	vector<scope_entry>::reverse_iterator it=th->scope_stack.rbegin();
 	bool found=false;
 	ASObject* ret=NULL;
-	for(;it!=th->scope_stack.rend();++it)
+	for(int i=th->scopeDepth()-1;i>=0;i--)
 	{
+		const scope_entry* it=&th->scopeAt(i);
 		found=it->object->hasPropertyByMultiname(*name, it->considerDynamic);
 
 		if(found)
@@ -1369,7 +1460,7 @@ ASObject* ABCVm::findProperty(call_context* th, multiname* name)
 		if(o)
 			ret=target;
 		else //else push the current global object
-			ret=th->scope_stack[0].object.getPtr();
+			ret=th->scopeAt(0).object.getPtr();
 	}
 
 	//TODO: make this a regular assert
@@ -1382,12 +1473,12 @@ ASObject* ABCVm::findPropStrict(call_context* th, multiname* name)
 {
 	LOG(LOG_CALLS, _("findPropStrict ") << *name );
 
-	vector<scope_entry>::reverse_iterator it=th->scope_stack.rbegin();
 	bool found=false;
 	ASObject* ret=NULL;
 
-	for(;it!=th->scope_stack.rend();++it)
+	for(int i=th->scopeDepth()-1;i>=0;i--)
 	{
+		const scope_entry* it=&th->scopeAt(i);
 		found=it->object->hasPropertyByMultiname(*name, it->considerDynamic);
 		if(found)
 		{
@@ -1782,7 +1873,7 @@ void ABCVm::newObject(call_context* th, int n)
 	{
 		ASObject* value=th->runtime_stack_pop();
 		ASObject* name=th->runtime_stack_pop();
-		propertyName.name_s=name->toString();
+		propertyName.setName(name->toString());
 		name->decRef();
 		ret->setVariableByMultiname(propertyName, value);
 	}
@@ -1925,7 +2016,7 @@ void ABCVm::newClass(call_context* th, int n)
 
 	ret->setDeclaredMethodByQName("toString",AS3,Class<IFunction>::getFunction(Class_base::_toString),NORMAL_METHOD,false);
 
-	ret->class_scope=th->scope_stack;
+	ret->class_scope=th->fullScopeStack();
 
 	LOG(LOG_CALLS,_("Building class traits"));
 	for(unsigned int i=0;i<th->context->classes[n].trait_count;i++)
@@ -1998,7 +2089,7 @@ void ABCVm::newClass(call_context* th, int n)
 	method_info* m=&th->context->methods[th->context->classes[n].cinit];
 	SyntheticFunction* cinit=Class<IFunction>::getSyntheticFunction(m);
 	//cinit must inherit the current scope
-	cinit->acquireScope(th->scope_stack);
+	cinit->acquireScope(ret->class_scope);
 	ASObject* ret2=cinit->call(ret,NULL,0);
 	assert_and_throw(ret2->is<Undefined>());
 	ret2->decRef();
@@ -2119,7 +2210,7 @@ ASObject* ABCVm::newFunction(call_context* th, int n)
 
 	method_info* m=&th->context->methods[n];
 	SyntheticFunction* f=Class<IFunction>::getSyntheticFunction(m);
-	f->func_scope=th->scope_stack;
+	f->func_scope=th->fullScopeStack();
 
 	//Bind the function to null, as this is not a class method
 	f->bind(NullRef,-1);
@@ -2128,7 +2219,7 @@ ASObject* ABCVm::newFunction(call_context* th, int n)
 
 ASObject* ABCVm::getScopeObject(call_context* th, int n)
 {
-	ASObject* ret=th->scope_stack[n+th->initialScopeStack].object.getPtr();
+	ASObject* ret=th->scope_stack[n].object.getPtr();
 	ret->incRef();
 	LOG(LOG_CALLS, _("getScopeObject: ") << ret );
 	return ret;
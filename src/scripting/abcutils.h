@@ -53,8 +53,11 @@ struct call_context
 	ABCContext* context;
 	uint32_t locals_size;
 	uint32_t max_stack;
+	/* The scope chain captured by the function. It is shared with
+	 * the function object instead of being copied on every call */
+	const std::vector<scope_entry>* parent_scope_stack;
+	/* The scopes pushed by this call, getscopeobject indexes here */
 	std::vector<scope_entry> scope_stack;
-	int initialScopeStack;
 	method_info* mi;
 	/* This is the function's inClass that is currently executing. It is used
 	 * by {construct,call,get,set}Super
@@ -65,6 +68,25 @@ struct call_context
 	 */
 	tiny_string defaultNamespaceUri;
 	~call_context();
+	uint32_t scopeDepth() const
+	{
+		return parent_scope_stack->size()+scope_stack.size();
+	}
+	/* Index 0 is the outermost scope, like for a flat scope stack */
+	const scope_entry& scopeAt(uint32_t i) const
+	{
+		uint32_t parentSize=parent_scope_stack->size();
+		return (i<parentSize)?(*parent_scope_stack)[i]:scope_stack[i-parentSize];
+	}
+	/* Builds the flat scope chain to be captured by new functions and classes */
+	std::vector<scope_entry> fullScopeStack() const
+	{
+		std::vector<scope_entry> ret;
+		ret.reserve(scopeDepth());
+		ret.insert(ret.end(),parent_scope_stack->begin(),parent_scope_stack->end());
+		ret.insert(ret.end(),scope_stack.begin(),scope_stack.end());
+		return ret;
+	}
 	void runtime_stack_clear();
 	void runtime_stack_push(ASObject* s)
 	{
@@ -31,6 +31,7 @@
 #include "backends/rendering.h"
 #include "backends/geometry.h"
 #include "backends/image.h"
+#include "backends/swfcache.h"
 #include "compat.h"
 #include "flash/accessibility/flashaccessibility.h"
 #include "argconv.h"
@@ -313,10 +314,12 @@ ASFUNCTIONBODY(Loader,loadBytes)
 	assert_and_throw(argslen>=1);
 	assert_and_throw(args[0]->getClass() && 
 			args[0]->getClass()->isSubClass(Class<ByteArray>::getClass()));
-	args[0]->incRef();
-	th->bytes=_MR(static_cast<ByteArray*>(args[0]));
-	if(th->bytes->bytes)
+	ByteArray* source=static_cast<ByteArray*>(args[0]);
+	if(source->bytes && source->len)
 	{
+		//The data is parsed in another thread, give it a view that the script can't change
+		th->bytes=_MR(Class<ByteArray>::getInstanceS());
+		th->bytes->shareBuffer(source,0,source->len);
 		th->loading=true;
 		th->source=BYTES;
 		//To be decreffed in jobFence
@@ -1425,10 +1428,13 @@ bool DisplayObject::skipRender(bool maskEnabled) const
 
 void DisplayObject::defaultRender(RenderContext& ctxt, bool maskEnabled) const
 {
-	/* cachedSurface is only modified from within the render thread
+	/* cachedSurface.tex is only modified from within the render thread
 	 * so we need no locking here */
 	if(!cachedSurface.tex.isValid())
 		return;
+	int32_t xOffset,yOffset;
+	float surfaceAlpha;
+	cachedSurface.getPlacement(xOffset,yOffset,surfaceAlpha);
 
 	float enableMaskLookup=0.0f;
 	//If the maskEnabled is already set we are the mask!
@@ -1442,8 +1448,8 @@ void DisplayObject::defaultRender(RenderContext& ctxt, bool maskEnabled) const
 	ctxt.setMatrixUniform(LSGL_MODELVIEW);
 	glUniform1f(ctxt.maskUniform, enableMaskLookup);
 	glUniform1f(ctxt.yuvUniform, 0);
-	glUniform1f(ctxt.alphaUniform, cachedSurface.alpha);
-	ctxt.renderTextured(cachedSurface.tex, cachedSurface.xOffset, cachedSurface.yOffset, cachedSurface.tex.width, cachedSurface.tex.height);
+	glUniform1f(ctxt.alphaUniform, surfaceAlpha);
+	ctxt.renderTextured(cachedSurface.tex, xOffset, yOffset, cachedSurface.tex.width, cachedSurface.tex.height);
 	ctxt.lsglPopMatrix();
 	ctxt.setMatrixUniform(LSGL_MODELVIEW);
 }
@@ -2064,7 +2070,7 @@ void DisplayObjectContainer::deleteLegacyChildAt(uint32_t depth)
 	{
 		multiname objName;
 		objName.name_type=multiname::NAME_STRING;
-		objName.name_s=obj->name;
+		objName.setName(obj->name);
 		objName.ns.push_back(nsNameAndKind("",NAMESPACE));
 		deleteVariableByMultiname(objName);
 	}
@@ -2088,7 +2094,7 @@ void DisplayObjectContainer::insertLegacyChildAt(uint32_t depth, DisplayObject*
 		obj->incRef();
 		multiname objName;
 		objName.name_type=multiname::NAME_STRING;
-		objName.name_s=obj->name;
+		objName.setName(obj->name);
 		objName.ns.push_back(nsNameAndKind("",NAMESPACE));
 		// If this function is called by PlaceObject tag
 		// before the properties are initialized, we need to
@@ -2895,9 +2901,20 @@ ASFUNCTIONBODY(Stage,_setScaleMode)
 	return NULL;
 }
 
+TokenList::Writer TokenContainer::getTokensForWrite()
+{
+	if(tokens->isShared())
+	{
+		TokenList* copy=new TokenList;
+		copy->tokens=tokens->tokens;
+		tokens=_MR(copy);
+	}
+	return TokenList::Writer(tokens.getPtr());
+}
+
 void TokenContainer::requestInvalidation()
 {
-	if(tokens.empty())
+	if(tokens->tokens.empty())
 		return;
 	owner->incRef();
 	getSys()->addToInvalidateQueue(_MR(owner));
@@ -2917,21 +2934,24 @@ void TokenContainer::invalidate()
 	owner->computeDeviceBoundsForRect(bxmin,bxmax,bymin,bymax,x,y,width,height);
 	if(width==0 || height==0)
 		return;
+	MATRIX matrix=owner->getConcatenatedMatrix();
+	float alpha=owner->getConcatenatedAlpha();
+	//Moving the object or changing its alpha does not need a new rasterization
+	if(owner->cachedSurface.reuseRaster(tokens.getPtr(), matrix, scaling, alpha))
+		return;
 	CairoRenderer* r=new CairoTokenRenderer(owner, owner->cachedSurface, tokens,
-				owner->getConcatenatedMatrix(), x, y, width, height, scaling,
-				owner->getConcatenatedAlpha());
+				matrix, x, y, width, height, scaling, alpha);
 	getSys()->addJob(r);
 }
 
 bool TokenContainer::isOpaqueImpl(number_t x, number_t y) const
 {
-	return CairoTokenRenderer::isOpaque(tokens, scaling, x, y);
+	return tokens->isOpaque(scaling, x, y);
 }
 
 _NR<InteractiveObject> TokenContainer::hitTestImpl(_NR<InteractiveObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const
 {
-	//TODO: test against the CachedSurface
-	if(CairoTokenRenderer::hitTest(tokens, scaling, x, y))
+	if(tokens->hitTest(scaling, x, y))
 	{
 		if(getSys()->getInputThread()->isMaskPresent())
 		{
@@ -2947,76 +2967,21 @@ _NR<InteractiveObject> TokenContainer::hitTestImpl(_NR<InteractiveObject> last,
 
 bool TokenContainer::boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const
 {
-
-	#define VECTOR_BOUNDS(v) \
-		xmin=dmin(v.x-strokeWidth,xmin); \
-		xmax=dmax(v.x+strokeWidth,xmax); \
-		ymin=dmin(v.y-strokeWidth,ymin); \
-		ymax=dmax(v.y+strokeWidth,ymax);
-
-	if(tokens.size()==0)
+	if(!tokens->getBounds(xmin,xmax,ymin,ymax))
 		return false;
 
-	xmin = numeric_limits<double>::infinity();
-	ymin = numeric_limits<double>::infinity();
-	xmax = -numeric_limits<double>::infinity();
-	ymax = -numeric_limits<double>::infinity();
-
-	bool hasContent = false;
-	double strokeWidth = 0;
-
-	for(unsigned int i=0;i<tokens.size();i++)
-	{
-		switch(tokens[i].type)
-		{
-			case CURVE_CUBIC:
-			{
-				VECTOR_BOUNDS(tokens[i].p3);
-				// fall through
-			}
-			case CURVE_QUADRATIC:
-			{
-				VECTOR_BOUNDS(tokens[i].p2);
-				// fall through
-			}
-			case STRAIGHT:
-			{
-				hasContent = true;
-				// fall through
-			}
-			case MOVE:
-			{
-				VECTOR_BOUNDS(tokens[i].p1);
-				break;
-			}
-			case CLEAR_FILL:
-			case CLEAR_STROKE:
-			case SET_FILL:
-			case FILL_KEEP_SOURCE:
-			case FILL_TRANSFORM_TEXTURE:
-				break;
-			case SET_STROKE:
-				strokeWidth = (double)(tokens[i].lineStyle.Width / 20.0);
-				break;
-		}
-	}
-	if(hasContent)
-	{
-		/* scale the bounding box coordinates and round them to a bigger integer box */
-		#define roundDown(x) \
-			copysign(floor(abs(x)), x)
-		#define roundUp(x) \
-			copysign(ceil(abs(x)), x)
-		xmin = roundDown(xmin*scaling);
-		xmax = roundUp(xmax*scaling);
-		ymin = roundDown(ymin*scaling);
-		ymax = roundUp(ymax*scaling);
-		#undef roundDown
-		#undef roundUp
-	}
-	return hasContent;
-
-#undef VECTOR_BOUNDS
+	/* scale the bounding box coordinates and round them to a bigger integer box */
+	#define roundDown(x) \
+		copysign(floor(abs(x)), x)
+	#define roundUp(x) \
+		copysign(ceil(abs(x)), x)
+	xmin = roundDown(xmin*scaling);
+	xmax = roundUp(xmax*scaling);
+	ymin = roundDown(ymin*scaling);
+	ymax = roundUp(ymax*scaling);
+	#undef roundDown
+	#undef roundUp
+	return true;
 }
 
 /* Find the size of the active texture (bitmap set by the latest SET_FILL). */
@@ -3025,12 +2990,13 @@ void TokenContainer::getTextureSize(int *width, int *height) const
 	*width=0;
 	*height=0;
 
-	unsigned int len=tokens.size();
+	const std::vector<GeomToken>& t=tokens->tokens;
+	unsigned int len=t.size();
 	for(unsigned int i=0;i<len;i++)
 	{
-		const FILLSTYLE& style=tokens[len-i-1].fillStyle;
+		const FILLSTYLE& style=t[len-i-1].fillStyle;
 		const FILL_STYLE_TYPE& fstype=style.FillStyleType;
-		if(tokens[len-i-1].type==SET_FILL && 
+		if(t[len-i-1].type==SET_FILL && 
 		   (fstype==REPEATING_BITMAP ||
 		    fstype==NON_SMOOTHED_REPEATING_BITMAP ||
 		    fstype==CLIPPED_BITMAP ||
@@ -3076,7 +3042,7 @@ ASFUNCTIONBODY(Graphics,clear)
 {
 	Graphics* th=static_cast<Graphics*>(obj);
 	th->checkAndSetScaling();
-	th->owner->tokens.clear();
+	th->owner->clearTokens();
 	th->owner->owner->requestInvalidation();
 	return NULL;
 }
@@ -3090,7 +3056,7 @@ ASFUNCTIONBODY(Graphics,moveTo)
 	th->curX=args[0]->toInt();
 	th->curY=args[1]->toInt();
 
-	th->owner->tokens.emplace_back(GeomToken(MOVE, Vector2(th->curX, th->curY)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(MOVE, Vector2(th->curX, th->curY)));
 	return NULL;
 }
 
@@ -3103,7 +3069,7 @@ ASFUNCTIONBODY(Graphics,lineTo)
 	int x=args[0]->toInt();
 	int y=args[1]->toInt();
 
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, Vector2(x, y)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, Vector2(x, y)));
 	th->owner->owner->requestInvalidation();
 
 	th->curX=x;
@@ -3123,7 +3089,7 @@ ASFUNCTIONBODY(Graphics,curveTo)
 	int anchorX=args[2]->toInt();
 	int anchorY=args[3]->toInt();
 
-	th->owner->tokens.emplace_back(GeomToken(CURVE_QUADRATIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_QUADRATIC,
 	                        Vector2(controlX, controlY),
 	                        Vector2(anchorX, anchorY)));
 	th->owner->owner->requestInvalidation();
@@ -3148,7 +3114,7 @@ ASFUNCTIONBODY(Graphics,cubicCurveTo)
 	int anchorX=args[4]->toInt();
 	int anchorY=args[5]->toInt();
 
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(control1X, control1Y),
 	                        Vector2(control2X, control2Y),
 	                        Vector2(anchorX, anchorY)));
@@ -3205,43 +3171,43 @@ ASFUNCTIONBODY(Graphics,drawRoundRect)
 	 */
 
 	// D
-	th->owner->tokens.emplace_back(GeomToken(MOVE, Vector2(x+width, y+height-ellipseHeight)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(MOVE, Vector2(x+width, y+height-ellipseHeight)));
 
 	// D -> E
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x+width, y+height-ellipseHeight+kappaH),
 	                        Vector2(x+width-ellipseWidth+kappaW, y+height),
 	                        Vector2(x+width-ellipseWidth, y+height)));
 
 	// E -> F
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, Vector2(x+ellipseWidth, y+height)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, Vector2(x+ellipseWidth, y+height)));
 
 	// F -> G
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x+ellipseWidth-kappaW, y+height),
 	                        Vector2(x, y+height-kappaH),
 	                        Vector2(x, y+height-ellipseHeight)));
 
 	// G -> H
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, Vector2(x, y+ellipseHeight)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, Vector2(x, y+ellipseHeight)));
 
 	// H -> A
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x, y+ellipseHeight-kappaH),
 	                        Vector2(x+ellipseWidth-kappaW, y),
 	                        Vector2(x+ellipseWidth, y)));
 
 	// A -> B
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, Vector2(x+width-ellipseWidth, y)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, Vector2(x+width-ellipseWidth, y)));
 
 	// B -> C
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x+width-ellipseWidth+kappaW, y),
 	                        Vector2(x+width, y+kappaH),
 	                        Vector2(x+width, y+ellipseHeight)));
 
 	// C -> D
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, Vector2(x+width, y+height-ellipseHeight)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, Vector2(x+width, y+height-ellipseHeight)));
 
 	th->owner->owner->requestInvalidation();
 	
@@ -3261,28 +3227,28 @@ ASFUNCTIONBODY(Graphics,drawCircle)
 	double kappa = KAPPA*radius;
 
 	// right
-	th->owner->tokens.emplace_back(GeomToken(MOVE, Vector2(x+radius, y)));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(MOVE, Vector2(x+radius, y)));
 
 	// bottom
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x+radius, y+kappa ),
 	                        Vector2(x+kappa , y+radius),
 	                        Vector2(x       , y+radius)));
 
 	// left
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x-kappa , y+radius),
 	                        Vector2(x-radius, y+kappa ),
 	                        Vector2(x-radius, y       )));
 
 	// top
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x-radius, y-kappa ),
 	                        Vector2(x-kappa , y-radius),
 	                        Vector2(x       , y-radius)));
 
 	// back to right
-	th->owner->tokens.emplace_back(GeomToken(CURVE_CUBIC,
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(CURVE_CUBIC,
 	                        Vector2(x+kappa , y-radius),
 	                        Vector2(x+radius, y-kappa ),
 	                        Vector2(x+radius, y       )));
@@ -3308,11 +3274,11 @@ ASFUNCTIONBODY(Graphics,drawRect)
 	const Vector2 c(x+width,y+height);
 	const Vector2 d(x,y+height);
 
-	th->owner->tokens.emplace_back(GeomToken(MOVE, a));
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, b));
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, c));
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, d));
-	th->owner->tokens.emplace_back(GeomToken(STRAIGHT, a));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(MOVE, a));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, b));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, c));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, d));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, a));
 	th->owner->owner->requestInvalidation();
 	
 	return NULL;
@@ -3411,7 +3377,7 @@ ASFUNCTIONBODY(Graphics,drawTriangles)
 
 	// According to testing, drawTriangles first fills the current
 	// path and creates a new path, but keeps the source.
-	th->owner->tokens.emplace_back(FILL_KEEP_SOURCE);
+	th->owner->getTokensForWrite()->emplace_back(FILL_KEEP_SOURCE);
 
 	if (has_uvt && (texturewidth==0 || textureheight==0))
 		return NULL;
@@ -3426,15 +3392,15 @@ ASFUNCTIONBODY(Graphics,drawTriangles)
 			if (indices.isNull())
 				vertex=3*i+j;
 			else
-				vertex=indices->at(3*i+j)->toInt();
+				vertex=indices->atInt(3*i+j);
 
-			x[j]=vertices->at(2*vertex)->toNumber();
-			y[j]=vertices->at(2*vertex+1)->toNumber();
+			x[j]=vertices->atNumber(2*vertex);
+			y[j]=vertices->atNumber(2*vertex+1);
 
 			if (has_uvt)
 			{
-				u[j]=uvtData->at(vertex*uvtElemSize)->toNumber()*texturewidth;
-				v[j]=uvtData->at(vertex*uvtElemSize+1)->toNumber()*textureheight;
+				u[j]=uvtData->atNumber(vertex*uvtElemSize)*texturewidth;
+				v[j]=uvtData->atNumber(vertex*uvtElemSize+1)*textureheight;
 			}
 		}
 		
@@ -3442,10 +3408,10 @@ ASFUNCTIONBODY(Graphics,drawTriangles)
 		Vector2 b(x[1], y[1]);
 		Vector2 c(x[2], y[2]);
 
-		th->owner->tokens.emplace_back(GeomToken(MOVE, a));
-		th->owner->tokens.emplace_back(GeomToken(STRAIGHT, b));
-		th->owner->tokens.emplace_back(GeomToken(STRAIGHT, c));
-		th->owner->tokens.emplace_back(GeomToken(STRAIGHT, a));
+		th->owner->getTokensForWrite()->emplace_back(GeomToken(MOVE, a));
+		th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, b));
+		th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, c));
+		th->owner->getTokensForWrite()->emplace_back(GeomToken(STRAIGHT, a));
 
 		if (has_uvt)
 		{
@@ -3467,7 +3433,7 @@ ASFUNCTIONBODY(Graphics,drawTriangles)
 					       v[0], v[1], v[2], &t[3]);
 
 			MATRIX m(t[1], t[5], t[4], t[2], t[0], t[3]);
-			th->owner->tokens.emplace_back(GeomToken(FILL_TRANSFORM_TEXTURE, m));
+			th->owner->getTokensForWrite()->emplace_back(GeomToken(FILL_TRANSFORM_TEXTURE, m));
 		}
 	}
 	
@@ -3483,7 +3449,7 @@ ASFUNCTIONBODY(Graphics,lineStyle)
 
 	if (argslen == 0)
 	{
-		th->owner->tokens.emplace_back(CLEAR_STROKE);
+		th->owner->getTokensForWrite()->emplace_back(CLEAR_STROKE);
 		return NULL;
 	}
 	uint32_t color = 0;
@@ -3499,7 +3465,7 @@ ASFUNCTIONBODY(Graphics,lineStyle)
 	LINESTYLE2 style(-1);
 	style.Color = RGBA(color, alpha);
 	style.Width = thickness;
-	th->owner->tokens.emplace_back(GeomToken(SET_STROKE, style));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(SET_STROKE, style));
 	return NULL;
 }
 
@@ -3587,7 +3553,7 @@ ASFUNCTIONBODY(Graphics,beginGradientFill)
 	}
 
 	style.Gradient = grad;
-	th->owner->tokens.emplace_back(GeomToken(SET_FILL, style));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(SET_FILL, style));
 	return NULL;
 }
 
@@ -3618,7 +3584,7 @@ ASFUNCTIONBODY(Graphics,beginBitmapFill)
 
 	//TODO: style.bitmap should be a reference
 	style.bitmap = bitmap.getPtr();
-	th->owner->tokens.emplace_back(GeomToken(SET_FILL, style));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(SET_FILL, style));
 	return NULL;
 }
 
@@ -3635,7 +3601,7 @@ ASFUNCTIONBODY(Graphics,beginFill)
 	FILLSTYLE style(-1);
 	style.FillStyleType = SOLID_FILL;
 	style.Color         = RGBA(color, alpha);
-	th->owner->tokens.emplace_back(GeomToken(SET_FILL, style));
+	th->owner->getTokensForWrite()->emplace_back(GeomToken(SET_FILL, style));
 	return NULL;
 }
 
@@ -3643,7 +3609,7 @@ ASFUNCTIONBODY(Graphics,endFill)
 {
 	Graphics* th=static_cast<Graphics*>(obj);
 	th->checkAndSetScaling();
-	th->owner->tokens.emplace_back(CLEAR_FILL);
+	th->owner->getTokensForWrite()->emplace_back(CLEAR_FILL);
 	return NULL;
 }
 
@@ -3780,14 +3746,28 @@ ASFUNCTIONBODY(BitmapData,draw)
 
 void BitmapData::copyFrom(BitmapData *source)
 {
-	if(data)
-		delete[] data;
-	dataSize = source->dataSize;
-	data = new uint8_t[dataSize];
-	memcpy(data, source->data, dataSize);
+	//The pixels are copied lazily, on the first write to either bitmap
+	if(source->buffer)
+		source->buffer->incRef();
+	setBuffer(source->buffer);
 	width = source->width;
 	height = source->height;
-	stride = source->stride;
+}
+
+void BitmapData::setBuffer(BitmapBuffer* b)
+{
+	if(buffer)
+		buffer->decRef();
+	buffer=b;
+}
+
+uint8_t* BitmapData::getDataForWrite()
+{
+	if(buffer==NULL)
+		return NULL;
+	if(buffer->isShared())
+		setBuffer(buffer->clone());
+	return buffer->getData();
 }
 
 uint32_t BitmapData::getPixelPriv(uint32_t x, uint32_t y)
@@ -3795,7 +3775,7 @@ uint32_t BitmapData::getPixelPriv(uint32_t x, uint32_t y)
 	if ((int)x >= width || (int)y >= height)
 		return 0;
 
-	uint32_t *p=reinterpret_cast<uint32_t *>(&data[y*stride + 4*x]);
+	uint32_t *p=reinterpret_cast<uint32_t *>(&buffer->getData()[y*buffer->getStride() + 4*x]);
 
 	return *p;
 }
@@ -3827,7 +3807,8 @@ void BitmapData::setPixelPriv(uint32_t x, uint32_t y, uint32_t color, bool setAl
 	if ((int)x >= width || (int)y >= height)
 		return;
 
-	uint32_t *p=reinterpret_cast<uint32_t *>(&data[y*stride + 4*x]);
+	uint8_t* data=getDataForWrite();
+	uint32_t *p=reinterpret_cast<uint32_t *>(&data[y*buffer->getStride() + 4*x]);
 	if(setAlpha)
 		*p=color;
 	else
@@ -3891,13 +3872,17 @@ ASFUNCTIONBODY(BitmapData,fillRect)
 		rectW = th->width;
 	if(rectH > th->height)
 		rectH = th->height;
+	if(rectW<=0 || rectH<=0)
+		return NULL;
 
+	uint8_t* data=th->getDataForWrite();
+	size_t stride=th->getStride();
 	for(int32_t i=0;i<rectH;i++)
 	{
 		for(int32_t j=0;j<rectW;j++)
 		{
-			uint32_t offset=(i+rectY)*th->stride + (j+rectX)*4;
-			uint32_t* ptr=(uint32_t*)(th->data+offset);
+			uint32_t offset=(i+rectY)*stride + (j+rectX)*4;
+			uint32_t* ptr=(uint32_t*)(data+offset);
 			*ptr=color;
 		}
 	}
@@ -3942,10 +3927,15 @@ ASFUNCTIONBODY(BitmapData,copyPixels)
 	if(copyWidth<=0 || copyHeight<=0)
 		return NULL;
 
+	//Unshare the destination first, as it may share its pixels with source
+	uint8_t* destData=th->getDataForWrite();
+	size_t destStride=th->getStride();
+	const uint8_t* srcData=source->getData();
+	size_t srcStride=source->getStride();
 	for(int i=0; i<copyHeight; i++)
 	{
-		memmove(th->data + (destTop+i)*th->stride + 4*destLeft, 
-			source->data + (srcTop+i)*source->stride + 4*srcLeft,
+		memmove(destData + (destTop+i)*destStride + 4*destLeft, 
+			srcData + (srcTop+i)*srcStride + 4*srcLeft,
 			4*copyWidth);
 	}
 
@@ -3991,10 +3981,17 @@ Bitmap::Bitmap(_R<BitmapData> data) : TokenContainer(this)
 	Bitmap::updatedData();
 }
 
+BitmapData::BitmapData(const BitmapData& other):ASObject(other),IBitmapDrawable(other),
+	buffer(other.buffer),width(other.width),height(other.height),transparent(other.transparent)
+{
+	if(buffer)
+		buffer->incRef();
+}
+
 BitmapData::~BitmapData()
 {
-	if(data)
-		delete[] data;
+	if(buffer)
+		buffer->decRef();
 }
 
 void Bitmap::sinit(Class_base* c)
@@ -4037,7 +4034,7 @@ ASFUNCTIONBODY_GETTER_SETTER_CB(Bitmap,bitmapData,onBitmapData);
 
 void Bitmap::updatedData()
 {
-	tokens.clear();
+	clearTokens();
 
 	if(bitmapData.isNull())
 		return;
@@ -4045,12 +4042,15 @@ void Bitmap::updatedData()
 	FILLSTYLE style(-1);
 	style.FillStyleType=CLIPPED_BITMAP;
 	style.bitmap=bitmapData.getPtr();
-	tokens.emplace_back(GeomToken(SET_FILL, style));
-	tokens.emplace_back(GeomToken(MOVE, Vector2(0, 0)));
-	tokens.emplace_back(GeomToken(STRAIGHT, Vector2(0, bitmapData->height)));
-	tokens.emplace_back(GeomToken(STRAIGHT, Vector2(bitmapData->width, bitmapData->height)));
-	tokens.emplace_back(GeomToken(STRAIGHT, Vector2(bitmapData->width, 0)));
-	tokens.emplace_back(GeomToken(STRAIGHT, Vector2(0, 0)));
+	{
+		TokenList::Writer t=getTokensForWrite();
+		t->emplace_back(GeomToken(SET_FILL, style));
+		t->emplace_back(GeomToken(MOVE, Vector2(0, 0)));
+		t->emplace_back(GeomToken(STRAIGHT, Vector2(0, bitmapData->height)));
+		t->emplace_back(GeomToken(STRAIGHT, Vector2(bitmapData->width, bitmapData->height)));
+		t->emplace_back(GeomToken(STRAIGHT, Vector2(bitmapData->width, 0)));
+		t->emplace_back(GeomToken(STRAIGHT, Vector2(0, 0)));
+	}
 	requestInvalidation();
 }
 bool Bitmap::boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const
@@ -4078,23 +4078,15 @@ bool BitmapData::fromRGB(uint8_t* rgb, uint32_t w, uint32_t h, bool hasAlpha)
 
 	width = w;
 	height = h;
-	if(hasAlpha)
-		data = CairoRenderer::convertBitmapWithAlphaToCairo(rgb, width, height, &dataSize, &stride);
-	else
-		data = CairoRenderer::convertBitmapToCairo(rgb, width, height, &dataSize, &stride);
-	delete[] rgb;
-	if(!data)
-	{
-		LOG(LOG_ERROR, "Error decoding image");
-		return false;
-	}
-
-	return true;
+	BitmapBuffer* b=new BitmapBuffer(w, h);
+	bool ret=b->fromRGB(rgb, hasAlpha);
+	setBuffer(b);
+	return ret;
 }
 
 bool BitmapData::fromJPEG(uint8_t *inData, int len)
 {
-	assert(!data);
+	assert(!buffer);
 	/* flash uses signed values for width and height */
 	uint32_t w,h;
 	uint8_t *rgb=ImageDecoder::decodeJPEG(inData, len, &w, &h);
@@ -4104,7 +4096,7 @@ bool BitmapData::fromJPEG(uint8_t *inData, int len)
 
 bool BitmapData::fromJPEG(std::istream &s)
 {
-	assert(!data);
+	assert(!buffer);
 	/* flash uses signed values for width and height */
 	uint32_t w,h;
 	uint8_t *rgb=ImageDecoder::decodeJPEG(s, &w, &h);
@@ -4112,6 +4104,101 @@ bool BitmapData::fromJPEG(std::istream &s)
 	return fromRGB(rgb, (int32_t)w, (int32_t)h, false);
 }
 
+BitmapBuffer::BitmapBuffer(int32_t w, int32_t h, bool encoded):ref_count(1),decoded(!encoded),
+	data(NULL),stride(0),dataSize(0),width(w),height(h)
+{
+}
+
+BitmapBuffer::~BitmapBuffer()
+{
+	delete[] data;
+}
+
+bool BitmapBuffer::fromRGB(uint8_t* rgb, bool hasAlpha)
+{
+	assert(data==NULL);
+	if(!rgb)
+		return false;
+
+	if(hasAlpha)
+		data = CairoRenderer::convertBitmapWithAlphaToCairo(rgb, width, height, &dataSize, &stride);
+	else
+		data = CairoRenderer::convertBitmapToCairo(rgb, width, height, &dataSize, &stride);
+	delete[] rgb;
+	if(!data)
+	{
+		LOG(LOG_ERROR, "Error decoding image");
+		return false;
+	}
+
+	return true;
+}
+
+bool BitmapBuffer::fromCache(const std::string& key)
+{
+	assert(data==NULL);
+	int32_t w,h;
+	uint8_t* cached=SWFCache::loadBitmap(key, w, h, stride, dataSize);
+	if(cached && (w!=width || h!=height))
+	{
+		delete[] cached;
+		cached=NULL;
+	}
+	data=cached;
+	return data!=NULL;
+}
+
+void BitmapBuffer::toCache(const std::string& key) const
+{
+	if(data)
+		SWFCache::storeBitmap(key, data, width, height, stride, dataSize);
+}
+
+uint8_t* BitmapBuffer::getData()
+{
+	if(ACQUIRE_READ(decoded))
+		return data;
+
+	Locker l(mutex);
+	if(!ACQUIRE_READ(decoded))
+	{
+		try
+		{
+			decode();
+		}
+		catch(std::exception& e)
+		{
+			LOG(LOG_ERROR, "Exception while decoding bitmap: " << e.what());
+			delete[] data;
+			data=NULL;
+		}
+		if(data==NULL && width>0 && height>0)
+		{
+			//Broken images are drawn transparent
+			stride=cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+			dataSize=stride*height;
+			data=new uint8_t[dataSize];
+			memset(data, 0, dataSize);
+		}
+		RELEASE_WRITE(decoded, true);
+	}
+	return data;
+}
+
+BitmapBuffer* BitmapBuffer::clone()
+{
+	BitmapBuffer* ret=new BitmapBuffer(width, height);
+	uint8_t* src=getData();
+	if(src)
+	{
+		ret->stride=stride;
+		ret->dataSize=dataSize;
+		ret->data=new uint8_t[dataSize];
+		memcpy(ret->data, src, dataSize);
+	}
+	return ret;
+}
+
 void SimpleButton::sinit(Class_base* c)
 {
 	c->setConstructor(Class<IFunction>::getFunction(_constructor));
@@ -93,7 +93,7 @@ protected:
 	bool skipRender(bool maskEnabled) const;
 	float clippedAlpha() const;
 	bool visible;
-	/* cachedSurface may only be read/written from within the render thread */
+	/* cachedSurface.tex may only be read/written from within the render thread */
 	CachedSurface cachedSurface;
 
 	void defaultRender(RenderContext& ctxt, bool maskEnabled) const;
@@ -336,22 +336,26 @@ public:
 	 * to 1.0f.
 	 */
 	float scaling;
-	std::vector<GeomToken> tokens;
+	/* Shared with the render jobs and with the other instances of the same tag */
+	_R<TokenList> tokens;
 	static void FromShaperecordListToShapeVector(const std::vector<SHAPERECORD>& shapeRecords,
 					 std::vector<GeomToken>& tokens, const std::list<FILLSTYLE>& fillStyles,
 					 const Vector2& offset = Vector2(), int scaling = 1);
 	void getTextureSize(int *width, int *height) const;
 protected:
-	TokenContainer(DisplayObject* _o) : owner(_o), scaling(1.0f) {}
-	TokenContainer(DisplayObject* _o, const std::vector<GeomToken>& _tokens, float _scaling)
+	TokenContainer(DisplayObject* _o) : owner(_o), scaling(1.0f), tokens(_MR(new TokenList)) {}
+	TokenContainer(DisplayObject* _o, _R<TokenList> _tokens, float _scaling)
 		: owner(_o), scaling(_scaling), tokens(_tokens) {}
+	/* Unshares the tokens before they are modified, the cached bounds are dropped after the write */
+	TokenList::Writer getTokensForWrite();
+	void clearTokens() { tokens=_MR(new TokenList); }
 
 	void invalidate();
 	void requestInvalidation();
 	bool boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const;
 	_NR<InteractiveObject> hitTestImpl(_NR<InteractiveObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const;
 	void renderImpl(RenderContext& ctxt, bool maskEnabled, number_t t1, number_t t2, number_t t3, number_t t4) const;
-	bool tokensEmpty() const { return tokens.empty(); }
+	bool tokensEmpty() const { return tokens->tokens.empty(); }
 	bool isOpaqueImpl(number_t x, number_t y) const;
 };
 
@@ -367,7 +371,7 @@ private:
 		if(owner->scaling != 1.0f)
 		{
 			owner->scaling = 1.0f;
-			owner->tokens.clear();
+			owner->clearTokens();
 			assert(curX == 0 && curY == 0);
 		}
 	}
@@ -415,7 +419,7 @@ protected:
 		{ return TokenContainer::hitTestImpl(last,x,y, type); }
 public:
 	Shape():TokenContainer(this), graphics() {}
-	Shape(const std::vector<GeomToken>& tokens, float scaling)
+	Shape(_R<TokenList> tokens, float scaling)
 		: TokenContainer(this, tokens, scaling), graphics() {}
 	void finalize();
 	static void sinit(Class_base* c);
@@ -501,6 +505,7 @@ private:
 	void execute();
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 public:
 	Loader():content(NullRef),loading(false),loaded(false),bytes(NullRef),contentLoaderInfo(NullRef),downloader(NULL)
 	{
@@ -765,25 +770,71 @@ public:
 	IntSize(uint32_t w, uint32_t h):width(h),height(h){}
 };
 
-class BitmapData: public ASObject, public IBitmapDrawable
+/*
+ * The pixels of a BitmapData in premultiplied, native-endian 32 bit
+ * ARGB format. stride is the number of bytes per row, may be larger
+ * than width. dataSize is the total allocated size of data
+ * (=stride*height). Buffers are shared by all the BitmapData objects
+ * created from the same source and are copied before being modified
+ * while shared. An encoded buffer keeps only the compressed image and
+ * calls decode() on the first access to the pixels
+ */
+class BitmapBuffer
 {
-CLASSBUILDABLE(BitmapData);
+private:
+	ATOMIC_INT32(ref_count);
+	Mutex mutex;
+	ACQUIRE_RELEASE_FLAG(decoded);
 protected:
+	uint8_t* data;
 	size_t stride;
 	size_t dataSize;
+	/* Called at most once, with the mutex held. Fills data, or leaves it NULL on errors */
+	virtual void decode() {}
+	bool fromCache(const std::string& key);
+	void toCache(const std::string& key) const;
+public:
+	const int32_t width;
+	const int32_t height;
+	BitmapBuffer(int32_t w, int32_t h, bool encoded=false);
+	virtual ~BitmapBuffer();
+	void incRef() { ATOMIC_INCREMENT(ref_count); }
+	void decRef()
+	{
+		if(ATOMIC_DECREMENT(ref_count)==0)
+			delete this;
+	}
+	bool isShared() const { return ref_count>1; }
+	/* Sets the pixels of a buffer that is being built or decoded, takes ownership of rgb */
+	bool fromRGB(uint8_t* rgb, bool hasAlpha);
+	/* Decodes the buffer if needed. Never NULL for a non empty buffer */
+	uint8_t* getData();
+	size_t getStride() { getData(); return stride; }
+	size_t getDataSize() { getData(); return dataSize; }
+	BitmapBuffer* clone();
+};
+
+class BitmapData: public ASObject, public IBitmapDrawable
+{
+CLASSBUILDABLE(BitmapData);
+protected:
+	/* NULL for an empty bitmap */
+	BitmapBuffer* buffer;
 	static void sinit(Class_base* c);
-	uint8_t* getData() { return data; }
 	uint32_t getPixelPriv(uint32_t x, uint32_t y);
 	void setPixelPriv(uint32_t x, uint32_t y, uint32_t color, bool setAlpha);
 	void copyFrom(BitmapData *source);
+	/* Takes ownership of b, which may be NULL */
+	void setBuffer(BitmapBuffer* b);
+	/* Unshares the pixels before modifying them */
+	uint8_t* getDataForWrite();
 public:
-	BitmapData() : stride(0), dataSize(0), data(NULL), width(0), height(0) {}
+	BitmapData() : buffer(NULL), width(0), height(0) {}
+	BitmapData(const BitmapData& other);
 	~BitmapData();
-	/* the bitmaps data in premultiplied, native-endian 32 bit
-	 * ARGB format. stride is the number of bytes per row, may be
-	 * larger than width. dataSize is the total allocated size of
-	 * data (=stride*height) */
-	uint8_t* data;
+	/* The pixels, see BitmapBuffer. NULL for an empty bitmap */
+	uint8_t* getData() const { return buffer?buffer->getData():NULL; }
+	size_t getStride() const { return buffer?buffer->getStride():0; }
 	ASPROPERTY_GETTER(int32_t, width);
 	ASPROPERTY_GETTER(int32_t, height);
 	ASPROPERTY_GETTER(bool, transparent);
@@ -155,7 +155,7 @@ ASFUNCTIONBODY(Event,formatToString)
 
 		multiname propName;
 		propName.name_type=multiname::NAME_STRING;
-		propName.name_s=prop;
+		propName.setName(prop);
 		propName.ns.push_back(nsNameAndKind("",PACKAGE_NAMESPACE));
 		_NR<ASObject> value=th->getVariableByMultiname(propName);
 		if (!value.isNull())
@@ -520,7 +520,7 @@ ASFUNCTIONBODY(EventDispatcher,dispatchEvent)
 		//Object must be cloned, closing is implemented with the clone AS method
 		multiname cloneName;
 		cloneName.name_type=multiname::NAME_STRING;
-		cloneName.name_s="clone";
+		cloneName.setName("clone");
 		cloneName.ns.push_back(nsNameAndKind("",PACKAGE_NAMESPACE));
 
 		_NR<ASObject> clone=e->getVariableByMultiname(cloneName);
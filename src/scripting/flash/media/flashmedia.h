@@ -63,6 +63,7 @@ public:
 	//IThreadJob interface
 	void execute();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 	void threadAbort();
 };
 
@@ -178,12 +178,12 @@ void URLStream::execute()
 		if(!downloader->hasFailed())
 		{
 			istream s(downloader);
-			uint8_t* buf=new uint8_t[downloader->getLength()];
-			//TODO: avoid this useless copy
+			//Read directly into the storage of the ByteArray
+			data->releaseBuffer();
+			data->setPosition(0);
+			uint8_t* buf=data->getBuffer(downloader->getLength(),true);
 			s.read((char*)buf,downloader->getLength());
 			//TODO: test binary data format
-			data->acquireBuffer(buf,downloader->getLength());
-			//The buffers must not be deleted, it's now handled by the ByteArray instance
 			//Send a complete event for this object
 			this->incRef();
 			getVm()->addEvent(_MR(this),_MR(Class<Event>::getInstanceS("complete")));
@@ -42,6 +42,7 @@ private:
 	void execute();
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 	void finalize();
 	static void sinit(Class_base*);
 	static void buildTraits(ASObject* o);
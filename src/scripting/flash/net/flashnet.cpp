@@ -377,25 +377,24 @@ void URLLoader::execute()
 		if(!downloader->hasFailed())
 		{
 			istream s(downloader);
-			uint8_t* buf=new uint8_t[downloader->getLength()];
-			//TODO: avoid this useless copy
-			s.read((char*)buf,downloader->getLength());
 			//TODO: test binary data format
 			if(dataFormat=="binary")
 			{
+				//Read directly into the storage of the ByteArray
 				_R<ByteArray> byteArray=_MR(Class<ByteArray>::getInstanceS());
-				byteArray->acquireBuffer(buf,downloader->getLength());
+				uint8_t* buf=byteArray->getBuffer(downloader->getLength(),true);
+				s.read((char*)buf,downloader->getLength());
 				data=byteArray;
-				//The buffers must not be deleted, it's now handled by the ByteArray instance
 			}
-			else if(dataFormat=="text")
-			{
-				data=_MR(Class<ASString>::getInstanceS((char*)buf,downloader->getLength()));
-				delete[] buf;
-			}
-			else if(dataFormat=="variables")
+			else
 			{
-				data=_MR(Class<URLVariables>::getInstanceS((char*)buf));
+				uint8_t* buf=new uint8_t[downloader->getLength()];
+				//TODO: avoid this useless copy
+				s.read((char*)buf,downloader->getLength());
+				if(dataFormat=="text")
+					data=_MR(Class<ASString>::getInstanceS((char*)buf,downloader->getLength()));
+				else if(dataFormat=="variables")
+					data=_MR(Class<URLVariables>::getInstanceS((char*)buf));
 				delete[] buf;
 			}
 			//Send a complete event for this object
@@ -1152,7 +1151,7 @@ void NetStream::execute()
 			{
 				multiname onMetaDataName;
 				onMetaDataName.name_type=multiname::NAME_STRING;
-				onMetaDataName.name_s="onMetaData";
+				onMetaDataName.setName("onMetaData");
 				onMetaDataName.ns.push_back(nsNameAndKind("",NAMESPACE));
 				_NR<ASObject> callback = client->getVariableByMultiname(onMetaDataName);
 				if(!callback.isNull() && callback->getObjectType() == T_FUNCTION)
@@ -1405,7 +1404,7 @@ void URLVariables::decode(const tiny_string& s)
 			//Check if the variable already exists
 			multiname propName;
 			propName.name_type=multiname::NAME_STRING;
-			propName.name_s=name;
+			propName.setName(name);
 			propName.ns.push_back(nsNameAndKind("",NAMESPACE));
 			_NR<ASObject> curValue=getVariableByMultiname(propName);
 			if(!curValue.isNull())
@@ -111,6 +111,7 @@ private:
 	void execute();
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 public:
 	URLLoader();
 	void finalize();
@@ -157,6 +158,7 @@ private:
 	void execute();
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 public:
 	NetConnection();
 	void finalize();
@@ -194,6 +196,7 @@ private:
 	void execute();
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 	//ITickJob interface to frame advance
 	void tick();
 	bool isReady() const;
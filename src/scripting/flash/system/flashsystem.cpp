@@ -211,12 +211,12 @@ ASObject* ApplicationDomain::getVariableByString(const std::string& str, ASObjec
 	name.name_type=multiname::NAME_STRING;
 	if(index==str.npos) //No dot
 	{
-		name.name_s=str;
+		name.setName(str);
 		name.ns.push_back(nsNameAndKind("",NAMESPACE)); //TODO: use ns kind
 	}
 	else
 	{
-		name.name_s=str.substr(index+1);
+		name.setName(str.substr(index+1));
 		name.ns.push_back(nsNameAndKind(str.substr(0,index),NAMESPACE));
 	}
 	return getVariableAndTargetByMultiname(name, target);
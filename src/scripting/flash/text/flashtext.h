@@ -121,7 +121,7 @@ protected:
 		{ return TokenContainer::hitTestImpl(last, x, y, type); }
 public:
 	StaticText() : TokenContainer(this) {};
-	StaticText(const std::vector<GeomToken>& tokens) : TokenContainer(this, tokens, 1.0f/1024.0f/20.0f/20.0f) {};
+	StaticText(_R<TokenList> tokens) : TokenContainer(this, tokens, 1.0f/1024.0f/20.0f/20.0f) {};
 	static void sinit(Class_base* c);
 	void requestInvalidation() { TokenContainer::requestInvalidation(); }
 	void invalidate() { TokenContainer::invalidate(); }
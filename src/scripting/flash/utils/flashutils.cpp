@@ -43,8 +43,6 @@ REGISTER_CLASS_NAME(Timer);
 REGISTER_CLASS_NAME(Dictionary);
 REGISTER_CLASS_NAME(Proxy);
 
-#define BA_CHUNK_SIZE 4096
-
 const char* Endian::littleEndian = "littleEndian";
 const char* Endian::bigEndian = "bigEndian";
 
@@ -100,22 +98,92 @@ void IDataOutput::linkTraits(Class_base* c)
 	lookupAndLink(c,"writeUTFBytes","flash.utils:IDataOutput");
 }
 
-ByteArray::ByteArray(uint8_t* b, uint32_t l):bytes(b),real_len(l),len(l),position(0),littleEndian(false),objectEncoding(ObjectEncoding::AMF3)
+ByteArray::ByteArray(uint8_t* b, uint32_t l):buffer(NULL),bytes(b),real_len(l),len(l),position(0),littleEndian(false),
+	objectEncoding(ObjectEncoding::AMF3)
 {
+	if(bytes)
+		buffer=new ByteArrayBuffer(bytes,len);
 }
 
-ByteArray::ByteArray(const ByteArray& b):ASObject(b),real_len(b.len),len(b.len),position(b.position),littleEndian(b.littleEndian),objectEncoding(b.objectEncoding)
+ByteArray::ByteArray(ByteArrayBuffer* b, uint32_t l):buffer(b),bytes(b->data),real_len(b->capacity),len(l),position(0),
+	littleEndian(false),objectEncoding(ObjectEncoding::AMF3)
+{
+	assert_and_throw(l<=real_len);
+	buffer->incRef();
+}
+
+ByteArray::ByteArray(const ByteArray& b):ASObject(b),buffer(b.buffer),bytes(b.bytes),real_len(b.real_len),len(b.len),
+	position(b.position),littleEndian(b.littleEndian),objectEncoding(b.objectEncoding)
 {
 	assert_and_throw(position==0);
-	bytes = (uint8_t*) malloc(len);
-	assert_and_throw(bytes);
-	memcpy(bytes,b.bytes,len);
+	//The data is copied only when one of the two is written
+	if(buffer)
+		buffer->incRef();
 }
 
 ByteArray::~ByteArray()
 {
-	if(bytes)
-		free(bytes);
+	releaseBuffer();
+}
+
+void ByteArray::releaseBuffer()
+{
+	if(buffer)
+		buffer->decRef();
+	buffer=NULL;
+	bytes=NULL;
+	len=0;
+	real_len=0;
+}
+
+void ByteArray::setCapacity(uint32_t capacity)
+{
+	//Never drop data, and never allocate 0 bytes as bytes must stay non NULL
+	capacity=max(max(capacity,len),1u);
+	if(buffer && !buffer->isShared() && bytes==buffer->data)
+	{
+		uint8_t* bytes2=(uint8_t*) realloc(buffer->data, capacity);
+		assert_and_throw(bytes2);
+		buffer->data=bytes2;
+		buffer->capacity=capacity;
+	}
+	else
+	{
+		//Copy our range out of a shared or empty buffer
+		uint8_t* bytes2=(uint8_t*) malloc(capacity);
+		assert_and_throw(bytes2);
+		if(len)
+			memcpy(bytes2,bytes,len);
+		if(buffer)
+			buffer->decRef();
+		buffer=new ByteArrayBuffer(bytes2,capacity);
+	}
+	bytes=buffer->data;
+	real_len=capacity;
+}
+
+void ByteArray::shareBuffer(ByteArray* source, uint32_t offset, uint32_t length)
+{
+	assert_and_throw(offset+length<=source->len);
+	if(length==0)
+	{
+		releaseBuffer();
+		return;
+	}
+	//Take the new reference first, source may already share our buffer
+	source->buffer->incRef();
+	if(buffer)
+		buffer->decRef();
+	buffer=source->buffer;
+	bytes=source->bytes+offset;
+	real_len=source->real_len-offset;
+	len=length;
+}
+
+void ByteArray::reserve(uint32_t capacity)
+{
+	if(capacity>real_len)
+		setCapacity(capacity);
 }
 
 void ByteArray::sinit(Class_base* c)
@@ -181,31 +249,26 @@ void ByteArray::buildTraits(ASObject* o)
 uint8_t* ByteArray::getBuffer(unsigned int size, bool enableResize)
 {
 	// The first allocation is exactly the size we need,
-	// the subsequent reallocations happen in increments of BA_CHUNK_SIZE bytes
+	// the subsequent reallocations at least double the capacity
 	if(bytes==NULL)
 	{
+		setCapacity(size);
 		len=size;
-		real_len=len;
-		bytes = (uint8_t*) malloc(len);
 	}
 	else if(enableResize==false)
 	{
 		assert_and_throw(size<=len);
+		if(buffer->isShared())
+			setCapacity(len);
 	}
-	else if(real_len<size) // && enableResize==true
-	{
-		while(real_len < size)
-			real_len += BA_CHUNK_SIZE;
-		// Reallocate the buffer, in chunks of BA_CHUNK_SIZE bytes
-		uint8_t* bytes2 = (uint8_t*) realloc(bytes, real_len);
-		assert_and_throw(bytes2);
-		bytes = bytes2;
-		len=size;
-		bytes=bytes2;
-	}
-	else if(len<size)
+	else
 	{
-		len=size;
+		if(real_len<size)
+			setCapacity(max<uint64_t>(size,min<uint64_t>(2ull*real_len,0xffffffffu)));
+		else if(buffer->isShared())
+			setCapacity(size);
+		if(len<size)
+			len=size;
 	}
 	return bytes;
 }
@@ -345,16 +408,16 @@ ASFUNCTIONBODY(ByteArray,_setLength)
 	if(newLen==th->len) //Nothing to do
 		return NULL;
 	uint32_t prevLen = th->len;
-	uint8_t* newBytes= (uint8_t*) realloc(th->bytes, newLen);
-	assert_and_throw(newBytes);
-	th->bytes = newBytes;
-	th->len = newLen;
-	th->real_len = newLen;
-	if(prevLen<newLen)
+	if(newLen<prevLen)
 	{
-		//Extend
-		memset(th->bytes+prevLen,0,newLen-prevLen);
+		//Keep the storage, it will be reused by following writes
+		th->len = newLen;
+		return NULL;
 	}
+	//Extend
+	th->reserve(newLen);
+	th->getBuffer(newLen,true);
+	memset(th->bytes+prevLen,0,newLen-prevLen);
 	return NULL;
 }
 
@@ -411,8 +474,16 @@ ASFUNCTIONBODY(ByteArray,readBytes)
 	{
 		throw Class<EOFError>::getInstanceS("Error #2030: End of file was encountered.");
 	}
-	uint8_t* buf=out->getBuffer(length,true);
-	memcpy(buf,th->bytes+th->position,length);
+	if(out->len==0 && out!=th)
+	{
+		//Share the storage instead of copying, until one of the two is written
+		out->shareBuffer(th,th->position,length);
+	}
+	else
+	{
+		uint8_t* buf=out->getBuffer(length,true);
+		memcpy(buf,th->bytes+th->position,length);
+	}
 	th->position+=length;
 
 	return NULL;
@@ -579,9 +650,18 @@ ASFUNCTIONBODY(ByteArray,writeBytes)
 	//If the length is 0 the whole buffer must be copied
 	if(length == 0)
 		length=(out->getLength()-offset);
-	uint8_t* buf=out->getBuffer(offset+length,false);
-	th->getBuffer(th->position+length,true);
-	memcpy(th->bytes+th->position,buf+offset,length);
+	if(th->len==0 && th->position==0 && out!=th)
+	{
+		//Share the storage instead of copying, until one of the two is written
+		th->shareBuffer(out,offset,length);
+	}
+	else
+	{
+		//Do not use getBuffer on the source, it would unshare it
+		assert_and_throw(offset+length<=out->len);
+		th->getBuffer(th->position+length,true);
+		memmove(th->bytes+th->position,out->bytes+offset,length);
+	}
 	th->position+=length;
 
 	return NULL;
@@ -973,6 +1053,8 @@ void ByteArray::setVariableByMultiname(const multiname& name, ASObject* o)
 		// Fill the gap between the end of the current data and the index with zeros
 		memset(bytes+prevLen, 0, index-prevLen);
 	}
+	else
+		getBuffer(len, false);
 
 	// Fill the byte pointed to by index with the truncated uint value of the object.
 	uint8_t value = static_cast<uint8_t>(o->toUInt() & 0xff);
@@ -988,8 +1070,8 @@ void ByteArray::setVariableByMultiname_i(const multiname& name, int32_t value)
 
 void ByteArray::acquireBuffer(uint8_t* buf, int bufLen)
 {
-	if(bytes)
-		free(bytes);
+	releaseBuffer();
+	buffer=new ByteArrayBuffer(buf,bufLen);
 	bytes=buf;
 	real_len=bufLen;
 	len=bufLen;
@@ -1103,13 +1185,10 @@ void ByteArray::uncompress_zlib()
 
 	inflateEnd(&strm);
 
-	len=strm.total_out;
-	real_len = len;
-	uint8_t* bytes2=(uint8_t*) realloc(bytes, len);
+	uint8_t* bytes2=(uint8_t*) malloc(max<uLong>(strm.total_out,1));
 	assert_and_throw(bytes2);
-	bytes = bytes2;
-	memcpy(bytes, &buf[0], len);
-	position=0;
+	memcpy(bytes2, &buf[0], strm.total_out);
+	acquireBuffer(bytes2, strm.total_out);
 }
 
 ASFUNCTIONBODY(ByteArray,_compress)
@@ -1155,11 +1234,7 @@ ASFUNCTIONBODY(ByteArray,_inflate)
 ASFUNCTIONBODY(ByteArray,clear)
 {
 	ByteArray* th=static_cast<ByteArray*>(obj);
-	if(th->bytes)
-		free(th->bytes);
-	th->bytes = NULL;
-	th->len=0;
-	th->real_len=0;
+	th->releaseBuffer();
 	th->position=0;
 	return NULL;
 }
@@ -1628,7 +1703,7 @@ void Proxy::setVariableByMultiname(const multiname& name, ASObject* o)
 	//Check if there is a custom setter defined, skipping implementation to avoid recursive calls
 	multiname setPropertyName;
 	setPropertyName.name_type=multiname::NAME_STRING;
-	setPropertyName.name_s="setProperty";
+	setPropertyName.setName("setProperty");
 	setPropertyName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> proxySetter=getVariableByMultiname(setPropertyName,ASObject::SKIP_IMPL);
 
@@ -1665,7 +1740,7 @@ _NR<ASObject> Proxy::getVariableByMultiname(const multiname& name, GET_VARIABLE_
 	//Check if there is a custom getter defined, skipping implementation to avoid recursive calls
 	multiname getPropertyName;
 	getPropertyName.name_type=multiname::NAME_STRING;
-	getPropertyName.name_s="getProperty";
+	getPropertyName.setName("getProperty");
 	getPropertyName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> o=getVariableByMultiname(getPropertyName,ASObject::SKIP_IMPL);
 
@@ -1698,7 +1773,7 @@ bool Proxy::hasPropertyByMultiname(const multiname& name, bool considerDynamic)
 	//Check if there is a custom deleter defined, skipping implementation to avoid recursive calls
 	multiname hasPropertyName;
 	hasPropertyName.name_type=multiname::NAME_STRING;
-	hasPropertyName.name_s="hasProperty";
+	hasPropertyName.setName("hasProperty");
 	hasPropertyName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> proxyHasProperty=getVariableByMultiname(hasPropertyName,ASObject::SKIP_IMPL);
 
@@ -1733,7 +1808,7 @@ bool Proxy::deleteVariableByMultiname(const multiname& name)
 	//Check if there is a custom deleter defined, skipping implementation to avoid recursive calls
 	multiname deletePropertyName;
 	deletePropertyName.name_type=multiname::NAME_STRING;
-	deletePropertyName.name_s="deleteProperty";
+	deletePropertyName.setName("deleteProperty");
 	deletePropertyName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> proxyDeleter=getVariableByMultiname(deletePropertyName,ASObject::SKIP_IMPL);
 
@@ -1765,7 +1840,7 @@ uint32_t Proxy::nextNameIndex(uint32_t cur_index)
 	//Check if there is a custom enumerator, skipping implementation to avoid recursive calls
 	multiname nextNameIndexName;
 	nextNameIndexName.name_type=multiname::NAME_STRING;
-	nextNameIndexName.name_s="nextNameIndex";
+	nextNameIndexName.setName("nextNameIndex");
 	nextNameIndexName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> o=getVariableByMultiname(nextNameIndexName,ASObject::SKIP_IMPL);
 	assert_and_throw(!o.isNull() && o->getObjectType()==T_FUNCTION);
@@ -1785,7 +1860,7 @@ _R<ASObject> Proxy::nextName(uint32_t index)
 	//Check if there is a custom enumerator, skipping implementation to avoid recursive calls
 	multiname nextNameName;
 	nextNameName.name_type=multiname::NAME_STRING;
-	nextNameName.name_s="nextName";
+	nextNameName.setName("nextName");
 	nextNameName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> o=getVariableByMultiname(nextNameName,ASObject::SKIP_IMPL);
 	assert_and_throw(!o.isNull() && o->getObjectType()==T_FUNCTION);
@@ -1802,7 +1877,7 @@ _R<ASObject> Proxy::nextValue(uint32_t index)
 	//Check if there is a custom enumerator, skipping implementation to avoid recursive calls
 	multiname nextValueName;
 	nextValueName.name_type=multiname::NAME_STRING;
-	nextValueName.name_s="nextValue";
+	nextValueName.setName("nextValue");
 	nextValueName.ns.push_back(nsNameAndKind(flash_proxy,NAMESPACE));
 	_NR<ASObject> o=getVariableByMultiname(nextValueName,ASObject::SKIP_IMPL);
 	assert_and_throw(!o.isNull() && o->getObjectType()==T_FUNCTION);
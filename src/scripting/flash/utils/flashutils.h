@@ -59,12 +59,39 @@ public:
 	static void linkTraits(Class_base* c);
 };
 
+/*
+ * Reference counted storage of a ByteArray. It may be shared by several
+ * ByteArrays, each looking at a range of it, until one of them writes
+ */
+class ByteArrayBuffer
+{
+private:
+	ATOMIC_INT32(ref_count);
+	~ByteArrayBuffer() { free(data); }
+public:
+	uint8_t* data;
+	uint32_t capacity;
+	/* data must be allocated using malloc, ownership is acquired */
+	ByteArrayBuffer(uint8_t* d, uint32_t c):ref_count(1),data(d),capacity(c){}
+	void incRef() { ATOMIC_INCREMENT(ref_count); }
+	void decRef()
+	{
+		if(ATOMIC_DECREMENT(ref_count)==0)
+			delete this;
+	}
+	bool isShared() const { return ref_count>1; }
+};
+
 class ByteArray: public ASObject, public IDataInput, public IDataOutput
 {
 friend class Loader;
 friend class URLLoader;
 protected:
+	//Non NULL exactly when bytes is
+	ByteArrayBuffer* buffer;
+	//Start of this array inside buffer
 	uint8_t* bytes;
+	//Bytes available from bytes to the end of buffer
 	uint32_t real_len;
 	uint32_t len;
 	uint32_t position;
@@ -73,8 +100,12 @@ protected:
 	ByteArray(const ByteArray& b);
 	void compress_zlib();
 	void uncompress_zlib();
+	void setCapacity(uint32_t capacity);
+	void shareBuffer(ByteArray* source, uint32_t offset, uint32_t length);
 public:
 	ByteArray(uint8_t* b = NULL, uint32_t l = 0);
+	/* Shares b without copying, the first l bytes are the content */
+	ByteArray(ByteArrayBuffer* b, uint32_t l);
 	~ByteArray();
 	//Helper interface for serialization
 	bool readByte(uint8_t& b);
@@ -139,10 +170,19 @@ public:
 		Get ownership over the passed buffer
 		@param buf Pointer to the buffer to acquire, ownership and delete authority is acquired
 		@param bufLen Lenght of the buffer
-		@pre buf must be allocated using new[]
+		@pre buf must be allocated using malloc
 	*/
 	void acquireBuffer(uint8_t* buf, int bufLen);
+	/**
+		Get a writable pointer to the data, the storage is unshared if needed
+		@param size Number of bytes that will be accessed
+		@param enableResize Extend the array to size bytes if it is shorter
+	*/
 	uint8_t* getBuffer(unsigned int size, bool enableResize);
+	/* Preallocate storage for bulk writes of a known size */
+	void reserve(uint32_t capacity);
+	/* Drop the content, the position is not changed */
+	void releaseBuffer();
 	uint32_t getLength() const { return len; }
 
 	uint16_t endianIn(uint16_t value);
@@ -156,6 +196,7 @@ public:
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt=NONE);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & ASObject::SKIP_IMPL)!=0; }
 	int32_t getVariableByMultiname_i(const multiname& name);
 	void setVariableByMultiname(const multiname& name, ASObject* o);
 	void setVariableByMultiname_i(const multiname& name, int32_t value);
@@ -198,6 +239,7 @@ public:
 	static void buildTraits(ASObject* o);
 	ASFUNCTION(_constructor);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt=NONE);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & ASObject::SKIP_IMPL)!=0; }
 	int32_t getVariableByMultiname_i(const multiname& name)
 	{
 		assert_and_throw(implEnable);
@@ -221,6 +263,7 @@ public:
 	static void buildTraits(ASObject* o);
 //	ASFUNCTION(_constructor);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt=NONE);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & ASObject::SKIP_IMPL)!=0; }
 	int32_t getVariableByMultiname_i(const multiname& name)
 	{
 		assert_and_throw(implEnable);
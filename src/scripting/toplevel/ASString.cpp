@@ -23,6 +23,7 @@
 #include "compat.h"
 #include "argconv.h"
 #include "parsing/amf3_generator.h"
+#include "regexp_cache.h"
 
 using namespace std;
 using namespace lightspark;
@@ -129,54 +130,36 @@ ASFUNCTIONBODY(ASString,search)
 	if(argslen == 0 || args[0]->getObjectType() == T_UNDEFINED)
 		return abstract_i(-1);
 
-	int options=PCRE_UTF8;
-	tiny_string restr;
+	_NR<CompiledRegExp> pcreRE;
 	if(args[0]->getClass() && args[0]->getClass()==Class<RegExp>::getClass())
 	{
 		RegExp* re=static_cast<RegExp*>(args[0]);
-		restr = re->source;
-		if(re->ignoreCase)
-			options|=PCRE_CASELESS;
-		if(re->extended)
-			options|=PCRE_EXTENDED;
-		if(re->multiline)
-			options|=PCRE_MULTILINE;
-		if(re->dotall)
-			options|=PCRE_DOTALL;
+		CompiledRegExp* compiled=re->getCompiled();
+		if(compiled)
+		{
+			compiled->incRef();
+			pcreRE=_MNR(compiled);
+		}
 	}
 	else
-	{
-		restr = args[0]->toString();
-	}
+		pcreRE=CompiledRegExp::get(args[0]->toString(), PCRE_UTF8);
 
-	const char* error;
-	int errorOffset;
-	pcre* pcreRE=pcre_compile(restr.raw_buf(), options, &error, &errorOffset,NULL);
-	if(error)
+	if(pcreRE.isNull())
 		return abstract_i(ret);
 	//Verify that 30 for ovector is ok, it must be at least (captGroups+1)*3
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return abstract_i(ret);
-	}
-	assert_and_throw(capturingGroups<10);
+	assert_and_throw(pcreRE->capturingGroups<10);
 	int ovector[30];
 	int offset=0;
 	//Global is not used in search
-	int rc=pcre_exec(pcreRE, NULL, data.raw_buf(), data.numBytes(), offset, 0, ovector, 30);
+	int rc=pcreRE->exec(data, offset, ovector, 30);
 	if(rc<0)
 	{
 		//No matches or error
-		pcre_free(pcreRE);
 		return abstract_i(ret);
 	}
 	ret=ovector[0];
 	// pcre_exec returns byte position, so we have to convert it to character position 
-	tiny_string tmp = data.substr_bytes(0, ret);
-	ret = tmp.numChars();
+	ret = data.charPosition(ret);
 	return abstract_i(ret);
 }
 
@@ -279,37 +262,19 @@ ASFUNCTIONBODY(ASString,split)
 			return ret;
 		}
 
-		const char* error;
-		int offset;
-		int options=PCRE_UTF8;
-		if(re->ignoreCase)
-			options|=PCRE_CASELESS;
-		if(re->extended)
-			options|=PCRE_EXTENDED;
-		if(re->multiline)
-			options|=PCRE_MULTILINE;
-		if(re->dotall)
-			options|=PCRE_DOTALL;
-		pcre* pcreRE=pcre_compile(re->source.raw_buf(), options, &error, &offset,NULL);
-		if(error)
+		CompiledRegExp* pcreRE=re->getCompiled();
+		if(pcreRE==NULL)
 			return ret;
 		//Verify that 30 for ovector is ok, it must be at least (captGroups+1)*3
-		int capturingGroups;
-		int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-		if(infoOk!=0)
-		{
-			pcre_free(pcreRE);
-			return ret;
-		}
-		assert_and_throw(capturingGroups<10);
+		assert_and_throw(pcreRE->capturingGroups<10);
 		int ovector[30];
-		offset=0;
+		int offset=0;
 		unsigned int end;
 		uint32_t lastMatch = 0;
 		do
 		{
 			//offset is a byte offset that must point to the beginning of an utf8 character
-			int rc=pcre_exec(pcreRE, NULL, data.raw_buf(), data.numBytes(), offset, 0, ovector, 30);
+			int rc=pcreRE->exec(data, offset, ovector, 30);
 			end=ovector[0];
 			if(rc<0)
 				break;
@@ -337,7 +302,6 @@ ASFUNCTIONBODY(ASString,split)
 			ASString* s=Class<ASString>::getInstanceS(data.substr_bytes(lastMatch,data.numBytes()-lastMatch));
 			ret->push(s);
 		}
-		pcre_free(pcreRE);
 	}
 	else
 	{
@@ -668,39 +632,21 @@ ASFUNCTIONBODY(ASString,replace)
 	{
 		RegExp* re=static_cast<RegExp*>(args[0]);
 
-		const char* error;
-		int errorOffset;
-		int options=PCRE_UTF8;
-		if(re->ignoreCase)
-			options|=PCRE_CASELESS;
-		if(re->extended)
-			options|=PCRE_EXTENDED;
-		if(re->multiline)
-			options|=PCRE_MULTILINE;
-		if(re->dotall)
-			options|=PCRE_DOTALL;
-		pcre* pcreRE=pcre_compile(re->source.raw_buf(), options, &error, &errorOffset,NULL);
-		if(error)
-			return ret;
-		//Verify that 30 for ovector is ok, it must be at least (captGroups+1)*3
-		int capturingGroups;
-		int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-		if(infoOk!=0)
-		{
-			pcre_free(pcreRE);
+		CompiledRegExp* pcreRE=re->getCompiled();
+		if(pcreRE==NULL)
 			return ret;
-		}
+		//Verify that 60 for ovector is ok, it must be at least (captGroups+1)*3
+		int capturingGroups=pcreRE->capturingGroups;
 		assert_and_throw(capturingGroups<20);
 		int ovector[60];
 		int offset=0;
 		int retDiff=0;
 		do
 		{
-			int rc=pcre_exec(pcreRE, NULL, ret->data.raw_buf(), ret->data.numBytes(), offset, 0, ovector, 60);
+			int rc=pcreRE->exec(ret->data, offset, ovector, 60);
 			if(rc<0)
 			{
 				//No matches or error
-				pcre_free(pcreRE);
 				return ret;
 			}
 			if(type==FUNC)
@@ -748,8 +694,6 @@ ASFUNCTIONBODY(ASString,replace)
 			retDiff+=replaceWith.numBytes()-(ovector[1]-ovector[0]);
 		}
 		while(re->global);
-
-		pcre_free(pcreRE);
 	}
 	else
 	{
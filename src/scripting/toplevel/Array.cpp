@@ -28,6 +28,258 @@ using namespace lightspark;
 SET_NAMESPACE("");
 REGISTER_CLASS_NAME(Array);
 
+//Smaller arrays always stay dense
+static const uint32_t SPARSE_MIN_SIZE=64;
+
+data_slot* array_data::getSparse(uint32_t index)
+{
+	map<uint32_t,data_slot>::iterator it=sparse.find(index);
+	if(it==sparse.end())
+		return NULL;
+	return &it->second;
+}
+
+void array_data::setSlow(uint32_t index, const data_slot& s)
+{
+	if(isHole(s))
+	{
+		erase(index);
+		return;
+	}
+	if(isSparse)
+	{
+		sparse[index]=s;
+		rebalance();
+		return;
+	}
+	if(index<dense.size())
+	{
+		//Filling a hole
+		dense[index]=s;
+		holes--;
+		return;
+	}
+	const uint32_t gap=index-dense.size();
+	if(index>=SPARSE_MIN_SIZE && holes+gap>index/2)
+	{
+		toSparse();
+		sparse[index]=s;
+		return;
+	}
+	dense.resize(index+1);
+	dense[index]=s;
+	holes+=gap;
+}
+
+void array_data::erase(uint32_t index)
+{
+	if(isSparse)
+	{
+		sparse.erase(index);
+		rebalance();
+		return;
+	}
+	if(index>=dense.size() || isHole(dense[index]))
+		return;
+	dense[index]=data_slot();
+	holes++;
+	trimDense();
+	rebalance();
+}
+
+void array_data::trimDense()
+{
+	while(!dense.empty() && isHole(dense.back()))
+	{
+		dense.pop_back();
+		holes--;
+	}
+}
+
+void array_data::rebalance()
+{
+	if(!isSparse)
+	{
+		if(dense.size()>=SPARSE_MIN_SIZE && holes>dense.size()/2)
+			toSparse();
+	}
+	else if(sparse.empty())
+		toDense();
+	else
+	{
+		//Go back to the vector when at most a quarter of it would be holes
+		const uint64_t span=(uint64_t)sparse.rbegin()->first+1;
+		if(span-sparse.size()<=span/4)
+			toDense();
+	}
+}
+
+void array_data::toSparse()
+{
+	assert(!isSparse);
+	for(uint32_t i=0;i<dense.size();i++)
+	{
+		if(!isHole(dense[i]))
+			sparse.insert(sparse.end(),make_pair(i,dense[i]));
+	}
+	//Actually free the memory
+	vector<data_slot>().swap(dense);
+	holes=0;
+	isSparse=true;
+}
+
+void array_data::toDense()
+{
+	assert(isSparse && dense.empty());
+	if(!sparse.empty())
+	{
+		const uint32_t span=sparse.rbegin()->first+1;
+		dense.resize(span);
+		map<uint32_t,data_slot>::const_iterator it=sparse.begin();
+		for(;it!=sparse.end();++it)
+			dense[it->first]=it->second;
+		holes=span-sparse.size();
+		sparse.clear();
+	}
+	isSparse=false;
+}
+
+uint32_t array_data::nextDefined(uint32_t index) const
+{
+	if(isSparse)
+	{
+		map<uint32_t,data_slot>::const_iterator it=sparse.lower_bound(index);
+		return (it==sparse.end())?NO_INDEX:it->first;
+	}
+	for(;index<dense.size();index++)
+	{
+		if(!isHole(dense[index]))
+			return index;
+	}
+	return NO_INDEX;
+}
+
+void array_data::truncate(uint32_t index)
+{
+	if(isSparse)
+	{
+		sparse.erase(sparse.lower_bound(index),sparse.end());
+		rebalance();
+		return;
+	}
+	if(index>=dense.size())
+		return;
+	for(uint32_t i=index;i<dense.size();i++)
+	{
+		if(isHole(dense[i]))
+			holes--;
+	}
+	dense.resize(index);
+	trimDense();
+	rebalance();
+}
+
+void array_data::shiftDown(uint32_t index, uint32_t count)
+{
+	if(isSparse)
+	{
+		map<uint32_t,data_slot> tmp;
+		map<uint32_t,data_slot>::const_iterator it=sparse.begin();
+		for(;it!=sparse.end();++it)
+		{
+			if(it->first<index)
+				tmp.insert(tmp.end(),*it);
+			else if(it->first-index>=count)
+				tmp.insert(tmp.end(),make_pair(it->first-count,it->second));
+		}
+		sparse.swap(tmp);
+		rebalance();
+		return;
+	}
+	if(index>=dense.size())
+		return;
+	const uint32_t end=min<uint64_t>((uint64_t)index+count,dense.size());
+	for(uint32_t i=index;i<end;i++)
+	{
+		if(isHole(dense[i]))
+			holes--;
+	}
+	dense.erase(dense.begin()+index,dense.begin()+end);
+	trimDense();
+	rebalance();
+}
+
+void array_data::shiftUp(uint32_t index, uint32_t count)
+{
+	if(count==0)
+		return;
+	if(isSparse)
+	{
+		map<uint32_t,data_slot> tmp;
+		map<uint32_t,data_slot>::const_iterator it=sparse.begin();
+		for(;it!=sparse.end();++it)
+		{
+			if(it->first<index)
+				tmp.insert(tmp.end(),*it);
+			else
+				tmp.insert(tmp.end(),make_pair(it->first+count,it->second));
+		}
+		sparse.swap(tmp);
+		rebalance();
+		return;
+	}
+	if(index>=dense.size())
+		return;
+	dense.insert(dense.begin()+index,count,data_slot());
+	holes+=count;
+	rebalance();
+}
+
+void array_data::reverse(uint32_t length)
+{
+	if(isSparse)
+	{
+		map<uint32_t,data_slot> tmp;
+		map<uint32_t,data_slot>::const_reverse_iterator it=sparse.rbegin();
+		for(;it!=sparse.rend();++it)
+			tmp.insert(tmp.end(),make_pair(length-(it->first+1),it->second));
+		sparse.swap(tmp);
+		rebalance();
+		return;
+	}
+	if(dense.empty())
+		return;
+	if(length-dense.size()>dense.size())
+	{
+		//Mostly trailing undefined elements, they would become leading holes
+		toSparse();
+		reverse(length);
+		return;
+	}
+	//Trailing undefined elements become leading holes
+	holes+=length-dense.size();
+	dense.resize(length);
+	std::reverse(dense.begin(),dense.end());
+	//Leading holes became trailing ones
+	trimDense();
+	rebalance();
+}
+
+//v must not contain holes
+void array_data::assign(const vector<data_slot>& v)
+{
+	clear();
+	dense=v;
+}
+
+void array_data::clear()
+{
+	dense.clear();
+	sparse.clear();
+	holes=0;
+	isSparse=false;
+}
+
 Array::Array()
 {
 	currentsize=0;
@@ -136,20 +388,14 @@ ASFUNCTIONBODY(Array,_concat)
 	
 	// copy values into new array
 	ret->resize(th->size());
-	std::map<uint32_t, data_slot>::iterator it=th->data.begin();
-	for(;it != th->data.end();++it)
-	{
-		ret->data[it->first]=it->second;
-	}
+	for(uint32_t i=th->data.nextDefined(0);i<th->size();i=th->data.nextDefined(i+1))
+		ret->data.set(i,*th->data.get(i));
 	
 	if(argslen==1 && args[0]->getObjectType()==T_ARRAY)
 	{
 		Array* tmp=Class<Array>::cast(args[0]);
-		std::map<uint32_t, data_slot>::iterator ittmp=tmp->data.begin();
-		for(;ittmp != tmp->data.end();++ittmp)
-		{
-			ret->data[ret->size()+ittmp->first]=ittmp->second;
-		}
+		for(uint32_t i=tmp->data.nextDefined(0);i<tmp->size();i=tmp->data.nextDefined(i+1))
+			ret->data.set(ret->size()+i,*tmp->data.get(i));
 		ret->resize(th->size()+tmp->size());
 	}
 	else
@@ -161,10 +407,11 @@ ASFUNCTIONBODY(Array,_concat)
 
 	//All the elements in the new array should be increffed, as args will be deleted and
 	//this array could die too
-	for(unsigned int i=0;i<ret->size();i++)
+	for(uint32_t i=ret->data.nextDefined(0);i<ret->size();i=ret->data.nextDefined(i+1))
 	{
-		if(ret->data.count(i) && ret->data[i].type==DATA_OBJECT && ret->data[i].data)
-			ret->data[i].data->incRef();
+		const data_slot* slot=ret->data.get(i);
+		if(slot->type==DATA_OBJECT)
+			slot->data->incRef();
 	}
 
 	return ret;
@@ -179,13 +426,14 @@ ASFUNCTIONBODY(Array,filter)
 	Array* ret=Class<Array>::getInstanceS();
 	ASObject *funcRet;
 
-	for(unsigned int i=0;i<th->size();i++)
+	for(uint32_t i=th->data.nextDefined(0);i<th->size();i=th->data.nextDefined(i+1))
 	{
-		if (!th->data.count(i))
-			continue;
-		assert_and_throw(th->data[i].type==DATA_OBJECT);
-		params[0] = th->data[i].data;
-		th->data[i].data->incRef();
+		const data_slot* slot=th->data.get(i);
+		assert_and_throw(slot->type==DATA_OBJECT);
+		//The callback may modify the array
+		ASObject* element=slot->data;
+		params[0] = element;
+		element->incRef();
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -203,8 +451,8 @@ ASFUNCTIONBODY(Array,filter)
 		{
 			if(Boolean_concrete(funcRet))
 			{
-				th->data[i].data->incRef();
-				ret->push(th->data[i].data);
+				element->incRef();
+				ret->push(element);
 			}
 			funcRet->decRef();
 		}
@@ -220,13 +468,12 @@ ASFUNCTIONBODY(Array, some)
 	ASObject* params[3];
 	ASObject *funcRet;
 
-	for(unsigned int i=0; i < th->size(); i++)
+	for(uint32_t i=th->data.nextDefined(0);i<th->size();i=th->data.nextDefined(i+1))
 	{
-		if (!th->data.count(i))
-			continue;
-		assert_and_throw(th->data[i].type==DATA_OBJECT);
-		params[0] = th->data[i].data;
-		th->data[i].data->incRef();
+		const data_slot* slot=th->data.get(i);
+		assert_and_throw(slot->type==DATA_OBJECT);
+		params[0] = slot->data;
+		slot->data->incRef();
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -260,13 +507,12 @@ ASFUNCTIONBODY(Array, every)
 	ASObject* params[3];
 	ASObject *funcRet;
 
-	for(unsigned int i=0; i < th->size(); i++)
+	for(uint32_t i=th->data.nextDefined(0);i<th->size();i=th->data.nextDefined(i+1))
 	{
-		if (!th->data.count(i))
-			continue;
-		assert_and_throw(th->data[i].type==DATA_OBJECT);
-		params[0] = th->data[i].data;
-		th->data[i].data->incRef();
+		const data_slot* slot=th->data.get(i);
+		assert_and_throw(slot->type==DATA_OBJECT);
+		params[0] = slot->data;
+		slot->data->incRef();
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -317,13 +563,12 @@ ASFUNCTIONBODY(Array,forEach)
 	IFunction* f = static_cast<IFunction*>(args[0]);
 	ASObject* params[3];
 
-	for(unsigned int i=0; i < th->size(); i++)
+	for(uint32_t i=th->data.nextDefined(0);i<th->size();i=th->data.nextDefined(i+1))
 	{
-		if (!th->data.count(i))
-			continue;
-		assert_and_throw(th->data[i].type==DATA_OBJECT);
-		params[0] = th->data[i].data;
-		th->data[i].data->incRef();
+		const data_slot* slot=th->data.get(i);
+		assert_and_throw(slot->type==DATA_OBJECT);
+		params[0] = slot->data;
+		slot->data->incRef();
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -349,14 +594,7 @@ ASFUNCTIONBODY(Array, _reverse)
 {
 	Array* th = static_cast<Array*>(obj);
 
-	std::map<uint32_t, data_slot> tmp = std::map<uint32_t, data_slot>(th->data);
-	uint32_t size = th->size();
-	th->data.clear();
-	std::map<uint32_t, data_slot>::iterator it=tmp.begin();
-	for(;it != tmp.end();++it)
- 	{
-		th->data[size-(it->first+1)]=it->second;
-	}
+	th->data.reverse(th->size());
 	th->incRef();
 	return th;
 }
@@ -396,12 +634,13 @@ ASFUNCTIONBODY(Array,lastIndexOf)
 	}
 	do
 	{
-		if (!th->data.count(i))
+		const data_slot* slot=th->data.get(i);
+		if (!slot)
 		    continue;
-		DATA_TYPE dtype = th->data[i].type;
+		DATA_TYPE dtype = slot->type;
 		assert_and_throw(dtype==DATA_OBJECT || dtype==DATA_INT);
-		if((dtype == DATA_OBJECT && ABCVm::strictEqualImpl(th->data[i].data,arg0)) ||
-			(dtype == DATA_INT && arg0->toInt() == th->data[i].data_i))
+		if((dtype == DATA_OBJECT && ABCVm::strictEqualImpl(slot->data,arg0)) ||
+			(dtype == DATA_INT && arg0->toInt() == slot->data_i))
 		{
 			ret=i;
 			break;
@@ -418,29 +657,16 @@ ASFUNCTIONBODY(Array,shift)
 	if(!th->size())
 		return new Undefined;
 	ASObject* ret;
-	if(!th->data.count(0))
+	const data_slot* slot=th->data.get(0);
+	if(!slot)
 		ret = new Undefined;
+	else if(slot->type==DATA_OBJECT)
+		ret=slot->data;
 	else
-	{
-		if(th->data[0].type==DATA_OBJECT)
-			ret=th->data[0].data;
-		else
-			ret = abstract_i(th->data[0].data_i);
-		th->data.erase(0);
-	}
-	for(uint32_t i= 1;i< th->size();i++)
-	{
-		if (th->data.count(i))
-		{
-			th->data[i-1]=th->data[i];
-		}
-		else if (th->data.count(i-1))
-		{
-			th->data.erase(i-1);
-		}
-	}
-	th->data.erase(th->size()-1);// erase here to avoid decref
-	th->resize(th->size()-1);
+		ret = abstract_i(slot->data_i);
+	//The reference of the first element is passed to the caller
+	th->data.shiftDown(0,1);
+	th->currentsize--;
 	return ret;
 }
 
@@ -481,11 +707,12 @@ ASFUNCTIONBODY(Array,slice)
 	int j = 0;
 	for(int i=startIndex; i<endIndex; i++) 
 	{
-		if (th->data.count(i))
+		const data_slot* slot=th->data.get(i);
+		if (slot)
 		{
-			if(th->data[i].type == DATA_OBJECT)
-				th->data[i].data->incRef();
-			ret->data[j]=th->data[i];
+			if(slot->type == DATA_OBJECT)
+				slot->data->incRef();
+			ret->data.set(j,*slot);
 		}
 		j++;
 	}
@@ -515,47 +742,24 @@ ASFUNCTIONBODY(Array,splice)
 	ret->resize(deleteCount);
 	if(deleteCount)
 	{
-		// write deleted items to return array
+		// move deleted items to return array
 		for(int i=0;i<deleteCount;i++)
 		{
-			if (th->data.count(startIndex+i))
-				ret->data[i] = th->data[startIndex+i];
-		}
-		// delete items from current array
-		for (int i = 0; i < deleteCount; i++)
-		{
-			if(th->data.count(startIndex+i))
-			{
-				th->data.erase(startIndex+i);
-			}
-		}
-	}
-	// remember items in current array that have to be moved to new position
-	vector<data_slot> tmp = vector<data_slot>(totalSize- (startIndex+deleteCount));
-	for (int i = startIndex+deleteCount; i < totalSize ; i++)
-	{
-		if (th->data.count(i))
-		{
-			tmp[i-(startIndex+deleteCount)] = th->data[i];
-			th->data.erase(i);
+			const data_slot* slot=th->data.get(startIndex+i);
+			if (slot)
+				ret->data.set(i,*slot);
 		}
+		th->data.shiftDown(startIndex,deleteCount);
 	}
-	th->resize(startIndex);
-
-	
-	//Insert requested values starting at startIndex
-	for(unsigned int i=2;i<argslen;i++)
+	//Make room for the requested values and insert them starting at startIndex
+	const uint32_t insertCount=(argslen > 2 ? argslen-2 : 0);
+	th->data.shiftUp(startIndex,insertCount);
+	for(unsigned int i=0;i<insertCount;i++)
 	{
-		args[i]->incRef();
-		th->push(args[i]);
+		args[i+2]->incRef();
+		th->data.set(startIndex+i,data_slot(args[i+2],DATA_OBJECT));
 	}
-	// move remembered items to new position
-	for(int i=0;i<totalSize- (startIndex+deleteCount);i++)
-	{
-		if (tmp[i].type != DATA_OBJECT || tmp[i].data != NULL)
-			th->data[startIndex+i+(argslen > 2 ? argslen-2 : 0)] = tmp[i];
-	}
-	th->resize((totalSize-deleteCount)+(argslen > 2 ? argslen-2 : 0));
+	th->currentsize=(totalSize-deleteCount)+insertCount;
 	return ret;
 }
 
@@ -590,14 +794,13 @@ ASFUNCTIONBODY(Array,indexOf)
 	}
 
 	DATA_TYPE dtype;
-	for(;i<th->size();i++)
+	for(i=th->data.nextDefined(i);i<th->size();i=th->data.nextDefined(i+1))
 	{
-		if (!th->data.count(i))
-			continue;
-		dtype = th->data[i].type;
+		const data_slot* slot=th->data.get(i);
+		dtype = slot->type;
 		assert_and_throw(dtype==DATA_OBJECT || dtype==DATA_INT);
-		if((dtype == DATA_OBJECT && ABCVm::strictEqualImpl(th->data[i].data,arg0)) ||
-			(dtype == DATA_INT && arg0->toInt() == th->data[i].data_i))
+		if((dtype == DATA_OBJECT && ABCVm::strictEqualImpl(slot->data,arg0)) ||
+			(dtype == DATA_INT && arg0->toInt() == slot->data_i))
 		{
 			ret=i;
 			break;
@@ -614,12 +817,13 @@ ASFUNCTIONBODY(Array,_pop)
 	if (size == 0)
 		return new Undefined;
 	ASObject* ret;
-	if (th->data.count(size-1))
+	const data_slot* slot=th->data.get(size-1);
+	if (slot)
 	{
-		if(th->data[size-1].type==DATA_OBJECT)
-			ret=th->data[size-1].data;
+		if(slot->type==DATA_OBJECT)
+			ret=slot->data;
 		else
-			ret = abstract_i(th->data[size-1].data_i);
+			ret = abstract_i(slot->data_i);
 		th->data.erase(size-1);
 	}
 	else
@@ -728,26 +932,18 @@ ASFUNCTIONBODY(Array,_sort)
 				throw UnsupportedException("Array::sort not completely implemented");
 		}
 	}
-	std::vector<data_slot> tmp = vector<data_slot>(th->data.size());
-	std::map<uint32_t, data_slot>::iterator it=th->data.begin();
-	int i = 0;
-	for(;it != th->data.end();++it)
-	{
-		tmp[i++]= it->second;
-	}
+	std::vector<data_slot> tmp;
+	tmp.reserve(th->data.defined());
+	for(uint32_t i=th->data.nextDefined(0);i<th->size();i=th->data.nextDefined(i+1))
+		tmp.push_back(*th->data.get(i));
 	
 	if(comp)
 		sort(tmp.begin(),tmp.end(),sortComparatorWrapper(comp));
 	else
 		sort(tmp.begin(),tmp.end(),sortComparatorDefault(isNumeric,isCaseInsensitive));
 
-	th->data.clear();
-	std::vector<data_slot>::iterator ittmp=tmp.begin();
-	i = 0;
-	for(;ittmp != tmp.end();++ittmp)
-	{
-		th->data[i++]= *ittmp;
-	}
+	//Defined elements are moved to the front
+	th->data.assign(tmp);
 	obj->incRef();
 	return obj;
 }
@@ -765,20 +961,11 @@ ASFUNCTIONBODY(Array,sortOn)
 ASFUNCTIONBODY(Array,unshift)
 {
 	Array* th=static_cast<Array*>(obj);
-	th->resize(th->size()+argslen);
-	for(uint32_t i=th->size();i> 0;i--)
-	{
-		if (th->data.count(i-1))
-		{
-			th->data[(i-1)+argslen]=th->data[i-1];
-			th->data.erase(i-1);
-		}
-		
-	}
-
+	th->data.shiftUp(0,argslen);
+	th->currentsize+=argslen;
 	for(uint32_t i=0;i<argslen;i++)
 	{
-		th->data[i] = data_slot(args[i],DATA_OBJECT);
+		th->data.set(i,data_slot(args[i],DATA_OBJECT));
 		args[i]->incRef();
 	}
 	return abstract_i(th->size());
@@ -808,20 +995,15 @@ ASFUNCTIONBODY(Array,_map)
 	for(uint32_t i=0;i<th->size();i++)
 	{
 		ASObject* funcArgs[3];
-		if (!th->data.count(i))
+		const data_slot* slot=th->data.get(i);
+		if (!slot)
 			funcArgs[0]=new Null;
+		else if(slot->type==DATA_INT)
+			funcArgs[0]=abstract_i(slot->data_i);
 		else
 		{
-			const data_slot& slot=th->data[i];
-			if(slot.type==DATA_INT)
-				funcArgs[0]=abstract_i(slot.data_i);
-			else if(slot.type==DATA_OBJECT && slot.data)
-			{
-				funcArgs[0]=slot.data;
-				funcArgs[0]->incRef();
-			}
-			else
-				funcArgs[0]=new Undefined;
+			funcArgs[0]=slot->data;
+			funcArgs[0]->incRef();
 		}
 		funcArgs[1]=abstract_i(i);
 		funcArgs[2]=th;
@@ -849,28 +1031,28 @@ int32_t Array::getVariableByMultiname_i(const multiname& name)
 
 	if(index<size())
 	{
-		if (!data.count(index))
+		const data_slot* slot=data.get(index);
+		if (!slot)
 			return 0;
-		switch(data[index].type)
+		switch(slot->type)
 		{
 			case DATA_OBJECT:
 			{
-				assert(data[index].data!=NULL);
-				if(data[index].data->getObjectType()==T_INTEGER)
+				if(slot->data->getObjectType()==T_INTEGER)
 				{
-					Integer* i=static_cast<Integer*>(data[index].data);
+					Integer* i=static_cast<Integer*>(slot->data);
 					return i->toInt();
 				}
-				else if(data[index].data->getObjectType()==T_NUMBER)
+				else if(slot->data->getObjectType()==T_NUMBER)
 				{
-					Number* i=static_cast<Number*>(data[index].data);
+					Number* i=static_cast<Number*>(slot->data);
 					return i->toInt();
 				}
 				else
 					throw UnsupportedException("Array::getVariableByMultiname_i not completely implemented");
 			}
 			case DATA_INT:
-				return data[index].data_i;
+				return slot->data_i;
 		}
 	}
 
@@ -892,23 +1074,16 @@ _NR<ASObject> Array::getVariableByMultiname(const multiname& name, GET_VARIABLE_
 	if(index<size())
 	{
 		ASObject* ret=NULL;
-		if (!data.count(index))
+		const data_slot* slot=data.get(index);
+		if (!slot)
 			ret = new Undefined;
-		switch(data[index].type)
+		else if(slot->type==DATA_OBJECT)
 		{
-			case DATA_OBJECT:
-				ret=data[index].data;
-				if(ret==NULL)
-				{
-					ret=new Undefined;
-					data[index].data=ret;
-				}
-				ret->incRef();
-				break;
-			case DATA_INT:
-				ret=abstract_i(data[index].data_i);
-				break;
+			ret=slot->data;
+			ret->incRef();
 		}
+		else
+			ret=abstract_i(slot->data_i);
 		return _MNR(ret);
 	}
 	else
@@ -925,14 +1100,12 @@ void Array::setVariableByMultiname_i(const multiname& name, int32_t value)
 		return;
 	}
 	if(index>=size())
-		resize(index+1);
-
-	if(data.count(index) && data[index].type==DATA_OBJECT && data[index].data)
-		data[index].data->decRef();
-	if(!data.count(index))
-		data[index] = data_slot();
-	data[index].data_i=value;
-	data[index].type=DATA_INT;
+		resize((uint64_t)index+1);
+
+	const data_slot* slot=data.get(index);
+	if(slot && slot->type==DATA_OBJECT)
+		slot->data->decRef();
+	data.set(index,data_slot(value));
 }
 
 
@@ -945,7 +1118,7 @@ bool Array::hasPropertyByMultiname(const multiname& name, bool considerDynamic)
 	if(!isValidMultiname(name,index))
 		return ASObject::hasPropertyByMultiname(name, considerDynamic);
 
-	return (index<size()) && (data.count(index));
+	return (index<size()) && data.count(index);
 }
 
 bool Array::isValidMultiname(const multiname& name, uint32_t& index)
@@ -1002,23 +1175,18 @@ void Array::setVariableByMultiname(const multiname& name, ASObject* o)
 	if(index>=size())
 		resize((uint64_t)index+1);
 
-	if(data.count(index) && data[index].type==DATA_OBJECT && data[index].data)
-		data[index].data->decRef();
-	if(!data.count(index))
-		data[index] = data_slot();
+	const data_slot* slot=data.get(index);
+	if(slot && slot->type==DATA_OBJECT)
+		slot->data->decRef();
 
 	if(o->getObjectType()==T_INTEGER)
 	{
 		Integer* i=static_cast<Integer*>(o);
-		data[index].data_i=i->val;
-		data[index].type=DATA_INT;
+		data.set(index,data_slot(i->val));
 		o->decRef();
 	}
 	else
-	{
-		data[index].data=o;
-		data[index].type=DATA_OBJECT;
-	}
+		data.set(index,data_slot(o,DATA_OBJECT));
 }
 
 bool Array::deleteVariableByMultiname(const multiname& name)
@@ -1030,10 +1198,11 @@ bool Array::deleteVariableByMultiname(const multiname& name)
 
 	if(index>=size())
 		return true;
-	if (!data.count(index))
+	const data_slot* slot=data.get(index);
+	if (!slot)
 		return true;
-	if(data[index].type==DATA_OBJECT && data[index].data)
-		data[index].data->decRef();
+	if(slot->type==DATA_OBJECT)
+		slot->data->decRef();
 
 	data.erase(index);
 	return true;
@@ -1069,17 +1238,15 @@ tiny_string Array::toString_priv() const
 	string ret;
 	for(uint32_t i=0;i<size();i++)
 	{
-		if (data.count(i))
+		const data_slot* slot=data.get(i);
+		if (slot)
 		{
-			if(data.at(i).type==DATA_OBJECT)
-			{
-				if(data.at(i).data)
-					ret+=data.at(i).data->toString().raw_buf();
-			}
-			else if(data.at(i).type==DATA_INT)
+			if(slot->type==DATA_OBJECT)
+				ret+=slot->data->toString().raw_buf();
+			else if(slot->type==DATA_INT)
 			{
 				char buf[20];
-				snprintf(buf,20,"%i",data.at(i).data_i);
+				snprintf(buf,20,"%i",slot->data_i);
 				ret+=buf;
 			}
 			else
@@ -1097,20 +1264,16 @@ _R<ASObject> Array::nextValue(uint32_t index)
 	if(index<=size())
 	{
 		index--;
-		if(!data.count(index))
+		const data_slot* slot=data.get(index);
+		if(!slot)
 			return _MR(new Undefined);
-		if(data[index].type==DATA_OBJECT)
+		if(slot->type==DATA_OBJECT)
 		{
-			if(data[index].data==NULL)
-				return _MR(new Undefined);
-			else
-			{
-				data[index].data->incRef();
-				return _MR(data[index].data);
-			}
+			slot->data->incRef();
+			return _MR(slot->data);
 		}
-		else if(data[index].type==DATA_INT)
-			return _MR(abstract_i(data[index].data_i));
+		else if(slot->type==DATA_INT)
+			return _MR(abstract_i(slot->data_i));
 		else
 			throw UnsupportedException("Unexpected data type");
 	}
@@ -1126,10 +1289,7 @@ uint32_t Array::nextNameIndex(uint32_t cur_index)
 	assert_and_throw(implEnable);
 	if(cur_index<size())
 	{
-		while (!data.count(cur_index) && cur_index<size())
-		{
-			cur_index++;
-		}
+		cur_index=data.nextDefined(cur_index);
 		if(cur_index<size())
 			return cur_index+1;
 		else
@@ -1164,20 +1324,18 @@ ASObject* Array::at(unsigned int index) const
 	if(size()<=index)
 		outofbounds();
 
-	if (!data.count(index))
+	const data_slot* slot=data.get(index);
+	if (!slot)
 		return new Undefined;
-	switch(data.at(index).type)
+	switch(slot->type)
 	{
 		case DATA_OBJECT:
-		{
-			if(data.at(index).data)
-				return data.at(index).data;
-		}
+			return slot->data;
 		case DATA_INT:
-			return abstract_i(data.at(index).data_i);
+			return abstract_i(slot->data_i);
 	}
 
-	//We should be here only if data is an object and is NULL
+	//Not reached
 	return new Undefined;
 }
 
@@ -1209,16 +1367,19 @@ void Array::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap
 		uint32_t value = (denseCount << 1) | 1;
 		out->writeU29(value);
 		serializeDynamicProperties(out, stringMap, objMap, traitsMap);
+		//Every element takes at least its marker byte
+		out->reserve(out->getPosition()+denseCount);
 		for(uint32_t i=0;i<denseCount;i++)
 		{
-			if (!data.count(i))
+			const data_slot* slot=data.get(i);
+			if (!slot)
 				throw UnsupportedException("undefined not supported in Array::serialize");
-			switch(data.at(i).type)
+			switch(slot->type)
 			{
 				case DATA_INT:
 					throw UnsupportedException("int not supported in Array::serialize");
 				case DATA_OBJECT:
-					data.at(i).data->serialize(out, stringMap, objMap, traitsMap);
+					slot->data->serialize(out, stringMap, objMap, traitsMap);
 			}
 		}
 	}
@@ -1227,12 +1388,22 @@ void Array::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap
 void Array::finalize()
 {
 	ASObject::finalize();
-	for(unsigned int i=0;i<size();i++)
+	resize(0);
+}
+
+void Array::resize(uint64_t n)
+{
+	if(n<currentsize)
 	{
-		if(data.count(i) && data[i].type==DATA_OBJECT && data[i].data)
-			data[i].data->decRef();
+		for(uint32_t i=data.nextDefined(n);i<currentsize;i=data.nextDefined(i+1))
+		{
+			const data_slot* slot=data.get(i);
+			if(slot->type==DATA_OBJECT)
+				slot->data->decRef();
+		}
+		data.truncate(n);
 	}
-	data.clear();
+	currentsize = n;
 }
 
 
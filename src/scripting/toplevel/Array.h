@@ -40,13 +40,91 @@ struct data_slot
 	explicit data_slot(int32_t i):type(DATA_INT),data_i(i){}
 };
 
+/*
+ * Indexed elements of an Array. While the array is mostly dense they are
+ * kept in a vector, empty slots (DATA_OBJECT with NULL data) being holes.
+ * When holes become the majority the elements move to a map, and back to the
+ * vector when the map fills up again. References are not managed here
+ */
+class array_data
+{
+private:
+	std::vector<data_slot> dense;
+	std::map<uint32_t,data_slot> sparse;
+	//Holes inside dense, the vector never ends with one
+	uint32_t holes;
+	bool isSparse;
+	static bool isHole(const data_slot& s) { return s.type==DATA_OBJECT && s.data==NULL; }
+	data_slot* getSparse(uint32_t index);
+	void setSlow(uint32_t index, const data_slot& s);
+	void trimDense();
+	void rebalance();
+	void toSparse();
+	void toDense();
+public:
+	//Returned by nextDefined when there are no more elements
+	static const uint32_t NO_INDEX=0xffffffff;
+	array_data():holes(0),isSparse(false){}
+	//Returns NULL if the element is not defined
+	data_slot* get(uint32_t index)
+	{
+		if(!isSparse)
+		{
+			if(index<dense.size() && !isHole(dense[index]))
+				return &dense[index];
+			return NULL;
+		}
+		return getSparse(index);
+	}
+	const data_slot* get(uint32_t index) const
+	{
+		return const_cast<array_data*>(this)->get(index);
+	}
+	bool count(uint32_t index) const { return get(index)!=NULL; }
+	//The previous value, if any, is overwritten without being released
+	void set(uint32_t index, const data_slot& s)
+	{
+		if(!isSparse && !isHole(s))
+		{
+			if(index<dense.size() && !isHole(dense[index]))
+			{
+				dense[index]=s;
+				return;
+			}
+			else if(index==dense.size())
+			{
+				dense.push_back(s);
+				return;
+			}
+		}
+		setSlow(index,s);
+	}
+	void erase(uint32_t index);
+	//Returns the first defined index not less than index, or NO_INDEX
+	uint32_t nextDefined(uint32_t index) const;
+	//Drops all the elements from index onwards
+	void truncate(uint32_t index);
+	//Drops count elements starting at index and moves the following ones down
+	void shiftDown(uint32_t index, uint32_t count);
+	//Moves the elements starting at index up by count, leaving holes behind
+	void shiftUp(uint32_t index, uint32_t count);
+	//Reverses the elements of an array of the given length
+	void reverse(uint32_t length);
+	//Replaces the content with the given elements, starting at 0
+	void assign(const std::vector<data_slot>& v);
+	void clear();
+	//Number of defined elements
+	uint32_t defined() const { return isSparse?sparse.size():dense.size()-holes; }
+	bool empty() const { return defined()==0; }
+};
+
 class Array: public ASObject
 {
 friend class ABCVm;
 CLASSBUILDABLE(Array);
 protected:
 	uint64_t currentsize;
-	std::map<uint32_t,data_slot> data;
+	array_data data;
 	void outofbounds() const;
 	Array();
 private:
@@ -107,12 +185,7 @@ public:
 	void set(unsigned int index, ASObject* o)
 	{
 		if(index<currentsize)
-		{
-			if(!data.count(index))
-				data[index]=data_slot();
-			data[index].data=o;
-			data[index].type=DATA_OBJECT;
-		}
+			data.set(index,data_slot(o,DATA_OBJECT));
 		else
 			outofbounds();
 	}
@@ -122,23 +195,12 @@ public:
 	}
 	void push(ASObject* o)
 	{
-		data[currentsize] = data_slot(o,DATA_OBJECT);
+		data.set(currentsize,data_slot(o,DATA_OBJECT));
 		currentsize++;
 	}
-	void resize(uint64_t n)
-	{
-		for (uint32_t i = n; i < currentsize; i++)
-		{
-			if(data.count(i))
-			{
-				if (data[i].type==DATA_OBJECT && data[i].data)
-					data[i].data->decRef();
-				data.erase(i);
-			}
-		}
-		currentsize = n;
-	}
+	void resize(uint64_t n);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & SKIP_IMPL)!=0; }
 	int32_t getVariableByMultiname_i(const multiname& name);
 	void setVariableByMultiname(const multiname& name, ASObject* o);
 	bool deleteVariableByMultiname(const multiname& name);
@@ -22,6 +22,9 @@
 #include "class.h"
 #include "parsing/amf3_generator.h"
 #include "argconv.h"
+#include <functional>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 using namespace lightspark;
@@ -86,6 +89,219 @@ void Vector::setTypes(const std::vector<Type*>& types)
 	assert(vec_type == NULL);
 	assert_and_throw(types.size() == 1);
 	vec_type = types[0];
+	if(vec_type == Class<Integer>::getClass())
+		kind = STORE_INT;
+	else if(vec_type == Class<UInteger>::getClass())
+		kind = STORE_UINT;
+	else if(vec_type == Class<Number>::getClass())
+		kind = STORE_NUMBER;
+	else
+		kind = STORE_OBJECT;
+}
+
+static bool isNumericValue(ASObject* o)
+{
+	SWFOBJECT_TYPE t=o->getObjectType();
+	return t==T_INTEGER || t==T_UINTEGER || t==T_NUMBER;
+}
+
+number_t Vector::numberAt(uint32_t index) const
+{
+	switch(kind)
+	{
+		case STORE_INT:
+			return vec_i[index];
+		case STORE_UINT:
+			return (uint32_t)vec_i[index];
+		case STORE_NUMBER:
+			return vec_d[index];
+		default:
+			assert(false);
+			return 0;
+	}
+}
+
+ASObject* Vector::at(unsigned int index) const
+{
+	if(index>=size())
+		throw Class<RangeError>::getInstanceS("Error #1125");
+	switch(kind)
+	{
+		case STORE_INT:
+			return abstract_i(vec_i[index]);
+		case STORE_UINT:
+			return abstract_ui(vec_i[index]);
+		case STORE_NUMBER:
+			return abstract_d(vec_d[index]);
+		default:
+			if(vec[index]==NULL)
+				return vec_type->coerce(new Null);
+			vec[index]->incRef();
+			return vec[index];
+	}
+}
+
+int32_t Vector::atInt(unsigned int index) const
+{
+	if(index>=size())
+		throw Class<RangeError>::getInstanceS("Error #1125");
+	switch(kind)
+	{
+		case STORE_INT:
+		case STORE_UINT:
+			//The bits of uints are already right
+			return vec_i[index];
+		case STORE_NUMBER:
+		{
+			//Same conversion as Number::toInt
+			number_t val=vec_d[index];
+			if(val<0)
+				return int(val);
+			uint32_t ret=val;
+			return ret;
+		}
+		default:
+			return vec[index]?vec[index]->toInt():0;
+	}
+}
+
+number_t Vector::atNumber(unsigned int index) const
+{
+	if(index>=size())
+		throw Class<RangeError>::getInstanceS("Error #1125");
+	switch(kind)
+	{
+		case STORE_OBJECT:
+			return vec[index]?vec[index]->toNumber():0;
+		default:
+			return numberAt(index);
+	}
+}
+
+void Vector::storeValue(uint32_t index, ASObject* o)
+{
+	switch(kind)
+	{
+		case STORE_INT:
+			vec_i[index]=o->toInt();
+			o->decRef();
+			break;
+		case STORE_UINT:
+			vec_i[index]=o->toUInt();
+			o->decRef();
+			break;
+		case STORE_NUMBER:
+			vec_d[index]=o->toNumber();
+			o->decRef();
+			break;
+		default:
+		{
+			ASObject* o2=vec_type->coerce(o);
+			if(vec[index])
+				vec[index]->decRef();
+			vec[index]=o2;
+		}
+	}
+}
+
+void Vector::pushValue(ASObject* o)
+{
+	switch(kind)
+	{
+		case STORE_INT:
+			vec_i.push_back(o->toInt());
+			o->decRef();
+			break;
+		case STORE_UINT:
+			vec_i.push_back(o->toUInt());
+			o->decRef();
+			break;
+		case STORE_NUMBER:
+			vec_d.push_back(o->toNumber());
+			o->decRef();
+			break;
+		default:
+			vec.push_back(vec_type->coerce(o));
+	}
+}
+
+void Vector::insertValues(uint32_t index, ASObject* const* values, uint32_t count)
+{
+	switch(kind)
+	{
+		case STORE_INT:
+			vec_i.insert(vec_i.begin()+index,count,0);
+			for(uint32_t i=0;i<count;i++)
+				vec_i[index+i]=values[i]->toInt();
+			break;
+		case STORE_UINT:
+			vec_i.insert(vec_i.begin()+index,count,0);
+			for(uint32_t i=0;i<count;i++)
+				vec_i[index+i]=values[i]->toUInt();
+			break;
+		case STORE_NUMBER:
+			vec_d.insert(vec_d.begin()+index,count,0);
+			for(uint32_t i=0;i<count;i++)
+				vec_d[index+i]=values[i]->toNumber();
+			break;
+		default:
+			vec.insert(vec.begin()+index,count,(ASObject*)NULL);
+			for(uint32_t i=0;i<count;i++)
+			{
+				values[i]->incRef();
+				vec[index+i]=vec_type->coerce(values[i]);
+			}
+	}
+}
+
+void Vector::eraseElements(uint32_t index, uint32_t count)
+{
+	switch(kind)
+	{
+		case STORE_INT:
+		case STORE_UINT:
+			vec_i.erase(vec_i.begin()+index,vec_i.begin()+index+count);
+			break;
+		case STORE_NUMBER:
+			vec_d.erase(vec_d.begin()+index,vec_d.begin()+index+count);
+			break;
+		default:
+			for(uint32_t i=index;i<index+count;i++)
+			{
+				if(vec[i])
+					vec[i]->decRef();
+			}
+			vec.erase(vec.begin()+index,vec.begin()+index+count);
+	}
+}
+
+void Vector::resizeStorage(uint32_t n)
+{
+	switch(kind)
+	{
+		case STORE_INT:
+		case STORE_UINT:
+			vec_i.resize(n);
+			break;
+		case STORE_NUMBER:
+			vec_d.resize(n);
+			break;
+		default:
+			for(size_t i=n; i< vec.size(); ++i)
+			{
+				if(vec[i])
+					vec[i]->decRef();
+			}
+			vec.resize(n);
+	}
+}
+
+bool Vector::equalsAt(uint32_t index, ASObject* o) const
+{
+	if(kind==STORE_OBJECT)
+		return vec[index] && ABCVm::strictEqualImpl(vec[index],o);
+	//Strict equality between numbers only depends on the value
+	return isNumericValue(o) && numberAt(index)==o->toNumber();
 }
 
 ASObject* Vector::generator(TemplatedClass<Vector>* o_class, ASObject* const* args, const unsigned int argslen)
@@ -94,8 +310,6 @@ ASObject* Vector::generator(TemplatedClass<Vector>* o_class, ASObject* const* ar
 	assert_and_throw(args[0]->getClass());
 	assert_and_throw(o_class->getTypes().size() == 1);
 
-	Type* type = o_class->getTypes()[0];
-
 	if(args[0]->getClass() == Class<Array>::getClass())
 	{
 		//create object without calling _constructor
@@ -107,7 +321,7 @@ ASObject* Vector::generator(TemplatedClass<Vector>* o_class, ASObject* const* ar
 			ASObject* obj = a->at(i);
 			obj->incRef();
 			//Convert the elements of the array to the type of this vector
-			ret->vec.push_back( type->coerce(obj) );
+			ret->pushValue(obj);
 		}
 		return ret;
 	}
@@ -117,11 +331,15 @@ ASObject* Vector::generator(TemplatedClass<Vector>* o_class, ASObject* const* ar
 
 		//create object without calling _constructor
 		Vector* ret = o_class->getInstance(false,NULL,0);
-		for(auto i = arg->vec.begin(); i != arg->vec.end(); ++i)
+		if(ret->kind==arg->kind && ret->kind!=STORE_OBJECT)
 		{
-			(*i)->incRef();
-			ret->vec.push_back( type->coerce(*i) );
+			//Same numeric type, the values can be copied as they are
+			ret->vec_i=arg->vec_i;
+			ret->vec_d=arg->vec_d;
+			return ret;
 		}
+		for(uint32_t i=0;i<arg->size();++i)
+			ret->pushValue(arg->at(i));
 		return ret;
 	}
 	else
@@ -141,7 +359,7 @@ ASFUNCTIONBODY(Vector,_constructor)
 	Vector* th=static_cast< Vector *>(obj);
 	assert(th->vec_type);
 	th->fixed = fixed;
-	th->vec.resize(len);
+	th->resizeStorage(len);
 
 	return NULL;
 }
@@ -151,14 +369,13 @@ ASFUNCTIONBODY(Vector,_concat)
 	Vector* th=static_cast<Vector*>(obj);
 	Vector* ret= (Vector*)obj->getClass()->getInstance(true,NULL,0);
 	// copy values into new Vector
-	ret->vec.resize(th->size());
-	std::vector<ASObject*>::iterator it=th->vec.begin();
-	uint32_t index = 0;
-	for(;it != th->vec.end();++it)
+	ret->vec=th->vec;
+	ret->vec_i=th->vec_i;
+	ret->vec_d=th->vec_d;
+	for(uint32_t i=0;i<ret->vec.size();i++)
 	{
-		if (*it)
-			ret->vec[index]=*it;
-		index++;
+		if(ret->vec[i])
+			ret->vec[i]->incRef();
 	}
 	//Insert the arguments in the vector
 	for(unsigned int i=0;i<argslen;i++)
@@ -166,34 +383,33 @@ ASFUNCTIONBODY(Vector,_concat)
 		if (args[i]->is<Vector>())
 		{
 			Vector* arg=static_cast<Vector*>(args[i]);
-			ret->vec.resize(index+arg->size());
-			std::vector<ASObject*>::iterator it=arg->vec.begin();
-			for(;it != arg->vec.end();++it)
+			if(arg->kind==ret->kind && ret->kind!=STORE_OBJECT)
+			{
+				//Same numeric type, no need to check the elements
+				ret->vec_i.insert(ret->vec_i.end(),arg->vec_i.begin(),arg->vec_i.end());
+				ret->vec_d.insert(ret->vec_d.end(),arg->vec_d.begin(),arg->vec_d.end());
+				continue;
+			}
+			for(uint32_t j=0;j<arg->size();j++)
 			{
-				if (*it)
+				if(arg->kind==STORE_OBJECT && arg->vec[j]==NULL)
 				{
-					// force Class_base to ensure that a TypeError is thrown 
-					// if the object type does not match the base vector type
-					ret->vec[index]=((Class_base*)th->vec_type)->Class_base::coerce(*it);
+					ret->resizeStorage(ret->size()+1);
+					continue;
 				}
-				index++;
+				// force Class_base to ensure that a TypeError is thrown 
+				// if the object type does not match the base vector type
+				ASObject* o=((Class_base*)th->vec_type)->Class_base::coerce(arg->at(j));
+				ret->pushValue(o);
 			}
 		}
 		else
 		{
-			ret->vec[index] = th->vec_type->coerce(args[i]);
-			index++;
+			args[i]->incRef();
+			ret->pushValue(args[i]);
 		}
 	}	
 
-	//All the elements in the new vector should be increffed, as args will be deleted and
-	//this vector could die too
-	for(unsigned int i=0;i<ret->size();i++)
-	{
-		if(ret->vec[i])
-			ret->vec[i]->incRef();
-	}
-
 	return ret;
 }
 
@@ -212,10 +428,12 @@ ASFUNCTIONBODY(Vector,filter)
 
 	for(unsigned int i=0;i<th->size();i++)
 	{
-		if (!th->vec[i])
+		if (th->kind==STORE_OBJECT && !th->vec[i])
 			continue;
-		params[0] = th->vec[i];
-		th->vec[i]->incRef();
+		//One reference is kept in case the element is added to the result
+		ASObject* element=th->at(i);
+		params[0] = element;
+		element->incRef();
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -229,15 +447,12 @@ ASFUNCTIONBODY(Vector,filter)
 			args[1]->incRef();
 			funcRet=f->call(args[1], params, 3);
 		}
+		if(funcRet && Boolean_concrete(funcRet))
+			ret->pushValue(element);
+		else
+			element->decRef();
 		if(funcRet)
-		{
-			if(Boolean_concrete(funcRet))
-			{
-				th->vec[i]->incRef();
-				ret->vec.push_back(th->vec[i]);
-			}
 			funcRet->decRef();
-		}
 	}
 	return ret;
 }
@@ -255,10 +470,9 @@ ASFUNCTIONBODY(Vector, some)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (!th->vec[i])
+		if (th->kind==STORE_OBJECT && !th->vec[i])
 			continue;
-		params[0] = th->vec[i];
-		th->vec[i]->incRef();
+		params[0] = th->at(i);
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -297,13 +511,10 @@ ASFUNCTIONBODY(Vector, every)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (th->vec[i])
-		{
-			params[0] = th->vec[i];
-			th->vec[i]->incRef();
-		}
-		else
+		if (th->kind==STORE_OBJECT && !th->vec[i])
 			params[0] = new Null;
+		else
+			params[0] = th->at(i);
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -341,9 +552,9 @@ ASFUNCTIONBODY(Vector,push)
 		args[i]->incRef();
 		//The proprietary player violates the specification and allows elements of any type to be pushed;
 		//they are converted to the vec_type
-		th->vec.push_back( th->vec_type->coerce(args[i]) );
+		th->pushValue(args[i]);
 	}
-	return abstract_ui(th->vec.size());
+	return abstract_ui(th->size());
 }
 
 ASFUNCTIONBODY(Vector,_pop)
@@ -354,16 +565,14 @@ ASFUNCTIONBODY(Vector,_pop)
 	uint32_t size =th->size();
 	if (size == 0)
         return th->vec_type->coerce(new Null);
-	ASObject* ret = th->vec[size-1];
-	if (!ret)
-		ret = th->vec_type->coerce(new Null);
-	th->vec.pop_back();
+	ASObject* ret = th->at(size-1);
+	th->eraseElements(size-1,1);
 	return ret;
 }
 
 ASFUNCTIONBODY(Vector,getLength)
 {
-	return abstract_ui(obj->as<Vector>()->vec.size());
+	return abstract_ui(obj->as<Vector>()->size());
 }
 
 ASFUNCTIONBODY(Vector,setLength)
@@ -373,13 +582,7 @@ ASFUNCTIONBODY(Vector,setLength)
 		throw Class<RangeError>::getInstanceS("Error #1126");
 	uint32_t len;
 	ARG_UNPACK (len);
-	if(len <= th->vec.size())
-	{
-		for(size_t i=len; i< th->vec.size(); ++i)
-			if(th->vec[i])
-				th->vec[i]->decRef();
-	}
-	th->vec.resize(len);
+	th->resizeStorage(len);
 	return NULL;
 }
 
@@ -409,10 +612,9 @@ ASFUNCTIONBODY(Vector,forEach)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (!th->vec[i])
+		if (th->kind==STORE_OBJECT && !th->vec[i])
 			continue;
-		params[0] = th->vec[i];
-		th->vec[i]->incRef();
+		params[0] = th->at(i);
 		params[1] = abstract_i(i);
 		params[2] = th;
 		th->incRef();
@@ -438,17 +640,9 @@ ASFUNCTIONBODY(Vector, _reverse)
 {
 	Vector* th = static_cast<Vector*>(obj);
 
-	std::vector<ASObject*> tmp = std::vector<ASObject*>(th->vec);
-	uint32_t size = th->size();
-	th->vec.clear();
-	th->vec.resize(size);
-	std::vector<ASObject*>::iterator it=tmp.begin();
-	uint32_t index = size-1;
-	for(;it != tmp.end();++it)
- 	{
-		th->vec[index]=*it;
-		index--;
-	}
+	std::reverse(th->vec.begin(),th->vec.end());
+	std::reverse(th->vec_i.begin(),th->vec_i.end());
+	std::reverse(th->vec_d.begin(),th->vec_d.end());
 	th->incRef();
 	return th;
 }
@@ -460,7 +654,7 @@ ASFUNCTIONBODY(Vector,lastIndexOf)
 	int ret=-1;
 	ASObject* arg0=args[0];
 
-	if(th->vec.size() == 0)
+	if(th->size() == 0)
 		return abstract_d(-1);
 
 	size_t i = th->size()-1;
@@ -488,9 +682,7 @@ ASFUNCTIONBODY(Vector,lastIndexOf)
 	}
 	do
 	{
-		if (!th->vec[i])
-		    continue;
-		if (ABCVm::strictEqualImpl(th->vec[i],arg0))
+		if (th->equalsAt(i,arg0))
 		{
 			ret=i;
 			break;
@@ -508,23 +700,8 @@ ASFUNCTIONBODY(Vector,shift)
 		throw Class<RangeError>::getInstanceS("Error #1126");
 	if(!th->size())
 		return th->vec_type->coerce(new Null);
-	ASObject* ret;
-	if(th->vec[0])
-		ret=th->vec[0];
-	else
-		ret=th->vec_type->coerce(new Null);
-	for(uint32_t i= 1;i< th->size();i++)
-	{
-		if (th->vec[i])
-		{
-			th->vec[i-1]=th->vec[i];
-		}
-		else if (th->vec[i-1])
-		{
-			th->vec[i-1] = NULL;
-		}
-	}
-	th->vec.resize(th->size()-1);
+	ASObject* ret=th->at(0);
+	th->eraseElements(0,1);
 	return ret;
 }
 
@@ -561,16 +738,29 @@ ASFUNCTIONBODY(Vector,slice)
 	startIndex=th->capIndex(startIndex);
 	endIndex=th->capIndex(endIndex);
 	Vector* ret= (Vector*)obj->getClass()->getInstance(true,NULL,0);
-	ret->vec.resize(endIndex-startIndex);
-	int j = 0;
-	for(int i=startIndex; i<endIndex; i++) 
+	if(endIndex<=startIndex)
+		return ret;
+	switch(th->kind)
 	{
-		if (th->vec[i])
-		{
-			th->vec[i]->incRef();
-			ret->vec[j] =th->vec_type->coerce(th->vec[i]);
-		}
-		j++;
+		case STORE_INT:
+		case STORE_UINT:
+			ret->vec_i.assign(th->vec_i.begin()+startIndex,th->vec_i.begin()+endIndex);
+			break;
+		case STORE_NUMBER:
+			ret->vec_d.assign(th->vec_d.begin()+startIndex,th->vec_d.begin()+endIndex);
+			break;
+		default:
+			ret->vec.resize(endIndex-startIndex);
+			int j = 0;
+			for(int i=startIndex; i<endIndex; i++) 
+			{
+				if (th->vec[i])
+				{
+					th->vec[i]->incRef();
+					ret->vec[j] =th->vec_type->coerce(th->vec[i]);
+				}
+				j++;
+			}
 	}
 	return ret;
 }
@@ -594,51 +784,28 @@ ASFUNCTIONBODY(Vector,splice)
 	if((startIndex+deleteCount)>totalSize)
 		deleteCount=totalSize-startIndex;
 
-	ret->vec.resize(deleteCount);
 	if(deleteCount)
 	{
-		// write deleted items to return array
-		for(int i=0;i<deleteCount;i++)
-		{
-			if (th->vec[startIndex+i])
-				ret->vec[i] = th->vec[startIndex+i];
-		}
-		// delete items from current array
-		for (int i = 0; i < deleteCount; i++)
-		{
-			if(th->vec[startIndex+i])
-			{
-				th->vec[startIndex+i] = NULL;
-			}
-		}
-	}
-	// remember items in current array that have to be moved to new position
-	vector<ASObject*> tmp = vector<ASObject*>(totalSize- (startIndex+deleteCount));
-	tmp.resize(totalSize- (startIndex+deleteCount));
-	for (int i = startIndex+deleteCount; i < totalSize ; i++)
-	{
-		if (th->vec[i])
+		// move deleted items to return vector
+		switch(th->kind)
 		{
-			tmp[i-(startIndex+deleteCount)] = th->vec[i];
-			th->vec[i] = NULL;
+			case STORE_INT:
+			case STORE_UINT:
+				ret->vec_i.assign(th->vec_i.begin()+startIndex,th->vec_i.begin()+startIndex+deleteCount);
+				th->vec_i.erase(th->vec_i.begin()+startIndex,th->vec_i.begin()+startIndex+deleteCount);
+				break;
+			case STORE_NUMBER:
+				ret->vec_d.assign(th->vec_d.begin()+startIndex,th->vec_d.begin()+startIndex+deleteCount);
+				th->vec_d.erase(th->vec_d.begin()+startIndex,th->vec_d.begin()+startIndex+deleteCount);
+				break;
+			default:
+				ret->vec.assign(th->vec.begin()+startIndex,th->vec.begin()+startIndex+deleteCount);
+				th->vec.erase(th->vec.begin()+startIndex,th->vec.begin()+startIndex+deleteCount);
 		}
 	}
-	th->vec.resize(startIndex);
-
-	
 	//Insert requested values starting at startIndex
-	for(unsigned int i=2;i<argslen;i++)
-	{
-		args[i]->incRef();
-		th->vec.push_back(args[i]);
-	}
-	// move remembered items to new position
-	th->vec.resize((totalSize-deleteCount)+(argslen > 2 ? argslen-2 : 0));
-	for(int i=0;i<totalSize- (startIndex+deleteCount);i++)
-	{
-		if (tmp[i])
-			th->vec[startIndex+i+(argslen > 2 ? argslen-2 : 0)] = tmp[i];
-	}
+	if(argslen > 2)
+		th->insertValues(startIndex,args+2,argslen-2);
 	return ret;
 }
 
@@ -652,8 +819,11 @@ ASFUNCTIONBODY(Vector,join)
 	string ret;
 	for(uint32_t i=0;i<th->size();i++)
 	{
-		if (th->vec[i])
-			ret+=th->vec[i]->toString().raw_buf();
+		if (th->kind!=STORE_OBJECT || th->vec[i])
+		{
+			_R<ASObject> element=_MR(th->at(i));
+			ret+=element->toString().raw_buf();
+		}
 		if(i!=th->size()-1)
 			ret+=del.raw_buf();
 	}
@@ -673,11 +843,26 @@ ASFUNCTIONBODY(Vector,indexOf)
 		i = args[1]->toInt();
 	}
 
+	if(th->kind!=STORE_OBJECT)
+	{
+		//Scan the unboxed values directly
+		if(!isNumericValue(arg0))
+			return abstract_i(-1);
+		const number_t needle=arg0->toNumber();
+		for(;i<th->size();i++)
+		{
+			if(th->numberAt(i)==needle)
+			{
+				ret=i;
+				break;
+			}
+		}
+		return abstract_i(ret);
+	}
+
 	for(;i<th->size();i++)
 	{
-		if (!th->vec[i])
-			continue;
-		if(ABCVm::strictEqualImpl(th->vec[i],arg0))
+		if(th->equalsAt(i,arg0))
 		{
 			ret=i;
 			break;
@@ -685,6 +870,7 @@ ASFUNCTIONBODY(Vector,indexOf)
 	}
 	return abstract_i(ret);
 }
+
 bool Vector::sortComparatorWrapper::operator()(ASObject* d1, ASObject* d2)
 {
 	ASObject* objs[2];
@@ -709,16 +895,106 @@ bool Vector::sortComparatorWrapper::operator()(ASObject* d1, ASObject* d2)
 	return (ret->toNumber()<0); //Less
 }
 
+static ASObject* boxElement(int32_t v)
+{
+	return abstract_i(v);
+}
+
+static ASObject* boxElement(uint32_t v)
+{
+	return abstract_ui(v);
+}
+
+static ASObject* boxElement(number_t v)
+{
+	return abstract_d(v);
+}
+
+template<class T>
+bool Vector::sortComparatorBoxed<T>::operator()(T d1, T d2)
+{
+	ASObject* objs[2];
+	objs[0] = boxElement(d1);
+	objs[1] = boxElement(d2);
+
+	assert(comparator);
+	_NR<ASObject> ret=_MNR(comparator->call(new Null, objs, 2));
+	assert_and_throw(ret);
+	return (ret->toNumber()<0); //Less
+}
+
+static bool isNotNaN(number_t d)
+{
+	return !std::isnan(d);
+}
+
 ASFUNCTIONBODY(Vector,_sort)
 {
 	if (argslen != 1)
 		throw Class<ArgumentError>::getInstanceS("Error #1063: Non-optional argument missing");
 	Vector* th=static_cast<Vector*>(obj);
 	
-	IFunction* comp=static_cast<IFunction*>(args[0]);
-	
+	if(!args[0]->is<IFunction>())
+	{
+		//Sort options, only the numeric ordering of numeric vectors is supported
+		enum { DESCENDING=2, NUMERIC=16 };
+		uint32_t options=args[0]->toUInt();
+		if(th->kind==STORE_OBJECT || (options&(~(NUMERIC|DESCENDING)))!=NUMERIC)
+			throw UnsupportedException("Vector::sort not completely implemented");
+		bool descending=(options&DESCENDING)!=0;
+		switch(th->kind)
+		{
+			case STORE_INT:
+				if(descending)
+					sort(th->vec_i.begin(),th->vec_i.end(),greater<int32_t>());
+				else
+					sort(th->vec_i.begin(),th->vec_i.end());
+				break;
+			case STORE_UINT:
+			{
+				//Sort as unsigned values
+				uint32_t* begin=reinterpret_cast<uint32_t*>(th->vec_i.data());
+				uint32_t* end=begin+th->vec_i.size();
+				if(descending)
+					sort(begin,end,greater<uint32_t>());
+				else
+					sort(begin,end);
+				break;
+			}
+			default:
+			{
+				//NaN is not ordered with anything, so it is moved last before sorting the rest
+				auto nans=stable_partition(th->vec_d.begin(),th->vec_d.end(),isNotNaN);
+				if(descending)
+					sort(th->vec_d.begin(),nans,greater<number_t>());
+				else
+					sort(th->vec_d.begin(),nans);
+			}
+		}
+		obj->incRef();
+		return obj;
+	}
 
-	sort(th->vec.begin(),th->vec.end(),sortComparatorWrapper(comp,th->vec_type));
+	//A user comparator may not be a strict weak ordering, for example when it returns NaN.
+	//std::sort may then run past the ends of the range, stable_sort does not
+	IFunction* comp=static_cast<IFunction*>(args[0]);
+	switch(th->kind)
+	{
+		case STORE_INT:
+			stable_sort(th->vec_i.begin(),th->vec_i.end(),sortComparatorBoxed<int32_t>(comp));
+			break;
+		case STORE_UINT:
+		{
+			uint32_t* begin=reinterpret_cast<uint32_t*>(th->vec_i.data());
+			stable_sort(begin,begin+th->vec_i.size(),sortComparatorBoxed<uint32_t>(comp));
+			break;
+		}
+		case STORE_NUMBER:
+			stable_sort(th->vec_d.begin(),th->vec_d.end(),sortComparatorBoxed<number_t>(comp));
+			break;
+		default:
+			stable_sort(th->vec.begin(),th->vec.end(),sortComparatorWrapper(comp,th->vec_type));
+	}
 	obj->incRef();
 	return obj;
 }
@@ -728,22 +1004,7 @@ ASFUNCTIONBODY(Vector,unshift)
 	Vector* th=static_cast<Vector*>(obj);
 	if (th->fixed)
 		throw Class<RangeError>::getInstanceS("Error #1126");
-	th->vec.resize(th->size()+argslen);
-	for(uint32_t i=th->size();i> 0;i--)
-	{
-		if (th->vec[i-1])
-		{
-			th->vec[(i-1)+argslen]=th->vec[i-1];
-			th->vec[i-1] = NULL;
-		}
-		
-	}
-
-	for(uint32_t i=0;i<argslen;i++)
-	{
-		th->vec[i] = th->vec_type->coerce(args[i]);
-		args[i]->incRef();
-	}
+	th->insertValues(0,args,argslen);
 	return abstract_i(th->size());
 }
 
@@ -757,24 +1018,16 @@ ASFUNCTIONBODY(Vector,_map)
 	for(uint32_t i=0;i<th->size();i++)
 	{
 		ASObject* funcArgs[3];
-		if (!th->vec[i])
+		if (th->kind==STORE_OBJECT && !th->vec[i])
 			funcArgs[0]=new Null;
 		else
-		{
-			if(th->vec[i])
-			{
-				funcArgs[0]=th->vec[i];
-				funcArgs[0]->incRef();
-			}
-			else
-				funcArgs[0]=new Undefined;
-		}
+			funcArgs[0]=th->at(i);
 		funcArgs[1]=abstract_i(i);
 		funcArgs[2]=th;
 		funcArgs[2]->incRef();
 		ASObject* funcRet=func->call(new Null, funcArgs, 3);
 		assert_and_throw(funcRet);
-		ret->vec.push_back(funcRet);
+		ret->pushValue(funcRet);
 	}
 
 	return ret;
@@ -782,21 +1035,10 @@ ASFUNCTIONBODY(Vector,_map)
 
 ASFUNCTIONBODY(Vector,_toString)
 {
-	tiny_string ret;
 	Vector* th = obj->as<Vector>();
-	for(size_t i=0; i < th->vec.size(); ++i)
-	{
-		if (th->vec[i])
-			ret += th->vec[i]->toString();
-		else
-			// use the type's default value
-			ret += th->vec_type->coerce( new Null )->toString();
-
-		if(i!=th->vec.size()-1)
-			ret += ',';
-	}
-	return Class<ASString>::getInstanceS(ret);
+	return Class<ASString>::getInstanceS(th->toString());
 }
+
 bool Vector::hasPropertyByMultiname(const multiname& name, bool considerDynamic)
 {
 	if(!considerDynamic)
@@ -809,7 +1051,7 @@ bool Vector::hasPropertyByMultiname(const multiname& name, bool considerDynamic)
 	if(!Vector::isValidMultiname(name,index))
 		return ASObject::hasPropertyByMultiname(name, considerDynamic);
 
-	if(index < vec.size())
+	if(index < size())
 		return true;
 	else
 		return false;
@@ -829,22 +1071,23 @@ _NR<ASObject> Vector::getVariableByMultiname(const multiname& name, GET_VARIABLE
 	if(!Vector::isValidMultiname(name,index))
 		return ASObject::getVariableByMultiname(name,opt);
 
-	if(index < vec.size())
-	{
-		if (vec[index])
-		{
-			vec[index]->incRef();
-			return _MNR(vec[index]);
-		}
-		else
-			return _MNR(vec_type->coerce( new Null ));
-	}
+	if(index < size())
+		return _MNR(at(index));
 	else
 	{
 		throw Class<RangeError>::getInstanceS("Error #1125");
 	}
 }
 
+int32_t Vector::getVariableByMultiname_i(const multiname& name)
+{
+	unsigned int index=0;
+	if(kind==STORE_OBJECT || !implEnable || name.ns.empty() || !Vector::isValidMultiname(name,index))
+		return ASObject::getVariableByMultiname_i(name);
+
+	return atInt(index);
+}
+
 void Vector::setVariableByMultiname(const multiname& name, ASObject* o)
 {
 	assert_and_throw(name.ns.size()>0);
@@ -854,45 +1097,75 @@ void Vector::setVariableByMultiname(const multiname& name, ASObject* o)
 	unsigned int index=0;
 	if(!Vector::isValidMultiname(name,index))
 		return ASObject::setVariableByMultiname(name, o);
-	ASObject* o2 = this->vec_type->coerce(o);
 	  
-	if(index < vec.size())
-	{
-		if (vec[index])
-			vec[index]->decRef();
-		vec[index] = o2;
-	}
-	else if(!fixed && index == vec.size())
-	{
-		vec.push_back( o2 );
-	}
+	if(index < size())
+		storeValue(index, o);
+	else if(!fixed && index == size())
+		pushValue(o);
 	else
 	{
+		o->decRef();
 		/* Spec says: one may not set a value with an index more than
 		 * one beyond the current final index. */
 		throw Class<RangeError>::getInstanceS("Error #1125");
 	}
 }
 
+void Vector::setVariableByMultiname_i(const multiname& name, int32_t value)
+{
+	unsigned int index=0;
+	if(kind==STORE_OBJECT || !implEnable || name.ns.empty() || !Vector::isValidMultiname(name,index))
+		return ASObject::setVariableByMultiname_i(name, value);
+
+	if(index == size() && !fixed)
+		resizeStorage(index+1);
+	else if(index >= size())
+		throw Class<RangeError>::getInstanceS("Error #1125");
+	switch(kind)
+	{
+		case STORE_INT:
+			vec_i[index]=value;
+			break;
+		case STORE_UINT:
+			//The value is converted to uint keeping the same bits
+			vec_i[index]=value;
+			break;
+		default:
+			vec_d[index]=value;
+	}
+}
+
 tiny_string Vector::toString(bool debugMsg)
 {
-	//TODO: test
 	tiny_string t;
-	for(size_t i = 0; i < vec.size(); ++i)
+	for(size_t i = 0; i < size(); ++i)
 	{
 		if( i )
 			t += ",";
-		if (vec[i]) 
-			t += vec[i]->toString();
-		else
-			t += vec_type->coerce( new Null )->toString();
+		switch(kind)
+		{
+			case STORE_INT:
+				t += Integer::toString(vec_i[i]);
+				break;
+			case STORE_UINT:
+				t += UInteger::toString(vec_i[i]);
+				break;
+			case STORE_NUMBER:
+				t += Number::toString(vec_d[i]);
+				break;
+			default:
+				if (vec[i]) 
+					t += vec[i]->toString();
+				else
+					t += vec_type->coerce( new Null )->toString();
+		}
 	}
 	return t;
 }
 
 uint32_t Vector::nextNameIndex(uint32_t cur_index)
 {
-	if(cur_index < vec.size())
+	if(cur_index < size())
 		return cur_index+1;
 	else
 		return 0;
@@ -900,7 +1173,7 @@ uint32_t Vector::nextNameIndex(uint32_t cur_index)
 
 _R<ASObject> Vector::nextName(uint32_t index)
 {
-	if(index<=vec.size())
+	if(index<=size())
 		return _MR(abstract_i(index-1));
 	else
 		throw RunTimeException("Vector::nextName out of bounds");
@@ -908,15 +1181,8 @@ _R<ASObject> Vector::nextName(uint32_t index)
 
 _R<ASObject> Vector::nextValue(uint32_t index)
 {
-	if(index<=vec.size())
-	{
-		if (vec[index])
-		{
-			vec[index-1]->incRef();
-			return _MR(vec[index-1]);
-		}
-		return _MR(vec_type->coerce( new Null ));
-	}
+	if(index<=size())
+		return _MR(at(index-1));
 	else
 		throw RunTimeException("Vector::nextValue out of bounds");
 }
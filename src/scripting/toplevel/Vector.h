@@ -30,8 +30,26 @@ class Vector: public ASObject
 {
 	Type* vec_type;
 	bool fixed;
+	/* Vectors of int, uint and Number keep their elements unboxed,
+	 * objects are created only when elements are read by AS code */
+	enum STORAGE_KIND { STORE_OBJECT=0, STORE_INT, STORE_UINT, STORE_NUMBER };
+	STORAGE_KIND kind;
 	std::vector<ASObject*> vec;
+	//Used by STORE_INT and STORE_UINT, uints keep their bit pattern
+	std::vector<int32_t> vec_i;
+	std::vector<number_t> vec_d;
 	int capIndex(int i) const;
+	//Only valid for numeric storage
+	number_t numberAt(uint32_t index) const;
+	//Coerces o to the element type and stores it at index. It consumes one reference of 'o'
+	void storeValue(uint32_t index, ASObject* o);
+	void pushValue(ASObject* o);
+	//Coerces count values and inserts them at index. The references are not consumed
+	void insertValues(uint32_t index, ASObject* const* values, uint32_t count);
+	//Removes count elements starting at index, releasing them
+	void eraseElements(uint32_t index, uint32_t count);
+	void resizeStorage(uint32_t n);
+	bool equalsAt(uint32_t index, ASObject* o) const;
 	class sortComparatorWrapper
 	{
 	private:
@@ -41,8 +59,17 @@ class Vector: public ASObject
 		sortComparatorWrapper(IFunction* c, Type* v):comparator(c),vec_type(v){}
 		bool operator()(ASObject* d1, ASObject* d2);
 	};
+	template<class T>
+	class sortComparatorBoxed
+	{
+	private:
+		IFunction* comparator;
+	public:
+		sortComparatorBoxed(IFunction* c):comparator(c){}
+		bool operator()(T d1, T d2);
+	};
 public:
-	Vector() : vec_type(NULL) {}
+	Vector() : vec_type(NULL),kind(STORE_OBJECT) {}
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o) {};
 	static ASObject* generator(TemplatedClass<Vector>* o_class, ASObject* const* args, const unsigned int argslen);
@@ -54,6 +81,9 @@ public:
 	void setVariableByMultiname(const multiname& name, ASObject* o);
 	bool hasPropertyByMultiname(const multiname& name, bool considerDynamic);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & SKIP_IMPL)!=0; }
+	int32_t getVariableByMultiname_i(const multiname& name);
+	void setVariableByMultiname_i(const multiname& name, int32_t value);
 	static bool isValidMultiname(const multiname& name, uint32_t& index);
 
 	uint32_t nextNameIndex(uint32_t cur_index);
@@ -62,12 +92,22 @@ public:
 
 	uint32_t size() const
 	{
-		return vec.size();
+		switch(kind)
+		{
+			case STORE_INT:
+			case STORE_UINT:
+				return vec_i.size();
+			case STORE_NUMBER:
+				return vec_d.size();
+			default:
+				return vec.size();
+		}
 	}
-        ASObject* at(unsigned int index) const
-        {
-                return vec.at(index);
-        }
+	//Returns a new reference to the element at index, missing objects get the default value
+	ASObject* at(unsigned int index) const;
+	//Return the element at index converted without boxing, a RangeError is thrown if index is out of range
+	int32_t atInt(unsigned int index) const;
+	number_t atNumber(unsigned int index) const;
 
 	//TODO: do we need to implement generator?
 	ASFUNCTION(_constructor);
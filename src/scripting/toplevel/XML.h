@@ -103,6 +103,7 @@ public:
 	static void sinit(Class_base* c);
 	void getDescendantsByQName(const tiny_string& name, const tiny_string& ns, std::vector<_R<XML> >& ret);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & SKIP_IMPL)!=0; }
 	bool hasPropertyByMultiname(const multiname& name, bool considerDynamic);
 	tiny_string toString();
 	void toXMLString_priv(xmlBufferPtr buf);
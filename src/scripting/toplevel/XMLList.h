@@ -59,6 +59,7 @@ public:
 	ASFUNCTION(valueOf);
 	ASFUNCTION(text);
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return (opt & SKIP_IMPL)!=0; }
 	void setVariableByMultiname(const multiname& name, ASObject* o);
 	bool hasPropertyByMultiname(const multiname& name, bool considerDynamic);
 	void getDescendantsByQName(const tiny_string& name, const tiny_string& ns, std::vector<_R<XML> >& ret);
@@ -0,0 +1,123 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2011  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "regexp_cache.h"
+#include "threading.h"
+#include "logger.h"
+#include <list>
+#include <map>
+
+using namespace std;
+using namespace lightspark;
+
+//Number of patterns kept alive by the cache
+static const uint32_t REGEXP_CACHE_SIZE=64;
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+#define STUDY_OPTIONS PCRE_STUDY_JIT_COMPILE
+#else
+#define STUDY_OPTIONS 0
+#endif
+
+CompiledRegExp::CompiledRegExp(pcre* r, pcre_extra* e):ref_count(1),re(r),extra(e),
+	capturingGroups(0),namedGroups(0),nameEntrySize(0),nameTable(NULL)
+{
+}
+
+CompiledRegExp::~CompiledRegExp()
+{
+	if(extra)
+	{
+#ifdef PCRE_STUDY_JIT_COMPILE
+		pcre_free_study(extra);
+#else
+		pcre_free(extra);
+#endif
+	}
+	pcre_free(re);
+}
+
+class RegExpCache
+{
+private:
+	typedef pair<tiny_string, int> key_type;
+	typedef list<pair<key_type, Ref<CompiledRegExp> > > entries_type;
+	Mutex mutex;
+	//Most recently used first
+	entries_type entries;
+	map<key_type, entries_type::iterator> index;
+public:
+	_NR<CompiledRegExp> find(const key_type& key)
+	{
+		Mutex::Lock l(mutex);
+		map<key_type, entries_type::iterator>::iterator it=index.find(key);
+		if(it==index.end())
+			return NullRef;
+		entries.splice(entries.begin(),entries,it->second);
+		return it->second->second;
+	}
+	void insert(const key_type& key, const Ref<CompiledRegExp>& r)
+	{
+		Mutex::Lock l(mutex);
+		if(index.count(key))
+			return;
+		entries.push_front(make_pair(key,r));
+		index[key]=entries.begin();
+		if(entries.size()>REGEXP_CACHE_SIZE)
+		{
+			//Patterns still used by RegExp objects stay alive
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+	}
+};
+
+static RegExpCache& getRegExpCache()
+{
+	static RegExpCache cache;
+	return cache;
+}
+
+_NR<CompiledRegExp> CompiledRegExp::get(const tiny_string& source, int options)
+{
+	const pair<tiny_string, int> key(source,options);
+	_NR<CompiledRegExp> ret=getRegExpCache().find(key);
+	if(!ret.isNull())
+		return ret;
+
+	const char* error;
+	int errorOffset;
+	pcre* pcreRE=pcre_compile(source.raw_buf(), options, &error, &errorOffset,NULL);
+	if(pcreRE==NULL)
+		return NullRef;
+	//Studying is worth it as patterns are reused
+	pcre_extra* extra=pcre_study(pcreRE, STUDY_OPTIONS, &error);
+	if(error)
+		LOG(LOG_ERROR,_("pcre_study failed: ") << error);
+	Ref<CompiledRegExp> compiled=_MR(new CompiledRegExp(pcreRE,extra));
+	if(pcre_fullinfo(pcreRE, extra, PCRE_INFO_CAPTURECOUNT, &compiled->capturingGroups)!=0 ||
+		pcre_fullinfo(pcreRE, extra, PCRE_INFO_NAMECOUNT, &compiled->namedGroups)!=0 ||
+		pcre_fullinfo(pcreRE, extra, PCRE_INFO_NAMEENTRYSIZE, &compiled->nameEntrySize)!=0 ||
+		pcre_fullinfo(pcreRE, extra, PCRE_INFO_NAMETABLE, &compiled->nameTable)!=0)
+	{
+		return NullRef;
+	}
+	getRegExpCache().insert(key,compiled);
+	return compiled;
+}
@@ -0,0 +1,65 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2011  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef TOPLEVEL_REGEXP_CACHE_H
+#define TOPLEVEL_REGEXP_CACHE_H
+
+#include "compat.h"
+#include "swftypes.h"
+#include "smartrefs.h"
+#include <pcre.h>
+
+namespace lightspark
+{
+
+/*
+ * A compiled and studied pcre pattern, with the pattern information that is
+ * needed to run it. Patterns are kept in a process wide LRU cache keyed by
+ * source and options, so RegExp objects created again and again for the same
+ * literal share a single compilation
+ */
+class CompiledRegExp
+{
+private:
+	ATOMIC_INT32(ref_count);
+	pcre* re;
+	pcre_extra* extra;
+	CompiledRegExp(pcre* r, pcre_extra* e);
+	~CompiledRegExp();
+public:
+	int capturingGroups;
+	int namedGroups;
+	int nameEntrySize;
+	char* nameTable;
+	void incRef() { ATOMIC_INCREMENT(ref_count); }
+	void decRef()
+	{
+		if(ATOMIC_DECREMENT(ref_count)==0)
+			delete this;
+	}
+	//Returns NullRef if the pattern does not compile
+	static _NR<CompiledRegExp> get(const tiny_string& source, int options);
+	int exec(const tiny_string& subject, int offset, int* ovector, int ovectorSize) const
+	{
+		return pcre_exec(re, extra, subject.raw_buf(), subject.numBytes(), offset, 0, ovector, ovectorSize);
+	}
+};
+
+};
+#endif
@@ -45,6 +45,7 @@
 #include "backends/urlutils.h"
 #include "parsing/amf3_generator.h"
 #include "argconv.h"
+#include "regexp_cache.h"
 
 using namespace std;
 using namespace lightspark;
@@ -635,7 +636,7 @@ ASFUNCTIONBODY(IFunction,apply)
 	if(argslen==0 || args[0]->is<Null>() || args[0]->is<Undefined>())
 	{
 		//get the current global object
-		newObj=getVm()->currentCallContext->scope_stack[0].object->as<Global>();
+		newObj=getVm()->currentCallContext->scopeAt(0).object->as<Global>();
 		newObj->incRef();
 	}
 	else
@@ -671,7 +672,7 @@ ASFUNCTIONBODY(IFunction,_call)
 	if(argslen==0 || args[0]->is<Null>() || args[0]->is<Undefined>())
 	{
 		//get the current global object
-		newObj=getVm()->currentCallContext->scope_stack[0].object->as<Global>();
+		newObj=getVm()->currentCallContext->scopeAt(0).object->as<Global>();
 		newObj->incRef();
 	}
 	else
@@ -777,12 +778,19 @@ ASObject* SyntheticFunction::call(ASObject* obj, ASObject* const* args, uint32_t
 			throw Class<ArgumentError>::getInstanceS("Error #1063: Not enough arguments provided");
 	}
 
-	//Temporarily disable JITting
-	if(!mi->body->exception_count && getSys()->useJit && (hit_count==hit_threshold || getSys()->useInterpreter==false))
+	if(getSys()->useJit && val==NULL)
 	{
-		//We passed the hot function threshold, synt the function
-		val=mi->synt_method();
-		assert_and_throw(val);
+		if(getSys()->useInterpreter==false)
+		{
+			val=getVm()->compileMethod(mi);
+			assert_and_throw(val);
+		}
+		else if(hit_count>=hit_threshold)
+		{
+			//We passed the hot function threshold, the function is compiled in the background
+			//and interpreted until the native code is ready
+			val=getVm()->getCompiledMethod(mi);
+		}
 	}
 
 	//Prepare arguments
@@ -822,8 +830,7 @@ ASObject* SyntheticFunction::call(ASObject* obj, ASObject* const* args, uint32_t
 	cc.stack_index=0;
 	cc.context=mi->context;
 	//cc.code= new istringstream(mi->body->code);
-	cc.scope_stack=func_scope;
-	cc.initialScopeStack=func_scope.size();
+	cc.parent_scope_stack=&func_scope;
 	cc.exec_pos=0;
 
 	/* Set the current global object, each script in each DoABCTag has its own */
@@ -859,7 +866,7 @@ ASObject* SyntheticFunction::call(ASObject* obj, ASObject* const* args, uint32_t
 			cc.locals[i+1]=mi->paramTypes[i]->coerce(mi->getOptional(iOptional));
 		else {
 			assert(mi->paramTypes[i] == Type::anyType);
-			cc.locals[i+1]=new Undefined();
+			cc.locals[i+1]=getVm()->getUndefinedRef();
 		}
 	}
 
@@ -891,7 +898,7 @@ ASObject* SyntheticFunction::call(ASObject* obj, ASObject* const* args, uint32_t
 	{
 		try
 		{
-			if(mi->body->exception_count || (val==NULL && getSys()->useInterpreter))
+			if(val==NULL && getSys()->useInterpreter)
 			{
 				//This is not a hot function, execute it using the interpreter
 				ret=ABCVm::executeFunction(this,&cc);
@@ -918,8 +925,6 @@ ASObject* SyntheticFunction::call(ASObject* obj, ASObject* const* args, uint32_t
 					cc.runtime_stack_clear();
 					cc.runtime_stack_push(excobj);
 					cc.scope_stack.clear();
-					cc.scope_stack=func_scope;
-					cc.initialScopeStack=func_scope.size();
 					break;
 				}
 			}
@@ -944,7 +949,7 @@ ASObject* SyntheticFunction::call(ASObject* obj, ASObject* const* args, uint32_t
 	obj->decRef();
 
 	if(ret==NULL)
-		ret=new Undefined;
+		ret=getVm()->getUndefinedRef();
 
 	return mi->returnType->coerce(ret);
 }
@@ -1057,12 +1062,47 @@ void Null::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
 	out->writeByte(null_marker);
 }
 
-RegExp::RegExp():dotall(false),global(false),ignoreCase(false),extended(false),multiline(false),lastIndex(0)
+RegExp::RegExp():compiled(NULL),dotall(false),global(false),ignoreCase(false),extended(false),multiline(false),lastIndex(0)
+{
+}
+
+RegExp::RegExp(const tiny_string& _re):compiled(NULL),dotall(false),global(false),ignoreCase(false),extended(false),multiline(false),lastIndex(0),source(_re)
+{
+}
+
+RegExp::~RegExp()
 {
+	if(compiled)
+		compiled->decRef();
 }
 
-RegExp::RegExp(const tiny_string& _re):dotall(false),global(false),ignoreCase(false),extended(false),multiline(false),lastIndex(0),source(_re)
+int RegExp::getPCREOptions() const
 {
+	int options=PCRE_UTF8;
+	if(ignoreCase)
+		options|=PCRE_CASELESS;
+	if(extended)
+		options|=PCRE_EXTENDED;
+	if(multiline)
+		options|=PCRE_MULTILINE;
+	if(dotall)
+		options|=PCRE_DOTALL;
+	return options;
+}
+
+CompiledRegExp* RegExp::getCompiled()
+{
+	//The source and the flags can't change after construction
+	if(compiled==NULL)
+	{
+		_NR<CompiledRegExp> r=CompiledRegExp::get(source,getPCREOptions());
+		if(!r.isNull())
+		{
+			r->incRef();
+			compiled=r.getPtr();
+		}
+	}
+	return compiled;
 }
 
 void RegExp::sinit(Class_base* c)
@@ -1169,65 +1209,25 @@ ASFUNCTIONBODY(RegExp,exec)
 
 ASObject *RegExp::match(const tiny_string& str)
 {
-	const char* error;
-	int errorOffset;
-	int options=PCRE_UTF8;
-	if(ignoreCase)
-		options|=PCRE_CASELESS;
-	if(extended)
-		options|=PCRE_EXTENDED;
-	if(multiline)
-		options|=PCRE_MULTILINE;
-	if(dotall)
-		options|=PCRE_DOTALL;
-	pcre* pcreRE=pcre_compile(source.raw_buf(), options, &error, &errorOffset,NULL);
-	if(error)
+	CompiledRegExp* pcreRE=getCompiled();
+	if(pcreRE==NULL)
 		return new Null;
 	//Verify that 30 for ovector is ok, it must be at least (captGroups+1)*3
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return new Null;
-	}
+	int capturingGroups=pcreRE->capturingGroups;
 	assert_and_throw(capturingGroups<10);
-	//Get information about named capturing groups
-	int namedGroups;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMECOUNT, &namedGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return new Null;
-	}
-	//Get information about the size of named entries
-	int namedSize;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMEENTRYSIZE, &namedSize);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return new Null;
-	}
 	struct nameEntry
 	{
 		uint16_t number;
 		char name[0];
 	};
-	char* entries;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMETABLE, &entries);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return new Null;
-	}
+	char* entries=pcreRE->nameTable;
 
 	int ovector[30];
 	int offset=global?lastIndex:0;
-	int rc=pcre_exec(pcreRE, NULL, str.raw_buf(), str.numBytes(), offset, 0, ovector, 30);
+	int rc=pcreRE->exec(str, offset, ovector, 30);
 	if(rc<0)
 	{
 		//No matches or error
-		pcre_free(pcreRE);
 		return new Null;
 	}
 	Array* a=Class<Array>::getInstanceS();
@@ -1246,17 +1246,16 @@ ASObject *RegExp::match(const tiny_string& str)
 	int index = tmp.numChars();
 
 	a->setVariableByQName("index","",abstract_i(index),DYNAMIC_TRAIT);
-	for(int i=0;i<namedGroups;i++)
+	for(int i=0;i<pcreRE->namedGroups;i++)
 	{
 		nameEntry* entry=(nameEntry*)entries;
 		uint16_t num=GINT16_FROM_BE(entry->number);
 		ASObject* captured=a->at(num);
 		captured->incRef();
 		a->setVariableByQName(tiny_string(entry->name, true),"",captured,DYNAMIC_TRAIT);
-		entries+=namedSize;
+		entries+=pcreRE->nameEntrySize;
 	}
 	lastIndex=ovector[1];
-	pcre_free(pcreRE);
 	return a;
 }
 
@@ -1266,27 +1265,14 @@ ASFUNCTIONBODY(RegExp,test)
 
 	const tiny_string& arg0 = args[0]->toString();
 
-	int options = PCRE_UTF8;
-	if(th->ignoreCase)
-		options |= PCRE_CASELESS;
-	if(th->extended)
-		options |= PCRE_EXTENDED;
-	if(th->multiline)
-		options |= PCRE_MULTILINE;
-	if(th->dotall)
-		options|=PCRE_DOTALL;
-
-	const char * error;
-	int errorOffset;
-	pcre * pcreRE = pcre_compile(th->source.raw_buf(), options, &error, &errorOffset, NULL);
-	if(error)
+	CompiledRegExp* pcreRE=th->getCompiled();
+	if(pcreRE==NULL)
 		return new Null;
 
 	int ovector[30];
 	int offset=(th->global)?th->lastIndex:0;
-	int rc = pcre_exec(pcreRE, NULL, arg0.raw_buf(), arg0.numBytes(), offset, 0, ovector, 30);
+	int rc = pcreRE->exec(arg0, offset, ovector, 30);
 	bool ret = (rc >= 0);
-	pcre_free(pcreRE);
 
 	return abstract_b(ret);
 }
@@ -1389,6 +1375,9 @@ Class_base::Class_base(const QName& name):use_protected(false),protected_ns("",P
 	isFinal(false),isSealed(false),context(NULL),class_name(name),class_index(-1)
 {
 	type=T_CLASS;
+#ifdef PROFILING_SUPPORT
+	allocationCount=0;
+#endif
 }
 
 /*
@@ -1404,12 +1393,10 @@ Class_base::Class_base(const QName& name):use_protected(false),protected_ns("",P
  */
 void Class_base::copyBorrowedTraitsFromSuper()
 {
-	assert(Variables.Variables.empty());
-	variables_map::var_iterator i = super->Variables.Variables.begin();
-	for(;i != super->Variables.Variables.end(); ++i)
+	assert(Variables.size()==0);
+	for(int i=0;i<super->Variables.size();i++)
 	{
-		const tiny_string& name = i->first;
-		variable& v = i->second;
+		variable& v = *super->Variables.getValueAt(i);
 		//copy only static and instance methods
 		if(v.kind != BORROWED_TRAIT)
 			continue;
@@ -1419,15 +1406,14 @@ void Class_base::copyBorrowedTraitsFromSuper()
 			v.getter->incRef();
 		if(v.setter)
 			v.setter->incRef();
-		const variables_map::var_iterator ret_end=Variables.Variables.upper_bound(name);
-		variables_map::var_iterator inserted=Variables.Variables.insert(ret_end,make_pair(name,v));
+		variable* inserted=Variables.copyVar(v);
 
 		//Overwrite protected ns
-		if(super->use_protected && v.ns.count(nsNameAndKind(super->protected_ns.name,PROTECTED_NAMESPACE)))
+		if(super->use_protected && v.hasNamespace(super->protected_ns.nameId))
 		{
 			assert(use_protected);
 			//add this classes protected ns
-			inserted->second.ns.insert(nsNameAndKind(protected_ns.name,PROTECTED_NAMESPACE));
+			inserted->addNamespace(protected_ns.nameId);
 		}
 	}
 }
@@ -1474,6 +1460,7 @@ void Class_base::addPrototypeGetter()
 
 Class_base::~Class_base()
 {
+	property_cache::invalidate();
 	if(!referencedObjects.empty())
 		LOG(LOG_ERROR,_("Class destroyed without cleanUp called"));
 }
@@ -1566,6 +1553,9 @@ void Class_base::acquireObject(ASObject* ob)
 	Locker l(referencedObjectsMutex);
 	bool ret=referencedObjects.insert(ob).second;
 	assert_and_throw(ret);
+#ifdef PROFILING_SUPPORT
+	allocationCount++;
+#endif
 }
 
 void Class_base::abandonObject(ASObject* ob)
@@ -1597,6 +1587,8 @@ void Class_base::finalizeObjects() const
 void Class_base::finalize()
 {
 	finalizeObjects();
+	//Borrowed variables are going away, drop them from the property caches
+	property_cache::invalidate();
 
 	ASObject::finalize();
 	if(constructor)
@@ -129,6 +129,10 @@ public:
 	ABCContext* context;
 	QName class_name;
 	int class_index;
+#ifdef PROFILING_SUPPORT
+	//Objects that got this class, dumped with the profiling data
+	uint64_t allocationCount;
+#endif
 	void handleConstruction(ASObject* target, ASObject* const* args, unsigned int argslen, bool buildAndLink);
 	void setConstructor(IFunction* c);
 	Class_base(const QName& name);
@@ -219,6 +223,7 @@ private:
 public:
 	//Name is 'Object' because trace(new f()) gives "[object Object]"
 	Class_function() : Class_base(QName("Object","")) {}
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return false; }
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt=NONE)
 	{
 		return NullRef;
@@ -303,6 +308,7 @@ public:
 
 class Function : public IFunction
 {
+friend class ABCVm;
 friend class Class<IFunction>;
 public:
 	typedef ASObject* (*as_function)(ASObject*, ASObject* const *, const unsigned int);
@@ -580,6 +586,7 @@ public:
 				std::map<const Class_base*, uint32_t>& traitsMap);
 };
 
+class CompiledRegExp;
 class RegExp: public ASObject
 {
 CLASSBUILDABLE(RegExp);
@@ -587,10 +594,16 @@ friend class ASString;
 private:
 	RegExp();
 	RegExp(const tiny_string& _re);
+	~RegExp();
+	//Shared with the regexp cache, see CompiledRegExp
+	CompiledRegExp* compiled;
 public:
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o);
 	ASObject *match(const tiny_string& str);
+	int getPCREOptions() const;
+	//Compiles the pattern on first use, returns NULL if it is not valid
+	CompiledRegExp* getCompiled();
 	ASFUNCTION(_constructor);
 	ASFUNCTION(generator);
 	ASFUNCTION(exec);
@@ -616,6 +629,7 @@ private:
 	int scriptId;
 public:
 	_NR<ASObject> getVariableByMultiname(const multiname& name, GET_VARIABLE_OPTION opt=NONE);
+	bool hasDefaultPropertyLookup(GET_VARIABLE_OPTION opt) const { return false; }
 };
 
 ASObject* eval(ASObject* obj,ASObject* const* args, const unsigned int argslen);
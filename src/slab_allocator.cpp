@@ -0,0 +1,251 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2011  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "slab_allocator.h"
+#include "threading.h"
+#include <glib.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace lightspark;
+
+static const uint32_t SIZE_CLASSES=SlabAllocator::MAX_SIZE/SlabAllocator::GRANULARITY;
+//Memory carved into blocks of a single size class at once
+static const size_t SLAB_SIZE=64*1024;
+//Blocks moved between a thread and the depot at once
+static const uint32_t BATCH=32;
+
+struct FreeBlock
+{
+	FreeBlock* next;
+};
+
+struct FreeList
+{
+	FreeBlock* head;
+	uint32_t count;
+	FreeList():head(NULL),count(0){}
+	void push(FreeBlock* b)
+	{
+		b->next=head;
+		head=b;
+		count++;
+	}
+	FreeBlock* pop()
+	{
+		FreeBlock* ret=head;
+		head=ret->next;
+		count--;
+		return ret;
+	}
+};
+
+struct ThreadCache
+{
+	FreeList lists[SIZE_CLASSES];
+#ifdef PROFILING_SUPPORT
+	uint64_t allocations[SIZE_CLASSES];
+	uint64_t frees[SIZE_CLASSES];
+	ThreadCache()
+	{
+		for(uint32_t i=0;i<SIZE_CLASSES;i++)
+		{
+			allocations[i]=0;
+			frees[i]=0;
+		}
+	}
+#endif
+};
+
+class Depot
+{
+private:
+	Mutex mutex;
+	FreeList lists[SIZE_CLASSES];
+#ifdef PROFILING_SUPPORT
+	//Counters of the threads that already terminated
+	uint64_t allocations[SIZE_CLASSES];
+	uint64_t frees[SIZE_CLASSES];
+	uint64_t slabs[SIZE_CLASSES];
+	std::vector<ThreadCache*> caches;
+#endif
+public:
+	Depot()
+	{
+#ifdef PROFILING_SUPPORT
+		for(uint32_t i=0;i<SIZE_CLASSES;i++)
+		{
+			allocations[i]=0;
+			frees[i]=0;
+			slabs[i]=0;
+		}
+#endif
+	}
+	//Moves a batch of blocks of size class sc to l, which must be empty
+	void refill(uint32_t sc, FreeList& l)
+	{
+		Mutex::Lock lock(mutex);
+		FreeList& d=lists[sc];
+		if(d.head==NULL)
+		{
+			const size_t blockSize=(sc+1)*SlabAllocator::GRANULARITY;
+			char* slab=static_cast<char*>(::operator new(SLAB_SIZE));
+			for(size_t off=0;off+blockSize<=SLAB_SIZE;off+=blockSize)
+				d.push(reinterpret_cast<FreeBlock*>(slab+off));
+#ifdef PROFILING_SUPPORT
+			slabs[sc]++;
+#endif
+		}
+		for(uint32_t i=0;i<BATCH && d.head;i++)
+			l.push(d.pop());
+	}
+	//Moves count blocks of size class sc from l back to the depot
+	void release(uint32_t sc, FreeList& l, uint32_t count)
+	{
+		Mutex::Lock lock(mutex);
+		for(uint32_t i=0;i<count && l.head;i++)
+			lists[sc].push(l.pop());
+	}
+#ifdef PROFILING_SUPPORT
+	void addCache(ThreadCache* c)
+	{
+		Mutex::Lock lock(mutex);
+		caches.push_back(c);
+	}
+#endif
+	//Takes back all the blocks of a terminating thread
+	void removeCache(ThreadCache* c)
+	{
+		Mutex::Lock lock(mutex);
+		for(uint32_t i=0;i<SIZE_CLASSES;i++)
+		{
+			while(c->lists[i].head)
+				lists[i].push(c->lists[i].pop());
+		}
+#ifdef PROFILING_SUPPORT
+		for(uint32_t i=0;i<SIZE_CLASSES;i++)
+		{
+			allocations[i]+=c->allocations[i];
+			frees[i]+=c->frees[i];
+		}
+		caches.erase(std::find(caches.begin(),caches.end(),c));
+#endif
+	}
+#ifdef PROFILING_SUPPORT
+	void dumpStatistics(std::ostream& f)
+	{
+		Mutex::Lock lock(mutex);
+		f << "# allocator: size allocations frees slabs" << endl;
+		for(uint32_t i=0;i<SIZE_CLASSES;i++)
+		{
+			//The counters of the running threads may be slightly stale
+			uint64_t a=allocations[i];
+			uint64_t fr=frees[i];
+			for(uint32_t j=0;j<caches.size();j++)
+			{
+				a+=caches[j]->allocations[i];
+				fr+=caches[j]->frees[i];
+			}
+			if(a==0 && fr==0)
+				continue;
+			f << "# allocator: " << (i+1)*SlabAllocator::GRANULARITY << ' ' << a << ' ' << fr << ' ' << slabs[i] << endl;
+		}
+	}
+#endif
+};
+
+static Depot& getDepot()
+{
+	//Constructed on first use, objects are allocated during static initialization too
+	static Depot depot;
+	return depot;
+}
+
+static GStaticPrivate thread_cache = G_STATIC_PRIVATE_INIT; /* TLS */
+
+static void destroyThreadCache(gpointer c)
+{
+	ThreadCache* cache=static_cast<ThreadCache*>(c);
+	getDepot().removeCache(cache);
+	delete cache;
+}
+
+static ThreadCache* getThreadCache()
+{
+	ThreadCache* ret=static_cast<ThreadCache*>(g_static_private_get(&thread_cache));
+	if(ret==NULL)
+	{
+		ret=new ThreadCache;
+#ifdef PROFILING_SUPPORT
+		getDepot().addCache(ret);
+#endif
+		g_static_private_set(&thread_cache,ret,destroyThreadCache);
+	}
+	return ret;
+}
+
+static inline uint32_t sizeClass(size_t size)
+{
+	return (size+SlabAllocator::GRANULARITY-1)/SlabAllocator::GRANULARITY-1;
+}
+
+void* SlabAllocator::allocate(size_t size)
+{
+	if(size>MAX_SIZE || size==0)
+		return ::operator new(size);
+	const uint32_t sc=sizeClass(size);
+	ThreadCache* cache=getThreadCache();
+	FreeList& l=cache->lists[sc];
+	if(l.head==NULL)
+		getDepot().refill(sc,l);
+#ifdef PROFILING_SUPPORT
+	cache->allocations[sc]++;
+#endif
+	return l.pop();
+}
+
+void SlabAllocator::deallocate(void* p, size_t size)
+{
+	if(p==NULL)
+		return;
+	if(size>MAX_SIZE || size==0)
+	{
+		::operator delete(p);
+		return;
+	}
+	const uint32_t sc=sizeClass(size);
+	ThreadCache* cache=getThreadCache();
+	FreeList& l=cache->lists[sc];
+	l.push(static_cast<FreeBlock*>(p));
+#ifdef PROFILING_SUPPORT
+	cache->frees[sc]++;
+#endif
+	//Blocks freed by this thread but allocated by others pile up here
+	if(l.count>2*BATCH)
+		getDepot().release(sc,l,BATCH);
+}
+
+#ifdef PROFILING_SUPPORT
+void SlabAllocator::dumpStatistics(std::ostream& f)
+{
+	getDepot().dumpStatistics(f);
+}
+#endif
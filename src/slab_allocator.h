@@ -0,0 +1,54 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2011  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef _SLAB_ALLOCATOR_H
+#define _SLAB_ALLOCATOR_H
+
+#include "compat.h"
+#include <cstddef>
+#include <iostream>
+
+namespace lightspark
+{
+
+/*
+ * Size class allocator behind ASObject::operator new. Each thread keeps
+ * free lists of blocks for every size class. They are refilled in batches
+ * from a depot shared by all threads, and overflow back to it when too many
+ * blocks are freed by the thread, which is how objects released by the
+ * render and parsing threads find their way back to the VM thread.
+ * Memory is never returned to the system
+ */
+class SlabAllocator
+{
+public:
+	//Bigger allocations go to the global operator new
+	static const size_t MAX_SIZE=1024;
+	static const size_t GRANULARITY=16;
+	static void* allocate(size_t size);
+	//size must be the one passed to allocate
+	static void deallocate(void* p, size_t size);
+#ifdef PROFILING_SUPPORT
+	//Writes the counters of each size class, as callgrind comments
+	static void dumpStatistics(std::ostream& f);
+#endif
+};
+
+};
+#endif
@@ -19,6 +19,7 @@
 
 #include <string>
 #include <algorithm>
+#include <deque>
 #include "scripting/abc.h"
 #include "scripting/flash/events/flashevents.h"
 #include "scripting/flash/utils/flashutils.h"
@@ -177,7 +178,7 @@ SystemState::SystemState(uint32_t fileSize):
 
 	mainThread = Thread::self();
 	applicationDomain=_MR(Class<ApplicationDomain>::getInstanceS());
-	threadPool=new ThreadPool(this);
+	threadPool=new ThreadPool(this, Config::getConfig()->getWorkerThreads());
 	timerThread=new TimerThread(this);
 	pluginManager = new PluginManager;
 	audioManager=new AudioManager(pluginManager);
@@ -366,6 +367,16 @@ void SystemState::saveProfilingInformation()
 		f << "events: Time" << endl;
 		for(uint32_t i=0;i<contextes.size();i++)
 			contextes[i]->dumpProfilingData(f);
+		//Memory statistics are appended as comments, the callgrind format ignores them
+		SlabAllocator::dumpStatistics(f);
+		variables_map::dumpStatistics(f);
+		f << "# objects: class count" << endl;
+		std::map<QName, Class_base*>::const_iterator it=classes.begin();
+		for(;it!=classes.end();++it)
+		{
+			if(it->second->allocationCount)
+				f << "# objects: " << it->first << ' ' << it->second->allocationCount << endl;
+		}
 		f.close();
 	}
 }
@@ -1033,6 +1044,125 @@ void ThreadProfile::plot(uint32_t maxTime, cairo_t *cr)
 	}
 }
 
+/*
+ * Parses a tag read by TagFactory::readTagOrBody in the thread pool. If no
+ * worker has started it yet when the result is needed, the parser thread
+ * parses it by itself, so waiting never depends on a free worker
+ */
+class ParseTagJob: public IThreadJob
+{
+private:
+	ATOMIC_INT32(ref_count);
+	Mutex mutex;
+	bool started;
+	Semaphore finished;
+	ACQUIRE_RELEASE_FLAG(ready);
+	ParseThread* parser;
+	RECORDHEADER header;
+	std::string body;
+	_NR<Tag> tag;
+	std::string error;
+	bool claim()
+	{
+		Locker l(mutex);
+		if(started)
+			return false;
+		started=true;
+		return true;
+	}
+	void parse();
+public:
+	ParseTagJob(ParseThread* p, RECORDHEADER h, std::string& b):ref_count(1),started(false),finished(0),
+		ready(false),parser(p),header(h)
+	{
+		body.swap(b);
+	}
+	void incRef() { ATOMIC_INCREMENT(ref_count); }
+	void decRef()
+	{
+		if(ATOMIC_DECREMENT(ref_count)==0)
+			delete this;
+	}
+	void execute()
+	{
+		if(claim())
+			parse();
+	}
+	void jobFence()
+	{
+		decRef();
+	}
+	bool isReady() const { return ACQUIRE_READ(ready); }
+	//Waits for the parsed tag, throws if parsing failed
+	_R<Tag> getTag();
+	//Makes sure that no worker is using the job anymore
+	void cancel();
+};
+
+void ParseTagJob::parse()
+{
+	//The tags look up the dictionary of the clip being parsed
+	ParseThread* prev=(ParseThread*)g_static_private_get(&parse_thread_tls);
+	g_static_private_set(&parse_thread_tls,parser,NULL);
+	try
+	{
+		tag=TagFactory::parseTag(header, body);
+	}
+	catch(LightsparkException& e)
+	{
+		error=e.cause;
+	}
+	catch(std::exception& e)
+	{
+		error=e.what();
+	}
+	g_static_private_set(&parse_thread_tls,prev,NULL);
+	std::string().swap(body);
+	RELEASE_WRITE(ready,true);
+	finished.signal();
+}
+
+_R<Tag> ParseTagJob::getTag()
+{
+	if(claim())
+		parse();
+	else if(!isReady())
+		finished.wait();
+	if(tag.isNull())
+		throw ParseException(error);
+	return tag;
+}
+
+void ParseTagJob::cancel()
+{
+	if(claim() || isReady())
+		return;
+	finished.wait();
+}
+
+//Limits how far the parser reads ahead of the tags still being parsed
+static const size_t MAX_PENDING_TAGS=256;
+
+struct PendingTag
+{
+	_NR<Tag> tag;
+	ParseTagJob* job;
+	PendingTag(_NR<Tag> t, ParseTagJob* j):tag(t),job(j){}
+};
+
+static void cancelPendingTags(std::deque<PendingTag>& pending)
+{
+	for(auto it=pending.begin();it!=pending.end();++it)
+	{
+		if(it->job)
+		{
+			it->job->cancel();
+			it->job->decRef();
+		}
+	}
+	pending.clear();
+}
+
 ParseThread::ParseThread(istream& in, _NR<ApplicationDomain> appDomain, Loader *_loader, tiny_string srcurl)
   : version(0),applicationDomain(appDomain),
     f(in),zlibFilter(NULL),backend(NULL),loader(_loader),
@@ -1194,96 +1324,64 @@ void ParseThread::parseSWF(UI8 ver)
 			}
 		}
 
+		/*
+		 * Deferrable tags are parsed in the thread pool while the
+		 * following ones are read. Tags are still processed in file
+		 * order, so a frame is committed as soon as all its tags are
+		 * parsed. Dictionary tags parsed here are added right away,
+		 * as the deferred tags may refer to them while parsing
+		 */
+		std::deque<PendingTag> pending;
 		bool done=false;
 		bool empty=true;
-		while(!done)
+		try
 		{
-			tag=factory.readTag();
-			switch(tag->getType())
+			while(!done)
 			{
-				case END_TAG:
+				RECORDHEADER h;
+				std::string body;
+				tag=factory.readTagOrBody(h, body);
+				if(tag.isNull())
 				{
-					// The whole frame has been parsed, now execute all queued SymbolClass tags,
-					// in the order in which they appeared in the file.
-					while(!symbolClassTags.empty())
-					{
-						symbolClassTags.front()->execute(root);
-						symbolClassTags.pop();
-					}
-
-					if(!empty)
-						root->commitFrame(false);
-					else
-						root->revertFrame();
-					RELEASE_WRITE(root->finishedLoading,true);
-					done=true;
-					root->check();
-					break;
+					ParseTagJob* job=new ParseTagJob(this, h, body);
+					pending.push_back(PendingTag(NullRef, job));
+					//One reference is released by the pool
+					job->incRef();
+					getSys()->addJob(job);
 				}
-				case DICT_TAG:
+				else if(tag->getType()==DICT_TAG)
+					processTag(tag, root, empty);
+				else
+					pending.push_back(PendingTag(tag, NULL));
+
+				//Process the tags that are ready, waiting for all of them at the end of a frame
+				bool wait=(!tag.isNull() && (tag->getType()==SHOW_TAG || tag->getType()==END_TAG)) ||
+					pending.size()>=MAX_PENDING_TAGS;
+				while(!pending.empty() && !done)
 				{
-					_R<DictionaryTag> d=tag.cast<DictionaryTag>();
-					d->setLoadedFrom(root);
-					root->addToDictionary(d);
-					break;
-				}
-				case DISPLAY_LIST_TAG:
-					root->addToFrame(tag.cast<DisplayListTag>());
-					empty=false;
-					break;
-				case SHOW_TAG:
-					// The whole frame has been parsed, now execute all queued SymbolClass tags,
-					// in the order in which they appeared in the file.
-					while(!symbolClassTags.empty())
+					PendingTag& p=pending.front();
+					if(p.job)
 					{
-						symbolClassTags.front()->execute(root);
-						symbolClassTags.pop();
+						if(!wait && !p.job->isReady())
+							break;
+						p.tag=p.job->getTag();
+						p.job->decRef();
+						p.job=NULL;
 					}
-
-					root->commitFrame(true);
-					empty=true;
-					break;
-				case SYMBOL_CLASS_TAG:
-				{
-					// Add symbol class tags to the queue, to be executed when the rest of the 
-					// frame has been parsed. This is to handle invalid SWF files that define ID's
-					// used in the SymbolClass tag only after the tag, which would otherwise result
-					// in "undefined dictionary ID" errors.
-					_R<ControlTag> stag = tag.cast<ControlTag>();
-					symbolClassTags.push(stag);
-					break;
-				}
-				case CONTROL_TAG:
-					/* The spec is not clear about that,
-					 * but it seems that all the CONTROL_TAGs
-					 * (=not one of the other tag types here)
-					 * appear in the first frame only.
-					 * We rely on that by not using
-					 * locking in ctag->execute's implementation.
-					 * ABC_TAG's are an exception, as they require no locking.
-					 */
-					assert(root->frames.size()==1);
-					//fall through
-				case ABC_TAG:
-				{
-					_R<ControlTag> ctag = tag.cast<ControlTag>();
-					ctag->execute(root);
-					break;
+					_R<Tag> t=p.tag;
+					pending.pop_front();
+					done=processTag(t, root, empty);
 				}
-				case FRAMELABEL_TAG:
-					/* No locking required, as the last frames is not
-					 * commited to the vm yet.
-					 */
-					root->addFrameLabel(root->frames.size()-1,static_cast<FrameLabelTag*>(tag.getPtr())->Name);
-					empty=false;
-					break;
-				case TAG:
-					//Not yet implemented tag, ignore it
+				if(getSys()->shouldTerminate() || threadAborting)
 					break;
 			}
-			if(getSys()->shouldTerminate() || threadAborting)
-				break;
 		}
+		catch(std::exception& e)
+		{
+			cancelPendingTags(pending);
+			throw;
+		}
+		cancelPendingTags(pending);
 	}
 	catch(std::exception& e)
 	{
@@ -1293,6 +1391,94 @@ void ParseThread::parseSWF(UI8 ver)
 	LOG(LOG_INFO,_("End of parsing"));
 }
 
+bool ParseThread::processTag(_R<Tag> tag, RootMovieClip* root, bool& empty)
+{
+	bool done=false;
+	switch(tag->getType())
+	{
+		case END_TAG:
+		{
+			// The whole frame has been parsed, now execute all queued SymbolClass tags,
+			// in the order in which they appeared in the file.
+			while(!symbolClassTags.empty())
+			{
+				symbolClassTags.front()->execute(root);
+				symbolClassTags.pop();
+			}
+
+			if(!empty)
+				root->commitFrame(false);
+			else
+				root->revertFrame();
+			RELEASE_WRITE(root->finishedLoading,true);
+			done=true;
+			root->check();
+			break;
+		}
+		case DICT_TAG:
+		{
+			_R<DictionaryTag> d=tag.cast<DictionaryTag>();
+			d->setLoadedFrom(root);
+			root->addToDictionary(d);
+			break;
+		}
+		case DISPLAY_LIST_TAG:
+			root->addToFrame(tag.cast<DisplayListTag>());
+			empty=false;
+			break;
+		case SHOW_TAG:
+			// The whole frame has been parsed, now execute all queued SymbolClass tags,
+			// in the order in which they appeared in the file.
+			while(!symbolClassTags.empty())
+			{
+				symbolClassTags.front()->execute(root);
+				symbolClassTags.pop();
+			}
+
+			root->commitFrame(true);
+			empty=true;
+			break;
+		case SYMBOL_CLASS_TAG:
+		{
+			// Add symbol class tags to the queue, to be executed when the rest of the 
+			// frame has been parsed. This is to handle invalid SWF files that define ID's
+			// used in the SymbolClass tag only after the tag, which would otherwise result
+			// in "undefined dictionary ID" errors.
+			_R<ControlTag> stag = tag.cast<ControlTag>();
+			symbolClassTags.push(stag);
+			break;
+		}
+		case CONTROL_TAG:
+			/* The spec is not clear about that,
+			 * but it seems that all the CONTROL_TAGs
+			 * (=not one of the other tag types here)
+			 * appear in the first frame only.
+			 * We rely on that by not using
+			 * locking in ctag->execute's implementation.
+			 * ABC_TAG's are an exception, as they require no locking.
+			 */
+			assert(root->frames.size()==1);
+			//fall through
+		case ABC_TAG:
+		{
+			_R<ControlTag> ctag = tag.cast<ControlTag>();
+			ctag->execute(root);
+			break;
+		}
+		case FRAMELABEL_TAG:
+			/* No locking required, as the last frames is not
+			 * commited to the vm yet.
+			 */
+			root->addFrameLabel(root->frames.size()-1,static_cast<FrameLabelTag*>(tag.getPtr())->Name);
+			empty=false;
+			break;
+		case TAG:
+			//Not yet implemented tag, ignore it
+			break;
+	}
+	return done;
+}
+
 void ParseThread::parseBitmap()
 {
 	_NR<Bitmap> tmp=_MNR(Class<Bitmap>::getInstanceS(&f, fileType));
@@ -379,8 +379,11 @@ private:
 	std::queue<_R<ControlTag>> symbolClassTags;
 	void threadAbort();
 	void jobFence() {};
+	JOB_PRIORITY getPriority() const { return JOB_PRIORITY_BACKGROUND; }
 	void parseSWFHeader(RootMovieClip *root, UI8 ver);
 	void parseSWF(UI8 ver);
+	//Returns true after the EndTag
+	bool processTag(_R<Tag> tag, RootMovieClip* root, bool& empty);
 	void parseBitmap();
 	void setRootMovie(RootMovieClip *root);
 };
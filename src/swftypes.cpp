@@ -29,15 +29,139 @@
 
 #include "exceptions.h"
 #include "compat.h"
+#include "threading.h"
 #include "scripting/toplevel/ASString.h"
 
 using namespace std;
 using namespace lightspark;
 
+uint32_t lightspark::nameHash(const tiny_string& s)
+{
+	//Embedded \0 are included
+	const unsigned char* p=reinterpret_cast<const unsigned char*>(s.raw_buf());
+	uint32_t h=EMPTY_NAME_HASH;
+	for(uint32_t i=0;i<s.numBytes();i++)
+		h=(h^p[i])*16777619u;
+	return h;
+}
+
+/*
+ * Interned names live in chunks that are never moved or freed, and are
+ * chained in a fixed number of buckets. A new entry is completed before
+ * its id is published as the head of its bucket, so lookups do not lock
+ */
+class NameTable
+{
+private:
+	struct entry
+	{
+		tiny_string name;
+		uint32_t hash;
+		//Next id in the same bucket, 0 ends the chain
+		uint32_t next;
+	};
+	static const uint32_t CHUNK_BITS=10;
+	static const uint32_t CHUNK_SIZE=1<<CHUNK_BITS;
+	static const uint32_t MAX_CHUNKS=1<<14;
+	static const uint32_t BUCKETS=1<<15;
+	//Only taken to add names
+	Mutex mutex;
+	entry* chunks[MAX_CHUNKS];
+	uint32_t count;
+	ATOMIC_INT32(buckets[BUCKETS]);
+	const entry& get(uint32_t id) const
+	{
+		return chunks[id>>CHUNK_BITS][id&(CHUNK_SIZE-1)];
+	}
+	uint32_t lookup(const tiny_string& s, uint32_t h) const
+	{
+		for(uint32_t id=ACQUIRE_READ(buckets[h&(BUCKETS-1)]);id!=0;id=get(id).next)
+		{
+			const entry& e=get(id);
+			if(e.hash==h && e.name==s)
+				return id;
+		}
+		return INVALID_NAME_ID;
+	}
+public:
+	NameTable():count(1)
+	{
+		//Id 0 is the empty string, which is never chained
+		chunks[0]=new entry[CHUNK_SIZE];
+		chunks[0][0].hash=EMPTY_NAME_HASH;
+		chunks[0][0].next=0;
+		for(uint32_t i=0;i<BUCKETS;i++)
+			RELEASE_WRITE(buckets[i],0);
+	}
+	uint32_t intern(const tiny_string& s)
+	{
+		const uint32_t h=nameHash(s);
+		uint32_t id=lookup(s,h);
+		if(id!=INVALID_NAME_ID)
+			return id;
+
+		Mutex::Lock l(mutex);
+		//It may have been added while we were not holding the lock
+		id=lookup(s,h);
+		if(id!=INVALID_NAME_ID)
+			return id;
+		id=count;
+		if((id&(CHUNK_SIZE-1))==0)
+		{
+			if((id>>CHUNK_BITS)==MAX_CHUNKS)
+				throw RunTimeException("Too many interned names");
+			chunks[id>>CHUNK_BITS]=new entry[CHUNK_SIZE];
+		}
+		entry& e=chunks[id>>CHUNK_BITS][id&(CHUNK_SIZE-1)];
+		//Always copy, s may not own its buffer
+		e.name=tiny_string(std::string(s));
+		e.hash=h;
+		e.next=ACQUIRE_READ(buckets[h&(BUCKETS-1)]);
+		count++;
+		RELEASE_WRITE(buckets[h&(BUCKETS-1)],id);
+		return id;
+	}
+	const tiny_string& name(uint32_t id) const
+	{
+		return get(id).name;
+	}
+	uint32_t hash(uint32_t id) const
+	{
+		return get(id).hash;
+	}
+};
+
+static NameTable& getNameTable()
+{
+	//Constructed on first use, names are interned during static initialization too
+	static NameTable table;
+	return table;
+}
+
+uint32_t lightspark::internName(const tiny_string& s)
+{
+	if(s.empty())
+		return 0;
+	return getNameTable().intern(s);
+}
+
+const tiny_string& lightspark::getInternedName(uint32_t id)
+{
+	assert(id!=INVALID_NAME_ID);
+	return getNameTable().name(id);
+}
+
+uint32_t lightspark::getInternedNameHash(uint32_t id)
+{
+	assert(id!=INVALID_NAME_ID);
+	return getNameTable().hash(id);
+}
+
 /* Implementation of Glib::ustring conversion for libxml++.
  * We implement them in the source file to not pollute the header with glib.h
  */
-tiny_string::tiny_string(const Glib::ustring& r):buf(_buf_static),stringSize(r.bytes()+1),type(STATIC)
+tiny_string::tiny_string(const Glib::ustring& r):buf(_buf_static),stringSize(r.bytes()+1),type(STATIC),
+	charCount(npos),charIndex(NULL)
 {
 	if(stringSize > STATIC_SIZE)
 		createBuffer(stringSize);
@@ -82,6 +206,7 @@ tiny_string& tiny_string::operator+=(const Glib::ustring& s)
 
 tiny_string& tiny_string::operator+=(const char* s)
 {	//deprecated, cannot handle '\0' inside string
+	resetCharIndex();
 	if(type==READONLY)
 	{
 		char* tmp=buf;
@@ -105,11 +230,14 @@ tiny_string& tiny_string::operator+=(const char* s)
 
 tiny_string& tiny_string::operator+=(const tiny_string& r)
 {
+	//Keep the character count when both sides know it, appending ASCII stays ASCII
+	uint32_t newCharCount=(charCount!=npos && r.charCount!=npos)?charCount+r.charCount:npos;
 	if(type==READONLY)
 	{
 		char* tmp=buf;
 		makePrivateCopy(tmp);
 	}
+	resetCharIndex();
 	uint32_t newStringSize=stringSize + r.stringSize-1;
 	if(type==STATIC && newStringSize > STATIC_SIZE)
 	{
@@ -122,6 +250,7 @@ tiny_string& tiny_string::operator+=(const tiny_string& r)
 	//start position is where the \0 was
 	memcpy(buf+stringSize-1,r.buf,r.stringSize);
 	stringSize=newStringSize;
+	charCount=newCharCount;
 	return *this;
 }
 
@@ -135,10 +264,10 @@ const tiny_string tiny_string::operator+(const tiny_string& r) const
 tiny_string& tiny_string::replace(uint32_t pos1, uint32_t n1, const tiny_string& o )
 {
 	assert(pos1 <= numChars());
-	uint32_t bytestart = g_utf8_offset_to_pointer(buf,pos1)-buf;
+	uint32_t bytestart = bytePosition(pos1);
 	if(pos1 + n1 > numChars())
 		n1 = numChars()-pos1;
-	uint32_t byteend = g_utf8_offset_to_pointer(buf,pos1+n1)-buf;
+	uint32_t byteend = bytePosition(pos1+n1);
 	return replace_bytes(bytestart, byteend-bytestart, o);
 }
 
@@ -158,6 +287,8 @@ tiny_string tiny_string::substr_bytes(uint32_t start, uint32_t len) const
 	memcpy(ret.buf,buf+start,len);
 	ret.buf[len]=0;
 	ret.stringSize = len+1;
+	//Any slice of an ASCII string is ASCII
+	ret.charCount = (charCount==numBytes())?len:npos;
 	return ret;
 }
 
@@ -166,19 +297,128 @@ tiny_string tiny_string::substr(uint32_t start, uint32_t len) const
 	assert_and_throw(start <= numChars());
 	if(start+len > numChars())
 		len = numChars()-start;
-	uint32_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-	uint32_t byteend = g_utf8_offset_to_pointer(buf,start+len) - buf;
+	uint32_t bytestart = bytePosition(start);
+	uint32_t byteend = bytePosition(start+len);
 	return substr_bytes(bytestart, byteend-bytestart);
 }
 
 tiny_string tiny_string::substr(uint32_t start, const CharIterator& end) const
 {
 	assert_and_throw(start < numChars());
-	uint32_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
+	uint32_t bytestart = bytePosition(start);
 	uint32_t byteend = end.buf_ptr - buf;
 	return substr_bytes(bytestart, byteend-bytestart);
 }
 
+uint32_t tiny_string::find(const tiny_string& needle, uint32_t start) const
+{
+	if(start > numChars())
+		return npos;
+	//Search in place, without copying into std::string
+	const char* end = buf+numBytes();
+	const char* pos = std::search((const char*)buf+bytePosition(start), end,
+			needle.buf, needle.buf+needle.numBytes());
+	if(pos == end && !needle.empty())
+		return npos;
+	return charPosition(pos-buf);
+}
+
+uint32_t tiny_string::rfind(const tiny_string& needle, uint32_t start) const
+{
+	if(needle.numBytes() > numBytes())
+		return npos;
+	//Matches must begin at or before bytestart, like std::string::rfind
+	uint32_t bytestart = numBytes()-needle.numBytes();
+	if(start != npos)
+		bytestart = std::min(bytestart, bytePosition(start));
+	const char* end = buf+bytestart+needle.numBytes();
+	const char* pos = std::find_end((const char*)buf, end,
+			needle.buf, needle.buf+needle.numBytes());
+	if(pos == end && !needle.empty())
+		return npos;
+	return charPosition(pos-buf);
+}
+
+uint32_t tiny_string::countChars() const
+{
+	//we cannot use g_utf8_strlen, as we may have '\0' inside our string
+	uint32_t len = 0;
+	const char* end = buf+numBytes();
+	const char* p = buf;
+	while(p < end)
+	{
+		if((unsigned char)*p < 0x80)
+			++p;
+		else
+			p = g_utf8_next_char(p);
+		++len;
+	}
+	return len;
+}
+
+const uint32_t* tiny_string::getCharIndex() const
+{
+	uint32_t* ret=ACQUIRE_READ_POINTER(charIndex);
+	if(ret)
+		return ret;
+	uint32_t entries = numChars()/CHAR_INDEX_STRIDE+1;
+	uint32_t* index = new uint32_t[entries];
+	const char* p = buf;
+	for(uint32_t i=0;i<entries;i++)
+	{
+		//A truncated sequence at the end may make us step past it
+		index[i] = std::min<uint32_t>(p-buf, numBytes());
+		if(i+1 == entries)
+			break;
+		for(uint32_t j=0;j<CHAR_INDEX_STRIDE;j++)
+			p = g_utf8_next_char(p);
+	}
+	//Another thread may have built the same index meanwhile, keep the published one
+	if(POINTER_COMPARE_AND_SWAP(charIndex, (uint32_t*)NULL, index))
+		return index;
+	delete[] index;
+	return ACQUIRE_READ_POINTER(charIndex);
+}
+
+uint32_t tiny_string::bytePositionSlow(uint32_t idx) const
+{
+	if(idx >= numChars())
+		return numBytes();
+	const char* p = buf;
+	if(idx >= CHAR_INDEX_STRIDE)
+	{
+		p += getCharIndex()[idx/CHAR_INDEX_STRIDE];
+		idx %= CHAR_INDEX_STRIDE;
+	}
+	for(;idx>0;idx--)
+		p = g_utf8_next_char(p);
+	return p-buf;
+}
+
+uint32_t tiny_string::charPositionSlow(uint32_t bytepos) const
+{
+	if(bytepos >= numBytes())
+		return numChars();
+	uint32_t ret = 0;
+	const char* p = buf;
+	if(numChars() > CHAR_INDEX_STRIDE)
+	{
+		const uint32_t* index = getCharIndex();
+		uint32_t entries = numChars()/CHAR_INDEX_STRIDE+1;
+		//Last indexed character starting at or before bytepos
+		uint32_t k = std::upper_bound(index, index+entries, bytepos) - index - 1;
+		p += index[k];
+		ret = k*CHAR_INDEX_STRIDE;
+	}
+	const char* target = buf+bytepos;
+	while(p < target)
+	{
+		p = g_utf8_next_char(p);
+		ret++;
+	}
+	return ret;
+}
+
 tiny_string multiname::qualifiedString() const
 {
 	assert_and_throw(ns.size()==1);
@@ -233,14 +473,12 @@ void multiname::setName(ASObject* n)
 	else if(n->getObjectType()==T_QNAME)
 	{
 		ASQName* qname=static_cast<ASQName*>(n);
-		name_s=qname->local_name;
-		name_type = NAME_STRING;
+		setName(qname->local_name);
 	}
 	else if(n->getObjectType()==T_STRING)
 	{
 		ASString* o=static_cast<ASString*>(n);
-		name_s=o->data;
-		name_type = NAME_STRING;
+		setName(o->data);
 	}
 	else
 	{
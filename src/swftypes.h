@@ -148,6 +148,24 @@ private:
 	*/
 	uint32_t stringSize;
 	TYPE type;
+	/* Number of utf-8 characters, or npos if not yet computed.
+	   When it equals numBytes() the string is pure ASCII */
+	mutable uint32_t charCount;
+	/* Byte offsets of every CHAR_INDEX_STRIDE-th character, built on demand
+	   for long non-ASCII strings. Const strings may be shared between
+	   threads, so the index is published with a compare and swap */
+	mutable ATOMIC_POINTER(uint32_t, charIndex);
+	enum { CHAR_INDEX_STRIDE = 32 };
+	void resetCharIndex() const
+	{
+		delete[] static_cast<uint32_t*>(charIndex);
+		charIndex=NULL;
+		charCount=npos;
+	}
+	const uint32_t* getCharIndex() const;
+	uint32_t countChars() const;
+	uint32_t bytePositionSlow(uint32_t idx) const;
+	uint32_t charPositionSlow(uint32_t bytepos) const;
 	//TODO: use static buffer again if reassigning to short string
 	void makePrivateCopy(const char* s)
 	{
@@ -175,6 +193,7 @@ private:
 	{
 		if(type==DYNAMIC)
 			delete[] buf;
+		resetCharIndex();
 		stringSize=1;
 		buf=_buf_static;
 		buf[0] = '\0';
@@ -183,7 +202,7 @@ private:
 public:
 	static const uint32_t npos = (uint32_t)(-1);
 
-	tiny_string():buf(_buf_static),stringSize(1),type(STATIC){buf[0]=0;}
+	tiny_string():buf(_buf_static),stringSize(1),type(STATIC),charCount(0),charIndex(NULL){buf[0]=0;}
 	/* construct from utf character */
 	static tiny_string fromChar(uint32_t c)
 	{
@@ -192,9 +211,10 @@ public:
 		ret.type = STATIC;
 		ret.stringSize = g_unichar_to_utf8(c,ret.buf) + 1;
 		ret.buf[ret.stringSize-1] = '\0';
+		ret.charCount = 1;
 		return ret;
 	}
-	tiny_string(const char* s,bool copy=false):buf(_buf_static),type(READONLY)
+	tiny_string(const char* s,bool copy=false):buf(_buf_static),type(READONLY),charCount(npos),charIndex(NULL)
 	{
 		if(copy)
 			makePrivateCopy(s);
@@ -204,7 +224,8 @@ public:
 			buf=(char*)s; //This is an unsafe conversion, we have to take care of the RO data
 		}
 	}
-	tiny_string(const tiny_string& r):buf(_buf_static),stringSize(r.stringSize),type(STATIC)
+	tiny_string(const tiny_string& r):buf(_buf_static),stringSize(r.stringSize),type(STATIC),
+		charCount(r.charCount),charIndex(NULL)
 	{
 		//Fast path for static read-only strings
 		if(r.type==READONLY)
@@ -217,7 +238,8 @@ public:
 			createBuffer(stringSize);
 		memcpy(buf,r.buf,stringSize);
 	}
-	tiny_string(const std::string& r):buf(_buf_static),stringSize(r.size()+1),type(STATIC)
+	tiny_string(const std::string& r):buf(_buf_static),stringSize(r.size()+1),type(STATIC),
+		charCount(npos),charIndex(NULL)
 	{
 		if(stringSize > STATIC_SIZE)
 			createBuffer(stringSize);
@@ -232,6 +254,7 @@ public:
 	{
 		resetToStatic();
 		stringSize=s.stringSize;
+		charCount=s.charCount;
 		//Fast path for static read-only strings
 		if(s.type==READONLY)
 		{
@@ -346,16 +369,29 @@ public:
 	/* returns the length in utf-8 characters, not counting the trailing \0 */
 	uint32_t numChars() const
 	{
-		//we cannot use g_utf8_strlen, as we may have '\0' inside our string
-		uint32_t len = 0;
-		char* end = buf+numBytes();
-		char* p = buf;
-		while(p < end)
-		{
-			p = g_utf8_next_char(p);
-			++len;
-		}
-		return len;
+		if(charCount==npos)
+			charCount=countChars();
+		return charCount;
+	}
+	/* true if every character is a single byte */
+	bool isASCII() const
+	{
+		return numChars()==numBytes();
+	}
+	/* converts an index of utf-8 characters to an index of bytes,
+	 * indices past the end map to numBytes() */
+	uint32_t bytePosition(uint32_t idx) const
+	{
+		if(isASCII())
+			return std::min(idx,numBytes());
+		return bytePositionSlow(idx);
+	}
+	/* converts an index of bytes to an index of utf-8 characters */
+	uint32_t charPosition(uint32_t bytepos) const
+	{
+		if(isASCII())
+			return std::min(bytepos,numBytes());
+		return charPositionSlow(bytepos);
 	}
 	/* start and len are indices of utf8-characters */
 	tiny_string substr(uint32_t start, uint32_t len) const;
@@ -386,35 +422,14 @@ public:
 	/* idx is an index of utf-8 characters */
 	uint32_t charAt(uint32_t idx) const
 	{
-		return g_utf8_get_char(g_utf8_offset_to_pointer(buf,idx));
+		if(isASCII())
+			return (unsigned char)buf[idx];
+		return g_utf8_get_char(buf+bytePositionSlow(idx));
 	}
 	/* start is an index of characters.
 	 * returns index of character */
-	uint32_t find(const tiny_string& needle, uint32_t start = 0) const
-	{
-		//TODO: omit copy into std::string
-		size_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-		size_t bytepos = std::string(*this).find(needle.raw_buf(),bytestart,needle.numBytes());
-		if(bytepos == std::string::npos)
-			return npos;
-		else
-			return g_utf8_pointer_to_offset(buf,buf+bytepos);
-	}
-	uint32_t rfind(const tiny_string& needle, uint32_t start = npos) const
-	{
-		//TODO: omit copy into std::string
-		size_t bytestart;
-		if(start == npos)
-			bytestart = std::string::npos;
-		else
-			bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-
-		size_t bytepos = std::string(*this).rfind(needle.raw_buf(),bytestart,needle.numBytes());
-		if(bytepos == std::string::npos)
-			return npos;
-		else
-			return g_utf8_pointer_to_offset(buf,buf+bytepos);
-	}
+	uint32_t find(const tiny_string& needle, uint32_t start = 0) const;
+	uint32_t rfind(const tiny_string& needle, uint32_t start = npos) const;
 	tiny_string& replace(uint32_t pos1, uint32_t n1, const tiny_string& o);
 	tiny_string& replace_bytes(uint32_t bytestart, uint32_t bytenum, const tiny_string& o);
 	tiny_string lowercase() const
@@ -465,6 +480,21 @@ public:
 	}
 };
 
+/*
+ * Namespaces, names from the ABC constant pools and names of traits are
+ * interned, so that they can be compared as integers. Interned names are
+ * never released, so names built at runtime are not interned: they are
+ * compared through nameHash and then as strings.
+ * Looking up interned names does not lock, the empty string always has id 0
+ */
+const uint32_t INVALID_NAME_ID=0xffffffff;
+//FNV-1a over the bytes of the string
+const uint32_t EMPTY_NAME_HASH=2166136261u;
+uint32_t nameHash(const tiny_string& s);
+uint32_t internName(const tiny_string& s);
+const tiny_string& getInternedName(uint32_t id);
+uint32_t getInternedNameHash(uint32_t id);
+
 struct multiname;
 class QName
 {
@@ -668,9 +698,11 @@ enum NS_KIND { NAMESPACE=0x08, PACKAGE_NAMESPACE=0x16, PACKAGE_INTERNAL_NAMESPAC
 struct nsNameAndKind
 {
 	tiny_string name;
+	//Interned name, see internName
+	uint32_t nameId;
 	NS_KIND kind;
-	nsNameAndKind(const tiny_string& _name, NS_KIND _kind):name(_name),kind(_kind){}
-	nsNameAndKind(const char* _name, NS_KIND _kind):name(_name),kind(_kind){}
+	nsNameAndKind(const tiny_string& _name, NS_KIND _kind):name(_name),nameId(internName(_name)),kind(_kind){}
+	nsNameAndKind(const char* _name, NS_KIND _kind):name(_name),nameId(internName(name)),kind(_kind){}
 	bool operator<(const nsNameAndKind& r) const
 	{
 		return name < r.name;
@@ -681,7 +713,7 @@ struct nsNameAndKind
 	}
 	bool operator==(const nsNameAndKind& r) const
 	{
-		return /*kind==r.kind &&*/ name==r.name;
+		return /*kind==r.kind &&*/ nameId==r.nameId;
 	}
 };
 
@@ -689,7 +721,11 @@ struct multiname
 {
 	enum NAME_TYPE {NAME_STRING,NAME_INT,NAME_NUMBER,NAME_OBJECT};
 	NAME_TYPE name_type;
+	//Only change name_s through setName or setInternedName, which keep name_s_id and name_s_hash in sync
 	tiny_string name_s;
+	//Interned name_s, INVALID_NAME_ID if name_s is not interned, see internName
+	uint32_t name_s_id;
+	uint32_t name_s_hash;
 	union
 	{
 		int32_t name_i;
@@ -698,6 +734,7 @@ struct multiname
 	};
 	std::vector<nsNameAndKind> ns;
 	bool isAttribute;
+	multiname():name_type(NAME_STRING),name_s_id(0),name_s_hash(EMPTY_NAME_HASH),isAttribute(false){}
 	/*
 		Returns a string name whatever is the name type
 	*/
@@ -705,14 +742,29 @@ struct multiname
 	tiny_string qualifiedString() const;
 	/* sets name_type, name_s/name_d based on the object n */
 	void setName(ASObject* n);
+	/* sets name_type to NAME_STRING and name_s to n */
+	void setName(const tiny_string& n)
+	{
+		name_s=n;
+		name_s_id=n.empty()?0:INVALID_NAME_ID;
+		name_s_hash=nameHash(n);
+		name_type=NAME_STRING;
+	}
+	/* like setName, for names of the ABC constant pools, which are interned */
+	void setInternedName(const tiny_string& n)
+	{
+		name_s=n;
+		name_s_id=internName(n);
+		name_s_hash=getInternedNameHash(name_s_id);
+		name_type=NAME_STRING;
+	}
 	bool isQName() const { return ns.size() == 1; }
 };
 
 inline QName::operator multiname() const
 {
 	multiname ret;
-	ret.name_type = multiname::NAME_STRING;
-	ret.name_s = name;
+	ret.setName(name);
 	ret.ns.push_back( nsNameAndKind(ns, PACKAGE_NAMESPACE) );
 	ret.isAttribute = false;
 	return ret;
@@ -26,44 +26,60 @@
 
 using namespace lightspark;
 
-ThreadPool::ThreadPool(SystemState* s):num_jobs(0),stopFlag(false)
+//The queue of the pool worker running in this thread, if any
+static GStaticPrivate worker_queue = G_STATIC_PRIVATE_INIT; /* TLS */
+
+ThreadPool::ThreadPool(SystemState* s, uint32_t n):numThreads(n),freeBackgroundSlots(0),nextQueue(0),idleThreads(0),
+	m_sys(s),stopFlag(false)
 {
-	m_sys=s;
-	for(uint32_t i=0;i<NUM_THREADS;i++)
-	{
-		curJobs[i]=NULL;
+	if(numThreads==0)
+		numThreads=compat_get_num_processors();
+	if(numThreads<MIN_THREADS)
+		numThreads=MIN_THREADS;
+	//A quarter of the workers never run background jobs, so they are always available for rendering
+	uint32_t reserved=numThreads/4;
+	freeBackgroundSlots=numThreads-reserved;
+	for(uint32_t i=0;i<JOB_PRIORITY_COUNT;i++)
+		pendingJobs[i]=0;
+	LOG(LOG_INFO,_("Starting ") << numThreads << _(" worker threads"));
+	queues=new WorkerQueue[numThreads];
+	threads=new Thread*[numThreads];
+	for(uint32_t i=0;i<numThreads;i++)
 		threads[i] = Thread::create(sigc::bind(&job_worker,this,i), true);
-	}
 }
 
 void ThreadPool::forceStop()
 {
 	if(!stopFlag)
 	{
-		stopFlag=true;
-		//Signal an event for all the threads
-		for(int i=0;i<NUM_THREADS;i++)
-			num_jobs.signal();
-
 		{
 			Locker l(mutex);
+			stopFlag=true;
+			//Signal an event for all the threads
+			newJobs.broadcast();
+		}
+
+		for(uint32_t i=0;i<numThreads;i++)
+		{
+			Locker l(queues[i].mutex);
 			//Now abort any job that is still executing
-			for(int i=0;i<NUM_THREADS;i++)
+			if(queues[i].curJob)
 			{
-				if(curJobs[i])
-				{
-					curJobs[i]->threadAborting = true;
-					curJobs[i]->threadAbort();
-				}
+				queues[i].curJob->threadAborting = true;
+				queues[i].curJob->threadAbort();
 			}
 			//Fence all the non executed jobs
-			std::deque<IThreadJob*>::iterator it=jobs.begin();
-			for(;it!=jobs.end();it++)
-				(*it)->jobFence();
-			jobs.clear();
+			for(uint32_t p=0;p<JOB_PRIORITY_COUNT;p++)
+			{
+				std::deque<IThreadJob*>& jobs=queues[i].jobs[p];
+				std::deque<IThreadJob*>::iterator it=jobs.begin();
+				for(;it!=jobs.end();it++)
+					(*it)->jobFence();
+				jobs.clear();
+			}
 		}
 
-		for(int i=0;i<NUM_THREADS;i++)
+		for(uint32_t i=0;i<numThreads;i++)
 		{
 			threads[i]->join();
 		}
@@ -73,11 +89,60 @@ void ThreadPool::forceStop()
 ThreadPool::~ThreadPool()
 {
 	forceStop();
+	delete[] threads;
+	delete[] queues;
+}
+
+IThreadJob* ThreadPool::popJob(uint32_t index, uint32_t priority)
+{
+	WorkerQueue& queue=queues[index];
+	Locker l(queue.mutex);
+	std::deque<IThreadJob*>& jobs=queue.jobs[priority];
+	if(jobs.empty())
+		return NULL;
+	IThreadJob* ret=jobs.front();
+	jobs.pop_front();
+	ATOMIC_DECREMENT(pendingJobs[priority]);
+	return ret;
+}
+
+IThreadJob* ThreadPool::findJob(uint32_t index)
+{
+	for(uint32_t p=0;p<JOB_PRIORITY_COUNT;p++)
+	{
+		if(pendingJobs[p]==0)
+			continue;
+		//Reserve a slot before taking a background job
+		if(p==JOB_PRIORITY_BACKGROUND && ATOMIC_DECREMENT(freeBackgroundSlots)<0)
+		{
+			ATOMIC_INCREMENT(freeBackgroundSlots);
+			return NULL;
+		}
+		//Look in our own queue first, then steal from the others
+		for(uint32_t i=0;i<numThreads;i++)
+		{
+			IThreadJob* ret=popJob((index+i)%numThreads,p);
+			if(ret)
+				return ret;
+		}
+		if(p==JOB_PRIORITY_BACKGROUND)
+			ATOMIC_INCREMENT(freeBackgroundSlots);
+	}
+	return NULL;
+}
+
+void ThreadPool::wakeWorker()
+{
+	Locker l(mutex);
+	if(idleThreads)
+		newJobs.signal();
 }
 
 void ThreadPool::job_worker(ThreadPool* th, uint32_t index)
 {
 	setTLSSys(th->m_sys);
+	WorkerQueue& queue=th->queues[index];
+	g_static_private_set(&worker_queue,&queue,NULL);
 
 	ThreadProfile* profile=getSys()->allocateProfiler(RGB(200,200,0));
 	char buf[16];
@@ -87,15 +152,30 @@ void ThreadPool::job_worker(ThreadPool* th, uint32_t index)
 	Chronometer chronometer;
 	while(1)
 	{
-		th->num_jobs.wait();
+		IThreadJob* myJob=th->findJob(index);
+		if(myJob==NULL)
+		{
+			Locker l(th->mutex);
+			//Look again while holding the lock, so that no signal is lost
+			while(!th->stopFlag && (myJob=th->findJob(index))==NULL)
+			{
+				th->idleThreads++;
+				th->newJobs.wait(th->mutex);
+				th->idleThreads--;
+			}
+		}
+		//The job may be stolen from another queue, so check for termination with our lock held
+		Locker l(queue.mutex);
 		if(th->stopFlag)
+		{
+			if(myJob)
+				myJob->jobFence();
 			return;
-		Locker l(th->mutex);
-		IThreadJob* myJob=th->jobs.front();
-		th->jobs.pop_front();
-		th->curJobs[index]=myJob;
+		}
+		queue.curJob=myJob;
 		l.release();
 
+		JOB_PRIORITY priority=myJob->getPriority();
 		chronometer.checkpoint();
 		try
 		{
@@ -113,24 +193,43 @@ void ThreadPool::job_worker(ThreadPool* th, uint32_t index)
 		profile->accountTime(chronometer.checkpoint());
 
 		l.acquire();
-		th->curJobs[index]=NULL;
+		queue.curJob=NULL;
 
 		myJob->jobFence();
 
 		l.release();
+
+		if(priority==JOB_PRIORITY_BACKGROUND)
+		{
+			ATOMIC_INCREMENT(th->freeBackgroundSlots);
+			//Another worker may be waiting for the slot
+			th->wakeWorker();
+		}
 	}
 }
 
 void ThreadPool::addJob(IThreadJob* j)
 {
-	Locker l(mutex);
-	if(stopFlag)
+	assert(j);
+	JOB_PRIORITY priority=j->getPriority();
+	//Jobs added by a worker are queued on it, the others are spread over all the workers
+	WorkerQueue* queue=static_cast<WorkerQueue*>(g_static_private_get(&worker_queue));
+	if(queue<queues || queue>=queues+numThreads)
+		queue=&queues[((uint32_t)ATOMIC_INCREMENT(nextQueue))%numThreads];
+	{
+		Locker l(queue->mutex);
+		if(!stopFlag)
+		{
+			queue->jobs[priority].push_back(j);
+			ATOMIC_INCREMENT(pendingJobs[priority]);
+			j=NULL;
+		}
+	}
+	if(j)
 	{
+		//The pool is stopping
 		j->jobFence();
 		return;
 	}
-	assert(j);
-	jobs.push_back(j);
-	num_jobs.signal();
+	wakeWorker();
 }
-
@@ -28,23 +28,45 @@
 namespace lightspark
 {
 
-#define NUM_THREADS 5
+//Lower bound of the number of workers, downloads and parsers block while holding one
+#define MIN_THREADS 6
 
 class SystemState;
 
 class ThreadPool
 {
 private:
+	class WorkerQueue
+	{
+	public:
+		Mutex mutex;
+		//Jobs queued on this worker, one deque for each priority
+		std::deque<IThreadJob*> jobs[JOB_PRIORITY_COUNT];
+		//Protected by mutex
+		IThreadJob* curJob;
+		WorkerQueue():curJob(NULL){}
+	};
+	uint32_t numThreads;
+	Thread** threads;
+	WorkerQueue* queues;
+	//Jobs queued on all the workers, for each priority
+	ATOMIC_INT32(pendingJobs[JOB_PRIORITY_COUNT]);
+	//Background jobs that may still be started, some workers are kept for rendering
+	ATOMIC_INT32(freeBackgroundSlots);
+	ATOMIC_INT32(nextQueue);
+	//Idle workers sleep on newJobs, protected by mutex
 	Mutex mutex;
-	Thread* threads[NUM_THREADS];
-	IThreadJob* volatile curJobs[NUM_THREADS];
-	std::deque<IThreadJob*> jobs;
-	Semaphore num_jobs;
+	Cond newJobs;
+	uint32_t idleThreads;
 	static void job_worker(ThreadPool* th, uint32_t threadIndex);
+	IThreadJob* popJob(uint32_t index, uint32_t priority);
+	IThreadJob* findJob(uint32_t index);
+	void wakeWorker();
 	SystemState* m_sys;
 	volatile bool stopFlag;
 public:
-	ThreadPool(SystemState* s);
+	/* numThreads==0 sizes the pool from the number of CPUs */
+	ThreadPool(SystemState* s, uint32_t numThreads=0);
 	~ThreadPool();
 	void addJob(IThreadJob* j);
 	void forceStop();
@@ -75,6 +75,12 @@ public:
 	}
 };
 
+/*
+ * Jobs are started in this order. Background jobs may block for a long
+ * time, so they are never allowed to take all the workers of the pool
+ */
+enum JOB_PRIORITY { JOB_PRIORITY_RENDER=0, JOB_PRIORITY_NORMAL, JOB_PRIORITY_BACKGROUND, JOB_PRIORITY_COUNT };
+
 class IThreadJob
 {
 friend class ThreadPool;
@@ -108,6 +114,7 @@ public:
 	 * 'delete this'.
 	 */
 	virtual void jobFence()=0;
+	virtual JOB_PRIORITY getPriority() const { return JOB_PRIORITY_NORMAL; }
 	IThreadJob() : threadAborting(false) {}
 	virtual ~IThreadJob() {}
 };
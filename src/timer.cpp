@@ -54,33 +54,88 @@ void TimerThread::wait()
 TimerThread::~TimerThread()
 {
 	stop();
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	for(;it!=pendingEvents.end();++it)
-		delete *it;
+	for(uint32_t i=0;i<pendingEvents.size();i++)
+		delete pendingEvents[i];
 }
 
-void TimerThread::insertNewEvent_nolock(TimingEvent* e)
+void TimerThread::siftUp(uint32_t index)
 {
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	//If there are no events pending, or this is earlier than the first, signal newEvent
-	if(pendingEvents.empty() || (*it)->timing > e->timing)
+	TimingEvent* e=pendingEvents[index];
+	while(index>0)
 	{
-		pendingEvents.insert(it, e);
-		newEvent.signal();
-		return;
+		uint32_t parent=(index-1)/2;
+		if(pendingEvents[parent]->timing <= e->timing)
+			break;
+		pendingEvents[index]=pendingEvents[parent];
+		pendingEvents[index]->heapIndex=index;
+		index=parent;
+	}
+	pendingEvents[index]=e;
+	e->heapIndex=index;
+}
+
+void TimerThread::siftDown(uint32_t index)
+{
+	TimingEvent* e=pendingEvents[index];
+	const uint32_t size=pendingEvents.size();
+	while(1)
+	{
+		uint32_t child=2*index+1;
+		if(child>=size)
+			break;
+		if(child+1<size && pendingEvents[child+1]->timing < pendingEvents[child]->timing)
+			child++;
+		if(e->timing <= pendingEvents[child]->timing)
+			break;
+		pendingEvents[index]=pendingEvents[child];
+		pendingEvents[index]->heapIndex=index;
+		index=child;
 	}
-	++it;
+	pendingEvents[index]=e;
+	e->heapIndex=index;
+}
+
+void TimerThread::pushEvent(TimingEvent* e)
+{
+	pendingEvents.push_back(e);
+	siftUp(pendingEvents.size()-1);
+}
 
-	for(;it!=pendingEvents.end();++it)
+void TimerThread::eraseEvent(uint32_t index)
+{
+	assert(index<pendingEvents.size());
+	TimingEvent* last=pendingEvents.back();
+	pendingEvents.pop_back();
+	if(index==pendingEvents.size())
+		return;
+	//Move the last event in the hole, then restore the heap in whichever direction is needed
+	pendingEvents[index]=last;
+	last->heapIndex=index;
+	siftUp(index);
+	siftDown(last->heapIndex);
+}
+
+void TimerThread::unlinkJobEvent(TimingEvent* e)
+{
+	auto range=jobEvents.equal_range(e->job);
+	for(auto it=range.first;it!=range.second;++it)
 	{
-		if((*it)->timing > e->timing)
+		if(it->second==e)
 		{
-			pendingEvents.insert(it, e);
+			jobEvents.erase(it);
 			return;
 		}
 	}
-	//Event has to be inserted after all the others
-	pendingEvents.insert(pendingEvents.end(), e);
+	assert(false);
+}
+
+void TimerThread::insertNewEvent_nolock(TimingEvent* e)
+{
+	jobEvents.insert(make_pair(e->job, e));
+	pushEvent(e);
+	//If this is earlier than all the others, signal newEvent
+	if(e->heapIndex==0)
+		newEvent.signal();
 }
 
 void TimerThread::insertNewEvent(TimingEvent* e)
@@ -92,10 +147,8 @@ void TimerThread::insertNewEvent(TimingEvent* e)
 //Unsafe debugging routine
 void TimerThread::dumpJobs()
 {
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	//Find if the job is in the list
-	for(;it!=pendingEvents.end();++it)
-		LOG(LOG_INFO, (*it)->job );
+	for(uint32_t i=0;i<pendingEvents.size();i++)
+		LOG(LOG_INFO, pendingEvents[i]->job );
 }
 
 void TimerThread::worker()
@@ -106,60 +159,64 @@ void TimerThread::worker()
 	while(1)
 	{
 		/* Wait until the first event appears */
-		while(pendingEvents.empty())
-		{
+		while(pendingEvents.empty() && !stopped)
 			newEvent.wait(mutex);
-			if(stopped)
-				return;
-		}
-
-		/* Get expiration of first event */
-		Glib::TimeVal timing=pendingEvents.front()->timing;
-		/* Wait for the absolute time or a newEvent signal
-		 * this unlocks the mutex and relocks it before returing
-		 */
-		newEvent.timed_wait(mutex,timing);
 
 		if(stopped)
 			return;
 
-		if(pendingEvents.empty())
-			continue;
-
-		TimingEvent* e=pendingEvents.front();
-
-		/* check if the top even is due now. It could be have been removed/inserted
-		 * while we slept */
-		Glib::TimeVal now;
-		now.assign_current_time();
-		if((now-timing).negative()) /* timing > now */
-			continue;
-
-		pendingEvents.pop_front();
-
-		if(e->job->stopMe)
+		/* Get expiration of first event */
+		uint64_t now=compat_msectiming();
+		uint64_t timing=pendingEvents.front()->timing;
+		if(timing > now)
 		{
-			delete e;
+			/* Wait for the absolute time or a newEvent signal
+			 * this unlocks the mutex and relocks it before returing.
+			 * Events could be removed/inserted while we sleep, so start over */
+			Glib::TimeVal deadline;
+			deadline.assign_current_time();
+			deadline.add_milliseconds(timing-now);
+			newEvent.timed_wait(mutex,deadline);
 			continue;
 		}
 
-		if(e->isTick)
+		/* Run all the events due by now in one batch, without going back to sleep */
+		while(!stopped && !pendingEvents.empty() && pendingEvents.front()->timing <= now)
 		{
-			/* re-enqueue*/
-			e->timing.add_milliseconds(e->tickTime);
-			insertNewEvent_nolock(e);
+			TimingEvent* e=pendingEvents.front();
+			eraseEvent(0);
+
+			if(e->job->stopMe)
+			{
+				unlinkJobEvent(e);
+				delete e;
+				continue;
+			}
+
+			const bool isTick=e->isTick;
+			if(isTick)
+			{
+				/* re-enqueue. If we are late, skip the missed ticks instead of replaying them */
+				const uint32_t period=(e->tickTime) ? e->tickTime : 1;
+				e->timing+=period;
+				if(e->timing <= now)
+					e->timing+=((now-e->timing)/period+1)*period;
+				pushEvent(e);
+			}
+			else
+				unlinkJobEvent(e);
+
+			/* let removeJob() know what we are currently doing */
+			inExecution = e->job;
+			l.release();
+			e->job->tick();
+			inExecution = NULL;
+			l.acquire();
+
+			/* Cleanup. Ticks may have been removed while running, so don't touch them */
+			if(!isTick)
+				delete e;
 		}
-
-		/* let removeJob() know what we are currently doing */
-		inExecution = e->job;
-		l.release();
-		e->job->tick();
-		inExecution = NULL;
-		l.acquire();
-
-		/* Cleanup */
-		if(!e->isTick)
-			delete e;
 	}
 }
 
@@ -169,8 +226,7 @@ void TimerThread::addTick(uint32_t tickTime, ITickJob* job)
 	e->isTick=true;
 	e->job=job;
 	e->tickTime=tickTime;
-	e->timing.assign_current_time();
-	e->timing.add_milliseconds(tickTime);
+	e->timing=compat_msectiming()+tickTime;
 	insertNewEvent(e);
 }
 
@@ -180,8 +236,7 @@ void TimerThread::addWait(uint32_t waitTime, ITickJob* job)
 	e->isTick=false;
 	e->job=job;
 	e->tickTime=0;
-	e->timing.assign_current_time();
-	e->timing.add_milliseconds(waitTime);
+	e->timing=compat_msectiming()+waitTime;
 	insertNewEvent(e);
 }
 
@@ -192,22 +247,21 @@ void TimerThread::removeJob(ITickJob* job)
 	while(inExecution == job)
 		Thread::yield();
 
-	/* See if that job is currently pending */
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	bool first=true;
-	//Find if the job is in the list
-	for(;it!=pendingEvents.end();++it)
+	/* See if that job is currently pending, remove its earliest event */
+	auto range=jobEvents.equal_range(job);
+	if(range.first==range.second)
+		return;
+	auto earliest=range.first;
+	for(auto it=range.first;it!=range.second;++it)
 	{
-		if((*it)->job==job)
-			break;
-		first=false;
+		if(it->second->timing < earliest->second->timing)
+			earliest=it;
 	}
 
-	if(it==pendingEvents.end())
-		return;
-
-	TimingEvent* e=*it;
-	pendingEvents.erase(it);
+	TimingEvent* e=earliest->second;
+	jobEvents.erase(earliest);
+	bool first=(e->heapIndex==0);
+	eraseEvent(e->heapIndex);
 	delete e;
 
 	/* the worker is waiting on this job, wake him up */
@@ -22,6 +22,8 @@
 
 #include "compat.h"
 #include <list>
+#include <vector>
+#include <map>
 #include <time.h>
 #include "threading.h"
 
@@ -56,13 +58,18 @@ private:
 		bool isTick;
 		ITickJob* job;
 		//Timing are in milliseconds
-		Glib::TimeVal timing;
+		uint64_t timing;
 		uint32_t tickTime;
+		//Position in pendingEvents
+		uint32_t heapIndex;
 	};
 	Mutex mutex;
 	Cond newEvent;
 	Thread* t;
-	std::list<TimingEvent*> pendingEvents;
+	//Binary min-heap ordered by timing
+	std::vector<TimingEvent*> pendingEvents;
+	//Pending events of each job, to remove them without scanning the heap
+	std::multimap<ITickJob*, TimingEvent*> jobEvents;
 	SystemState* m_sys;
 	volatile bool stopped;
 	bool joined;
@@ -70,6 +77,11 @@ private:
 	void worker();
 	void insertNewEvent(TimingEvent* e);
 	void insertNewEvent_nolock(TimingEvent* e);
+	void unlinkJobEvent(TimingEvent* e);
+	void pushEvent(TimingEvent* e);
+	void eraseEvent(uint32_t index);
+	void siftUp(uint32_t index);
+	void siftDown(uint32_t index);
 	void dumpJobs();
 public:
 	TimerThread(SystemState* s);
@@ -0,0 +1,53 @@
+package {
+
+	import flash.utils.getTimer;
+
+	/* Times benchmarks side by side. Each run calls every benchmark once and
+	 * traces their times on one line, followed by their results so that the
+	 * work is not optimized away. The JIT compiles a method after it has been
+	 * called a few times, so the first runs are slower with -j */
+	public class PerfRunner {
+
+		private var names:Array = new Array();
+		private var benchmarks:Array = new Array();
+		private var argLists:Array = new Array();
+		private var operations:Array = new Array();
+		private var units:Array = new Array();
+
+		public function add(name:String, benchmark:Function, ...args):void {
+			push(name, 0, null, benchmark, args);
+		}
+
+		/* Also traces the rate of a benchmark that performs the given
+		 * number of operations per call, as units per ms */
+		public function addRate(name:String, count:Number, unit:String, benchmark:Function, ...args):void {
+			push(name, count, unit, benchmark, args);
+		}
+
+		private function push(name:String, count:Number, unit:String, benchmark:Function, args:Array):void {
+			names.push(name);
+			benchmarks.push(benchmark);
+			argLists.push(args);
+			operations.push(count);
+			units.push(unit);
+		}
+
+		public function run(runs:int):void {
+			for(var run:int = 0; run < runs; run++) {
+				var times:String = "";
+				var results:Array = new Array();
+				for(var i:int = 0; i < benchmarks.length; i++) {
+					var start:int = getTimer();
+					results.push(benchmarks[i].apply(null, argLists[i]));
+					var elapsed:int = getTimer() - start;
+					times += names[i] + ": " + elapsed + "ms ";
+					if(units[i])
+						times += "[" + Math.round(operations[i] / Math.max(elapsed, 1)) + " " + units[i] + "/ms] ";
+				}
+				trace(times + "(" + results.join(" ") + ")");
+			}
+		}
+
+	}
+
+}
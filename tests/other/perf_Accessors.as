@@ -0,0 +1,51 @@
+package {
+
+	import flash.display.Sprite;
+	import flash.geom.Point;
+
+	/* Reads properties through trivial getters, native getters and
+	 * plain fields. Run it with tightspark and the JIT enabled, the
+	 * getter rates should get close to the field one */
+	public class perf_Accessors extends Sprite {
+
+		private static const READS:int = 1000000;
+
+		private var _value:int = 1;
+		public var field:int = 1;
+
+		public function get value():int {
+			return _value;
+		}
+
+		private function getters():int {
+			var sum:int = 0;
+			for(var i:int = 0; i < READS; i++)
+				sum += this.value;
+			return sum;
+		}
+
+		private function nativeGetters(p:Point):Number {
+			var sum:Number = 0;
+			for(var i:int = 0; i < READS; i++)
+				sum += p.length;
+			return sum;
+		}
+
+		private function fields():int {
+			var sum:int = 0;
+			for(var i:int = 0; i < READS; i++)
+				sum += this.field;
+			return sum;
+		}
+
+		public function perf_Accessors() {
+			var runner:PerfRunner = new PerfRunner();
+			runner.add("getter", getters);
+			runner.add("native getter", nativeGetters, new Point(3, 4));
+			runner.add("field", fields);
+			runner.run(12);
+		}
+
+	}
+
+}
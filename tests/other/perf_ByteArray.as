@@ -0,0 +1,61 @@
+package {
+
+	import flash.display.Sprite;
+	import flash.utils.ByteArray;
+
+	/* Writes 100 MB sequentially into a ByteArray, reads it back and
+	 * slices it. Compare the traced throughput between builds */
+	public class perf_ByteArray extends Sprite {
+
+		private static const SIZE:uint = 100 * 1024 * 1024;
+		private static const CHUNK:uint = 64 * 1024;
+
+		private var b:ByteArray;
+
+		private function writeInt():uint {
+			b = new ByteArray();
+			for(var i:uint = 0; i < SIZE; i += 4)
+				b.writeInt(i);
+			return b.length;
+		}
+
+		private function writeBytes():uint {
+			var chunk:ByteArray = new ByteArray();
+			chunk.length = CHUNK;
+			var c:ByteArray = new ByteArray();
+			for(var i:uint = 0; i < SIZE; i += CHUNK)
+				c.writeBytes(chunk);
+			return c.length;
+		}
+
+		private function readInt():uint {
+			b.position = 0;
+			var sum:uint = 0;
+			for(var i:uint = 0; i < SIZE; i += 4)
+				sum += b.readInt();
+			return sum;
+		}
+
+		private function readBytes():uint {
+			var sum:uint = 0;
+			for(var i:uint = 0; i < 100; i++) {
+				var slice:ByteArray = new ByteArray();
+				b.position = 0;
+				b.readBytes(slice, 0, SIZE);
+				sum += slice[i];
+			}
+			return sum;
+		}
+
+		public function perf_ByteArray() {
+			var runner:PerfRunner = new PerfRunner();
+			runner.addRate("writeInt", SIZE / 1024, "KB", writeInt);
+			runner.addRate("writeBytes", SIZE / 1024, "KB", writeBytes);
+			runner.addRate("readInt", SIZE / 1024, "KB", readInt);
+			runner.add("readBytes of 100 copies", readBytes);
+			runner.run(3);
+		}
+
+	}
+
+}
@@ -0,0 +1,68 @@
+package {
+
+	import flash.display.Sprite;
+
+	/* Measures the per-call overhead of small functions, recursion,
+	 * missing arguments and closures. Run it with tightspark and compare
+	 * the traced rates between builds */
+	public class perf_Calls extends Sprite {
+
+		private static const CALLS:int = 1000000;
+		//fib(25) makes 242785 calls
+		private static const FIB_CALLS:int = 242785;
+
+		private var closure:Function;
+
+		private function add(a:int, b:int):int {
+			return a + b;
+		}
+
+		private function optional(a:int, b:* = undefined, c:* = undefined):int {
+			return a;
+		}
+
+		private function fib(n:int):int {
+			if(n < 2)
+				return n;
+			return fib(n - 1) + fib(n - 2);
+		}
+
+		private function methods():int {
+			var sum:int = 0;
+			for(var i:int = 0; i < CALLS; i++)
+				sum = add(sum, i);
+			return sum;
+		}
+
+		private function missingArguments():int {
+			var sum:int = 0;
+			for(var i:int = 0; i < CALLS; i++)
+				sum += optional(i);
+			return sum;
+		}
+
+		private function closures():int {
+			var sum:int = 0;
+			for(var i:int = 0; i < CALLS; i++)
+				sum = closure(sum);
+			return sum;
+		}
+
+		private function recursive():int {
+			return fib(25);
+		}
+
+		public function perf_Calls() {
+			var depth:int = 1;
+			closure = function(x:int):int { return x + depth; };
+			var runner:PerfRunner = new PerfRunner();
+			runner.addRate("method", CALLS, "calls", methods);
+			runner.addRate("missing arguments", CALLS, "calls", missingArguments);
+			runner.addRate("closure", CALLS, "calls", closures);
+			runner.addRate("recursive", FIB_CALLS, "calls", recursive);
+			runner.run(3);
+		}
+
+	}
+
+}
@@ -0,0 +1,79 @@
+package {
+
+	import flash.display.Sprite;
+
+	/* Runs small loops that are dominated by the dispatch of the interpreter:
+	 * locals and integer arithmetic, branches and switches, array accesses and
+	 * property accesses. Run it with tightspark without -j, so that the JIT
+	 * does not take over, and compare the traced rates between builds */
+	public class perf_Interpreter extends Sprite {
+
+		private static const ITERATIONS:int = 1000000;
+
+		private var counter:int = 0;
+
+		private function locals():int {
+			var a:int = 1;
+			var b:int = 2;
+			var c:int = 0;
+			for(var i:int = 0; i < ITERATIONS; i++) {
+				c = a + b * i;
+				a = b;
+				b = c & 0xffff;
+			}
+			return c;
+		}
+
+		private function branches():int {
+			var n:int = 0;
+			for(var i:int = 0; i < ITERATIONS; i++) {
+				if(i & 1)
+					n++;
+				else if(i & 2)
+					n += 2;
+				switch(i & 3) {
+					case 0:
+						n += 3;
+						break;
+					case 1:
+						n -= 1;
+						break;
+					default:
+						n ^= 1;
+				}
+			}
+			return n;
+		}
+
+		private function arrays():int {
+			var a:Array = new Array(256);
+			for(var j:int = 0; j < 256; j++)
+				a[j] = j;
+			var sum:int = 0;
+			for(var i:int = 0; i < ITERATIONS; i++) {
+				var k:int = i & 255;
+				sum += a[k];
+				a[k] = sum & 255;
+			}
+			return sum;
+		}
+
+		private function properties():int {
+			counter = 0;
+			for(var i:int = 0; i < ITERATIONS; i++)
+				counter = counter + 1;
+			return counter;
+		}
+
+		public function perf_Interpreter() {
+			var runner:PerfRunner = new PerfRunner();
+			runner.addRate("locals", ITERATIONS, "iterations", locals);
+			runner.addRate("branches", ITERATIONS, "iterations", branches);
+			runner.addRate("arrays", ITERATIONS, "iterations", arrays);
+			runner.addRate("properties", ITERATIONS, "iterations", properties);
+			runner.run(3);
+		}
+
+	}
+
+}
@@ -0,0 +1,79 @@
+package {
+
+	import flash.display.Sprite;
+
+	/* Creates many small objects and reads their properties back.
+	 * Compare the traced rates between builds. With PROFILING_SUPPORT,
+	 * --profiling-output also writes the bytes per object at exit */
+	public class perf_Properties extends Sprite {
+
+		private static const OBJECTS:int = 50000;
+		private static const LOOKUPS:int = 2000000;
+
+		private var objs:Array;
+		private var points:Array;
+
+		private function create():int {
+			objs = new Array();
+			for(var i:int = 0; i < OBJECTS; i++) {
+				var o:Object = new Object();
+				o.x = i;
+				o.y = i * 2;
+				o.name = "obj";
+				o.visible = true;
+				objs.push(o);
+			}
+			points = new Array();
+			for(i = 0; i < OBJECTS; i++)
+				points.push(new PerfPoint(i, i * 2));
+			return objs.length + points.length;
+		}
+
+		private function dynamicLookups():Number {
+			var sum:Number = 0;
+			for(var i:int = 0; i < LOOKUPS; i++) {
+				var o:Object = objs[i % OBJECTS];
+				sum += o.x + o.y;
+			}
+			return sum;
+		}
+
+		private function declaredLookups():Number {
+			var sum:Number = 0;
+			for(var i:int = 0; i < LOOKUPS; i++) {
+				var p:PerfPoint = points[i % OBJECTS];
+				sum += p.x + p.y;
+			}
+			return sum;
+		}
+
+		private function enumerate():int {
+			var names:int = 0;
+			for(var i:int = 0; i < OBJECTS; i++) {
+				for(var n:String in objs[i])
+					names++;
+			}
+			return names;
+		}
+
+		public function perf_Properties() {
+			var runner:PerfRunner = new PerfRunner();
+			runner.addRate("create", 2 * OBJECTS, "objects", create);
+			runner.addRate("dynamic", 2 * LOOKUPS, "lookups", dynamicLookups);
+			runner.addRate("declared", 2 * LOOKUPS, "lookups", declaredLookups);
+			runner.add("enumerate", enumerate);
+			runner.run(3);
+		}
+
+	}
+
+}
+
+class PerfPoint {
+	public var x:Number;
+	public var y:Number;
+	public function PerfPoint(_x:Number, _y:Number) {
+		x = _x;
+		y = _y;
+	}
+}
@@ -0,0 +1,51 @@
+package {
+
+	import flash.display.Shape;
+	import flash.display.Sprite;
+	import flash.events.Event;
+
+	/* Redraws a few hundred vector shapes on every frame, so that all of
+	 * them are rasterized again. Run it with different values of
+	 * [threads] workers in lightspark.conf. Close the player once "done"
+	 * is traced and compare the rasterization statistics it logs. Frame
+	 * times are bounded by the frame rate, so they are not traced */
+	public class perf_Rasterization extends Sprite {
+
+		private static const SHAPES:int = 300;
+		private static const FRAMES:int = 200;
+
+		private var shapes:Array = new Array();
+		private var frame:int = 0;
+
+		public function perf_Rasterization() {
+			for(var i:int = 0; i < SHAPES; i++) {
+				var s:Shape = new Shape();
+				s.x = (i % 20) * 32;
+				s.y = int(i / 20) * 32;
+				addChild(s);
+				shapes.push(s);
+			}
+			addEventListener(Event.ENTER_FRAME, redraw);
+		}
+
+		private function redraw(e:Event):void {
+			for(var i:int = 0; i < SHAPES; i++) {
+				var s:Shape = shapes[i];
+				s.graphics.clear();
+				s.graphics.lineStyle(1, 0x000000);
+				s.graphics.beginFill((i * 0x10203 + frame * 0x40) & 0xffffff);
+				s.graphics.drawRoundRect(0, 0, 28, 28, 4 + frame % 10, 4 + frame % 10);
+				s.graphics.drawCircle(14, 14, 4 + (i + frame) % 9);
+				s.graphics.curveTo(28, 28, 0, 28);
+				s.graphics.endFill();
+			}
+			frame++;
+			if(frame == FRAMES) {
+				removeEventListener(Event.ENTER_FRAME, redraw);
+				trace("done");
+			}
+		}
+
+	}
+
+}
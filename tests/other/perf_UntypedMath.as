@@ -0,0 +1,43 @@
+package {
+
+	import flash.display.Sprite;
+
+	/* Runs the same numeric loop on untyped and typed variables.
+	 * Run it with tightspark and the JIT enabled, the untyped rate
+	 * should get close to the typed one */
+	public class perf_UntypedMath extends Sprite {
+
+		private static const ITERATIONS:int = 2000000;
+
+		private function untyped():* {
+			var sum = 0;
+			var x = 0.5;
+			for(var i = 0; i < ITERATIONS; i++) {
+				sum = sum + i * x;
+				if(sum > 1000000)
+					sum = sum - 1000000;
+			}
+			return sum;
+		}
+
+		private function typed():Number {
+			var sum:Number = 0;
+			var x:Number = 0.5;
+			for(var i:int = 0; i < ITERATIONS; i++) {
+				sum = sum + i * x;
+				if(sum > 1000000)
+					sum = sum - 1000000;
+			}
+			return sum;
+		}
+
+		public function perf_UntypedMath() {
+			var runner:PerfRunner = new PerfRunner();
+			runner.add("untyped", untyped);
+			runner.add("typed", typed);
+			runner.run(12);
+		}
+
+	}
+
+}